@@ -0,0 +1,1486 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+/*
+ * dsremote-bench: measures the transport and the acquisition loop of a DHO800/DHO900
+ * (or dsremote-sim) and writes the results as JSON, so that releases can be compared.
+ *
+ * usage: dsremote-bench [options] <hostname|IP-address|/dev/usbtmcN>
+ *        dsremote-bench -c [-o <file>]
+ *
+ *  -n <iterations>  round trips per command for the latency test (default 200)
+ *  -r <repeats>     downloads per memory depth (default 3)
+ *  -d <depths>      comma separated memory depths for the deep memory throughput (default 1000000,25000000)
+ *  -s <seconds>     duration of the screen streaming test per channel count (default 5)
+ *  -o <file>        write the JSON to file instead of stdout
+ *  -b               baseline transport: LAN without the bulk transfer tuning (see tmc_lan.h),
+ *                   USB without the usbtmc fast path (see tmc_dev.c)
+ *  -q               LAN: enable TCP_QUICKACK
+ *  -c               only the sample conversion, no device needed
+ *
+ * The screen streaming results include the time per stage of the screen loop, see stage_timer.h.
+ * The sample conversion (wav_convert.h) is timed for every instruction set the CPU supports.
+ * The settings that are changed (channels on/off, memory depth, run/stop) are restored afterwards.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include "global.h"
+#include "utils.h"
+#include "connection.h"
+#include "tmc_dev.h"
+#include "tmc_cmd.h"
+#include "mem_download_thread.h"
+#include "screen_thread.h"
+#include "stage_timer.h"
+#include "wav_convert.h"
+
+
+#define BENCH_LAT_ITERATIONS   (200)
+#define BENCH_DL_REPEATS         (3)
+#define BENCH_SCRN_SECS          (5)
+
+#define BENCH_MAX_DEPTHS         (8)
+#define BENCH_MAX_LAT_CMDS      (16)
+
+/* bin n counts the samples from 2^(n-1) up to 2^n micro-Sec., bin 0 the samples below 1 micro-Sec. */
+#define BENCH_HIST_BINS         (32)
+
+/* time the device gets to fill the memory at a new memory depth before it's stopped (in milli-Sec.) */
+#define BENCH_ACQ_MS          (1000)
+
+#define BENCH_CNV_REPEATS        (5)
+#define BENCH_CNV_SIZES          (2)
+#define BENCH_CNV_FUNCS          (2)
+#define BENCH_CNV_LEVELS         (3)
+
+
+struct bench_config
+{
+  char device[MAX_PATHLEN];
+  int lat_iter;
+  int dl_repeats;
+  int scrn_secs;
+  int depths[BENCH_MAX_DEPTHS];
+  int depth_cnt;
+  char out_path[MAX_PATHLEN];
+  int lan_tuning;  /* TMC_LAN_xxx */
+  int usb_fastpath;
+  int cnv_only;
+};
+
+
+struct bench_stats
+{
+  int samples;
+  double min,  /* micro-Sec. */
+         mean,
+         p50,
+         p95,
+         p99,
+         max;
+  int hist[BENCH_HIST_BINS];
+};
+
+
+struct bench_lat
+{
+  int cmd_class;
+  char cmd[128];
+  struct bench_stats stats;
+};
+
+
+struct bench_thrput
+{
+  int points;
+  int bytes;
+  double mbs;  /* MB/s over all repeats */
+  double wire_mbs;  /* MB/s while a block was being received */
+  struct bench_stats stats;
+};
+
+
+struct bench_fps
+{
+  int channels;
+  int frames;
+  double secs;
+  double fps;
+  struct stgtmr_stats stages[STGTMR_CNT];  /* of the last STGTMR_WINDOW_NS of the run */
+};
+
+
+struct bench_cnv
+{
+  int func;  /* index in bench_cnv_names */
+  int level;  /* WAVCNV_xxx */
+  int points;
+  double min_ms;
+  double mean_ms;
+  double mpts;  /* million points per second, of the fastest run */
+};
+
+
+struct bench_results
+{
+  struct bench_lat lat[BENCH_MAX_LAT_CMDS];
+  int lat_cnt;
+  struct bench_stats lat_class[TMC_CMD_CLASS_CNT];
+  struct bench_thrput scrn;
+  struct bench_thrput mem[BENCH_MAX_DEPTHS];
+  int mem_cnt;
+  struct bench_fps fps[MAX_CHNS];
+  int fps_cnt;
+  struct bench_cnv cnv[BENCH_CNV_LEVELS * BENCH_CNV_SIZES * BENCH_CNV_FUNCS];
+  int cnv_cnt;
+};
+
+
+/* device state that is restored when done */
+struct bench_saved
+{
+  int valid;
+  int chandisplay[MAX_CHNS];
+  char memdepth[64];
+  int running;
+};
+
+
+static struct tmcdev *device=NULL;
+
+static const char *bench_class_names[TMC_CMD_CLASS_CNT]={"query", "wav", "setting", "slow"};
+
+static const char *bench_cnv_names[BENCH_CNV_FUNCS]={"u8_to_s16", "s16_to_double"};
+
+static const char *bench_cnv_levels[BENCH_CNV_LEVELS]={"scalar", "sse2", "avx2"};
+
+/* the memory depths of the conversion test */
+static const int bench_cnv_sizes[BENCH_CNV_SIZES]={1000000, 24000000};
+
+
+static int bench_parse_args(int, char **, struct bench_config *);
+static int bench_open(struct bench_config *, struct device_settings *, char *, int);
+static int bench_query(const char *, char *, int);
+static int bench_save_state(struct device_settings *, struct bench_saved *, char *, int);
+static void bench_restore_state(struct device_settings *, struct bench_saved *);
+static int bench_set_channels(struct device_settings *, int, char *, int);
+static int bench_latency(struct bench_config *, struct bench_results *, char *, int);
+static int bench_screen_block(struct bench_config *, struct bench_results *, char *, int);
+static int bench_screen_fps(struct bench_config *, struct device_settings *, int, struct bench_fps *, char *, int);
+static int bench_memory(struct bench_config *, struct device_settings *, int, struct bench_thrput *, char *, int);
+static int bench_conversion(struct bench_results *, char *, int);
+static int bench_cmp_dbl(const void *, const void *);
+static void bench_calc_stats(double *, int, struct bench_stats *);
+static void bench_json_str(FILE *, const char *);
+static void bench_json_stats(FILE *, struct bench_stats *);
+static int bench_write_json(struct bench_config *, struct device_settings *, struct bench_results *, int);
+
+
+
+int main(int argc, char *argv[])
+{
+  int i, err=1, json_fd;
+
+  char str[1024]="";
+
+  struct bench_config cfg;
+
+  struct device_settings *devparms=NULL;
+
+  struct bench_results *res=NULL;
+
+  struct bench_saved saved;
+
+  QCoreApplication app(argc, argv);
+
+  memset(&saved, 0, sizeof(struct bench_saved));
+
+  if(bench_parse_args(argc, argv, &cfg))
+  {
+    fprintf(stderr,
+            "usage: dsremote-bench [options] <hostname|IP-address|/dev/usbtmcN>\n"
+            "       dsremote-bench -c [-o <file>]\n\n"
+            "  -n <iterations>  round trips per command for the latency test (default %i)\n"
+            "  -r <repeats>     downloads per memory depth (default %i)\n"
+            "  -d <depths>      comma separated memory depths (default 1000000,25000000)\n"
+            "  -s <seconds>     duration of the screen streaming test per channel count (default %i)\n"
+            "  -o <file>        write the JSON to file instead of stdout\n"
+            "  -b               baseline transport, LAN without bulk tuning, USB without fast path\n"
+            "  -q               LAN: enable TCP_QUICKACK\n"
+            "  -c               only the sample conversion, no device needed\n",
+            BENCH_LAT_ITERATIONS, BENCH_DL_REPEATS, BENCH_SCRN_SECS);
+    return EXIT_FAILURE;
+  }
+
+  /* the transport prints the commands to stdout, keep stdout for the JSON only */
+  fflush(stdout);
+
+  json_fd = dup(STDOUT_FILENO);
+  if((json_fd < 0) || (dup2(STDERR_FILENO, STDOUT_FILENO) < 0))
+  {
+    fprintf(stderr, "Can not redirect stdout.\n");
+    return EXIT_FAILURE;
+  }
+
+  devparms = (struct device_settings *)calloc(1, sizeof(struct device_settings));
+  res = (struct bench_results *)calloc(1, sizeof(struct bench_results));
+  if((devparms == NULL) || (res == NULL))
+  {
+    fprintf(stderr, "Malloc error.\n");
+    goto OUT;
+  }
+
+  /* the GUI buffers that screen_thread::get_frame() swaps with its own frame buffers */
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    devparms->wavebuf[i] = (short *)calloc(1, WAVFRM_MAX_BUFSZ * sizeof(short));
+    if(devparms->wavebuf[i] == NULL)
+    {
+      fprintf(stderr, "Malloc error.\n");
+      goto OUT;
+    }
+  }
+
+  devparms->fftbuf_out = (double *)calloc(1, FFT_MAX_BUFSZ * sizeof(double));
+  if(devparms->fftbuf_out == NULL)
+  {
+    fprintf(stderr, "Malloc error.\n");
+    goto OUT;
+  }
+
+  if(cfg.cnv_only)
+  {
+    fprintf(stderr, "sample conversion...\n");
+
+    if(bench_conversion(res, str, 1024))
+    {
+      fprintf(stderr, "%s\n", str);
+      goto OUT;
+    }
+
+    if(bench_write_json(&cfg, devparms, res, json_fd))
+    {
+      fprintf(stderr, "Can not write the results.\n");
+      goto OUT;
+    }
+
+    err = 0;
+
+    goto OUT;
+  }
+
+  if(bench_open(&cfg, devparms, str, 1024))
+  {
+    fprintf(stderr, "%s\n", str);
+    goto OUT;
+  }
+
+  if(bench_save_state(devparms, &saved, str, 1024))  goto OUT_ERROR;
+
+  if(tmc_write(":RUN") < 0)
+  {
+    snprintf(str, 1024, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    goto OUT_ERROR;
+  }
+
+  if(bench_set_channels(devparms, 1, str, 1024))  goto OUT_ERROR;
+
+  fprintf(stderr, "latency...\n");
+
+  if(bench_latency(&cfg, res, str, 1024))  goto OUT_ERROR;
+
+  fprintf(stderr, "screen block throughput...\n");
+
+  if(bench_screen_block(&cfg, res, str, 1024))  goto OUT_ERROR;
+
+  for(i=0; i<devparms->channel_cnt; i++)
+  {
+    fprintf(stderr, "screen streaming, %i channel(s)...\n", i + 1);
+
+    if(bench_screen_fps(&cfg, devparms, i + 1, &res->fps[i], str, 1024))  goto OUT_ERROR;
+
+    res->fps_cnt++;
+  }
+
+  if(bench_set_channels(devparms, 1, str, 1024))  goto OUT_ERROR;
+
+  for(i=0; i<cfg.depth_cnt; i++)
+  {
+    fprintf(stderr, "deep memory throughput, %i points...\n", cfg.depths[i]);
+
+    if(bench_memory(&cfg, devparms, cfg.depths[i], &res->mem[i], str, 1024))  goto OUT_ERROR;
+
+    res->mem_cnt++;
+  }
+
+  bench_restore_state(devparms, &saved);
+
+  fprintf(stderr, "sample conversion...\n");
+
+  if(bench_conversion(res, str, 1024))
+  {
+    fprintf(stderr, "%s\n", str);
+    goto OUT;
+  }
+
+  if(bench_write_json(&cfg, devparms, res, json_fd))
+  {
+    fprintf(stderr, "Can not write the results.\n");
+    goto OUT;
+  }
+
+  err = 0;
+
+  goto OUT;
+
+OUT_ERROR:
+
+  fprintf(stderr, "%s\n", str);
+
+  bench_restore_state(devparms, &saved);
+
+OUT:
+
+  if(device != NULL)
+  {
+    tmc_close();
+
+    device = NULL;
+  }
+
+  if(devparms != NULL)
+  {
+    for(i=0; i<MAX_CHNS; i++)
+    {
+      free(devparms->wavebuf[i]);
+    }
+
+    free(devparms->fftbuf_out);
+  }
+
+  free(devparms);
+  free(res);
+
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static int bench_parse_args(int argc, char **argv, struct bench_config *cfg)
+{
+  int c;
+
+  char str[512],
+       *ptr;
+
+  memset(cfg, 0, sizeof(struct bench_config));
+
+  cfg->lat_iter = BENCH_LAT_ITERATIONS;
+  cfg->dl_repeats = BENCH_DL_REPEATS;
+  cfg->scrn_secs = BENCH_SCRN_SECS;
+  cfg->depths[0] = 1000000;
+  cfg->depths[1] = 25000000;
+  cfg->depth_cnt = 2;
+  cfg->lan_tuning = TMC_LAN_BULK;
+  cfg->usb_fastpath = 1;
+
+  while((c = getopt(argc, argv, "n:r:d:s:o:bqc")) != -1)
+  {
+    switch(c)
+    {
+      case 'n': cfg->lat_iter = atoi(optarg);
+                break;
+      case 'r': cfg->dl_repeats = atoi(optarg);
+                break;
+      case 's': cfg->scrn_secs = atoi(optarg);
+                break;
+      case 'o': strlcpy(cfg->out_path, optarg, MAX_PATHLEN);
+                break;
+      case 'b': cfg->lan_tuning &= ~TMC_LAN_BULK;
+                cfg->usb_fastpath = 0;
+                break;
+      case 'q': cfg->lan_tuning |= TMC_LAN_QUICKACK;
+                break;
+      case 'c': cfg->cnv_only = 1;
+                break;
+      case 'd': strlcpy(str, optarg, 512);
+                cfg->depth_cnt = 0;
+                for(ptr=strtok(str, ", "); ptr!=NULL; ptr=strtok(NULL, ", "))
+                {
+                  if(cfg->depth_cnt == BENCH_MAX_DEPTHS)
+                  {
+                    return -1;
+                  }
+
+                  cfg->depths[cfg->depth_cnt] = atoi(ptr);
+                  if(cfg->depths[cfg->depth_cnt] < 1000)
+                  {
+                    return -1;
+                  }
+
+                  cfg->depth_cnt++;
+                }
+                break;
+      default : return -1;
+    }
+  }
+
+  if((cfg->lat_iter < 1) || (cfg->dl_repeats < 1) || (cfg->scrn_secs < 1))
+  {
+    return -1;
+  }
+
+  if(cfg->cnv_only)
+  {
+    return (optind == argc) ? 0 : -1;
+  }
+
+  if(optind != (argc - 1))
+  {
+    return -1;
+  }
+
+  strlcpy(cfg->device, argv[optind], MAX_PATHLEN);
+
+  return 0;
+}
+
+
+static int bench_open(struct bench_config *cfg, struct device_settings *devparms, char *err, int err_sz)
+{
+  char resp_str[1024],
+       *ptr;
+
+  if(!strncmp(cfg->device, "/dev/", 5))
+  {
+    device = tmc_open_usb(cfg->device);
+  }
+  else
+  {
+    device = tmc_open_lan(cfg->device);
+  }
+
+  if(device == NULL)
+  {
+    snprintf(err, err_sz, "Can not open connection to %s", cfg->device);
+    return -1;
+  }
+
+  tmc_set_lan_tuning(cfg->lan_tuning);
+
+  tmc_set_usb_fastpath(cfg->usb_fastpath);
+
+  if(bench_query("*IDN?", resp_str, 1024))
+  {
+    snprintf(err, err_sz, "Can not read from device %s", cfg->device);
+    goto OUT_ERROR;
+  }
+
+  ptr = strtok(resp_str, ",");
+  if((ptr == NULL) || (strcmp(ptr, "RIGOL TECHNOLOGIES") && strcmp(ptr, "NK TECHNOLOGIES")))
+  {
+    snprintf(err, err_sz, "Received an unknown identification string from device: %s", device->buf);
+    goto OUT_ERROR;
+  }
+
+  ptr = strtok(NULL, ",");
+
+  /* DHO802, DHO804, DHO812, DHO814, DHO914, DHO924, DHO914S, DHO924S */
+  if((ptr == NULL) || strncmp(ptr, "DHO", 3) || (strlen(ptr) < 6) ||
+     ((ptr[3] != '8') && (ptr[3] != '9')) || ((ptr[5] != '2') && (ptr[5] != '4')))
+  {
+    snprintf(err, err_sz, "Unsupported device: %s", device->buf);
+    goto OUT_ERROR;
+  }
+
+  strlcpy(devparms->modelname, ptr, 128);
+
+  devparms->modelserie = 7;
+
+  devparms->channel_cnt = ptr[5] - '0';
+
+  ptr = strtok(NULL, ",");
+  if(ptr != NULL)
+  {
+    strlcpy(devparms->serialnr, ptr, 128);
+  }
+
+  devparms->connected = 1;
+
+  devparms->wav_multichn = -1;  // probe on first use
+
+  devparms->mem_blk_sz = 0;
+
+  devparms->mem_blk_max = SAV_MEM_BSZ_MAX_DHO;
+
+  fprintf(stderr, "connected to %s %s\n", devparms->modelname, devparms->serialnr);
+
+  return 0;
+
+OUT_ERROR:
+
+  tmc_close();
+
+  device = NULL;
+
+  return -1;
+}
+
+
+static int bench_query(const char *cmd, char *dest, int sz)
+{
+  if(tmc_write(cmd) != (int)strlen(cmd))
+  {
+    return -1;
+  }
+
+  if(tmc_read() < 1)
+  {
+    return -1;
+  }
+
+  strlcpy(dest, device->buf, sz);
+
+  return 0;
+}
+
+
+static int bench_save_state(struct device_settings *devparms, struct bench_saved *saved, char *err, int err_sz)
+{
+  int chn;
+
+  char str[128],
+       resp[128];
+
+  for(chn=0; chn<devparms->channel_cnt; chn++)
+  {
+    snprintf(str, 128, ":CHAN%i:DISP?", chn + 1);
+
+    if(bench_query(str, resp, 128))
+    {
+      snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    saved->chandisplay[chn] = atoi(resp);
+  }
+
+  if(bench_query(":ACQ:MDEP?", saved->memdepth, 64))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  if(bench_query(":TRIG:STAT?", resp, 128))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  saved->running = strcmp(resp, "STOP") ? 1 : 0;
+
+  saved->valid = 1;
+
+  return 0;
+}
+
+
+static void bench_restore_state(struct device_settings *devparms, struct bench_saved *saved)
+{
+  int chn;
+
+  char str[128];
+
+  if(!saved->valid)
+  {
+    return;
+  }
+
+  mem_download_thread::restore_device(devparms);
+
+  for(chn=0; chn<devparms->channel_cnt; chn++)
+  {
+    snprintf(str, 128, ":CHAN%i:DISP %i", chn + 1, saved->chandisplay[chn]);
+
+    tmc_write(str);
+  }
+
+  snprintf(str, 128, ":ACQ:MDEP %s", saved->memdepth);
+
+  tmc_write(str);
+
+  tmc_write(saved->running ? ":RUN" : ":STOP");
+
+  saved->valid = 0;
+}
+
+
+/* switches the first chns channels on and the others off, reads their vertical scale */
+static int bench_set_channels(struct device_settings *devparms, int chns, char *err, int err_sz)
+{
+  int chn;
+
+  char str[128],
+       resp[128];
+
+  for(chn=0; chn<devparms->channel_cnt; chn++)
+  {
+    devparms->chandisplay[chn] = (chn < chns) ? 1 : 0;
+
+    snprintf(str, 128, ":CHAN%i:DISP %i", chn + 1, devparms->chandisplay[chn]);
+
+    if(tmc_write(str) < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    if(!devparms->chandisplay[chn])
+    {
+      continue;
+    }
+
+    snprintf(str, 128, ":CHAN%i:SCAL?", chn + 1);
+
+    if(bench_query(str, resp, 128))
+    {
+      snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    devparms->chanscale[chn] = atof(resp);
+  }
+
+  return 0;
+}
+
+
+/*
+ * Round trip times of tmc_write() (and tmc_read() for queries) per command.
+ * Setters include the completion wait of their command class, same as in the GUI.
+ * The setters write the value the device already has.
+ */
+static int bench_latency(struct bench_config *cfg, struct bench_results *res, char *err, int err_sz)
+{
+  int i, j, n, cls,
+      cls_cnt[TMC_CMD_CLASS_CNT];
+
+  char resp[128];
+
+  double *smps=NULL,
+         *cls_smps[TMC_CMD_CLASS_CNT];
+
+  QElapsedTimer tmr;
+
+  const char *queries[]={"*IDN?", ":TRIG:STAT?", ":ACQ:SRAT?", ":ACQ:MDEP?", ":CHAN1:SCAL?"};
+
+  const char *wav_cmds[]={":WAV:SOUR CHAN1", ":WAV:FORM BYTE", ":WAV:MODE NORM"};
+
+  for(i=0; i<TMC_CMD_CLASS_CNT; i++)
+  {
+    cls_smps[i] = NULL;
+
+    cls_cnt[i] = 0;
+  }
+
+  n = 0;
+
+  for(i=0; i<5; i++)
+  {
+    strlcpy(res->lat[n++].cmd, queries[i], 128);
+  }
+
+  for(i=0; i<3; i++)
+  {
+    strlcpy(res->lat[n++].cmd, wav_cmds[i], 128);
+  }
+
+  if(bench_query(":TIM:SCAL?", resp, 128))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  snprintf(res->lat[n++].cmd, 128, ":TIM:SCAL %s", resp);
+
+  if(bench_query(":CHAN1:SCAL?", resp, 128))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  snprintf(res->lat[n++].cmd, 128, ":CHAN1:SCAL %s", resp);
+
+  res->lat_cnt = n;
+
+  smps = (double *)malloc(cfg->lat_iter * sizeof(double));
+  if(smps == NULL)
+  {
+    snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    goto OUT_ERROR;
+  }
+
+  for(i=0; i<TMC_CMD_CLASS_CNT; i++)
+  {
+    cls_smps[i] = (double *)malloc(cfg->lat_iter * res->lat_cnt * sizeof(double));
+    if(cls_smps[i] == NULL)
+    {
+      snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+      goto OUT_ERROR;
+    }
+  }
+
+  for(i=0; i<res->lat_cnt; i++)
+  {
+    cls = tmc_cmd_class(res->lat[i].cmd);
+
+    res->lat[i].cmd_class = cls;
+
+    for(j=0; j<cfg->lat_iter; j++)
+    {
+      tmr.start();
+
+      if(tmc_write(res->lat[i].cmd) < 0)
+      {
+        snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+        goto OUT_ERROR;
+      }
+
+      if(cls == TMC_CMD_CLASS_QUERY)
+      {
+        if(tmc_read() < 1)
+        {
+          snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+          goto OUT_ERROR;
+        }
+      }
+
+      smps[j] = tmr.nsecsElapsed() / 1e3;
+
+      cls_smps[cls][cls_cnt[cls]++] = smps[j];
+    }
+
+    bench_calc_stats(smps, cfg->lat_iter, &res->lat[i].stats);
+  }
+
+  for(i=0; i<TMC_CMD_CLASS_CNT; i++)
+  {
+    bench_calc_stats(cls_smps[i], cls_cnt[i], &res->lat_class[i]);
+
+    free(cls_smps[i]);
+  }
+
+  free(smps);
+
+  return 0;
+
+OUT_ERROR:
+
+  for(i=0; i<TMC_CMD_CLASS_CNT; i++)
+  {
+    free(cls_smps[i]);
+  }
+
+  free(smps);
+
+  return -1;
+}
+
+
+/* the :WAV:DATA? block that screen_thread downloads for every channel of every frame */
+static int bench_screen_block(struct bench_config *cfg, struct bench_results *res, char *err, int err_sz)
+{
+  int i, n;
+
+  long long bytes=0;
+
+  double secs=0,
+         *smps=NULL;
+
+  char *buf=NULL;
+
+  QElapsedTimer tmr;
+
+  const char *wav_cmds[]={":WAV:SOUR CHAN1", ":WAV:FORM BYTE", ":WAV:MODE NORM"};
+
+  if(tmc_write_batch_cached(wav_cmds, 3) != 3)
+  {
+    snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  smps = (double *)malloc(cfg->lat_iter * sizeof(double));
+  buf = (char *)malloc(WAVFRM_MAX_BUFSZ);
+  if((smps == NULL) || (buf == NULL))
+  {
+    snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    goto OUT_ERROR;
+  }
+
+  for(i=0; i<cfg->lat_iter; i++)
+  {
+    tmr.start();
+
+    if(tmc_write(":WAV:DATA?") != 10)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      goto OUT_ERROR;
+    }
+
+    n = tmc_read_block(buf, WAVFRM_MAX_BUFSZ);
+    if(n < 1)
+    {
+      snprintf(err, err_sz, "Can not read from device. (n is %i)  line %i file %s", n, __LINE__, __FILE__);
+      goto OUT_ERROR;
+    }
+
+    smps[i] = tmr.nsecsElapsed() / 1e3;
+
+    secs += smps[i] / 1e6;
+
+    bytes += n;
+  }
+
+  res->scrn.points = n;
+
+  res->scrn.bytes = n;
+
+  res->scrn.mbs = (secs > 0) ? (bytes / secs / 1e6) : 0;
+
+  bench_calc_stats(smps, cfg->lat_iter, &res->scrn.stats);
+
+  free(smps);
+  free(buf);
+
+  return 0;
+
+OUT_ERROR:
+
+  free(smps);
+  free(buf);
+
+  return -1;
+}
+
+
+/*
+ * Runs screen_thread in streaming mode, the same way the GUI does, and counts the
+ * frames it publishes. The first frame is not counted because it includes the
+ * probe of the multichannel readout.
+ */
+static int bench_screen_fps(struct bench_config *cfg, struct device_settings *devparms, int chns,
+                            struct bench_fps *res, char *err, int err_sz)
+{
+  int i, error=0;
+
+  long long t_first=0,
+            t_last=0;
+
+  QElapsedTimer tmr;
+
+  screen_thread *scrn_thrd;
+
+  res->channels = chns;
+
+  if(bench_set_channels(devparms, chns, err, err_sz))
+  {
+    return -1;
+  }
+
+  scrn_thrd = new screen_thread;
+
+  scrn_thrd->set_device(device);
+
+  stgtmr_reset();
+
+  stgtmr_enable(1);
+
+  scrn_thrd->start_streaming(devparms);
+
+  tmr.start();
+
+  while(tmr.elapsed() < (cfg->scrn_secs * 1000LL))
+  {
+    if(!scrn_thrd->get_frame(devparms))
+    {
+      if(!scrn_thrd->isRunning())
+      {
+        snprintf(err, err_sz, "The screen thread stopped.  line %i file %s", __LINE__, __FILE__);
+        error = 1;
+        break;
+      }
+
+      usleep(1000);
+
+      continue;
+    }
+
+    if(devparms->thread_error_stat)
+    {
+      snprintf(err, err_sz, "The screen thread returned error %i from line %i.",
+               devparms->thread_error_stat, devparms->thread_error_line);
+      error = 1;
+      break;
+    }
+
+    if(!res->frames)
+    {
+      t_first = tmr.nsecsElapsed();
+    }
+
+    t_last = tmr.nsecsElapsed();
+
+    res->frames++;
+  }
+
+  for(i=0; i<STGTMR_CNT; i++)
+  {
+    stgtmr_get_stats(i, &res->stages[i]);
+  }
+
+  stgtmr_enable(0);
+
+  scrn_thrd->stop_streaming();
+
+  scrn_thrd->detach_frames(devparms);
+
+  delete scrn_thrd;
+
+  if(error)
+  {
+    return -1;
+  }
+
+  if(res->frames < 2)
+  {
+    snprintf(err, err_sz, "The screen thread published less than two frames in %i seconds.", cfg->scrn_secs);
+    return -1;
+  }
+
+  res->frames--;
+
+  res->secs = (t_last - t_first) / 1e9;
+
+  res->fps = res->frames / res->secs;
+
+  return 0;
+}
+
+
+/* acquires at memory depth depth and downloads the memory of channel 1 with mem_download_thread */
+static int bench_memory(struct bench_config *cfg, struct device_settings *devparms, int depth,
+                        struct bench_thrput *res, char *err, int err_sz)
+{
+  int i, mempnts,
+      yref[MAX_CHNS];
+
+  long long bytes=0, xfer_bytes, xfer_nsec, xfer_bytes2, xfer_nsec2;
+
+  char str[128],
+       resp[128];
+
+  double secs=0,
+         *smps=NULL;
+
+  short *wavbuf[MAX_CHNS];
+
+  QElapsedTimer tmr;
+
+  mem_download_thread dl_thrd;
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    wavbuf[i] = NULL;
+  }
+
+  snprintf(str, 128, ":ACQ:MDEP %i", depth);
+
+  if((tmc_write(str) < 0) || (tmc_write(":RUN") < 0))
+  {
+    snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  usleep(BENCH_ACQ_MS * 1000);
+
+  if(tmc_write(":STOP") < 0)
+  {
+    snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  if(bench_query(":ACQ:MDEP?", resp, 128))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  mempnts = atoi(resp);
+
+  if(mempnts != depth)
+  {
+    snprintf(err, err_sz, "The device does not accept a memory depth of %i points (reads back %s).", depth, resp);
+    return -1;
+  }
+
+  devparms->acquirememdepth = mempnts;
+
+  res->points = mempnts;
+
+  res->bytes = mempnts;
+
+  smps = (double *)malloc(cfg->dl_repeats * sizeof(double));
+  wavbuf[0] = (short *)malloc(mempnts * sizeof(short));
+  if((smps == NULL) || (wavbuf[0] == NULL))
+  {
+    snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    goto OUT_ERROR;
+  }
+
+  if(mem_download_thread::prepare_device(device, devparms, yref, err, err_sz))
+  {
+    goto OUT_ERROR;
+  }
+
+  tmc_get_xfer_stats(&xfer_bytes, &xfer_nsec);
+
+  for(i=0; i<cfg->dl_repeats; i++)
+  {
+    dl_thrd.set_params(devparms, wavbuf, yref, mempnts);
+
+    tmr.start();
+
+    dl_thrd.start();
+
+    dl_thrd.wait();
+
+    smps[i] = tmr.nsecsElapsed() / 1e3;
+
+    devparms->wav_multichn = dl_thrd.get_wav_multichn();
+
+    dl_thrd.get_blk_sz(&devparms->mem_blk_sz, &devparms->mem_blk_max);
+
+    if(dl_thrd.get_error_num())
+    {
+      dl_thrd.get_error_str(err, err_sz);
+      goto OUT_ERROR;
+    }
+
+    secs += smps[i] / 1e6;
+
+    bytes += mempnts;
+  }
+
+  res->mbs = (secs > 0) ? (bytes / secs / 1e6) : 0;
+
+  tmc_get_xfer_stats(&xfer_bytes2, &xfer_nsec2);
+
+  res->wire_mbs = (xfer_nsec2 > xfer_nsec) ? ((xfer_bytes2 - xfer_bytes) * 1e3 / (xfer_nsec2 - xfer_nsec)) : 0;
+
+  bench_calc_stats(smps, cfg->dl_repeats, &res->stats);
+
+  free(smps);
+  free(wavbuf[0]);
+
+  return 0;
+
+OUT_ERROR:
+
+  free(smps);
+  free(wavbuf[0]);
+
+  return -1;
+}
+
+
+/*
+ * Times wavcnv_u8_to_s16() and wavcnv_s16_to_double() with every instruction set
+ * the CPU supports, the way the screen and memory downloads use them.
+ */
+static int bench_conversion(struct bench_results *res, char *err, int err_sz)
+{
+  int i, lvl, max_lvl, sz, fn, rep, n;
+
+  long long nsec;
+
+  double t_min, t_sum;
+
+  unsigned char *src8=NULL;
+
+  short *buf16=NULL;
+
+  double *buf_dbl=NULL;
+
+  struct bench_cnv *cnv;
+
+  QElapsedTimer tmr;
+
+  n = bench_cnv_sizes[BENCH_CNV_SIZES - 1];
+
+  src8 = (unsigned char *)malloc(n);
+  buf16 = (short *)malloc(n * sizeof(short));
+  buf_dbl = (double *)malloc(n * sizeof(double));
+  if((src8 == NULL) || (buf16 == NULL) || (buf_dbl == NULL))
+  {
+    snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    free(src8);
+    free(buf16);
+    free(buf_dbl);
+    return -1;
+  }
+
+  srand(1);
+
+  for(i=0; i<n; i++)
+  {
+    src8[i] = rand() & 0xff;
+  }
+
+  max_lvl = wavcnv_level();
+
+  res->cnv_cnt = 0;
+
+  for(lvl=WAVCNV_SCALAR; lvl<=max_lvl; lvl++)
+  {
+    wavcnv_set_level(lvl);
+
+    for(sz=0; sz<BENCH_CNV_SIZES; sz++)
+    {
+      n = bench_cnv_sizes[sz];
+
+      for(fn=0; fn<BENCH_CNV_FUNCS; fn++)
+      {
+        t_min = 1e30;
+
+        t_sum = 0;
+
+        for(rep=0; rep<=BENCH_CNV_REPEATS; rep++)  // the first run pages the buffers in and is not counted
+        {
+          tmr.start();
+
+          if(fn == 0)
+          {
+            wavcnv_u8_to_s16(buf16, src8, n, 127, 0);
+          }
+          else
+          {
+            wavcnv_s16_to_double(buf_dbl, buf16, n, 0.04);
+          }
+
+          nsec = tmr.nsecsElapsed();
+
+          if(!rep)  continue;
+
+          if((nsec / 1e6) < t_min)  t_min = nsec / 1e6;
+
+          t_sum += nsec / 1e6;
+        }
+
+        cnv = &res->cnv[res->cnv_cnt++];
+
+        cnv->func = fn;
+        cnv->level = lvl;
+        cnv->points = n;
+        cnv->min_ms = t_min;
+        cnv->mean_ms = t_sum / BENCH_CNV_REPEATS;
+        cnv->mpts = (t_min > 0) ? ((n / 1e6) / (t_min / 1e3)) : 0;
+
+        fprintf(stderr, "  %-13s %-6s %8i points: %8.3f ms\n",
+                bench_cnv_names[fn], bench_cnv_levels[lvl], n, t_min);
+      }
+    }
+  }
+
+  wavcnv_set_level(max_lvl);
+
+  free(src8);
+  free(buf16);
+  free(buf_dbl);
+
+  return 0;
+}
+
+
+static int bench_cmp_dbl(const void *a, const void *b)
+{
+  if(*(const double *)a < *(const double *)b)  return -1;
+
+  if(*(const double *)a > *(const double *)b)  return 1;
+
+  return 0;
+}
+
+
+/* sorts smps, the percentiles use the nearest rank method */
+static void bench_calc_stats(double *smps, int n, struct bench_stats *st)
+{
+  int i, bin;
+
+  double sum=0;
+
+  memset(st, 0, sizeof(struct bench_stats));
+
+  if(n < 1)
+  {
+    return;
+  }
+
+  qsort(smps, n, sizeof(double), bench_cmp_dbl);
+
+  for(i=0; i<n; i++)
+  {
+    sum += smps[i];
+
+    for(bin=0; (bin < (BENCH_HIST_BINS - 1)) && (smps[i] >= (1LL << bin)); bin++);
+
+    st->hist[bin]++;
+  }
+
+  st->samples = n;
+  st->min = smps[0];
+  st->max = smps[n - 1];
+  st->mean = sum / n;
+  st->p50 = smps[(int)ceil(n * 0.50) - 1];
+  st->p95 = smps[(int)ceil(n * 0.95) - 1];
+  st->p99 = smps[(int)ceil(n * 0.99) - 1];
+}
+
+
+static void bench_json_str(FILE *f, const char *str)
+{
+  fputc('"', f);
+
+  for(; *str!=0; str++)
+  {
+    if((*str == '"') || (*str == '\\'))
+    {
+      fputc('\\', f);
+    }
+
+    if((unsigned char)*str < 32)
+    {
+      continue;
+    }
+
+    fputc(*str, f);
+  }
+
+  fputc('"', f);
+}
+
+
+/* the histogram is written up to the last bin that is not empty */
+static void bench_json_stats(FILE *f, struct bench_stats *st)
+{
+  int i, last=0;
+
+  fprintf(f, "\"samples\": %i, \"min_us\": %.1f, \"mean_us\": %.1f, \"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"hist_log2_us\": [",
+          st->samples, st->min, st->mean, st->p50, st->p95, st->p99, st->max);
+
+  for(i=0; i<BENCH_HIST_BINS; i++)
+  {
+    if(st->hist[i])
+    {
+      last = i;
+    }
+  }
+
+  for(i=0; i<=last; i++)
+  {
+    fprintf(f, "%s%i", i ? ", " : "", st->hist[i]);
+  }
+
+  fprintf(f, "]");
+}
+
+
+/* writes to the file of option -o or else to json_fd (the original stdout) */
+static int bench_write_json(struct bench_config *cfg, struct device_settings *devparms, struct bench_results *res, int json_fd)
+{
+  int i, j, n, err;
+
+  char str[64];
+
+  struct stgtmr_stats *st;
+
+  time_t t;
+
+  struct tm tm_s;
+
+  FILE *f;
+
+  if(cfg->out_path[0])
+  {
+    f = fopen(cfg->out_path, "wb");
+  }
+  else
+  {
+    f = fdopen(json_fd, "wb");
+  }
+
+  if(f == NULL)
+  {
+    return -1;
+  }
+
+  t = time(NULL);
+
+  localtime_r(&t, &tm_s);
+
+  strftime(str, 64, "%Y-%m-%dT%H:%M:%S", &tm_s);
+
+  fprintf(f, "{\n  \"program\": \"dsremote-bench\",\n  \"version\": ");
+  bench_json_str(f, PROGRAM_VERSION);
+  fprintf(f, ",\n  \"date\": \"%s\",\n", str);
+
+  if(cfg->cnv_only)
+  {
+    goto CONVERSION;
+  }
+
+  fprintf(f, "  \"device\": ");
+  bench_json_str(f, cfg->device);
+  fprintf(f, ",\n  \"model\": ");
+  bench_json_str(f, devparms->modelname);
+  fprintf(f, ",\n  \"serial\": ");
+  bench_json_str(f, devparms->serialnr);
+  fprintf(f, ",\n  \"connection\": \"%s\",\n", (device->conn_type == TMC_CONN_LAN) ? "lan" : "usb");
+  if(device->conn_type == TMC_CONN_LAN)
+  {
+    fprintf(f, "  \"lan_tuning\": {\"bulk\": %i, \"quickack\": %i},\n",
+            (cfg->lan_tuning & TMC_LAN_BULK) ? 1 : 0, (cfg->lan_tuning & TMC_LAN_QUICKACK) ? 1 : 0);
+  }
+  else
+  {
+    fprintf(f, "  \"usb_fastpath\": %i,\n", tmcdev_get_fastpath(device));
+  }
+
+  fprintf(f, "  \"latency_class\": [\n");
+  for(i=0, n=0; i<TMC_CMD_CLASS_CNT; i++)
+  {
+    if(!res->lat_class[i].samples)  continue;
+
+    fprintf(f, "%s    {\"class\": \"%s\", ", n++ ? ",\n" : "", bench_class_names[i]);
+    bench_json_stats(f, &res->lat_class[i]);
+    fprintf(f, "}");
+  }
+
+  fprintf(f, "\n  ],\n  \"latency_command\": [\n");
+  for(i=0; i<res->lat_cnt; i++)
+  {
+    fprintf(f, "%s    {\"class\": \"%s\", \"command\": ", i ? ",\n" : "", bench_class_names[res->lat[i].cmd_class]);
+    bench_json_str(f, res->lat[i].cmd);
+    fprintf(f, ", ");
+    bench_json_stats(f, &res->lat[i].stats);
+    fprintf(f, "}");
+  }
+
+  fprintf(f, "\n  ],\n  \"throughput\": [\n");
+  fprintf(f, "    {\"block\": \"screen\", \"points\": %i, \"bytes\": %i, \"mb_per_s\": %.3f, ",
+          res->scrn.points, res->scrn.bytes, res->scrn.mbs);
+  bench_json_stats(f, &res->scrn.stats);
+  fprintf(f, "}");
+  for(i=0; i<res->mem_cnt; i++)
+  {
+    fprintf(f, ",\n    {\"block\": \"memory\", \"points\": %i, \"bytes\": %i, \"mb_per_s\": %.3f, \"wire_mb_per_s\": %.3f, ",
+            res->mem[i].points, res->mem[i].bytes, res->mem[i].mbs, res->mem[i].wire_mbs);
+    bench_json_stats(f, &res->mem[i].stats);
+    fprintf(f, "}");
+  }
+
+  fprintf(f, "\n  ],\n  \"screen_fps\": [\n");
+  for(i=0; i<res->fps_cnt; i++)
+  {
+    fprintf(f, "%s    {\"channels\": %i, \"frames\": %i, \"seconds\": %.3f, \"fps\": %.2f, \"stages\": [",
+            i ? ",\n" : "", res->fps[i].channels, res->fps[i].frames, res->fps[i].secs, res->fps[i].fps);
+
+    for(j=0, n=0; j<STGTMR_CNT; j++)
+    {
+      st = &res->fps[i].stages[j];
+
+      if(!st->cnt)  continue;
+
+      fprintf(f, "%s\n      {\"stage\": \"%s\", \"calls_per_s\": %.2f, \"mean_ms\": %.3f, \"max_ms\": %.3f, \"load\": %.4f}",
+              n++ ? "," : "", stgtmr_name(j), st->rate, st->mean, st->max, st->load);
+    }
+
+    fprintf(f, "]}");
+  }
+
+  fprintf(f, "\n  ],\n");
+
+CONVERSION:
+
+  fprintf(f, "  \"conversion\": [\n");
+  for(i=0; i<res->cnv_cnt; i++)
+  {
+    fprintf(f, "%s    {\"function\": \"%s\", \"path\": \"%s\", \"points\": %i, \"min_ms\": %.3f, \"mean_ms\": %.3f, \"mpoints_per_s\": %.1f}",
+            i ? ",\n" : "", bench_cnv_names[res->cnv[i].func], bench_cnv_levels[res->cnv[i].level],
+            res->cnv[i].points, res->cnv[i].min_ms, res->cnv[i].mean_ms, res->cnv[i].mpts);
+  }
+
+  fprintf(f, "\n  ]\n}\n");
+
+  err = ferror(f);
+
+  if(fclose(f))  err = 1;
+
+  return err ? -1 : 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
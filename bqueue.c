@@ -0,0 +1,190 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "bqueue.h"
+
+
+struct bqueue
+{
+  pthread_mutex_t mtx;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  void **items;
+  int capacity;
+  int head;
+  int cnt;
+  int aborted;
+};
+
+
+struct bqueue * bqueue_create(int capacity)
+{
+  struct bqueue *q;
+
+  if(capacity < 1)
+  {
+    return NULL;
+  }
+
+  q = (struct bqueue *)calloc(1, sizeof(struct bqueue));
+  if(q == NULL)
+  {
+    return NULL;
+  }
+
+  q->items = (void **)calloc(capacity, sizeof(void *));
+  if(q->items == NULL)
+  {
+    free(q);
+    return NULL;
+  }
+
+  q->capacity = capacity;
+
+  pthread_mutex_init(&q->mtx, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+
+  return q;
+}
+
+
+void bqueue_destroy(struct bqueue *q)
+{
+  if(q == NULL)
+  {
+    return;
+  }
+
+  pthread_cond_destroy(&q->not_full);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_mutex_destroy(&q->mtx);
+
+  free(q->items);
+
+  free(q);
+}
+
+
+int bqueue_put(struct bqueue *q, void *item)
+{
+  pthread_mutex_lock(&q->mtx);
+
+  while((q->cnt == q->capacity) && (!q->aborted))
+  {
+    pthread_cond_wait(&q->not_full, &q->mtx);
+  }
+
+  if(q->aborted)
+  {
+    pthread_mutex_unlock(&q->mtx);
+
+    return -1;
+  }
+
+  q->items[(q->head + q->cnt) % q->capacity] = item;
+
+  q->cnt++;
+
+  pthread_cond_signal(&q->not_empty);
+
+  pthread_mutex_unlock(&q->mtx);
+
+  return 0;
+}
+
+
+void * bqueue_get(struct bqueue *q)
+{
+  void *item;
+
+  pthread_mutex_lock(&q->mtx);
+
+  while((!q->cnt) && (!q->aborted))
+  {
+    pthread_cond_wait(&q->not_empty, &q->mtx);
+  }
+
+  if(q->aborted)
+  {
+    pthread_mutex_unlock(&q->mtx);
+
+    return NULL;
+  }
+
+  item = q->items[q->head];
+
+  q->head = (q->head + 1) % q->capacity;
+
+  q->cnt--;
+
+  pthread_cond_signal(&q->not_full);
+
+  pthread_mutex_unlock(&q->mtx);
+
+  return item;
+}
+
+
+void bqueue_abort(struct bqueue *q)
+{
+  pthread_mutex_lock(&q->mtx);
+
+  q->aborted = 1;
+
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_cond_broadcast(&q->not_full);
+
+  pthread_mutex_unlock(&q->mtx);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,88 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef BQUEUE_H
+#define BQUEUE_H
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * Bounded FIFO of pointers between two threads.
+ * bqueue_put() waits while the queue is full and bqueue_get() waits while it is empty,
+ * so a slow consumer holds up the producer and the memory in flight stays bounded.
+ * After bqueue_abort() all waiting and future calls return immediately with an error.
+ */
+struct bqueue;
+
+/* returns NULL in case of a malloc error */
+struct bqueue * bqueue_create(int capacity);
+
+void bqueue_destroy(struct bqueue *);
+
+/* returns 0 on success or -1 when the queue was aborted */
+int bqueue_put(struct bqueue *, void *);
+
+/* returns the oldest item or NULL when the queue was aborted */
+void * bqueue_get(struct bqueue *);
+
+void bqueue_abort(struct bqueue *);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,553 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "capture_view.h"
+#include "edflib.h"
+#include "utils.h"
+
+
+
+static int capview_open_raw(struct capview *, const char *, char *, int);
+static int capview_open_edf(struct capview *, const char *, char *, int);
+static void capview_edf_field(const char *, int, int, char *);
+static int capview_load_raw8(struct capview *, const int *);
+static int capview_load_edf(struct capview *, const int *);
+
+
+
+int capview_open(struct capview *v, const char *path, char *err, int err_sz)
+{
+  int fd, n;
+
+  char magic[8];
+
+  memset(v, 0, sizeof(struct capview));
+
+  v->fd = -1;
+
+  v->raw.fd = -1;
+
+  v->loaded = 1;
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0)
+  {
+    snprintf(err, err_sz, "Can not open file %s: %s", path, strerror(errno));
+    return -1;
+  }
+
+  n = read(fd, magic, 8);
+
+  close(fd);
+
+  if(n != 8)
+  {
+    snprintf(err, err_sz, "File %s is not a capture file.", path);
+    return -1;
+  }
+
+  if(!memcmp(magic, RAWCAP_MAGIC, 8))
+  {
+    return capview_open_raw(v, path, err, err_sz);
+  }
+
+  if(!memcmp(magic, "0       ", 8))
+  {
+    return capview_open_edf(v, path, err, err_sz);
+  }
+
+  snprintf(err, err_sz, "File %s is not a capture file.", path);
+
+  return -1;
+}
+
+
+static int capview_open_raw(struct capview *v, const char *path, char *err, int err_sz)
+{
+  int chn;
+
+  struct rawcap_hdr *hdr;
+
+  v->type = CAPVIEW_TYPE_RAW;
+
+  if(rawcap_open(&v->raw, path, err, err_sz))
+  {
+    return -1;
+  }
+
+  hdr = v->raw.hdr;
+
+  if(hdr->smps > 0x7fffffffLL)
+  {
+    strlcpy(err, "The capture is too large for the Wave Inspector.", err_sz);
+    goto OUT_ERROR;
+  }
+
+  v->smps = hdr->smps;
+
+  v->samplerate = hdr->samplerate;
+
+  strlcpy(v->model, hdr->model, 64);
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(!hdr->chan[chn].captured)
+    {
+      continue;
+    }
+
+    v->yinc[chn] = hdr->chan[chn].yinc;
+
+    if(hdr->smp_fmt == RAWCAP_FMT_S16)
+    {
+      v->buf[chn] = (short *)rawcap_samples(&v->raw, chn);
+
+      continue;
+    }
+
+    v->buf[chn] = (short *)malloc(v->smps * sizeof(short));
+    if(v->buf[chn] == NULL)
+    {
+      snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+      goto OUT_ERROR;
+    }
+
+    v->buf_alloc[chn] = 1;
+
+    v->loaded = 0;  // converted by capview_load()
+  }
+
+  return 0;
+
+OUT_ERROR:
+
+  capview_close(v);
+
+  return -1;
+}
+
+
+static int capview_open_edf(struct capview *v, const char *path, char *err, int err_sz)
+{
+  int i, j, chn, ns, hdr_sz, datrecs, smps_per_rec=0,
+      sig_smps, rec_sz=0, sig_ofs[RAWCAP_MAX_CHNS];
+
+  long long rec_duration;
+
+  char str[96];
+
+  struct stat st;
+
+  struct edf_hdr_struct *edfhdr;
+
+  v->type = CAPVIEW_TYPE_EDF;
+
+  edfhdr = (struct edf_hdr_struct *)malloc(sizeof(struct edf_hdr_struct));
+  if(edfhdr == NULL)
+  {
+    snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  /* edflib checks the header and the file size */
+  if(edfopen_file_readonly(path, edfhdr, EDFLIB_DO_NOT_READ_ANNOTATIONS))
+  {
+    snprintf(err, err_sz, "Can not open EDF file %s, error %i", path, edfhdr->filetype);
+    free(edfhdr);
+    return -1;
+  }
+
+  edfclose_file(edfhdr->handle);
+
+  if((edfhdr->filetype != EDFLIB_FILETYPE_EDF) && (edfhdr->filetype != EDFLIB_FILETYPE_EDFPLUS))
+  {
+    strlcpy(err, "Only EDF and EDF+ files are supported.", err_sz);
+    free(edfhdr);
+    return -1;
+  }
+
+  datrecs = edfhdr->datarecords_in_file;
+
+  strlcpy(v->model, edfhdr->equipment, 81);
+
+  rec_duration = edfhdr->datarecord_duration;
+
+  free(edfhdr);
+
+  if((datrecs < 1) || (rec_duration < 1))
+  {
+    strlcpy(err, "This EDF file was not saved by DSRemote.", err_sz);
+    return -1;
+  }
+
+  v->fd = open(path, O_RDONLY);
+  if(v->fd < 0)
+  {
+    snprintf(err, err_sz, "Can not open file %s: %s", path, strerror(errno));
+    return -1;
+  }
+
+  if(fstat(v->fd, &st))
+  {
+    snprintf(err, err_sz, "Can not stat file %s: %s", path, strerror(errno));
+    goto OUT_ERROR;
+  }
+
+  v->map_sz = st.st_size;
+
+  v->map = (char *)mmap(NULL, v->map_sz, PROT_READ, MAP_SHARED, v->fd, 0);
+  if(v->map == MAP_FAILED)
+  {
+    v->map = NULL;
+    snprintf(err, err_sz, "Can not map file %s: %s", path, strerror(errno));
+    goto OUT_ERROR;
+  }
+
+  capview_edf_field(v->map, 184, 8, str);
+
+  hdr_sz = atoi(str);
+
+  capview_edf_field(v->map, 252, 4, str);
+
+  ns = atoi(str);
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    sig_ofs[chn] = -1;
+  }
+
+  for(i=0; i<ns; i++)
+  {
+    capview_edf_field(v->map, 256 + (ns * 216) + (i * 8), 8, str);
+
+    sig_smps = atoi(str);
+
+    capview_edf_field(v->map, 256 + (i * 16), 16, str);
+
+    if((strlen(str) != 5) || strncmp(str, "CHAN", 4) || (str[4] < '1') || (str[4] > '4'))
+    {
+      rec_sz += sig_smps * 2;
+
+      continue;
+    }
+
+    chn = str[4] - '1';
+
+    if((sig_ofs[chn] >= 0) || (smps_per_rec && (sig_smps != smps_per_rec)))
+    {
+      strlcpy(err, "This EDF file was not saved by DSRemote.", err_sz);
+      goto OUT_ERROR;
+    }
+
+    capview_edf_field(v->map, 256 + (ns * 120) + (i * 8), 8, str);
+
+    j = atoi(str);
+
+    capview_edf_field(v->map, 256 + (ns * 128) + (i * 8), 8, str);
+
+    if((j != -32768) || (atoi(str) != 32767))
+    {
+      strlcpy(err, "This EDF file was not saved by DSRemote.", err_sz);
+      goto OUT_ERROR;
+    }
+
+    capview_edf_field(v->map, 256 + (ns * 112) + (i * 8), 8, str);
+
+    v->yinc[chn] = atof(str) / 32767.0;
+
+    capview_edf_field(v->map, 256 + (ns * 104) + (i * 8), 8, str);
+
+    v->range[chn] = (v->yinc[chn] * 32767.0) - atof(str);
+
+    capview_edf_field(v->map, 256 + (ns * 96) + (i * 8), 8, str);
+
+    if(!strcmp(str, "mV"))
+    {
+      v->yinc[chn] /= 1000.0;
+
+      v->range[chn] /= 1000.0;
+    }
+
+    capview_edf_field(v->map, 256 + (ns * 16) + (i * 80), 80, str);
+
+    if(!strncmp(str, "DSRemote scale ", 15))
+    {
+      v->scale[chn] = atof(str + 15);
+    }
+
+    smps_per_rec = sig_smps;
+
+    sig_ofs[chn] = rec_sz;
+
+    rec_sz += sig_smps * 2;
+  }
+
+  if((!smps_per_rec) || ((hdr_sz + ((long long)datrecs * rec_sz)) > v->map_sz))
+  {
+    strlcpy(err, "This EDF file was not saved by DSRemote.", err_sz);
+    goto OUT_ERROR;
+  }
+
+  if(((long long)smps_per_rec * datrecs) > 0x7fffffffLL)
+  {
+    strlcpy(err, "The capture is too large for the Wave Inspector.", err_sz);
+    goto OUT_ERROR;
+  }
+
+  v->smps = smps_per_rec * datrecs;
+
+  /* datarecord_duration is in units of 100 nanoSeconds */
+  v->samplerate = (smps_per_rec * (double)EDFLIB_TIME_DIMENSION) / rec_duration;
+
+  v->hdr_sz = hdr_sz;
+
+  v->datrecs = datrecs;
+
+  v->rec_sz = rec_sz;
+
+  v->smps_per_rec = smps_per_rec;
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    v->sig_ofs[chn] = sig_ofs[chn];
+
+    if(sig_ofs[chn] < 0)
+    {
+      continue;
+    }
+
+    if(datrecs == 1)  // the samples of a channel are contiguous, the header size is even
+    {
+      v->buf[chn] = (short *)(v->map + hdr_sz + sig_ofs[chn]);
+    }
+    else
+    {
+      v->buf[chn] = (short *)malloc(v->smps * sizeof(short));
+      if(v->buf[chn] == NULL)
+      {
+        snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+        goto OUT_ERROR;
+      }
+
+      v->buf_alloc[chn] = 1;
+
+      v->loaded = 0;  // copied by capview_load()
+    }
+  }
+
+  return 0;
+
+OUT_ERROR:
+
+  capview_close(v);
+
+  return -1;
+}
+
+
+int capview_load(struct capview *v, const int *abort_req)
+{
+  if(v->loaded)
+  {
+    return 0;
+  }
+
+  if(v->type == CAPVIEW_TYPE_RAW)
+  {
+    return capview_load_raw8(v, abort_req);
+  }
+
+  return capview_load_edf(v, abort_req);
+}
+
+
+static int capview_load_raw8(struct capview *v, const int *abort_req)
+{
+  int i, chn, ofs;
+
+  const unsigned char *src8;
+
+  struct rawcap_hdr *hdr;
+
+  hdr = v->raw.hdr;
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(!v->buf_alloc[chn])
+    {
+      continue;
+    }
+
+    src8 = (const unsigned char *)rawcap_samples(&v->raw, chn);
+
+    ofs = hdr->chan[chn].yref + hdr->chan[chn].yor;
+
+    for(i=0; i<v->smps; i++)
+    {
+      if(!(i & 0xfffff) && __atomic_load_n(abort_req, __ATOMIC_RELAXED))
+      {
+        return -1;
+      }
+
+      v->buf[chn][i] = ((int)src8[i]) - ofs;
+    }
+  }
+
+  v->loaded = 1;
+
+  return 0;
+}
+
+
+/* de-interleaves the datarecords, one channel after the other */
+static int capview_load_edf(struct capview *v, const int *abort_req)
+{
+  int i, chn;
+
+  const short *src;
+
+  madvise(v->map, v->map_sz, MADV_SEQUENTIAL);
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(!v->buf_alloc[chn])
+    {
+      continue;
+    }
+
+    for(i=0; i<v->datrecs; i++)
+    {
+      if(__atomic_load_n(abort_req, __ATOMIC_RELAXED))
+      {
+        return -1;
+      }
+
+      src = (const short *)(v->map + v->hdr_sz + ((long long)i * v->rec_sz) + v->sig_ofs[chn]);
+
+      memcpy(v->buf[chn] + ((long long)i * v->smps_per_rec), src, v->smps_per_rec * sizeof(short));
+    }
+  }
+
+  /* everything is copied, the mapping is not needed anymore */
+  munmap(v->map, v->map_sz);
+
+  v->map = NULL;
+
+  close(v->fd);
+
+  v->fd = -1;
+
+  v->loaded = 1;
+
+  return 0;
+}
+
+
+void capview_close(struct capview *v)
+{
+  int chn;
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(v->buf_alloc[chn])
+    {
+      free(v->buf[chn]);
+    }
+
+    v->buf[chn] = NULL;
+
+    v->buf_alloc[chn] = 0;
+  }
+
+  if(v->raw.fd >= 0)
+  {
+    rawcap_close(&v->raw);
+  }
+
+  if(v->map != NULL)
+  {
+    munmap(v->map, v->map_sz);
+
+    v->map = NULL;
+  }
+
+  if(v->fd >= 0)
+  {
+    close(v->fd);
+
+    v->fd = -1;
+  }
+}
+
+
+/* copies a header field of len characters to dest without the trailing spaces, dest must hold len + 1 characters */
+static void capview_edf_field(const char *hdr, int ofs, int len, char *dest)
+{
+  memcpy(dest, hdr + ofs, len);
+
+  dest[len] = 0;
+
+  for(len--; (len >= 0) && (dest[len] == ' '); len--)
+  {
+    dest[len] = 0;
+  }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,130 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#ifndef CAPTURE_VIEW_H
+#define CAPTURE_VIEW_H
+
+
+
+#include "raw_capture.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * Read-only view of a saved capture for the Wave Inspector.
+ *
+ * 16-bit raw capture files and EDF files with one datarecord are used through
+ * the mapping of the file, buf[] points into the page cache and nothing is read
+ * before it is used. 8-bit raw capture files and EDF files with more than one
+ * datarecord (the channels are interleaved per datarecord) need a conversion
+ * into allocated buffers: capview_open() only allocates them and clears loaded,
+ * capview_load() fills them and can run in a worker thread.
+ *
+ * Only EDF files with the layout written by DSRemote are accepted:
+ * signals labeled CHAN1 to CHAN4 with a digital range of -32768 to 32767.
+ * Nothing but the header is read when the file is opened, the vertical scale is
+ * taken from the transducer field ("DSRemote scale <V/div> V/div") or else from
+ * the physical range.
+ */
+
+
+#define CAPVIEW_TYPE_RAW   (0)
+#define CAPVIEW_TYPE_EDF   (1)
+
+
+struct capview
+{
+  int type;
+  int smps;                         /* samples per channel */
+  double samplerate;
+  double yinc[RAWCAP_MAX_CHNS];     /* Volt per step of the samples in buf[] */
+  double scale[RAWCAP_MAX_CHNS];    /* EDF only, Volt per division, 0 when not in the file */
+  double range[RAWCAP_MAX_CHNS];    /* EDF only, physical maximum minus minimum in Volt */
+  char model[81];
+  short *buf[RAWCAP_MAX_CHNS];      /* NULL for the channels that are not in the file */
+  int buf_alloc[RAWCAP_MAX_CHNS];   /* 1 when buf[] is allocated instead of a view of the mapping */
+  int loaded;                       /* 0 until capview_load() has filled the allocated buffers */
+  struct rawcap_file raw;           /* CAPVIEW_TYPE_RAW */
+  int fd;                           /* CAPVIEW_TYPE_EDF */
+  char *map;
+  long long map_sz;
+  int hdr_sz;                       /* CAPVIEW_TYPE_EDF, the layout of the datarecords */
+  int datrecs;
+  int rec_sz;
+  int smps_per_rec;
+  int sig_ofs[RAWCAP_MAX_CHNS];
+};
+
+
+/* opens a raw capture file or an EDF file, returns 0 on success or -1 with the reason in err */
+int capview_open(struct capview *, const char *path, char *err, int err_sz);
+
+/*
+ * converts the samples into the allocated buffers when loaded is 0,
+ * stops early when *abort_req becomes non-zero (loaded stays 0)
+ * returns 0 on success or -1 when aborted
+ */
+int capview_load(struct capview *, const int *abort_req);
+
+/* frees the buffers and unmaps the file, buf[] must not be used anymore */
+void capview_close(struct capview *);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,884 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+/*
+ * dsremote-cli: headless capture of the deep memory of a DHO800/DHO900 to EDF files.
+ * Uses the same connection, download and EDF code as the GUI but does not link QtWidgets.
+ *
+ * usage: dsremote-cli <config file>
+ *        dsremote-cli -e <capture file> <EDF file>     (export a raw capture file to EDF)
+ *
+ * The config file is an ini file, e.g.:
+ *
+ * [connection]
+ * device=192.168.1.100     ; hostname, IP-address or /dev/usbtmcN
+ *
+ * [capture]
+ * channels=1,2             ; channels to capture, the others are switched off
+ * memdepth=1000000         ; 0 = leave as is
+ * count=10                 ; number of captures, 0 = until SIGINT or SIGTERM
+ * interval=0               ; pause between the captures in milli-Sec.
+ * timeout=10               ; seconds to wait for a trigger, 0 = forever
+ *
+ * [trigger]
+ * source=CHAN1             ; edge trigger source, empty = leave the trigger as is
+ * slope=POS                ; POS, NEG or RFAL
+ * level=0.5                ; Volt
+ *
+ * [output]
+ * directory=/data/captures
+ * prefix=capture
+ * direct=0                 ; 1 = write with O_DIRECT, bypassing the page cache
+ * format=edf               ; edf, raw (16-bit .dscap file) or raw8 (8-bit .dscap file)
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include <QCoreApplication>
+#include <QSettings>
+#include <QString>
+#include <QElapsedTimer>
+
+#include "global.h"
+#include "utils.h"
+#include "connection.h"
+#include "tmc_dev.h"
+#include "mem_download_thread.h"
+#include "save_data_thread.h"
+#include "edflib.h"
+
+
+#define CLI_TRIG_POLL_MS   (20)
+
+/* samples per channel handed at once to the raw capture file */
+#define CLI_RAW_SEG_SMPS   (1048576)
+
+#define CLI_FMT_EDF    (0)
+#define CLI_FMT_RAW    (1)
+#define CLI_FMT_RAW8   (2)
+
+
+struct cli_config
+{
+  char device[MAX_PATHLEN];
+  int chandisplay[MAX_CHNS];
+  int memdepth;
+  int count;
+  int interval;
+  int trig_timeout;
+  char trig_src[32];
+  char trig_slope[16];
+  double trig_level;
+  char out_dir[MAX_PATHLEN];
+  char out_prefix[128];
+  int out_direct;
+  int out_format;
+};
+
+
+static volatile sig_atomic_t cli_stop=0;
+
+static struct tmcdev *device=NULL;
+
+
+static void cli_sig_handler(int);
+static int cli_read_config(const char *, struct cli_config *, char *, int);
+static int cli_open(struct cli_config *, struct device_settings *, char *, int);
+static int cli_setup(struct cli_config *, struct device_settings *, char *, int);
+static int cli_wait_trigger(struct cli_config *, char *, int);
+static int cli_read_acquisition(struct device_settings *, char *, int);
+static int cli_capture(struct cli_config *, struct device_settings *, int, char *, int);
+static int cli_capture_raw(struct cli_config *, struct device_settings *, int, char *, int);
+
+
+
+int main(int argc, char *argv[])
+{
+  int n, err=0;
+
+  char str[1024];
+
+  struct cli_config cfg;
+
+  struct device_settings *devparms;
+
+  QCoreApplication app(argc, argv);
+
+  if((argc == 4) && (!strcmp(argv[1], "-e")))
+  {
+    if(save_data_thread::export_raw_file_to_edf(argv[2], argv[3], str, 1024))
+    {
+      fprintf(stderr, "%s\n", str);
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "usage: dsremote-cli <config file>\n"
+                    "       dsremote-cli -e <capture file> <EDF file>\n");
+    return EXIT_FAILURE;
+  }
+
+  if(cli_read_config(argv[1], &cfg, str, 1024))
+  {
+    fprintf(stderr, "%s\n", str);
+    return EXIT_FAILURE;
+  }
+
+  devparms = (struct device_settings *)calloc(1, sizeof(struct device_settings));
+  if(devparms == NULL)
+  {
+    fprintf(stderr, "Malloc error.\n");
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGINT, cli_sig_handler);
+  signal(SIGTERM, cli_sig_handler);
+
+  if(cli_open(&cfg, devparms, str, 1024))
+  {
+    fprintf(stderr, "%s\n", str);
+    free(devparms);
+    return EXIT_FAILURE;
+  }
+
+  if(cli_setup(&cfg, devparms, str, 1024))
+  {
+    err = 1;
+    goto OUT;
+  }
+
+  for(n=0; (!cfg.count) || (n < cfg.count); n++)
+  {
+    if(cli_stop)  break;
+
+    if(n && (cfg.interval > 0))
+    {
+      usleep(cfg.interval * 1000);
+    }
+
+    err = cli_wait_trigger(&cfg, str, 1024);
+    if(err < 0)
+    {
+      goto OUT;
+    }
+
+    if(err > 0)  // timeout or stopped
+    {
+      fprintf(stderr, "%s\n", str);
+
+      err = 0;
+
+      continue;
+    }
+
+    if(cli_read_acquisition(devparms, str, 1024))
+    {
+      err = 1;
+      goto OUT;
+    }
+
+    if(cfg.out_format == CLI_FMT_EDF)
+    {
+      err = cli_capture(&cfg, devparms, n + 1, str, 1024);
+    }
+    else
+    {
+      err = cli_capture_raw(&cfg, devparms, n + 1, str, 1024);
+    }
+
+    if(err)
+    {
+      err = 1;
+      goto OUT;
+    }
+
+    printf("capture %i: %s\n", n + 1, str);
+  }
+
+OUT:
+
+  if(err)
+  {
+    fprintf(stderr, "%s\n", str);
+  }
+
+  mem_download_thread::restore_device(devparms);
+
+  tmc_close();
+
+  device = NULL;
+
+  free(devparms);
+
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static void cli_sig_handler(int sig)
+{
+  (void)sig;
+
+  cli_stop = 1;
+}
+
+
+static int cli_read_config(const char *path, struct cli_config *cfg, char *err, int err_sz)
+{
+  int chn, chns=0;
+
+  char str[256],
+       *ptr;
+
+  memset(cfg, 0, sizeof(struct cli_config));
+
+  if(access(path, R_OK))
+  {
+    snprintf(err, err_sz, "Can not read config file %s", path);
+    return -1;
+  }
+
+  QSettings settings(QString::fromLocal8Bit(path), QSettings::IniFormat);
+
+  strlcpy(cfg->device, settings.value("connection/device", "").toString().toLocal8Bit().data(), MAX_PATHLEN);
+
+  if(!cfg->device[0])
+  {
+    strlcpy(err, "No device in config file", err_sz);
+    return -1;
+  }
+
+  /* a list is split by QSettings, join it again */
+  strlcpy(str, settings.value("capture/channels", "1").toStringList().join(",").toLocal8Bit().data(), 256);
+
+  for(ptr=strtok(str, ", "); ptr!=NULL; ptr=strtok(NULL, ", "))
+  {
+    chn = atoi(ptr);
+
+    if((chn < 1) || (chn > MAX_CHNS))
+    {
+      snprintf(err, err_sz, "Invalid channel in config file: %s", ptr);
+      return -1;
+    }
+
+    cfg->chandisplay[chn - 1] = 1;
+
+    chns++;
+  }
+
+  if(!chns)
+  {
+    strlcpy(err, "No channels in config file", err_sz);
+    return -1;
+  }
+
+  cfg->memdepth = settings.value("capture/memdepth", 0).toInt();
+
+  cfg->count = settings.value("capture/count", 1).toInt();
+
+  cfg->interval = settings.value("capture/interval", 0).toInt();
+
+  cfg->trig_timeout = settings.value("capture/timeout", 10).toInt();
+
+  if((cfg->memdepth < 0) || (cfg->count < 0) || (cfg->interval < 0) || (cfg->trig_timeout < 0))
+  {
+    strlcpy(err, "Invalid capture settings in config file", err_sz);
+    return -1;
+  }
+
+  strlcpy(cfg->trig_src, settings.value("trigger/source", "").toString().toLocal8Bit().data(), 32);
+
+  strlcpy(cfg->trig_slope, settings.value("trigger/slope", "POS").toString().toLocal8Bit().data(), 16);
+
+  cfg->trig_level = settings.value("trigger/level", 0.0).toDouble();
+
+  strlcpy(cfg->out_dir, settings.value("output/directory", ".").toString().toLocal8Bit().data(), MAX_PATHLEN);
+
+  strlcpy(cfg->out_prefix, settings.value("output/prefix", "capture").toString().toLocal8Bit().data(), 128);
+
+  cfg->out_direct = settings.value("output/direct", 0).toInt() ? 1 : 0;
+
+  strlcpy(str, settings.value("output/format", "edf").toString().toLocal8Bit().data(), 256);
+
+  if(!strcmp(str, "edf"))
+  {
+    cfg->out_format = CLI_FMT_EDF;
+  }
+  else if(!strcmp(str, "raw"))
+    {
+      cfg->out_format = CLI_FMT_RAW;
+    }
+    else if(!strcmp(str, "raw8"))
+      {
+        cfg->out_format = CLI_FMT_RAW8;
+      }
+      else
+      {
+        snprintf(err, err_sz, "Invalid output format in config file: %s", str);
+        return -1;
+      }
+
+  if(access(cfg->out_dir, W_OK))
+  {
+    snprintf(err, err_sz, "Can not write to output directory %s", cfg->out_dir);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+static int cli_open(struct cli_config *cfg, struct device_settings *devparms, char *err, int err_sz)
+{
+  char resp_str[1024],
+       *ptr;
+
+  if(!strncmp(cfg->device, "/dev/", 5))
+  {
+    device = tmc_open_usb(cfg->device);
+  }
+  else
+  {
+    device = tmc_open_lan(cfg->device);
+  }
+
+  if(device == NULL)
+  {
+    snprintf(err, err_sz, "Can not open connection to %s", cfg->device);
+    return -1;
+  }
+
+  if(tmc_write("*IDN?") != 5)
+  {
+    snprintf(err, err_sz, "Can not write to device %s", cfg->device);
+    goto OUT_ERROR;
+  }
+
+  if(tmc_read() < 1)
+  {
+    snprintf(err, err_sz, "Can not read from device %s", cfg->device);
+    goto OUT_ERROR;
+  }
+
+  strlcpy(resp_str, device->buf, 1024);
+
+  ptr = strtok(resp_str, ",");
+  if((ptr == NULL) || (strcmp(ptr, "RIGOL TECHNOLOGIES") && strcmp(ptr, "NK TECHNOLOGIES")))
+  {
+    snprintf(err, err_sz, "Received an unknown identification string from device: %s", device->buf);
+    goto OUT_ERROR;
+  }
+
+  ptr = strtok(NULL, ",");
+
+  /* DHO802, DHO804, DHO812, DHO814, DHO914, DHO924, DHO914S, DHO924S */
+  if((ptr == NULL) || strncmp(ptr, "DHO", 3) || (strlen(ptr) < 6) ||
+     ((ptr[3] != '8') && (ptr[3] != '9')) || ((ptr[5] != '2') && (ptr[5] != '4')))
+  {
+    snprintf(err, err_sz, "Unsupported device: %s", device->buf);
+    goto OUT_ERROR;
+  }
+
+  strlcpy(devparms->modelname, ptr, 128);
+
+  devparms->modelserie = 7;
+
+  devparms->channel_cnt = ptr[5] - '0';
+
+  devparms->hordivisions = 10;
+
+  devparms->vertdivisions = 8;
+
+  ptr = strtok(NULL, ",");
+  if(ptr != NULL)
+  {
+    strlcpy(devparms->serialnr, ptr, 128);
+  }
+
+  devparms->connected = 1;
+
+  devparms->wav_multichn = -1;  // probe on first use
+
+  devparms->mem_blk_sz = 0;
+
+  devparms->mem_blk_max = SAV_MEM_BSZ_MAX_DHO;
+
+  devparms->edf_direct = cfg->out_direct;
+
+  printf("connected to %s %s\n", devparms->modelname, devparms->serialnr);
+
+  return 0;
+
+OUT_ERROR:
+
+  tmc_close();
+
+  device = NULL;
+
+  return -1;
+}
+
+
+static int cli_setup(struct cli_config *cfg, struct device_settings *devparms, char *err, int err_sz)
+{
+  int chn;
+
+  char str[256];
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(chn >= devparms->channel_cnt)
+    {
+      if(cfg->chandisplay[chn])
+      {
+        snprintf(err, err_sz, "Channel %i is not available on the %s", chn + 1, devparms->modelname);
+        return -1;
+      }
+
+      continue;
+    }
+
+    devparms->chandisplay[chn] = cfg->chandisplay[chn];
+
+    snprintf(str, 256, ":CHAN%i:DISP %i", chn + 1, devparms->chandisplay[chn]);
+
+    if(tmc_write(str) < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+  }
+
+  if(cfg->memdepth)
+  {
+    snprintf(str, 256, ":ACQ:MDEP %i", cfg->memdepth);
+
+    if(tmc_write(str) < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+  }
+
+  if(cfg->trig_src[0])
+  {
+    if(tmc_write(":TRIG:MODE EDGE") < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    snprintf(str, 256, ":TRIG:EDGE:SOUR %s", cfg->trig_src);
+
+    if(tmc_write(str) < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    snprintf(str, 256, ":TRIG:EDGE:SLOP %s", cfg->trig_slope);
+
+    if(tmc_write(str) < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    snprintf(str, 256, ":TRIG:EDGE:LEV %e", cfg->trig_level);
+
+    if(tmc_write(str) < 0)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ * Arms a single acquisition and waits until it's done.
+ * Returns 0 when the acquisition is done, 1 on timeout or stop request, -1 on error.
+ */
+static int cli_wait_trigger(struct cli_config *cfg, char *err, int err_sz)
+{
+  int armed=0;
+
+  QElapsedTimer tmr;
+
+  if(tmc_write(":SING") < 0)
+  {
+    snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  tmr.start();
+
+  while(!cli_stop)
+  {
+    if(tmc_write(":TRIG:STAT?") != 11)
+    {
+      snprintf(err, err_sz, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    if(tmc_read() < 1)
+    {
+      snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    if(!strcmp(device->buf, "STOP"))
+    {
+      /* the status can still be the one of the previous acquisition right after :SING */
+      if(armed || (tmr.elapsed() > 1000))
+      {
+        return 0;
+      }
+    }
+    else
+    {
+      armed = 1;
+    }
+
+    if(cfg->trig_timeout && (tmr.elapsed() > (cfg->trig_timeout * 1000LL)))
+    {
+      tmc_write(":STOP");
+
+      strlcpy(err, "No trigger, timeout", err_sz);
+
+      return 1;
+    }
+
+    usleep(CLI_TRIG_POLL_MS * 1000);
+  }
+
+  tmc_write(":STOP");
+
+  strlcpy(err, "Stopped", err_sz);
+
+  return 1;
+}
+
+
+/* reads the memory depth, samplerate and vertical scales of the last acquisition */
+static int cli_read_acquisition(struct device_settings *devparms, char *err, int err_sz)
+{
+  int chn;
+
+  char str[128];
+
+  if((tmc_write(":ACQ:MDEP?") != 10) || (tmc_read() < 1))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  devparms->acquirememdepth = atoi(device->buf);
+
+  if((tmc_write(":ACQ:SRAT?") != 10) || (tmc_read() < 1))
+  {
+    snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  devparms->samplerate = atof(device->buf);
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!devparms->chandisplay[chn])
+    {
+      continue;
+    }
+
+    snprintf(str, 128, ":CHAN%i:SCAL?", chn + 1);
+
+    if((tmc_write(str) < 0) || (tmc_read() < 1))
+    {
+      snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    devparms->chanscale[chn] = atof(device->buf);
+  }
+
+  if(devparms->acquirememdepth < 1)
+  {
+    strlcpy(err, "Can not download waveform when memory depth is set to \"Auto\".", err_sz);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Downloads the memory to <directory>/<prefix>_<date>_<time>_<capture>.edf
+ * The download, the conversion and the file writes run in parallel and
+ * the memory in use does not depend on the memory depth.
+ */
+static int cli_capture(struct cli_config *cfg, struct device_settings *devparms, int capt, char *msg, int msg_sz)
+{
+  int hdl, datrecs, smps_per_record, blk_sz, blk_max, err,
+      yref[MAX_CHNS];
+
+  char path[MAX_PATHLEN],
+       str[64];
+
+  time_t t;
+
+  struct tm tm_s;
+
+  QElapsedTimer tmr;
+
+  mem_download_thread dl_thrd;
+
+  mem_pipeline pipe;
+
+  t = time(NULL);
+
+  localtime_r(&t, &tm_s);
+
+  strftime(str, 64, "%Y%m%d_%H%M%S", &tm_s);
+
+  snprintf(path, MAX_PATHLEN, "%s/%s_%s_%04i.edf", cfg->out_dir, cfg->out_prefix, str, capt);
+
+  if(mem_download_thread::prepare_device(device, devparms, yref, msg, msg_sz))
+  {
+    return -1;
+  }
+
+  hdl = save_data_thread::create_memory_edf_file(devparms, path, &datrecs, &smps_per_record, msg, msg_sz);
+  if(hdl < 0)
+  {
+    return -1;
+  }
+
+  dl_thrd.set_params(devparms, NULL, yref, devparms->acquirememdepth);
+
+  dl_thrd.get_blk_sz(&blk_sz, &blk_max);
+
+  if(pipe.start(devparms->chandisplay, smps_per_record, datrecs, blk_max,
+                save_data_thread::write_memory_edf_record, &hdl, msg, msg_sz))
+  {
+    edfclose_file(hdl);
+    unlink(path);
+    return -1;
+  }
+
+  dl_thrd.set_pipeline(&pipe);
+
+  tmr.start();
+
+  dl_thrd.start();
+
+  while(!dl_thrd.wait(100))
+  {
+    if(cli_stop)
+    {
+      dl_thrd.abort();
+    }
+  }
+
+  err = pipe.finish(dl_thrd.get_error_num() ? 1 : 0, msg, msg_sz);
+
+  devparms->wav_multichn = dl_thrd.get_wav_multichn();
+
+  dl_thrd.get_blk_sz(&devparms->mem_blk_sz, &devparms->mem_blk_max);
+
+  if(edfclose_file(hdl) && (!err))  // the last datarecords are written and synced here
+  {
+    strlcpy(msg, "A file write error occurred.", msg_sz);
+    err = -1;
+  }
+
+  if(err == -1)  // the write error is the cause
+  {
+    unlink(path);
+    return -1;
+  }
+
+  if(dl_thrd.get_error_num() || err)
+  {
+    dl_thrd.get_error_str(msg, msg_sz);
+    unlink(path);
+    return -1;
+  }
+
+  printf("capture %i: %i samples in %.3f s, %lli bytes of buffers\n",
+         capt, smps_per_record * datrecs, tmr.nsecsElapsed() / 1e9, pipe.get_buf_bytes());
+
+  strlcpy(msg, path, msg_sz);
+
+  return 0;
+}
+
+
+/*
+ * Downloads the memory to <directory>/<prefix>_<date>_<time>_<capture>.dscap
+ * The samples go through the same pipeline as the EDF captures
+ * and are copied into the memory-mapped file without any formatting.
+ */
+static int cli_capture_raw(struct cli_config *cfg, struct device_settings *devparms, int capt, char *msg, int msg_sz)
+{
+  int seg, seg_cnt, blk_sz, blk_max, err,
+      yref[MAX_CHNS];
+
+  char path[MAX_PATHLEN],
+       str[64];
+
+  time_t t;
+
+  struct tm tm_s;
+
+  struct rawcap_file f;
+
+  QElapsedTimer tmr;
+
+  mem_download_thread dl_thrd;
+
+  mem_pipeline pipe;
+
+  t = time(NULL);
+
+  localtime_r(&t, &tm_s);
+
+  strftime(str, 64, "%Y%m%d_%H%M%S", &tm_s);
+
+  snprintf(path, MAX_PATHLEN, "%s/%s_%s_%04i.dscap", cfg->out_dir, cfg->out_prefix, str, capt);
+
+  if(mem_download_thread::prepare_device(device, devparms, yref, msg, msg_sz))
+  {
+    return -1;
+  }
+
+  /* the segments must add up to the memory depth, the depths are a multiple of a power of two */
+  seg = devparms->acquirememdepth;
+
+  for(seg_cnt=1; (seg > CLI_RAW_SEG_SMPS) && (!(seg % 2)); seg_cnt*=2)
+  {
+    seg /= 2;
+  }
+
+  if(save_data_thread::create_memory_raw_file(devparms, path,
+       (cfg->out_format == CLI_FMT_RAW8) ? RAWCAP_FMT_U8 : RAWCAP_FMT_S16, &f, msg, msg_sz))
+  {
+    return -1;
+  }
+
+  dl_thrd.set_params(devparms, NULL, yref, devparms->acquirememdepth);
+
+  dl_thrd.get_blk_sz(&blk_sz, &blk_max);
+
+  if(pipe.start(devparms->chandisplay, seg, seg_cnt, blk_max,
+                save_data_thread::write_memory_raw_record, &f, msg, msg_sz))
+  {
+    rawcap_close(&f);
+    unlink(path);
+    return -1;
+  }
+
+  dl_thrd.set_pipeline(&pipe);
+
+  tmr.start();
+
+  dl_thrd.start();
+
+  while(!dl_thrd.wait(100))
+  {
+    if(cli_stop)
+    {
+      dl_thrd.abort();
+    }
+  }
+
+  err = pipe.finish(dl_thrd.get_error_num() ? 1 : 0, msg, msg_sz);
+
+  devparms->wav_multichn = dl_thrd.get_wav_multichn();
+
+  dl_thrd.get_blk_sz(&devparms->mem_blk_sz, &devparms->mem_blk_max);
+
+  if(rawcap_close(&f) && (!err))
+  {
+    strlcpy(msg, "A file write error occurred.", msg_sz);
+    err = -1;
+  }
+
+  if(err == -1)
+  {
+    unlink(path);
+    return -1;
+  }
+
+  if(dl_thrd.get_error_num() || err)
+  {
+    dl_thrd.get_error_str(msg, msg_sz);
+    unlink(path);
+    return -1;
+  }
+
+  printf("capture %i: %i samples in %.3f s, %lli bytes of buffers\n",
+         capt, devparms->acquirememdepth, tmr.nsecsElapsed() / 1e9, pipe.get_buf_bytes());
+
+  strlcpy(msg, path, msg_sz);
+
+  return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -29,78 +29,860 @@
 #include "connection.h"
 
 
+#define TMC_SHADOW_SZ          (64)
+#define TMC_SHADOW_HDR_LEN     (32)
+#define TMC_SHADOW_VAL_LEN     (96)
 
-int tmc_connection_type;
 
+/* the device used by the functions without a device argument */
 struct tmcdev *tmc_device;
 
 
+/*
+ * Device-state shadow: the last acknowledged value of every setter that
+ * was written through this file. It's used by the _cached() write functions
+ * to suppress writes that would not change the state of the device.
+ * Every device has its own shadow.
+ */
+struct tmc_shadow_entry
+{
+  char hdr[TMC_SHADOW_HDR_LEN];
+  char val[TMC_SHADOW_VAL_LEN];
+};
 
-struct tmcdev * tmc_open_usb(const char *device)
+struct tmc_shadow
 {
-  tmc_connection_type = 0;
+  struct tmc_shadow_entry ent[TMC_SHADOW_SZ];
+  int cnt;
+};
 
-  tmc_device = tmcdev_open(device);
+/* commands starting with one of these can change the waveform readout settings */
+static const char *tmc_shadow_wav_deps[]=
+{
+  ":WAV", ":CHAN", ":ACQ", ":TIM", ":RUN", ":STOP", ":SING", ":TFOR",
+  ":FUNC", ":MATH", ":CALC", ":LA", ":DISP:CLE", ":CLE", NULL
+};
 
-  return tmc_device;
+
+static struct tmcdev * tmc_dev_attach_shadow(struct tmcdev *);
+static int tmc_shadow_split(const char *, char *, char *);
+static int tmc_shadow_find(struct tmc_shadow *, const char *);
+static void tmc_shadow_remove(struct tmc_shadow *, int);
+static void tmc_shadow_store(struct tmc_shadow *, const char *);
+static void tmc_shadow_forget(struct tmc_shadow *, const char *);
+static int tmc_shadow_match(struct tmc_shadow *, const char *);
+static int tmc_shadow_root_len(const char *);
+
+
+
+static struct tmcdev * tmc_dev_attach_shadow(struct tmcdev *dev)
+{
+  if(dev == NULL)
+  {
+    return NULL;
+  }
+
+  dev->shadow = (struct tmc_shadow *)calloc(1, sizeof(struct tmc_shadow));
+  if(dev->shadow == NULL)
+  {
+    tmc_dev_close(dev);
+
+    return NULL;
+  }
+
+  return dev;
 }
 
 
-struct tmcdev * tmc_open_lan(const char *address)
+struct tmcdev * tmc_dev_open_usb(const char *device)
 {
-  tmc_connection_type = 1;
+  return tmc_dev_attach_shadow(tmcdev_open(device));
+}
 
-  tmc_device =  tmclan_open(address);
 
-  return tmc_device;
+struct tmcdev * tmc_dev_open_lan(const char *address)
+{
+  return tmc_dev_attach_shadow(tmclan_open(address));
 }
 
 
-void tmc_close(void)
+void tmc_dev_close(struct tmcdev *dev)
 {
-  if(tmc_connection_type == 0)
+  if(dev == NULL)
   {
-    tmcdev_close(tmc_device);
+    return;
+  }
+
+  free(dev->shadow);
+
+  dev->shadow = NULL;
+
+  if(dev->conn_type == TMC_CONN_USB)
+  {
+    tmcdev_close(dev);
   }
   else
   {
-    tmclan_close(tmc_device);
+    tmclan_close(dev);
   }
+}
 
-  tmc_device = NULL;
+
+int tmc_dev_write(struct tmcdev *dev, const char *cmd)
+{
+  int n, cmd_class;
+
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  cmd_class = tmc_cmd_class(cmd);
+
+  if(cmd_class == TMC_CMD_CLASS_SLOW)
+  {
+    tmc_dev_shadow_clear(dev);
+  }
+
+  if(dev->conn_type == TMC_CONN_USB)
+  {
+    n = tmcdev_write(dev, cmd);
+  }
+  else
+  {
+    n = tmclan_write(dev, cmd);
+  }
+
+  if(cmd_class != TMC_CMD_CLASS_QUERY)
+  {
+    if(n < 0)
+    {
+      tmc_shadow_forget(dev->shadow, cmd);
+    }
+    else
+    {
+      tmc_shadow_store(dev->shadow, cmd);
+    }
+  }
+
+  return n;
 }
 
 
-int tmc_write(const char *cmd)
+/* same as tmc_dev_write() but skips the write when the device already has this setting */
+int tmc_dev_write_cached(struct tmcdev *dev, const char *cmd)
 {
-  if(tmc_connection_type == 0)
+  if(dev == NULL)
   {
-    return tmcdev_write(tmc_device, cmd);
+    return -1;
+  }
+
+  if(tmc_shadow_match(dev->shadow, cmd))
+  {
+    return strlen(cmd);
+  }
+
+  return tmc_dev_write(dev, cmd);
+}
+
+
+int tmc_dev_write_batch(struct tmcdev *dev, const char * const *cmds, int cnt)
+{
+  int i, n;
+
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  if(dev->conn_type == TMC_CONN_USB)
+  {
+    n = tmcdev_write_batch(dev, cmds, cnt);
   }
   else
   {
-    return tmclan_write(tmc_device, cmd);
+    n = tmclan_write_batch(dev, cmds, cnt);
+  }
+
+  for(i=0; i<cnt; i++)
+  {
+    if(n == cnt)
+    {
+      tmc_shadow_store(dev->shadow, cmds[i]);
+    }
+    else
+    {
+      tmc_shadow_forget(dev->shadow, cmds[i]);
+    }
+  }
+
+  return n;
+}
+
+
+/*
+ * Same as tmc_dev_write_batch() but only the setters that differ from the
+ * shadow are sent. Returns cnt when the device has all settings.
+ */
+int tmc_dev_write_batch_cached(struct tmcdev *dev, const char * const *cmds, int cnt)
+{
+  int i, n=0;
+
+  const char *changed[TMC_SHADOW_SZ];
+
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  if((cnt < 1) || (cnt > TMC_SHADOW_SZ))
+  {
+    return tmc_dev_write_batch(dev, cmds, cnt);
+  }
+
+  for(i=0; i<cnt; i++)
+  {
+    if(!tmc_shadow_match(dev->shadow, cmds[i]))
+    {
+      changed[n++] = cmds[i];
+    }
+  }
+
+  if(!n)
+  {
+    return cnt;
+  }
+
+  if(tmc_dev_write_batch(dev, changed, n) != n)
+  {
+    return -1;
+  }
+
+  return cnt;
+}
+
+
+/*
+ * Must be called for every command that is sent from the command cue.
+ * Drops the shadowed settings of the subsystem the command belongs to and,
+ * when the command can influence the waveform readout, the :WAV settings.
+ */
+void tmc_dev_shadow_invalidate(struct tmcdev *dev, const char *cmd)
+{
+  int i, len, wav=0;
+
+  struct tmc_shadow *sh;
+
+  if((dev == NULL) || (dev->shadow == NULL))
+  {
+    return;
+  }
+
+  sh = dev->shadow;
+
+  for(i=0; tmc_shadow_wav_deps[i]!=NULL; i++)
+  {
+    if(!strncmp(cmd, tmc_shadow_wav_deps[i], strlen(tmc_shadow_wav_deps[i])))
+    {
+      wav = 1;
+
+      break;
+    }
+  }
+
+  len = tmc_shadow_root_len(cmd);
+
+  for(i=sh->cnt-1; i>=0; i--)
+  {
+    if(wav && (!strncmp(sh->ent[i].hdr, ":WAV", 4)))
+    {
+      tmc_shadow_remove(sh, i);
+
+      continue;
+    }
+
+    if((len > 0) && (tmc_shadow_root_len(sh->ent[i].hdr) == len) &&
+       (!strncmp(sh->ent[i].hdr, cmd, len)))
+    {
+      tmc_shadow_remove(sh, i);
+    }
+  }
+}
+
+
+void tmc_dev_shadow_clear(struct tmcdev *dev)
+{
+  if((dev == NULL) || (dev->shadow == NULL))
+  {
+    return;
+  }
+
+  dev->shadow->cnt = 0;
+}
+
+
+/*
+ * Writes the waveform source command for all displayed channels into dest,
+ * e.g. ":WAV:SOUR CHAN1,CHAN3". Returns the number of channels in the list.
+ */
+int tmc_wav_source_list(char *dest, int sz, const int *chandisplay)
+{
+  int chn, cnt=0;
+
+  char str[16];
+
+  strlcpy(dest, ":WAV:SOUR ", sz);
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!chandisplay[chn])
+    {
+      continue;
+    }
+
+    snprintf(str, 16, "%sCHAN%i", cnt ? "," : "", chn + 1);
+
+    strlcat(dest, str, sz);
+
+    cnt++;
+  }
+
+  return cnt;
+}
+
+
+/*
+ * Checks if the firmware accepts a list of channels in :WAV:SOUR.
+ * In that case :WAV:DATA? returns the samples of all listed channels
+ * interleaved in one block: ch_a[0], ch_b[0], ch_a[1], ch_b[1], etc.
+ * Returns 1 if supported, 0 if not and -1 in case of a communication error.
+ */
+int tmc_dev_wav_multi_source_probe(struct tmcdev *dev, const char *src_list)
+{
+  int ret=0;
+
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  if(tmc_dev_write(dev, src_list) < 0)
+  {
+    return -1;
+  }
+
+  if(tmc_dev_write(dev, ":WAV:SOUR?") != 10)
+  {
+    return -1;
+  }
+
+  if(tmc_dev_read(dev) < 1)
+  {
+    return -1;
+  }
+
+  if(strchr(dev->buf, ',') != NULL)
+  {
+    ret = 1;
+  }
+
+  /* the device may have rejected the list, don't trust the shadow */
+  tmc_dev_shadow_invalidate(dev, ":WAV");
+
+  return ret;
+}
+
+
+/* splits a setter like ":WAV:SOUR CHAN1" into header and value, returns 0 on success */
+static int tmc_shadow_split(const char *cmd, char *hdr, char *val)
+{
+  int i;
+
+  if(tmc_cmd_class(cmd) == TMC_CMD_CLASS_QUERY)
+  {
+    return -1;
+  }
+
+  for(i=0; cmd[i]!=0; i++)
+  {
+    if((cmd[i] == ' ') || (cmd[i] == ';'))
+    {
+      break;
+    }
+  }
+
+  if((cmd[i] != ' ') || (i >= TMC_SHADOW_HDR_LEN) || (i < 2))
+  {
+    return -1;
+  }
+
+  if(strchr(cmd, ';') != NULL)  /* compound commands are not shadowed */
+  {
+    return -1;
+  }
+
+  if(strlen(cmd + i + 1) >= TMC_SHADOW_VAL_LEN)
+  {
+    return -1;
+  }
+
+  strlcpy(val, cmd + i + 1, TMC_SHADOW_VAL_LEN);
+
+  strlcpy(hdr, cmd, i + 1);
+
+  return 0;
+}
+
+
+static int tmc_shadow_find(struct tmc_shadow *sh, const char *hdr)
+{
+  int i;
+
+  for(i=0; i<sh->cnt; i++)
+  {
+    if(!strcmp(sh->ent[i].hdr, hdr))
+    {
+      return i;
+    }
   }
 
   return -1;
 }
 
 
-int tmc_read(void)
+static void tmc_shadow_remove(struct tmc_shadow *sh, int idx)
+{
+  if((idx < 0) || (idx >= sh->cnt))
+  {
+    return;
+  }
+
+  sh->cnt--;
+
+  if(idx != sh->cnt)
+  {
+    memcpy(&sh->ent[idx], &sh->ent[sh->cnt], sizeof(struct tmc_shadow_entry));
+  }
+}
+
+
+static void tmc_shadow_store(struct tmc_shadow *sh, const char *cmd)
+{
+  int idx;
+
+  char hdr[TMC_SHADOW_HDR_LEN],
+       val[TMC_SHADOW_VAL_LEN];
+
+  if(sh == NULL)
+  {
+    return;
+  }
+
+  if(tmc_shadow_split(cmd, hdr, val))
+  {
+    return;
+  }
+
+  idx = tmc_shadow_find(sh, hdr);
+
+  if(idx < 0)
+  {
+    if(sh->cnt >= TMC_SHADOW_SZ)
+    {
+      tmc_shadow_remove(sh, 0);
+    }
+
+    idx = sh->cnt++;
+
+    strlcpy(sh->ent[idx].hdr, hdr, TMC_SHADOW_HDR_LEN);
+  }
+
+  strlcpy(sh->ent[idx].val, val, TMC_SHADOW_VAL_LEN);
+}
+
+
+static void tmc_shadow_forget(struct tmc_shadow *sh, const char *cmd)
+{
+  char hdr[TMC_SHADOW_HDR_LEN],
+       val[TMC_SHADOW_VAL_LEN];
+
+  if(sh == NULL)
+  {
+    return;
+  }
+
+  if(tmc_shadow_split(cmd, hdr, val))
+  {
+    return;
+  }
+
+  tmc_shadow_remove(sh, tmc_shadow_find(sh, hdr));
+}
+
+
+static int tmc_shadow_match(struct tmc_shadow *sh, const char *cmd)
+{
+  int idx;
+
+  char hdr[TMC_SHADOW_HDR_LEN],
+       val[TMC_SHADOW_VAL_LEN];
+
+  if(sh == NULL)
+  {
+    return 0;
+  }
+
+  if(tmc_shadow_split(cmd, hdr, val))
+  {
+    return 0;
+  }
+
+  idx = tmc_shadow_find(sh, hdr);
+
+  if(idx < 0)
+  {
+    return 0;
+  }
+
+  if(strcmp(sh->ent[idx].val, val))
+  {
+    return 0;
+  }
+
+  return 1;
+}
+
+
+/* returns the length of the first node of a command, e.g. 6 for ":CHAN1:SCAL 1" */
+static int tmc_shadow_root_len(const char *cmd)
 {
-  if(tmc_connection_type == 0)
+  int i;
+
+  for(i=1; cmd[i]!=0; i++)
   {
-    return tmcdev_read(tmc_device);
+    if((cmd[i] == ':') || (cmd[i] == ' ') || (cmd[i] == '?') || (cmd[i] == ';'))
+    {
+      break;
+    }
+  }
+
+  return i;
+}
+
+
+void tmc_dev_set_completion_policy(struct tmcdev *dev, int cmd_class, int policy, int delay)
+{
+  if(dev == NULL)
+  {
+    return;
+  }
+
+  if((cmd_class < 0) || (cmd_class >= TMC_CMD_CLASS_CNT))
+  {
+    return;
+  }
+
+  if((policy < TMC_COMPL_NONE) || (policy > TMC_COMPL_DELAY))
+  {
+    return;
+  }
+
+  if(delay < 0)
+  {
+    delay = 0;
+  }
+
+  dev->cmd_compl[cmd_class].policy = policy;
+
+  dev->cmd_compl[cmd_class].delay = delay;
+}
+
+
+/*
+ * Sets the maximum time the response to a command of class cmd_class may stall
+ * before the read fails. The timeout restarts whenever data arrives so it does not
+ * limit the duration of a large transfer. On USB it is the timeout of the usbtmc driver,
+ * it is only set when the fast path is enabled (see tmc_dev.c).
+ */
+void tmc_dev_set_timeout(struct tmcdev *dev, int cmd_class, int msec)
+{
+  if(dev == NULL)
+  {
+    return;
+  }
+
+  if((cmd_class < 0) || (cmd_class >= TMC_CMD_CLASS_CNT))
+  {
+    return;
+  }
+
+  if(msec < 1)
+  {
+    msec = 1;
+  }
+
+  dev->cmd_compl[cmd_class].timeout = msec;
+}
+
+
+/*
+ * Interrupts a transfer that is in progress in another thread, the read returns TMC_ERR_CANCELED.
+ * Reads keep failing until tmc_dev_cancel_clear() is called, the rest of the interrupted
+ * response is discarded by the next read. USB transfers can not be interrupted,
+ * they end with the block that is being received.
+ */
+void tmc_dev_cancel(struct tmcdev *dev)
+{
+  if(dev == NULL)
+  {
+    return;
+  }
+
+  if(dev->conn_type == TMC_CONN_LAN)
+  {
+    tmclan_cancel(dev);
+  }
+}
+
+
+void tmc_dev_cancel_clear(struct tmcdev *dev)
+{
+  if(dev == NULL)
+  {
+    return;
+  }
+
+  if(dev->conn_type == TMC_CONN_LAN)
+  {
+    tmclan_cancel_clear(dev);
+  }
+}
+
+
+/* selects the optimized usbtmc path (default) or the plain read()/write() path, see tmc_dev.c */
+void tmc_dev_set_usb_fastpath(struct tmcdev *dev, int fast)
+{
+  if(dev == NULL)
+  {
+    return;
+  }
+
+  if(dev->conn_type == TMC_CONN_USB)
+  {
+    tmcdev_set_fastpath(dev, fast);
+  }
+}
+
+
+/* selects the TCP tuning of a LAN connection, see tmc_lan.h */
+void tmc_dev_set_lan_tuning(struct tmcdev *dev, int tuning)
+{
+  if(dev == NULL)
+  {
+    return;
+  }
+
+  if(dev->conn_type == TMC_CONN_LAN)
+  {
+    tmclan_set_tuning(dev, tuning);
+  }
+}
+
+
+/*
+ * Returns the number of block payload bytes received since the connection was opened
+ * and the time spent receiving them, from the block header to the end of the block.
+ * The difference between two calls gives the sustained throughput of the transfers in between.
+ */
+void tmc_dev_get_xfer_stats(struct tmcdev *dev, long long *bytes, long long *nsec)
+{
+  if(dev == NULL)
+  {
+    *bytes = 0;
+
+    *nsec = 0;
+
+    return;
+  }
+
+  *bytes = dev->xfer_bytes;
+
+  *nsec = dev->xfer_nsec;
+}
+
+
+int tmc_dev_read(struct tmcdev *dev)
+{
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  if(dev->conn_type == TMC_CONN_USB)
+  {
+    return tmcdev_read(dev);
   }
   else
   {
-    return tmclan_read(tmc_device);
+    return tmclan_read(dev);
   }
 
   return -1;
 }
 
 
+/*
+ * Reads a definite length block response (e.g. :WAV:DATA?) directly into dest
+ * without going through the response buffer of the device.
+ * Returns the number of payload bytes or a negative number in case of an error.
+ */
+int tmc_dev_read_block(struct tmcdev *dev, char *dest, int dest_sz)
+{
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  if(dev->conn_type == TMC_CONN_USB)
+  {
+    return tmcdev_read_block(dev, dest, dest_sz);
+  }
+  else
+  {
+    return tmclan_read_block(dev, dest, dest_sz);
+  }
+
+  return -1;
+}
+
+
+/*
+ * The functions below operate on the device that was opened with
+ * tmc_open_usb() or tmc_open_lan().
+ */
+
+struct tmcdev * tmc_open_usb(const char *device)
+{
+  tmc_device = tmc_dev_open_usb(device);
+
+  return tmc_device;
+}
+
+
+struct tmcdev * tmc_open_lan(const char *address)
+{
+  tmc_device = tmc_dev_open_lan(address);
+
+  return tmc_device;
+}
+
+
+void tmc_close(void)
+{
+  tmc_dev_close(tmc_device);
+
+  tmc_device = NULL;
+}
+
+
+int tmc_write(const char *cmd)
+{
+  return tmc_dev_write(tmc_device, cmd);
+}
+
+
+int tmc_write_cached(const char *cmd)
+{
+  return tmc_dev_write_cached(tmc_device, cmd);
+}
+
+
+int tmc_write_batch(const char * const *cmds, int cnt)
+{
+  return tmc_dev_write_batch(tmc_device, cmds, cnt);
+}
+
+
+int tmc_write_batch_cached(const char * const *cmds, int cnt)
+{
+  return tmc_dev_write_batch_cached(tmc_device, cmds, cnt);
+}
+
+
+void tmc_shadow_invalidate(const char *cmd)
+{
+  tmc_dev_shadow_invalidate(tmc_device, cmd);
+}
+
+
+void tmc_shadow_clear(void)
+{
+  tmc_dev_shadow_clear(tmc_device);
+}
+
+
+int tmc_wav_multi_source_probe(const char *src_list)
+{
+  return tmc_dev_wav_multi_source_probe(tmc_device, src_list);
+}
+
+
+void tmc_set_completion_policy(int cmd_class, int policy, int delay)
+{
+  tmc_dev_set_completion_policy(tmc_device, cmd_class, policy, delay);
+}
+
+
+void tmc_set_timeout(int cmd_class, int msec)
+{
+  tmc_dev_set_timeout(tmc_device, cmd_class, msec);
+}
+
+
+void tmc_cancel(void)
+{
+  tmc_dev_cancel(tmc_device);
+}
+
+
+void tmc_cancel_clear(void)
+{
+  tmc_dev_cancel_clear(tmc_device);
+}
+
+
+void tmc_set_usb_fastpath(int fast)
+{
+  tmc_dev_set_usb_fastpath(tmc_device, fast);
+}
+
+
+void tmc_set_lan_tuning(int tuning)
+{
+  tmc_dev_set_lan_tuning(tmc_device, tuning);
+}
+
+
+void tmc_get_xfer_stats(long long *bytes, long long *nsec)
+{
+  tmc_dev_get_xfer_stats(tmc_device, bytes, nsec);
+}
+
+
+int tmc_read(void)
+{
+  return tmc_dev_read(tmc_device);
+}
+
+
+int tmc_read_block(char *dest, int dest_sz)
+{
+  return tmc_dev_read_block(tmc_device, dest, dest_sz);
+}
+
+
+
+
 
 
 
@@ -44,10 +44,47 @@
 #include "utils.h"
 
 
+/* explicit device, several devices can be used concurrently (one thread per device) */
+struct tmcdev * tmc_dev_open_usb(const char *);
+struct tmcdev * tmc_dev_open_lan(const char *);
+void tmc_dev_close(struct tmcdev *);
+int tmc_dev_write(struct tmcdev *, const char *);
+int tmc_dev_write_cached(struct tmcdev *, const char *);
+int tmc_dev_write_batch(struct tmcdev *, const char * const *, int);
+int tmc_dev_write_batch_cached(struct tmcdev *, const char * const *, int);
+void tmc_dev_shadow_invalidate(struct tmcdev *, const char *);
+void tmc_dev_shadow_clear(struct tmcdev *);
+int tmc_dev_wav_multi_source_probe(struct tmcdev *, const char *);
+int tmc_dev_read(struct tmcdev *);
+int tmc_dev_read_block(struct tmcdev *, char *, int);
+void tmc_dev_set_completion_policy(struct tmcdev *, int, int, int);
+void tmc_dev_set_timeout(struct tmcdev *, int, int);
+void tmc_dev_cancel(struct tmcdev *);
+void tmc_dev_cancel_clear(struct tmcdev *);
+void tmc_dev_set_usb_fastpath(struct tmcdev *, int);
+void tmc_dev_set_lan_tuning(struct tmcdev *, int);
+void tmc_dev_get_xfer_stats(struct tmcdev *, long long *, long long *);
+
+/* implicit device, the one that was opened last with tmc_open_usb() or tmc_open_lan() */
 struct tmcdev * tmc_open_usb(const char *);
 void tmc_close(void);
 int tmc_write(const char *);
+int tmc_write_cached(const char *);
+int tmc_write_batch(const char * const *, int);  /* setters only, returns the number of commands written */
+int tmc_write_batch_cached(const char * const *, int);
+void tmc_shadow_invalidate(const char *);
+void tmc_shadow_clear(void);
+int tmc_wav_source_list(char *, int, const int *);
+int tmc_wav_multi_source_probe(const char *);
 int tmc_read(void);
+int tmc_read_block(char *, int);
+void tmc_set_completion_policy(int, int, int);  /* command class, TMC_COMPL_xxx, delay in micro-Sec */
+void tmc_set_timeout(int, int);  /* command class, timeout in milli-Sec */
+void tmc_cancel(void);  /* may be called from another thread */
+void tmc_cancel_clear(void);
+void tmc_set_usb_fastpath(int);
+void tmc_set_lan_tuning(int);  /* TMC_LAN_BULK and/or TMC_LAN_QUICKACK */
+void tmc_get_xfer_stats(long long *, long long *);  /* block payload bytes and nano-Sec since the connection was opened */
 struct tmcdev * tmc_open_lan(const char *);
 
 
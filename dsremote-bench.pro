@@ -0,0 +1,97 @@
+
+contains(QT_MAJOR_VERSION, 4) {
+
+LIST = 0 1 2 3 4 5 6
+for(a, LIST):contains(QT_MINOR_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+
+contains(QT_MINOR_VERSION, 7) {
+  LIST = 0
+  for(a, LIST):contains(QT_PATCH_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+}
+}
+
+
+contains(QT_MAJOR_VERSION, 5) {
+
+LIST = 0 1 2 3 4 5 6 7 8
+for(a, LIST):contains(QT_MINOR_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+
+contains(QT_MINOR_VERSION, 9) {
+  LIST = 0
+  for(a, LIST):contains(QT_PATCH_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+}
+}
+
+
+contains(QT_MAJOR_VERSION, 6) {
+
+LIST = 0 1 2 3
+for(a, LIST):contains(QT_MINOR_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+
+contains(QT_MINOR_VERSION, 4) {
+  LIST = 0
+  for(a, LIST):contains(QT_PATCH_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+}
+}
+
+
+# Transport and acquisition benchmark, see bench_main.cpp. Does not link QtWidgets or QtGui.
+
+TEMPLATE = app
+TARGET = dsremote-bench
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG += qt
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += warn_on
+CONFIG += release
+CONFIG += largefile
+
+QT -= gui
+
+QMAKE_CXXFLAGS += -Wextra -Wshadow -Wformat -Wformat-nonliteral -Wformat-security -Wtype-limits -Wfatal-errors -Wdeprecated-declarations
+
+QMAKE_CFLAGS += -Wall -Wextra -Wshadow -Wformat-nonliteral -Wformat-security -Wtype-limits -Wfatal-errors -D_LARGEFILE64_SOURCE -D_LARGEFILE_SOURCE
+
+OBJECTS_DIR = ./objects_bench
+MOC_DIR = ./moc_bench
+
+HEADERS += global.h
+HEADERS += utils.h
+HEADERS += connection.h
+HEADERS += tmc_dev.h
+HEADERS += tmc_lan.h
+HEADERS += tmc_cmd.h
+HEADERS += wav_convert.h
+HEADERS += mem_download_thread.h
+HEADERS += mem_pipeline.h
+HEADERS += bqueue.h
+HEADERS += read_settings_thread.h
+HEADERS += screen_thread.h
+HEADERS += stage_timer.h
+HEADERS += third_party/kiss_fft/kiss_fft.h
+HEADERS += third_party/kiss_fft/_kiss_fft_guts.h
+HEADERS += third_party/kiss_fft/kiss_fftr.h
+
+SOURCES += bench_main.cpp
+SOURCES += utils.c
+SOURCES += connection.cpp
+SOURCES += tmc_dev.c
+SOURCES += tmc_lan.c
+SOURCES += tmc_cmd.c
+SOURCES += wav_convert.c
+SOURCES += mem_download_thread.cpp
+SOURCES += mem_pipeline.cpp
+SOURCES += bqueue.c
+SOURCES += read_settings_thread.cpp
+SOURCES += screen_thread.cpp
+SOURCES += stage_timer.c
+SOURCES += third_party/kiss_fft/kiss_fft.c
+SOURCES += third_party/kiss_fft/kiss_fftr.c
+
+target.path = /usr/bin
+target.files = dsremote-bench
+INSTALLS += target
+
+
@@ -0,0 +1,61 @@
+
+contains(QT_MAJOR_VERSION, 4) {
+
+LIST = 0 1 2 3 4 5 6
+for(a, LIST):contains(QT_MINOR_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+
+contains(QT_MINOR_VERSION, 7) {
+  LIST = 0
+  for(a, LIST):contains(QT_PATCH_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+}
+}
+
+
+contains(QT_MAJOR_VERSION, 5) {
+
+LIST = 0 1 2 3 4 5 6 7 8
+for(a, LIST):contains(QT_MINOR_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+
+contains(QT_MINOR_VERSION, 9) {
+  LIST = 0
+  for(a, LIST):contains(QT_PATCH_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+}
+}
+
+
+contains(QT_MAJOR_VERSION, 6) {
+
+LIST = 0 1 2 3
+for(a, LIST):contains(QT_MINOR_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+
+contains(QT_MINOR_VERSION, 4) {
+  LIST = 0
+  for(a, LIST):contains(QT_PATCH_VERSION, $$a):error("This project needs Qt4 version >= 4.7.1 or Qt5 version >= 5.9.1 or Qt6 version >= 6.4.1")
+}
+}
+
+
+# Simulated DHO800/DHO900 on TCP port 5555, see scpi_sim.c. Plain C, no Qt.
+
+TEMPLATE = app
+TARGET = dsremote-sim
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG -= qt
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += warn_on
+CONFIG += release
+
+QMAKE_CFLAGS += -Wall -Wextra -Wshadow -Wformat-nonliteral -Wformat-security -Wtype-limits -Wfatal-errors
+
+LIBS += -lm
+
+OBJECTS_DIR = ./objects_sim
+
+HEADERS += utils.h
+
+SOURCES += scpi_sim.c
+SOURCES += utils.c
+
+
@@ -63,19 +63,30 @@ HEADERS += utils.h
 HEADERS += connection.h
 HEADERS += tmc_dev.h
 HEADERS += tmc_lan.h
+HEADERS += tmc_cmd.h
+HEADERS += wav_convert.h
 HEADERS += tled.h
 HEADERS += edflib.h
+HEADERS += raw_capture.h
+HEADERS += capture_view.h
 HEADERS += signalcurve.h
 HEADERS += settings_dialog.h
 HEADERS += screen_thread.h
 HEADERS += lan_connect_thread.h
 HEADERS += read_settings_thread.h
 HEADERS += save_data_thread.h
+HEADERS += mem_download_thread.h
+HEADERS += wave_pyramid_thread.h
+HEADERS += mem_pipeline.h
+HEADERS += bqueue.h
 HEADERS += decode_dialog.h
 HEADERS += tdial.h
 HEADERS += wave_dialog.h
 HEADERS += wave_view.h
+HEADERS += wave_pyramid.h
 HEADERS += playback_dialog.h
+HEADERS += stage_timer.h
+HEADERS += stats_dialog.h
 
 HEADERS += third_party/kiss_fft/kiss_fft.h
 HEADERS += third_party/kiss_fft/_kiss_fft_guts.h
@@ -93,19 +104,30 @@ SOURCES += utils.c
 SOURCES += connection.cpp
 SOURCES += tmc_dev.c
 SOURCES += tmc_lan.c
+SOURCES += tmc_cmd.c
+SOURCES += wav_convert.c
 SOURCES += tled.cpp
 SOURCES += edflib.c
+SOURCES += raw_capture.c
+SOURCES += capture_view.c
 SOURCES += signalcurve.cpp
 SOURCES += settings_dialog.cpp
 SOURCES += screen_thread.cpp
 SOURCES += lan_connect_thread.cpp
 SOURCES += read_settings_thread.cpp
 SOURCES += save_data_thread.cpp
+SOURCES += mem_download_thread.cpp
+SOURCES += wave_pyramid_thread.cpp
+SOURCES += mem_pipeline.cpp
+SOURCES += bqueue.c
 SOURCES += decode_dialog.cpp
 SOURCES += tdial.cpp
 SOURCES += wave_dialog.cpp
 SOURCES += wave_view.cpp
+SOURCES += wave_pyramid.c
 SOURCES += playback_dialog.cpp
+SOURCES += stage_timer.c
+SOURCES += stats_dialog.cpp
 
 SOURCES += third_party/kiss_fft/kiss_fft.c
 SOURCES += third_party/kiss_fft/kiss_fftr.c
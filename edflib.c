@@ -33,8 +33,17 @@
 
 /* compile with options "-D_LARGEFILE64_SOURCE -D_LARGEFILE_SOURCE" */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  /* O_DIRECT */
+#endif
+
 #include "edflib.h"
 
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
 #define EDFLIB_VERSION  (123)
 #define EDFLIB_MAXFILES  (64)
 
@@ -78,6 +87,9 @@
 
 #define EDFLIB_ANNOT_MEMBLOCKSZ  (1000)
 
+/* alignment of the stream buffer, its size and the file offsets of O_DIRECT writes */
+#define EDFLIB_STREAM_ALIGN  (4096)
+
 struct edfparamblock{
         char   label[17];
         char   transducer[81];
@@ -146,6 +158,13 @@ struct edfhdrblock{
         int       eq_sf;
         char      *wrbuf;
         int       wrbufsize;
+        char      *stream_buf;
+        int       stream_bufsize;
+        int       stream_len;
+        int       stream_flags;
+        int       stream_started;
+        int       stream_fd;
+        long long stream_ofs;
         struct edfparamblock *edfparam;
       };
 
@@ -187,7 +206,11 @@ static int edflib_sprint_int_number_nonlocalized(char *, int, int, int);
 static int edflib_snprint_ll_number_nonlocalized(char *, long long, int, int, int);
 static int edflib_fprint_int_number_nonlocalized(FILE *, int, int, int);
 static int edflib_fprint_ll_number_nonlocalized(FILE *, long long, int, int);
-static int edflib_write_tal(struct edfhdrblock *, FILE *);
+static int edflib_write_tal(struct edfhdrblock *);
+static int edflib_write_data(struct edfhdrblock *, const void *, int);
+static int edflib_stream_start(struct edfhdrblock *);
+static int edflib_stream_flush(struct edfhdrblock *, int);
+static void edflib_stream_free(struct edfhdrblock *);
 static int edflib_strlcpy(char *, const char *, int);
 static int edflib_strlcat(char *, const char *, int);
 
@@ -464,7 +487,8 @@ int edfclose_file(int handle)
 
   int i, j, k, n, p, err,
       datrecsize,
-      nmemb;
+      nmemb,
+      stream_err;
 
   long long offset,
             datarecords;
@@ -480,8 +504,15 @@ int edfclose_file(int handle)
 
   hdr = hdrlist[handle];
 
+  stream_err = 0;
+
   if(hdr->writemode)
   {
+    if(hdr->stream_buf != NULL)
+    {
+      stream_err = edflib_stream_flush(hdr, 1);
+    }
+
     if(hdr->datarecords == 0LL)
     {
       err = edflib_write_edf_header(hdr);
@@ -489,6 +520,8 @@ int edfclose_file(int handle)
       {
         fclose(hdr->file_hdl);
 
+        edflib_stream_free(hdr);
+
         free(hdr->edfparam);
 
         free(hdr->wrbuf);
@@ -654,6 +687,17 @@ int edfclose_file(int handle)
     }
 
     free(write_annotationslist[handle]);
+
+    if(hdr->stream_buf != NULL)  // written at disk speed without syncs in between, sync once at the end
+    {
+      if(fflush(hdr->file_hdl))  stream_err = -1;
+
+#ifndef _WIN32
+      if(fsync(fileno(hdr->file_hdl)))  stream_err = -1;
+#endif
+
+      edflib_stream_free(hdr);
+    }
   }
   else
   {
@@ -672,7 +716,7 @@ int edfclose_file(int handle)
 
   edf_files_open--;
 
-  return 0;
+  return stream_err;
 }
 
 
@@ -3595,6 +3639,8 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
 
   hdr->file_hdl = file;
 
+  hdr->stream_fd = -1;
+
   edflib_strlcpy(hdr->path, path, 1024);
 
   edf_files_open++;
@@ -3732,6 +3778,75 @@ int edf_set_subsecond_starttime(int handle, int subsecond)
 }
 
 
+int edf_set_stream_buffer(int handle, int size, int flags)
+{
+  struct edfhdrblock *hdr;
+
+  if((handle<0)||(handle>=EDFLIB_MAXFILES))  return -1;
+
+  if(hdrlist[handle]==NULL)  return -1;
+
+  if(!hdrlist[handle]->writemode)  return -1;
+
+  if(hdrlist[handle]->datarecords || hdrlist[handle]->signal_write_sequence_pos)  return -1;
+
+  if(size < 0)  return -1;
+
+  hdr = hdrlist[handle];
+
+  edflib_stream_free(hdr);
+
+  if(!size)  return 0;
+
+  /* a multiple of the alignment, so that a full buffer can be written with O_DIRECT */
+  size = ((size + EDFLIB_STREAM_ALIGN - 1) / EDFLIB_STREAM_ALIGN) * EDFLIB_STREAM_ALIGN;
+
+#ifdef _WIN32
+  hdr->stream_buf = (char *)malloc(size);
+#else
+  if(posix_memalign((void **)&hdr->stream_buf, EDFLIB_STREAM_ALIGN, size))
+  {
+    hdr->stream_buf = NULL;
+  }
+#endif
+
+  if(hdr->stream_buf == NULL)  return -1;
+
+  hdr->stream_bufsize = size;
+
+  hdr->stream_flags = flags;
+
+  return 0;
+}
+
+
+int edf_sync_file(int handle)
+{
+  struct edfhdrblock *hdr;
+
+  if((handle<0)||(handle>=EDFLIB_MAXFILES))  return -1;
+
+  if(hdrlist[handle]==NULL)  return -1;
+
+  if(!hdrlist[handle]->writemode)  return -1;
+
+  hdr = hdrlist[handle];
+
+  if(hdr->stream_buf != NULL)
+  {
+    if(edflib_stream_flush(hdr, 1))  return -1;
+  }
+
+  if(fflush(hdr->file_hdl))  return -1;
+
+#ifndef _WIN32
+  if(fsync(fileno(hdr->file_hdl)))  return -1;
+#endif
+
+  return 0;
+}
+
+
 int edfwrite_digital_short_samples(int handle, short *buf)
 {
   int  i,
@@ -3790,7 +3905,7 @@ int edfwrite_digital_short_samples(int handle, short *buf)
       }
     }
 
-    if(fwrite(buf, sf * 2, 1, file) != 1)  return -1;
+    if(edflib_write_data(hdr, buf, sf * 2))  return -1;
   }
   else  // BDF
   {
@@ -3822,7 +3937,7 @@ int edfwrite_digital_short_samples(int handle, short *buf)
       hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)  return -1;
+    if(edflib_write_data(hdr, hdr->wrbuf, sf * 3))  return -1;
   }
 
   hdr->signal_write_sequence_pos++;
@@ -3831,11 +3946,11 @@ int edfwrite_digital_short_samples(int handle, short *buf)
   {
     hdr->signal_write_sequence_pos = 0;
 
-    if(edflib_write_tal(hdr, file))  return -1;
+    if(edflib_write_tal(hdr))  return -1;
 
     hdr->datarecords++;
 
-    fflush(file);
+    if(hdr->stream_buf == NULL)  fflush(file);
   }
 
   return 0;
@@ -3914,7 +4029,7 @@ int edfwrite_digital_samples(int handle, int *buf)
       hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)  return -1;
+    if(edflib_write_data(hdr, hdr->wrbuf, sf * 2))  return -1;
   }
   else  // BDF
   {
@@ -3946,7 +4061,7 @@ int edfwrite_digital_samples(int handle, int *buf)
       hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)  return -1;
+    if(edflib_write_data(hdr, hdr->wrbuf, sf * 3))  return -1;
   }
 
   hdr->signal_write_sequence_pos++;
@@ -3955,11 +4070,11 @@ int edfwrite_digital_samples(int handle, int *buf)
   {
     hdr->signal_write_sequence_pos = 0;
 
-    if(edflib_write_tal(hdr, file))  return -1;
+    if(edflib_write_tal(hdr))  return -1;
 
     hdr->datarecords++;
 
-    fflush(file);
+    if(hdr->stream_buf == NULL)  fflush(file);
   }
 
   return 0;
@@ -4042,7 +4157,7 @@ int edf_blockwrite_digital_samples(int handle, int *buf)
         hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)  return -1;
+      if(edflib_write_data(hdr, hdr->wrbuf, sf * 2))  return -1;
     }
     else  // BDF
     {
@@ -4074,17 +4189,17 @@ int edf_blockwrite_digital_samples(int handle, int *buf)
         hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)  return -1;
+      if(edflib_write_data(hdr, hdr->wrbuf, sf * 3))  return -1;
     }
 
     buf_offset += sf;
   }
 
-  if(edflib_write_tal(hdr, file))  return -1;
+  if(edflib_write_tal(hdr))  return -1;
 
   hdr->datarecords++;
 
-  fflush(file);
+  if(hdr->stream_buf == NULL)  fflush(file);
 
   return 0;
 }
@@ -4161,7 +4276,7 @@ int edf_blockwrite_digital_short_samples(int handle, short *buf)
         }
       }
 
-      if(fwrite(buf + buf_offset, sf * 2, 1, file) != 1)  return -1;
+      if(edflib_write_data(hdr, buf + buf_offset, sf * 2))  return -1;
     }
     else  // BDF
     {
@@ -4193,17 +4308,17 @@ int edf_blockwrite_digital_short_samples(int handle, short *buf)
         hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)  return -1;
+      if(edflib_write_data(hdr, hdr->wrbuf, sf * 3))  return -1;
     }
 
     buf_offset += sf;
   }
 
-  if(edflib_write_tal(hdr, file))  return -1;
+  if(edflib_write_tal(hdr))  return -1;
 
   hdr->datarecords++;
 
-  fflush(file);
+  if(hdr->stream_buf == NULL)  fflush(file);
 
   return 0;
 }
@@ -4250,13 +4365,13 @@ int edf_blockwrite_digital_3byte_samples(int handle, void *buf)
     total_samples += hdr->edfparam[j].smp_per_record;
   }
 
-  if(fwrite(buf, total_samples * 3, 1, file) != 1)  return -1;
+  if(edflib_write_data(hdr, buf, total_samples * 3))  return -1;
 
-  if(edflib_write_tal(hdr, file))  return -1;
+  if(edflib_write_tal(hdr))  return -1;
 
   hdr->datarecords++;
 
-  fflush(file);
+  if(hdr->stream_buf == NULL)  fflush(file);
 
   return 0;
 }
@@ -4341,7 +4456,7 @@ int edfwrite_physical_samples(int handle, double *buf)
       hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)  return -1;
+    if(edflib_write_data(hdr, hdr->wrbuf, sf * 2))  return -1;
   }
   else  // BDF
   {
@@ -4373,7 +4488,7 @@ int edfwrite_physical_samples(int handle, double *buf)
       hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)  return -1;
+    if(edflib_write_data(hdr, hdr->wrbuf, sf * 3))  return -1;
   }
 
   hdr->signal_write_sequence_pos++;
@@ -4382,11 +4497,11 @@ int edfwrite_physical_samples(int handle, double *buf)
   {
     hdr->signal_write_sequence_pos = 0;
 
-    if(edflib_write_tal(hdr, file))  return -1;
+    if(edflib_write_tal(hdr))  return -1;
 
     hdr->datarecords++;
 
-    fflush(file);
+    if(hdr->stream_buf == NULL)  fflush(file);
   }
 
   return 0;
@@ -4476,7 +4591,7 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
         hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)  return -1;
+      if(edflib_write_data(hdr, hdr->wrbuf, sf * 2))  return -1;
     }
     else  // BDF
     {
@@ -4508,17 +4623,17 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
         hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)  return -1;
+      if(edflib_write_data(hdr, hdr->wrbuf, sf * 3))  return -1;
     }
 
     buf_offset += sf;
   }
 
-  if(edflib_write_tal(hdr, file))  return -1;
+  if(edflib_write_tal(hdr))  return -1;
 
   hdr->datarecords++;
 
-  fflush(file);
+  if(hdr->stream_buf == NULL)  fflush(file);
 
   return 0;
 }
@@ -6295,7 +6410,7 @@ static int edflib_atoi_nonlocalized(const char *str)
 }
 
 
-static int edflib_write_tal(struct edfhdrblock *hdr, FILE *file)
+static int edflib_write_tal(struct edfhdrblock *hdr)
 {
   int p;
 
@@ -6314,7 +6429,7 @@ static int edflib_write_tal(struct edfhdrblock *hdr, FILE *file)
     str[p] = 0;
   }
 
-  if(fwrite(str, hdr->total_annot_bytes, 1, file) != 1)
+  if(edflib_write_data(hdr, str, hdr->total_annot_bytes))
   {
     return -1;
   }
@@ -6323,6 +6438,197 @@ static int edflib_write_tal(struct edfhdrblock *hdr, FILE *file)
 }
 
 
+/* writes samples or a TAL, directly or through the stream buffer */
+static int edflib_write_data(struct edfhdrblock *hdr, const void *data, int len)
+{
+  int n;
+
+  const char *ptr;
+
+  if(hdr->stream_buf == NULL)
+  {
+    if(fwrite(data, len, 1, hdr->file_hdl) != 1)  return -1;
+
+    return 0;
+  }
+
+  if(!hdr->stream_started)
+  {
+    if(edflib_stream_start(hdr))  return -1;
+  }
+
+  ptr = (const char *)data;
+
+  if((hdr->stream_fd < 0) && ((hdr->stream_len + len) > hdr->stream_bufsize))
+  {
+    if(edflib_stream_flush(hdr, 0))  return -1;
+
+    if(len >= hdr->stream_bufsize)  // no need to copy, it is written in one call anyway
+    {
+      if(fwrite(data, len, 1, hdr->file_hdl) != 1)  return -1;
+
+      return 0;
+    }
+  }
+
+  while(len > 0)
+  {
+    n = hdr->stream_bufsize - hdr->stream_len;
+
+    if(n > len)  n = len;
+
+    memcpy(hdr->stream_buf + hdr->stream_len, ptr, n);
+
+    hdr->stream_len += n;
+
+    ptr += n;
+
+    len -= n;
+
+    if(hdr->stream_len == hdr->stream_bufsize)
+    {
+      if(edflib_stream_flush(hdr, 0))  return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ * Called before the first datarecord, the header has been written through the stdio stream.
+ * With O_DIRECT the buffer starts at the aligned file offset below the end of the header,
+ * the header bytes in front are read back so that every write covers whole blocks.
+ * When the filesystem does not support O_DIRECT, the buffer is written through the stdio stream.
+ */
+static int edflib_stream_start(struct edfhdrblock *hdr)
+{
+  hdr->stream_started = 1;
+
+  hdr->stream_len = 0;
+
+  if(fflush(hdr->file_hdl))  return -1;
+
+#if defined(__linux__) && defined(O_DIRECT)
+  if(hdr->stream_flags & EDFLIB_STREAM_DIRECT)
+  {
+    long long hdr_end;
+
+    hdr_end = ftello(hdr->file_hdl);
+
+    hdr->stream_ofs = hdr_end - (hdr_end % EDFLIB_STREAM_ALIGN);
+
+    hdr->stream_fd = open(hdr->path, O_RDWR | O_DIRECT);
+
+    if(hdr->stream_fd >= 0)
+    {
+      if((hdr_end - hdr->stream_ofs) > hdr->stream_bufsize)
+      {
+        close(hdr->stream_fd);
+
+        hdr->stream_fd = -1;
+      }
+      else if(hdr_end > hdr->stream_ofs)
+        {
+          if(pread(hdr->stream_fd, hdr->stream_buf, EDFLIB_STREAM_ALIGN, hdr->stream_ofs) != (hdr_end - hdr->stream_ofs))
+          {
+            close(hdr->stream_fd);
+
+            hdr->stream_fd = -1;
+          }
+          else
+          {
+            hdr->stream_len = hdr_end - hdr->stream_ofs;
+          }
+        }
+    }
+  }
+#endif
+
+  return 0;
+}
+
+
+/*
+ * Writes the stream buffer. When final is zero, only whole blocks are written with O_DIRECT.
+ * When final is non-zero, everything is written and O_DIRECT is switched off.
+ */
+static int edflib_stream_flush(struct edfhdrblock *hdr, int final)
+{
+#ifndef _WIN32
+  int n;
+
+  if(hdr->stream_fd >= 0)
+  {
+    if(final)  // the tail is not a whole block, write it without O_DIRECT and continue with the stdio stream
+    {
+      close(hdr->stream_fd);
+
+      hdr->stream_fd = -1;
+
+      if(hdr->stream_len)
+      {
+        if(pwrite(fileno(hdr->file_hdl), hdr->stream_buf, hdr->stream_len, hdr->stream_ofs) != hdr->stream_len)  return -1;
+      }
+
+      hdr->stream_ofs += hdr->stream_len;
+
+      hdr->stream_len = 0;
+
+      if(fseeko(hdr->file_hdl, hdr->stream_ofs, SEEK_SET))  return -1;
+
+      return 0;
+    }
+
+    n = hdr->stream_len - (hdr->stream_len % EDFLIB_STREAM_ALIGN);
+
+    if(!n)  return 0;
+
+    if(pwrite(hdr->stream_fd, hdr->stream_buf, n, hdr->stream_ofs) != n)  return -1;
+
+    hdr->stream_ofs += n;
+
+    hdr->stream_len -= n;
+
+    memmove(hdr->stream_buf, hdr->stream_buf + n, hdr->stream_len);
+
+    return 0;
+  }
+#endif
+
+  if(!hdr->stream_len)  return 0;
+
+  if(fwrite(hdr->stream_buf, hdr->stream_len, 1, hdr->file_hdl) != 1)  return -1;
+
+  hdr->stream_len = 0;
+
+  return 0;
+}
+
+
+static void edflib_stream_free(struct edfhdrblock *hdr)
+{
+#ifndef _WIN32
+  if(hdr->stream_fd >= 0)
+  {
+    close(hdr->stream_fd);
+  }
+#endif
+
+  hdr->stream_fd = -1;
+
+  free(hdr->stream_buf);
+
+  hdr->stream_buf = NULL;
+
+  hdr->stream_bufsize = 0;
+
+  hdr->stream_len = 0;
+
+  hdr->stream_started = 0;
+}
+
+
 static int edflib_strlcpy(char *dst, const char *src, int sz)
 {
   int srclen;
@@ -150,6 +150,9 @@
 #define EDFLIB_READ_ANNOTATIONS         (1)
 #define EDFLIB_READ_ALL_ANNOTATIONS     (2)
 
+/* flags for edf_set_stream_buffer() */
+#define EDFLIB_STREAM_DIRECT  (1)
+
 /* the following defines are possible errors returned by the first sample write action */
 #define EDFLIB_NO_SIGNALS                  (-20)
 #define EDFLIB_TOO_MANY_SIGNALS            (-21)
@@ -659,6 +662,26 @@ int edf_set_number_of_annotation_signals(int handle, int annot_signals);
  * Returns 0 on success, otherwise -1
  */
 
+int edf_set_stream_buffer(int handle, int size, int flags);
+/* Collects the datarecords in a buffer of size bytes (rounded up to a multiple of 4096)
+ * and writes it when it is full, instead of writing and flushing every datarecord.
+ * The file is synced to disk once, by edfclose_file().
+ * With flag EDFLIB_STREAM_DIRECT the buffer is written with O_DIRECT, bypassing the page cache,
+ * where the OS and the filesystem support it, otherwise the flag is ignored.
+ * Use a size of several megabytes when writing large recordings, a size of 0 switches the buffer off.
+ * This function is optional and can be called only after opening a file in writemode
+ * and before the first sample write action
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_sync_file(int handle);
+/* Writes the datarecords that are still in the stream buffer and waits until the file is on disk.
+ * O_DIRECT, if used, is switched off for the rest of the file.
+ * This function is optional, call it from a worker thread when edfclose_file() must not block
+ * on a large file. Can be called only in writemode.
+ * Returns 0 on success, otherwise -1
+ */
+
 int edf_set_subsecond_starttime(int handle, int subsecond);
 /* Sets the subsecond starttime expressed in units of 100 nanoSeconds
  * Valid range is 0 to 9999999 inclusive. Default is 0
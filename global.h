@@ -82,6 +82,12 @@
 
 #define TMC_DIAL_TIMER_DELAY    (300)
 
+#define SETTINGS_GRP_CORE         (1)  // channels, timebase, trigger, acquisition, display
+#define SETTINGS_GRP_MATH         (2)
+#define SETTINGS_GRP_DECODE       (4)
+#define SETTINGS_GRP_RECORD       (8)
+#define SETTINGS_GRP_ALL         (15)
+
 #define DECODE_MODE_TAB_PAR       (0)
 #define DECODE_MODE_TAB_UART      (1)
 #define DECODE_MODE_TAB_SPI       (2)
@@ -269,6 +275,7 @@ struct device_settings
   int wavebufsz;
   double yinc[MAX_CHNS];
   int yor[MAX_CHNS];
+  int yref[MAX_CHNS];           // :WAV:YREF? of the deep memory, wavebuf[] = ADC code - yref - yor
 
   double xorigin[MAX_CHNS];
 
@@ -332,6 +339,17 @@ struct device_settings
   int func_wplay_operate;
   int func_wplay_fcur;
   int func_has_record;
+
+  int wav_multichn;             // -1=unknown, 0=one channel per :WAV:DATA?, 1=all channels interleaved in one :WAV:DATA?
+
+  int mem_blk_sz;               // tuned block size in bytes of the deep memory download, 0=not yet tuned
+  int mem_blk_max;              // max. block size in bytes the device accepts
+
+  int edf_direct;               // 1=write the EDF files of the deep memory with O_DIRECT, bypassing the page cache
+
+  int acq_streaming;            // 1=screen_thread runs continuously and publishes frames, 0=one thread run per screen timer tick
+
+  int settings_loaded;          // SETTINGS_GRP_xxx that have been read from the device
 };
 
 
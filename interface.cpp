@@ -1855,12 +1855,22 @@ void UI_Mainwindow::utilButtonClicked()
 
 void UI_Mainwindow::show_playback_window()
 {
+  if(load_settings_group(SETTINGS_GRP_RECORD))  return;
+
   UI_playback_window w(this);
 }
 
 
+void UI_Mainwindow::show_stats_window()
+{
+  new UI_stats_window(this);
+}
+
+
 void UI_Mainwindow::playpauseButtonClicked()
 {
+  if(load_settings_group(SETTINGS_GRP_RECORD))  return;
+
   if(devparms.func_wrec_enable == 0)  return;
 
   if(devparms.func_wrec_operate)  return;
@@ -1897,6 +1907,8 @@ void UI_Mainwindow::playpauseButtonClicked()
 
 void UI_Mainwindow::stopButtonClicked()
 {
+  if(load_settings_group(SETTINGS_GRP_RECORD))  return;
+
   if(devparms.func_wrec_enable == 0)  return;
 
   if(devparms.func_wrec_operate)
@@ -1917,6 +1929,8 @@ void UI_Mainwindow::stopButtonClicked()
 
 void UI_Mainwindow::recordButtonClicked()
 {
+  if(load_settings_group(SETTINGS_GRP_RECORD))  return;
+
   if(devparms.func_wrec_enable == 0)  return;
 
   if(devparms.func_wplay_operate)  return;
@@ -2517,6 +2531,8 @@ void UI_Mainwindow::math_menu()
     return;
   }
 
+  if(load_settings_group(SETTINGS_GRP_MATH))  return;
+
   if(devparms.timebasedelayenable)
   {
     val = 100.0 / devparms.timebasedelayscale;
@@ -3408,7 +3424,7 @@ void UI_Mainwindow::autoButtonClicked()
 
   scrn_timer->stop();
 
-  scrn_thread->wait();
+  scrn_thread->stop_streaming();
 
   statusLabel->setText("Auto settings");
 
@@ -4151,6 +4167,8 @@ void UI_Mainwindow::trigAdjustDialClicked(QPoint)
 
 void UI_Mainwindow::toggle_fft()
 {
+  if(load_settings_group(SETTINGS_GRP_MATH))  return;
+
   if(devparms.math_fft == 1)
   {
     devparms.math_fft = 0;
@@ -4869,6 +4887,8 @@ void UI_Mainwindow::set_fft_voffset()
 
 void UI_Mainwindow::show_decode_window()
 {
+  if(load_settings_group(SETTINGS_GRP_DECODE))  return;
+
   UI_decoder_window w(this);
 }
 
@@ -191,6 +191,14 @@ void UI_Mainwindow::open_connection()
     }
   }
 
+  tmc_set_completion_policy(TMC_CMD_CLASS_WAV,
+                            settings.value("connection/compl_wav_policy", TMC_COMPL_OPC).toInt(),
+                            settings.value("connection/compl_wav_delay", 0).toInt());
+
+  tmc_set_completion_policy(TMC_CMD_CLASS_SETTING,
+                            settings.value("connection/compl_setting_policy", TMC_COMPL_OPC).toInt(),
+                            settings.value("connection/compl_setting_delay", 25000).toInt());
+
   if(tmc_write("*IDN?") != 5)
 //  if(tmc_write("*IDN?;:SYST:ERR?") != 16)  // This is a fix for the broken *IDN? command in older fw version
   {
@@ -356,6 +364,24 @@ void UI_Mainwindow::open_connection()
 
   devparms.func_has_record = 0;
 
+  if(settings.value("connection/wav_multi_source", 1).toInt())
+  {
+    devparms.wav_multichn = -1;  // probe on first use
+  }
+  else
+  {
+    devparms.wav_multichn = 0;
+  }
+
+  devparms.acq_streaming = settings.value("connection/continuous_acquisition", 1).toInt() ? 1 : 0;
+
+  devparms.mem_blk_sz = 0;
+
+  devparms.mem_blk_max = settings.value("connection/mem_block_max",
+                                        (devparms.modelserie == 7) ? SAV_MEM_BSZ_MAX_DHO : SAV_MEM_BSZ).toInt();
+
+  devparms.edf_direct = settings.value("output/edf_direct", 0).toInt() ? 1 : 0;
+
   devparms.fftbufsz = devparms.hordivisions * 50;
 
   if(devparms.k_cfg != NULL)
@@ -468,7 +494,7 @@ void UI_Mainwindow::close_connection()
 
   devparms.connected = 0;
 
-  if(scrn_thread->wait(5000) == false)
+  if(scrn_thread->stop_streaming(5000) == false)
   {
     scrn_thread->terminate();
 
@@ -480,6 +506,8 @@ void UI_Mainwindow::close_connection()
     scrn_thread->h_busy = 0;
   }
 
+  scrn_thread->detach_frames(&devparms);
+
   devparms.screenupdates_on = 0;
 
   setWindowTitle(PROGRAM_NAME " " PROGRAM_VERSION);
@@ -543,6 +571,10 @@ void UI_Mainwindow::close_connection()
 
   scrn_thread->set_device(NULL);
 
+  scrn_thread->cancel_settings(SETTINGS_GRP_ALL);
+
+  devparms.settings_loaded = 0;
+
   devparms.math_fft = 0;
 
   devparms.math_fft_split = 0;
@@ -576,12 +608,14 @@ void UI_Mainwindow::closeEvent(QCloseEvent *cl_event)
 
   adjdial_timer->stop();
 
-  scrn_thread->wait(5000);
+  scrn_thread->stop_streaming(5000);
 
   scrn_thread->terminate();
 
   scrn_thread->wait(5000);
 
+  scrn_thread->detach_frames(&devparms);
+
   devparms.screenupdates_on = 0;
 
   scrn_thread->set_device(NULL);
@@ -605,6 +639,7 @@ int UI_Mainwindow::get_device_settings(int delay)
   read_settings_thread rd_set_thrd;
   rd_set_thrd.set_device(device);
   rd_set_thrd.set_delay(delay);
+  rd_set_thrd.set_groups(SETTINGS_GRP_CORE);
   rd_set_thrd.set_devparm_ptr(&devparms);
   rd_set_thrd.start();
 
@@ -638,6 +673,21 @@ int UI_Mainwindow::get_device_settings(int delay)
     return -1;
   }
 
+  /* math, decode and record settings are read by the screen thread between frames */
+  devparms.settings_loaded = SETTINGS_GRP_CORE;
+
+  devparms.math_fft = 0;
+
+  devparms.math_fft_split = 0;
+
+  devparms.math_decode_display = 0;
+
+  devparms.func_wrec_enable = 0;
+
+  scrn_thread->cancel_settings(SETTINGS_GRP_ALL);
+
+  scrn_thread->request_settings(&devparms, SETTINGS_GRP_ALL & ~SETTINGS_GRP_CORE);
+
   for(chn=0; chn<devparms.channel_cnt; chn++)
   {
     if(devparms.chandisplay[chn] == 1)
@@ -695,6 +745,73 @@ int UI_Mainwindow::get_device_settings(int delay)
 }
 
 
+/*
+ * Makes sure the settings groups in grp (SETTINGS_GRP_xxx) are loaded.
+ * Groups that the screen thread did not read yet are read right away.
+ */
+int UI_Mainwindow::load_settings_group(int grp)
+{
+  int missing, tmr_active;
+
+  char str[4096] = {""};
+
+  if(device == NULL)
+  {
+    return -1;
+  }
+
+  devparms.settings_loaded |= scrn_thread->take_settings(&devparms);
+
+  if((devparms.settings_loaded & grp) == grp)
+  {
+    return 0;
+  }
+
+  tmr_active = scrn_timer->isActive();
+
+  scrn_timer->stop();
+
+  scrn_thread->stop_streaming();
+
+  devparms.settings_loaded |= scrn_thread->take_settings(&devparms);
+
+  missing = grp & ~devparms.settings_loaded;
+
+  if(missing)
+  {
+    scrn_thread->cancel_settings(missing);
+
+    statusLabel->setText("Reading instrument settings...");
+
+    read_settings_thread rd_set_thrd;
+    rd_set_thrd.set_device(device);
+    rd_set_thrd.set_devparm_ptr(&devparms);
+
+    if(rd_set_thrd.read_groups(missing))
+    {
+      statusLabel->setText("Error while reading settings");
+      rd_set_thrd.get_error_str(str, 4096);
+      QMessageBox msgBox;
+      msgBox.setIcon(QMessageBox::Critical);
+      msgBox.setText(str);
+      msgBox.exec();
+
+      if(tmr_active)  scrn_timer->start(devparms.screentimerival);
+
+      return -1;
+    }
+
+    devparms.settings_loaded |= missing;
+
+    statusLabel->setText("Connected");
+  }
+
+  if(tmr_active)  scrn_timer->start(devparms.screentimerival);
+
+  return 0;
+}
+
+
 int UI_Mainwindow::parse_preamble(char *str, int sz, struct waveform_preamble *wfp, int chn)
 {
   char *ptr;
@@ -2720,7 +2837,7 @@ void UI_Mainwindow::set_to_factory()
 
   scrn_timer->stop();
 
-  scrn_thread->wait();
+  scrn_thread->stop_streaming();
 
   tmc_write("*RST");
 
@@ -2823,10 +2940,24 @@ void UI_Mainwindow::set_to_factory()
 
 
 // this function is called when screen_thread has finished
+void UI_Mainwindow::scrn_thread_finished()
+{
+  if(devparms.acq_streaming)  // frames are picked up by scrn_timer_handler()
+  {
+    return;
+  }
+
+  screenUpdate();
+}
+
+
+// called when screen_thread has finished or, in streaming mode, by scrn_timer_handler()
 void UI_Mainwindow::screenUpdate()
 {
   int i, chns=0;
 
+  long long stg_t;
+
   char str[512];
 
   if(device == NULL)
@@ -2850,7 +2981,24 @@ void UI_Mainwindow::screenUpdate()
     return;
   }
 
-  scrn_thread->get_params(&devparms);
+  if(devparms.acq_streaming)
+  {
+    if(!scrn_thread->get_frame(&devparms))  // no new frame since the last screen refresh
+    {
+      pthread_mutex_unlock(&devparms.mutexx);
+
+      return;
+    }
+  }
+  else
+  {
+    scrn_thread->get_params(&devparms);
+  }
+
+  if(devparms.settings_loaded != SETTINGS_GRP_ALL)
+  {
+    devparms.settings_loaded |= scrn_thread->take_settings(&devparms);
+  }
 
   if(devparms.thread_error_stat)
   {
@@ -2974,7 +3122,11 @@ void UI_Mainwindow::screenUpdate()
   {
     if(devparms.math_decode_display)
     {
+      stg_t = stgtmr_begin();
+
       serial_decoder(&devparms);
+
+      stgtmr_end(STGTMR_DECODE, stg_t);
     }
 
     waveForm->drawCurve(&devparms, device);
@@ -2994,9 +3146,7 @@ void UI_Mainwindow::set_cue_cmd(const char *str)
 
   devparms.cmd_cue_resp[devparms.cmd_cue_idx_in] = NULL;
 
-  devparms.cmd_cue_idx_in++;
-
-  devparms.cmd_cue_idx_in %= TMC_CMD_CUE_SZ;
+  __atomic_store_n(&devparms.cmd_cue_idx_in, (devparms.cmd_cue_idx_in + 1) % TMC_CMD_CUE_SZ, __ATOMIC_RELEASE);
 
   scrn_timer_handler();
 }
@@ -3010,9 +3160,7 @@ void UI_Mainwindow::set_cue_cmd(const char *str, char *ptr)
 
   devparms.cmd_cue_resp[devparms.cmd_cue_idx_in] = ptr;
 
-  devparms.cmd_cue_idx_in++;
-
-  devparms.cmd_cue_idx_in %= TMC_CMD_CUE_SZ;
+  __atomic_store_n(&devparms.cmd_cue_idx_in, (devparms.cmd_cue_idx_in + 1) % TMC_CMD_CUE_SZ, __ATOMIC_RELEASE);
 
   scrn_timer_handler();
 }
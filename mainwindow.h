@@ -47,6 +47,8 @@
 #include "utils.h"
 #include "connection.h"
 #include "tmc_dev.h"
+#include "wav_convert.h"
+#include "stage_timer.h"
 #include "tled.h"
 #include "edflib.h"
 #include "signalcurve.h"
@@ -55,10 +57,12 @@
 #include "lan_connect_thread.h"
 #include "read_settings_thread.h"
 #include "save_data_thread.h"
+#include "mem_download_thread.h"
 #include "decode_dialog.h"
 #include "tdial.h"
 #include "wave_dialog.h"
 #include "playback_dialog.h"
+#include "stats_dialog.h"
 
 #include "third_party/kiss_fft/kiss_fftr.h"
 
@@ -83,6 +87,7 @@ public:
   void set_cue_cmd(const char *, char *);
   void serial_decoder(struct device_settings *);
   void save_wave_inspector_buffer_to_edf(struct device_settings *);
+  void save_wave_inspector_buffer_to_raw(struct device_settings *);
 
   struct device_settings devparms;
 
@@ -103,6 +108,7 @@ private:
   QMenuBar     *menubar;
 
   QMenu        *devicemenu,
+               *filemenu,
                *settingsmenu,
                *helpmenu;
 
@@ -215,11 +221,13 @@ private:
   inline unsigned char reverse_bitorder_8(unsigned char);
   inline unsigned int reverse_bitorder_32(unsigned int);
   int get_device_settings(int delay=0);
+  int load_settings_group(int);
 
 private slots:
 
   void scrn_timer_handler();
   void screenUpdate();
+  void scrn_thread_finished();
   void adjdial_timer_handler();
   void label_timer_handler();
   void test_timer_handler();
@@ -234,8 +242,11 @@ private slots:
   void open_connection();
   void close_connection();
   void open_settings_dialog();
+  void show_stats_window();
   void save_screen_waveform();
   void get_deep_memory_waveform();
+  void open_capture_file();
+  void export_capture_to_edf();
   void save_screenshot();
   void save_app_screenshot();
 
@@ -142,6 +142,8 @@ UI_Mainwindow::UI_Mainwindow()
     settings.setValue("gui/show_fps", devparms.show_fps);
   }
 
+  stgtmr_enable(settings.value("gui/stage_timers", 0).toInt());
+
   devparms.displaygrid = 2;
 
   devparms.channel_cnt = 4;
@@ -195,9 +197,16 @@ UI_Mainwindow::UI_Mainwindow()
 #endif
   menubar->addMenu(devicemenu);
 
+  filemenu = new QMenu(this);
+  filemenu->setTitle("File");
+  filemenu->addAction("Open capture file", this, SLOT(open_capture_file()));
+  filemenu->addAction("Export capture file to EDF", this, SLOT(export_capture_to_edf()));
+  menubar->addMenu(filemenu);
+
   settingsmenu = new QMenu(this);
   settingsmenu->setTitle("Settings");
   settingsmenu->addAction("Settings", this, SLOT(open_settings_dialog()));
+  settingsmenu->addAction("Performance statistics", this, SLOT(show_stats_window()));
   menubar->addMenu(settingsmenu);
 
   helpmenu = new QMenu(this);
@@ -605,7 +614,7 @@ UI_Mainwindow::UI_Mainwindow()
 #endif
 
   connect(scrn_timer,          SIGNAL(timeout()),        this, SLOT(scrn_timer_handler()));
-  connect(scrn_thread,         SIGNAL(finished()),       this, SLOT(screenUpdate()));
+  connect(scrn_thread,         SIGNAL(finished()),       this, SLOT(scrn_thread_finished()));
   connect(adjdial_timer,       SIGNAL(timeout()),        this, SLOT(adjdial_timer_handler()));
   connect(navDial,             SIGNAL(sliderReleased()), this, SLOT(navDialReleased()));
   connect(navDial_timer,       SIGNAL(timeout()),        this, SLOT(navDial_timer_handler()));
@@ -669,6 +678,8 @@ UI_Mainwindow::~UI_Mainwindow()
 
   settings.setValue("path/savedir", QString(recent_savedir));
 
+  scrn_thread->detach_frames(&devparms);
+
   delete scrn_thread;
   delete appfont;
   pthread_mutex_destroy(&devparms.mutexx);
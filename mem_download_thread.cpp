@@ -0,0 +1,846 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#include "mem_download_thread.h"
+
+
+
+mem_download_thread::mem_download_thread()
+{
+  int i;
+
+  err_num = -1;
+
+  err_str[0] = 0;
+
+  mempnts = 0;
+
+  modelserie = 0;
+
+  wav_multichn = 0;
+
+  aborted = 0;
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    chandisplay[i] = 0;
+
+    yofs[i] = 0;
+
+    wavbuf[i] = NULL;
+  }
+
+  stage_buf = NULL;
+
+  pipe = NULL;
+
+  blk_sz = SAV_MEM_BSZ;
+
+  blk_max = SAV_MEM_BSZ;
+
+  tune_stage = 0;
+
+  tune_bytes = 0;
+
+  tune_secs = 0;
+}
+
+
+mem_download_thread::~mem_download_thread()
+{
+  free(stage_buf);
+}
+
+
+/*
+ * wav: destination buffers of mempnts samples for every displayed channel, NULL with a pipeline
+ * yref: the :WAV:YREF? of every channel, devparms->yor must be set as well
+ */
+void mem_download_thread::set_params(struct device_settings *devparms, short **wav, const int *yref, int pnts)
+{
+  int i;
+
+  mempnts = pnts;
+
+  modelserie = devparms->modelserie;
+
+  wav_multichn = devparms->wav_multichn;
+
+  blk_max = devparms->mem_blk_max;
+
+  if(blk_max < SAV_MEM_BSZ_MIN)
+  {
+    blk_max = SAV_MEM_BSZ;
+  }
+
+  blk_sz = devparms->mem_blk_sz;  // tuned during an earlier download
+
+  tune_stage = 2;
+
+  if((blk_sz < SAV_MEM_BSZ_MIN) || (blk_sz > blk_max))
+  {
+    blk_sz = (SAV_MEM_BSZ > blk_max) ? blk_max : SAV_MEM_BSZ;
+
+    tune_stage = 0;
+  }
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    chandisplay[i] = devparms->chandisplay[i];
+
+    yofs[i] = yref[i] + devparms->yor[i];
+
+    wavbuf[i] = (wav != NULL) ? wav[i] : NULL;
+  }
+}
+
+
+int mem_download_thread::get_error_num(void)
+{
+  return err_num;
+}
+
+
+void mem_download_thread::get_error_str(char *dest, int sz)
+{
+  strlcpy(dest, err_str, sz);
+}
+
+
+/*
+ * Passes the downloaded blocks to p instead of converting them into the buffers of set_params(),
+ * the pipeline must be started before the thread. NULL switches back to the buffers.
+ */
+void mem_download_thread::set_pipeline(mem_pipeline *p)
+{
+  pipe = p;
+}
+
+
+/* can change when the device does not support multiple sources in one block */
+int mem_download_thread::get_wav_multichn(void)
+{
+  return wav_multichn;
+}
+
+
+/* the tuned block size and the maximum block size of the device, to be used for the next download */
+void mem_download_thread::get_blk_sz(int *sz, int *max)
+{
+  *sz = (tune_stage == 2) ? blk_sz : 0;
+
+  *max = blk_max;
+}
+
+
+/*
+ * Reads the scaling of the raw memory of every displayed channel into devparms->yinc[],
+ * devparms->yor[] and yref[] and, if not yet known, probes the multi-channel readout.
+ * Must be called before set_params(), with the acquisition stopped.
+ * Returns 0 on success or -1 with the reason in err.
+ */
+int mem_download_thread::prepare_device(struct tmcdev *device, struct device_settings *devparms,
+                                        int *yref, char *err, int err_sz)
+{
+  int chn, chns=0;
+
+  char str[512];
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!devparms->chandisplay[chn])  // Download data only when channel is switched on
+    {
+      continue;
+    }
+
+    chns++;
+
+    snprintf(str, 512, ":WAV:SOUR CHAN%i", chn + 1);
+
+    tmc_write(str);
+
+    tmc_write(":WAV:FORM BYTE");
+
+    usleep(20000);
+
+    tmc_write(":WAV:MODE RAW");
+
+    usleep(20000);
+
+    tmc_write(":WAV:YINC?");
+
+    usleep(20000);
+
+    tmc_read();
+
+    devparms->yinc[chn] = atof(device->buf);
+
+    if(devparms->yinc[chn] < 1e-6)
+    {
+      snprintf(err, err_sz, "Error, parameter \"YINC\" out of range for channel %i: %e  line %i file %s", chn, devparms->yinc[chn], __LINE__, __FILE__);
+      return -1;
+    }
+
+    usleep(20000);
+
+    tmc_write(":WAV:YREF?");
+
+    usleep(20000);
+
+    tmc_read();
+
+    yref[chn] = atoi(device->buf);
+
+    if((yref[chn] < 1) || (yref[chn] > 255))
+    {
+      snprintf(err, err_sz, "Error, parameter \"YREF\" out of range for channel %i: %i  line %i file %s", chn, yref[chn], __LINE__, __FILE__);
+      return -1;
+    }
+
+    devparms->yref[chn] = yref[chn];
+
+    usleep(20000);
+
+    tmc_write(":WAV:YOR?");
+
+    usleep(20000);
+
+    tmc_read();
+
+    devparms->yor[chn] = atoi(device->buf);
+
+    if((devparms->yor[chn] < -32000) || (devparms->yor[chn] > 32000))
+    {
+      snprintf(err, err_sz, "Error, parameter \"YOR\" out of range for channel %i: %i  line %i file %s", chn, devparms->yor[chn], __LINE__, __FILE__);
+      return -1;
+    }
+  }
+
+  if((chns > 1) && (devparms->modelserie == 7) && devparms->wav_multichn)
+  {
+    tmc_wav_source_list(str, 512, devparms->chandisplay);
+
+    if(devparms->wav_multichn < 0)
+    {
+      devparms->wav_multichn = tmc_wav_multi_source_probe(str);
+
+      if(devparms->wav_multichn < 0)
+      {
+        snprintf(err, err_sz, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* sets the waveform readout of the displayed channels back to the screen data */
+void mem_download_thread::restore_device(struct device_settings *devparms)
+{
+  int chn;
+
+  char str[128];
+
+  tmc_cancel_clear();  /* in case the download was canceled */
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!devparms->chandisplay[chn])
+    {
+      continue;
+    }
+
+    snprintf(str, 128, ":WAV:SOUR CHAN%i", chn + 1);
+
+    usleep(20000);
+
+    tmc_write(str);
+
+    usleep(20000);
+
+    tmc_write(":WAV:MODE NORM");
+
+    usleep(20000);
+
+    tmc_write(":WAV:STAR 1");
+
+    if(devparms->modelserie == 1)
+    {
+      usleep(20000);
+
+      tmc_write(":WAV:STOP 1200");
+    }
+    else
+    {
+      usleep(20000);
+
+      tmc_write(":WAV:STOP 1400");
+
+      usleep(20000);
+
+      tmc_write(":WAV:POIN 1400");
+    }
+  }
+}
+
+
+/* stops the download, over LAN the block that is being received is interrupted */
+void mem_download_thread::abort(void)
+{
+  __atomic_store_n(&aborted, 1, __ATOMIC_RELEASE);
+
+  tmc_cancel();
+}
+
+
+/* sets the range of the next block, up to sample last, and asks for it, the response is read by download_group() */
+int mem_download_thread::request_block(int start, int blk_pnts, int last)
+{
+  char str_star[64],
+       str_stop[64];
+
+  const char *cmds[2];
+
+  snprintf(str_star, 64, ":WAV:STAR %i", start + 1);
+
+  if((start + blk_pnts) > last)
+  {
+    snprintf(str_stop, 64, ":WAV:STOP %i", last);
+  }
+  else
+  {
+    snprintf(str_stop, 64, ":WAV:STOP %i", start + blk_pnts);
+  }
+
+  cmds[0] = str_star;
+  cmds[1] = str_stop;
+
+  if(tmc_write_batch(cmds, 2) != 2)  // waits for completion according to the policy of the :WAV class
+  {
+    return -1;
+  }
+
+  if(tmc_write(":WAV:DATA?") != 10)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * The time of a block is modelled as t = overhead + bytes / rate.
+ * The first two full blocks, with the start size and with double that size,
+ * give the overhead and the rate of the connection. The block size is then
+ * set so that the overhead is about 5% of the block time.
+ */
+void mem_download_thread::blk_tune(int bytes, double secs)
+{
+  double rate, ovh;
+
+  if(tune_stage == 0)
+  {
+    tune_bytes = bytes;
+
+    tune_secs = secs;
+
+    tune_stage = 1;
+
+    blk_sz = (bytes * 2 > blk_max) ? blk_max : (bytes * 2);
+
+    return;
+  }
+
+  if(tune_stage != 1)
+  {
+    return;
+  }
+
+  tune_stage = 2;
+
+  if((bytes <= tune_bytes) || (secs <= tune_secs))  // no usable difference, per-request overhead dominates
+  {
+    blk_sz = blk_max;
+
+    printf("memory download: block size %i bytes\n", blk_sz);
+
+    return;
+  }
+
+  rate = (bytes - tune_bytes) / (secs - tune_secs);
+
+  ovh = tune_secs - (tune_bytes / rate);
+
+  if(ovh < 0)
+  {
+    ovh = 0;
+  }
+
+  blk_sz = ovh * rate * 19;
+
+  if(blk_sz < SAV_MEM_BSZ_MIN)
+  {
+    blk_sz = SAV_MEM_BSZ_MIN;
+  }
+
+  if(blk_sz > blk_max)
+  {
+    blk_sz = blk_max;
+  }
+
+  printf("memory download: %.1f MB/s, %.1f ms per request, block size %i bytes\n",
+         rate / 1e6, ovh * 1e3, blk_sz);
+}
+
+
+/* the device returned less than requested, this is its maximum */
+void mem_download_thread::blk_limit(int bytes)
+{
+  if(bytes < SAV_MEM_BSZ_MIN)
+  {
+    return;
+  }
+
+  blk_max = bytes;
+
+  if(blk_sz > blk_max)
+  {
+    blk_sz = blk_max;
+  }
+
+  printf("memory download: device limits the block size to %i bytes\n", blk_max);
+}
+
+
+/*
+ * Downloads the samples [first, last> of one channel, or of all channels in grp_chn[] interleaved in one block.
+ * The request for the next block is sent before the current block is converted
+ * so that the device prepares the data meanwhile.
+ * With a pipeline the blocks are passed to it instead of being converted here.
+ * Returns 0 on success, 1 when the device does not interleave the channels or -1 on error.
+ */
+int mem_download_thread::download_group(const int *grp_chn, int grp_cnt, int first, int last)
+{
+  int i, j, k, n, chn, req_pnts, start, dst_sz, max_sz, empty_buf=0;
+
+  char str[512];
+
+  QElapsedTimer req_tmr;
+
+  const char *cmds[2];
+
+  unsigned char *dst;
+
+  struct mem_pipe_blk *blk=NULL, *nblk;
+
+  chn = grp_chn[0];
+
+  if(grp_cnt > 1)
+  {
+    tmc_wav_source_list(str, 512, chandisplay);
+
+    emit dl_status("Downloading waveform data...");
+  }
+  else
+  {
+    snprintf(str, 512, "Downloading channel %i waveform data...", chn + 1);
+
+    emit dl_status(QString(str));
+
+    snprintf(str, 512, ":WAV:SOUR CHAN%i", chn + 1);
+  }
+
+  cmds[0] = str;
+  cmds[1] = ":WAV:MODE RAW";
+
+  if(tmc_write_batch(cmds, 2) != 2)
+  {
+    snprintf(err_str, 4096, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  max_sz = (pipe != NULL) ? pipe->get_blk_sz() : blk_max;
+
+  start = first;
+
+  req_pnts = ((blk_sz < max_sz) ? blk_sz : max_sz) / grp_cnt;
+
+  if(pipe != NULL)  // a block must be available before its request is sent
+  {
+    blk = pipe->get_block();
+    if(blk == NULL)
+    {
+      strlcpy(err_str, "Canceled", 4096);
+      return -1;
+    }
+  }
+
+  req_tmr.start();
+
+  if(request_block(start, req_pnts, last))
+  {
+    snprintf(err_str, 4096, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  while(start < last)
+  {
+    emit dl_progress(start);
+
+    nblk = NULL;
+
+    if(pipe != NULL)
+    {
+      dst_sz = max_sz;
+
+      dst = blk->data;
+    }
+    else if(grp_cnt == 1)  // receive the samples in the upper half of their destination, they are widened in place below
+      {
+        dst_sz = ((start + req_pnts) > last) ? (last - start) : req_pnts;
+
+        dst = (unsigned char *)(wavbuf[chn] + start) + dst_sz;
+      }
+      else
+      {
+        dst_sz = blk_max;
+
+        dst = stage_buf;
+      }
+
+    n = tmc_read_block((char *)dst, dst_sz);
+    if((n == TMC_ERR_CANCELED) || ((n < 0) && __atomic_load_n(&aborted, __ATOMIC_ACQUIRE)))
+    {
+      strlcpy(err_str, "Canceled", 4096);
+      return -1;
+    }
+
+    if(n < 0)
+    {
+      snprintf(err_str, 4096, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
+      return -1;
+    }
+
+    if(n == 0)
+    {
+      strlcpy(err_str, "No waveform data available.", 4096);
+      return -1;
+    }
+
+    if(__atomic_load_n(&aborted, __ATOMIC_ACQUIRE))  // nothing outstanding at this point
+    {
+      strlcpy(err_str, "Canceled", 4096);
+      return -1;
+    }
+
+    if((grp_cnt > 1) && (n % grp_cnt))
+    {
+      if((pipe != NULL) && (start != first))  // earlier blocks of this segment are already passed on
+      {
+        snprintf(err_str, 4096, "Unexpected multi-channel blocksize %i.  line %i file %s", n, __LINE__, __FILE__);
+        return -1;
+      }
+
+      printf("Unexpected multi-channel blocksize %i, falling back to one channel per block.\n", n);
+
+      if(blk != NULL)
+      {
+        pipe->release_block(blk);
+      }
+
+      return 1;
+    }
+
+    n /= grp_cnt;
+
+    if(n < 1)
+    {
+      if(empty_buf++ > 100)
+      {
+        break;
+      }
+    }
+    else
+    {
+      empty_buf = 0;
+    }
+
+    if((start + n) < last)
+    {
+      if(n < req_pnts)  // the device limits the block size
+      {
+        blk_limit(n * grp_cnt);
+      }
+      else
+      {
+        blk_tune(n * grp_cnt, req_tmr.nsecsElapsed() / 1e9);
+      }
+
+      req_pnts = ((blk_sz < max_sz) ? blk_sz : max_sz) / grp_cnt;
+
+      if((pipe != NULL) && (n > 0))
+      {
+        nblk = pipe->get_block();  // waits when the conversion or the writer is behind
+        if(nblk == NULL)
+        {
+          strlcpy(err_str, "Canceled", 4096);
+          return -1;
+        }
+      }
+
+      req_tmr.start();
+
+      if(request_block(start + n, req_pnts, last))
+      {
+        snprintf(err_str, 4096, "Can not write to device.  line %i file %s", __LINE__, __FILE__);
+        return -1;
+      }
+    }
+
+    if((start + n) > last)
+    {
+      n = last - start;
+    }
+
+    if(pipe != NULL)
+    {
+      if(n > 0)
+      {
+        blk->start = start;
+        blk->cnt = n;
+        blk->grp_cnt = grp_cnt;
+
+        for(j=0; j<grp_cnt; j++)
+        {
+          blk->grp_chn[j] = grp_chn[j];
+        }
+
+        if(pipe->put_block(blk))
+        {
+          strlcpy(err_str, "Canceled", 4096);
+          return -1;
+        }
+
+        blk = nblk;
+      }
+    }
+    else if(grp_cnt == 1)
+      {
+        wavcnv_u8_to_s16(wavbuf[chn] + start, dst, n, yofs[chn], 0);
+      }
+      else
+      {
+        for(j=0; j<grp_cnt; j++)
+        {
+          i = grp_chn[j];
+
+          for(k=0; k<n; k++)
+          {
+            wavbuf[i][start + k] = ((int)dst[(k * grp_cnt) + j]) - yofs[i];
+          }
+        }
+      }
+
+    if(pipe == NULL)
+    {
+      emit dl_data(start, n);
+    }
+
+    start += n;
+  }
+
+  if(blk != NULL)
+  {
+    pipe->release_block(blk);
+  }
+
+  if(start < last)
+  {
+    snprintf(err_str, 4096, "Download error.  line %i file %s", __LINE__, __FILE__);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Without a pipeline the memory is downloaded in one segment, one channel after the other.
+ * With a pipeline it is downloaded in the segments of the pipeline, all channels of
+ * a segment before the next segment.
+ */
+void mem_download_thread::run()
+{
+  int i, chn, chns=0, grp_cnt, grp_chn[MAX_CHNS], err, multi, first, last, seg_pnts, total_pnts;
+
+  long long xfer_bytes, xfer_nsec, bytes, nsec;
+
+  QElapsedTimer dl_tmr;
+
+  err_num = -1;
+
+  err_str[0] = 0;
+
+  __atomic_store_n(&aborted, 0, __ATOMIC_RELEASE);
+
+  tmc_cancel_clear();
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    if(chandisplay[i])
+    {
+      grp_chn[chns++] = i;
+    }
+  }
+
+  if((!chns) || (mempnts < 1))
+  {
+    strlcpy(err_str, "Nothing to download.", 4096);
+
+    err_num = 1;
+
+    return;
+  }
+
+  if(pipe != NULL)
+  {
+    seg_pnts = pipe->get_seg_pnts();
+
+    total_pnts = pipe->get_total_pnts();
+
+    if(total_pnts > mempnts)
+    {
+      strlcpy(err_str, "The pipeline is larger than the memory.", 4096);
+
+      err_num = 1;
+
+      return;
+    }
+
+    pipe->set_offsets(yofs);
+  }
+  else
+  {
+    seg_pnts = mempnts;
+
+    total_pnts = mempnts;
+  }
+
+  multi = 0;
+
+  if((chns > 1) && (modelserie == 7) && (wav_multichn > 0))  // all channels in one block
+  {
+    multi = 1;
+
+    if(pipe == NULL)
+    {
+      free(stage_buf);
+
+      stage_buf = (unsigned char *)malloc(blk_max);
+
+      if(stage_buf == NULL)
+      {
+        strlcpy(err_str, "Malloc error.", 4096);
+
+        err_num = 2;
+
+        return;
+      }
+    }
+  }
+
+  tmc_get_xfer_stats(&xfer_bytes, &xfer_nsec);
+
+  dl_tmr.start();
+
+  for(first=0; first<total_pnts; first+=seg_pnts)
+  {
+    last = ((first + seg_pnts) > total_pnts) ? total_pnts : (first + seg_pnts);
+
+    if(multi)
+    {
+      err = download_group(grp_chn, chns, first, last);
+
+      if(err < 0)
+      {
+        err_num = 3;
+
+        return;
+      }
+
+      if(!err)
+      {
+        continue;
+      }
+
+      multi = 0;
+
+      wav_multichn = 0;  // start again, one channel at a time
+
+      tmc_shadow_invalidate(":WAV");
+    }
+
+    for(chn=0; chn<MAX_CHNS; chn++)
+    {
+      if(!chandisplay[chn])
+      {
+        continue;
+      }
+
+      grp_cnt = 1;
+
+      grp_chn[0] = chn;
+
+      if(download_group(grp_chn, grp_cnt, first, last))
+      {
+        err_num = 3;
+
+        return;
+      }
+    }
+  }
+
+  tmc_get_xfer_stats(&bytes, &nsec);
+
+  bytes -= xfer_bytes;
+
+  nsec -= xfer_nsec;
+
+  /* overall rate including the requests and the conversion, and the rate while a block was being received */
+  printf("memory download: %lli bytes in %.3f s, %.1f MB/s, %.1f MB/s sustained\n",
+         bytes, dl_tmr.nsecsElapsed() / 1e9, bytes * 1e3 / (dl_tmr.nsecsElapsed() + 1), bytes * 1e3 / (nsec + 1));
+
+  err_num = 0;
+}
+
+
+
@@ -0,0 +1,124 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef DEF_MEM_DOWNLOAD_THREAD_H
+#define DEF_MEM_DOWNLOAD_THREAD_H
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <QObject>
+#include <QThread>
+#include <QString>
+#include <QElapsedTimer>
+
+#include "global.h"
+#include "utils.h"
+#include "connection.h"
+#include "tmc_dev.h"
+#include "wav_convert.h"
+#include "mem_pipeline.h"
+
+
+/* bytes per :WAV:DATA? block when downloading the memory, the size is tuned during the download */
+#define SAV_MEM_BSZ         (250000)
+#define SAV_MEM_BSZ_MIN      (50000)
+#define SAV_MEM_BSZ_MAX_DHO (1000000)
+
+
+
+class mem_download_thread : public QThread
+{
+  Q_OBJECT
+
+public:
+
+  mem_download_thread();
+  ~mem_download_thread();
+
+  void set_params(struct device_settings *, short **, const int *, int);
+  void set_pipeline(mem_pipeline *);
+  int get_error_num(void);
+  void get_error_str(char *, int);
+  int get_wav_multichn(void);
+  void get_blk_sz(int *, int *);
+
+  static int prepare_device(struct tmcdev *, struct device_settings *, int *, char *, int);
+  static void restore_device(struct device_settings *);
+
+public slots:
+
+  void abort(void);
+
+signals:
+
+  void dl_progress(int);
+  void dl_status(const QString &);
+  void dl_data(int, int);  /* samples [first, first + cnt> of the current channel(s) are available */
+
+private:
+
+  int err_num,
+      mempnts,
+      chandisplay[MAX_CHNS],
+      yofs[MAX_CHNS],
+      modelserie,
+      wav_multichn,
+      aborted,
+      blk_sz,
+      blk_max,
+      tune_stage,
+      tune_bytes;
+
+  double tune_secs;
+
+  char err_str[4096];
+
+  short *wavbuf[MAX_CHNS];
+
+  unsigned char *stage_buf;
+
+  mem_pipeline *pipe;
+
+  void run();
+
+  int download_group(const int *, int, int, int);
+  int request_block(int, int, int);
+  void blk_tune(int, double);
+  void blk_limit(int);
+};
+
+
+
+#endif
+
+
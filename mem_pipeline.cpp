@@ -0,0 +1,528 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include "mem_pipeline.h"
+
+
+#define MEM_PIPE_STAGE_CONVERT   (0)
+#define MEM_PIPE_STAGE_WRITE     (1)
+
+#define MEM_PIPE_ERR_STAGE   (1)  /* the conversion or the writer failed */
+#define MEM_PIPE_ERR_ABORT   (2)  /* stopped by finish() */
+
+
+
+mem_pipe_stage::mem_pipe_stage(mem_pipeline *p, int s)
+{
+  pipe = p;
+
+  stage = s;
+}
+
+
+void mem_pipe_stage::run()
+{
+  if(stage == MEM_PIPE_STAGE_CONVERT)
+  {
+    pipe->convert_loop();
+  }
+  else
+  {
+    pipe->write_loop();
+  }
+}
+
+
+mem_pipeline::mem_pipeline()
+{
+  int i, chn;
+
+  chns = 0;
+
+  seg_pnts = 0;
+
+  seg_cnt = 0;
+
+  seg_bufs = 0;
+
+  blk_sz = 0;
+
+  err_num = 0;
+
+  running = 0;
+
+  err_str[0] = 0;
+
+  sink = NULL;
+
+  sink_ctx = NULL;
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    chandisplay[chn] = 0;
+
+    yofs[chn] = 0;
+  }
+
+  for(i=0; i<MEM_PIPE_BLKS; i++)
+  {
+    blks[i].data = NULL;
+  }
+
+  for(i=0; i<MEM_PIPE_SEGS; i++)
+  {
+    for(chn=0; chn<MAX_CHNS; chn++)
+    {
+      segs[i].buf[chn] = NULL;
+    }
+  }
+
+  blk_free = NULL;
+  blk_full = NULL;
+  seg_free = NULL;
+  seg_full = NULL;
+
+  cnv_thrd = NULL;
+  wr_thrd = NULL;
+}
+
+
+mem_pipeline::~mem_pipeline()
+{
+  if(running)
+  {
+    finish(1, NULL, 0);
+  }
+
+  release();
+}
+
+
+void mem_pipeline::release(void)
+{
+  int i, chn;
+
+  delete cnv_thrd;
+  delete wr_thrd;
+
+  cnv_thrd = NULL;
+  wr_thrd = NULL;
+
+  for(i=0; i<MEM_PIPE_BLKS; i++)
+  {
+    free(blks[i].data);
+
+    blks[i].data = NULL;
+  }
+
+  for(i=0; i<MEM_PIPE_SEGS; i++)
+  {
+    for(chn=0; chn<MAX_CHNS; chn++)
+    {
+      free(segs[i].buf[chn]);
+
+      segs[i].buf[chn] = NULL;
+    }
+  }
+
+  bqueue_destroy(blk_free);
+  bqueue_destroy(blk_full);
+  bqueue_destroy(seg_free);
+  bqueue_destroy(seg_full);
+
+  blk_free = NULL;
+  blk_full = NULL;
+  seg_free = NULL;
+  seg_full = NULL;
+}
+
+
+/*
+ * chandisp: the channels that are downloaded
+ * seg: samples per channel per segment, cnt: number of segments
+ * bsz: size of the largest block the download can receive
+ * snk, ctx: the writer, see mem_pipe_sink
+ * Allocates the buffers and starts the conversion and writer threads.
+ * Returns 0 on success or -1 with the reason in err.
+ */
+int mem_pipeline::start(const int *chandisp, int seg, int cnt, int bsz,
+                        mem_pipe_sink snk, void *ctx, char *err, int err_sz)
+{
+  int i, chn;
+
+  if(running || (seg < 1) || (cnt < 1) || (bsz < 1) || (snk == NULL))
+  {
+    strlcpy(err, "mem_pipeline::start(): invalid parameters.", err_sz);
+    return -1;
+  }
+
+  release();
+
+  chns = 0;
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    chandisplay[chn] = chandisp[chn];
+
+    if(chandisplay[chn])
+    {
+      chns++;
+    }
+  }
+
+  if(!chns)
+  {
+    strlcpy(err, "No active channels.", err_sz);
+    return -1;
+  }
+
+  seg_pnts = seg;
+
+  seg_cnt = cnt;
+
+  seg_bufs = (seg_cnt < MEM_PIPE_SEGS) ? seg_cnt : MEM_PIPE_SEGS;  // a short memory needs less
+
+  blk_sz = bsz;
+
+  sink = snk;
+
+  sink_ctx = ctx;
+
+  err_num = 0;
+
+  err_str[0] = 0;
+
+  blk_free = bqueue_create(MEM_PIPE_BLKS);
+  blk_full = bqueue_create(MEM_PIPE_BLKS);
+  seg_free = bqueue_create(MEM_PIPE_SEGS);
+  seg_full = bqueue_create(MEM_PIPE_SEGS);
+  if((blk_free == NULL) || (blk_full == NULL) || (seg_free == NULL) || (seg_full == NULL))
+  {
+    goto OUT_ERROR;
+  }
+
+  for(i=0; i<MEM_PIPE_BLKS; i++)
+  {
+    blks[i].data = (unsigned char *)malloc(blk_sz);
+    if(blks[i].data == NULL)
+    {
+      goto OUT_ERROR;
+    }
+
+    bqueue_put(blk_free, &blks[i]);
+  }
+
+  for(i=0; i<seg_bufs; i++)
+  {
+    for(chn=0; chn<MAX_CHNS; chn++)
+    {
+      if(!chandisplay[chn])
+      {
+        continue;
+      }
+
+      segs[i].buf[chn] = (short *)malloc(seg_pnts * sizeof(short));
+      if(segs[i].buf[chn] == NULL)
+      {
+        goto OUT_ERROR;
+      }
+    }
+
+    bqueue_put(seg_free, &segs[i]);
+  }
+
+  cnv_thrd = new mem_pipe_stage(this, MEM_PIPE_STAGE_CONVERT);
+
+  wr_thrd = new mem_pipe_stage(this, MEM_PIPE_STAGE_WRITE);
+
+  running = 1;
+
+  wr_thrd->start();
+
+  cnv_thrd->start();
+
+  return 0;
+
+OUT_ERROR:
+
+  release();
+
+  snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+
+  return -1;
+}
+
+
+/*
+ * Waits until all segments are written or, when abort is non-zero, stops the pipeline.
+ * Returns 0 when all segments were written, -1 when the conversion or the writer failed
+ * (the reason is in err) or -2 when aborted.
+ */
+int mem_pipeline::finish(int abort, char *err, int err_sz)
+{
+  int ret;
+
+  if(!running)
+  {
+    return -2;
+  }
+
+  if(abort)
+  {
+    fail(MEM_PIPE_ERR_ABORT, "Canceled");
+  }
+
+  cnv_thrd->wait();
+
+  wr_thrd->wait();
+
+  running = 0;
+
+  ret = __atomic_load_n(&err_num, __ATOMIC_ACQUIRE);
+
+  if(ret == MEM_PIPE_ERR_STAGE)
+  {
+    if(err != NULL)
+    {
+      strlcpy(err, err_str, err_sz);
+    }
+
+    return -1;
+  }
+
+  if(ret == MEM_PIPE_ERR_ABORT)
+  {
+    return -2;
+  }
+
+  return 0;
+}
+
+
+/* the first error is kept, all stages are released */
+void mem_pipeline::fail(int num, const char *str)
+{
+  int expected=0;
+
+  if(__atomic_compare_exchange_n(&err_num, &expected, -1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+  {
+    strlcpy(err_str, str, 4096);
+
+    __atomic_store_n(&err_num, num, __ATOMIC_RELEASE);
+  }
+
+  bqueue_abort(blk_free);
+  bqueue_abort(blk_full);
+  bqueue_abort(seg_free);
+  bqueue_abort(seg_full);
+}
+
+
+/* the :WAV:YREF? plus :WAV:YOR? of every channel, must be set before the first block */
+void mem_pipeline::set_offsets(const int *ofs)
+{
+  int chn;
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    yofs[chn] = ofs[chn];
+  }
+}
+
+
+int mem_pipeline::get_seg_pnts(void)
+{
+  return seg_pnts;
+}
+
+
+int mem_pipeline::get_total_pnts(void)
+{
+  return seg_pnts * seg_cnt;
+}
+
+
+int mem_pipeline::get_blk_sz(void)
+{
+  return blk_sz;
+}
+
+
+/* the memory used by the buffers of the pipeline */
+long long mem_pipeline::get_buf_bytes(void)
+{
+  return ((long long)MEM_PIPE_BLKS * blk_sz) + ((long long)seg_bufs * chns * seg_pnts * sizeof(short));
+}
+
+
+/* returns a free block of get_blk_sz() bytes, waits when all blocks are in use, NULL when the pipeline stopped */
+struct mem_pipe_blk * mem_pipeline::get_block(void)
+{
+  return (struct mem_pipe_blk *)bqueue_get(blk_free);
+}
+
+
+/* passes a received block to the conversion, returns -1 when the pipeline stopped */
+int mem_pipeline::put_block(struct mem_pipe_blk *blk)
+{
+  return bqueue_put(blk_full, blk);
+}
+
+
+/* returns a block that is not used, e.g. because the device sent no samples */
+void mem_pipeline::release_block(struct mem_pipe_blk *blk)
+{
+  bqueue_put(blk_free, blk);
+}
+
+
+void mem_pipeline::convert_loop(void)
+{
+  int i, j, k, chn, s=0, ofs, filled=0;
+
+  struct mem_pipe_blk *blk;
+
+  struct mem_pipe_seg *seg=NULL;
+
+  while(s < seg_cnt)
+  {
+    blk = (struct mem_pipe_blk *)bqueue_get(blk_full);
+    if(blk == NULL)
+    {
+      return;
+    }
+
+    if(seg == NULL)
+    {
+      seg = (struct mem_pipe_seg *)bqueue_get(seg_free);
+      if(seg == NULL)
+      {
+        return;
+      }
+
+      filled = 0;
+    }
+
+    ofs = blk->start - (s * seg_pnts);
+
+    if((ofs < 0) || ((ofs + blk->cnt) > seg_pnts))
+    {
+      fail(MEM_PIPE_ERR_STAGE, "Block out of sequence.");
+      return;
+    }
+
+    if(blk->grp_cnt == 1)
+    {
+      chn = blk->grp_chn[0];
+
+      wavcnv_u8_to_s16(seg->buf[chn] + ofs, blk->data, blk->cnt, yofs[chn], 0);
+    }
+    else
+    {
+      for(j=0; j<blk->grp_cnt; j++)
+      {
+        i = blk->grp_chn[j];
+
+        for(k=0; k<blk->cnt; k++)
+        {
+          seg->buf[i][ofs + k] = ((int)blk->data[(k * blk->grp_cnt) + j]) - yofs[i];
+        }
+      }
+    }
+
+    filled += blk->cnt * blk->grp_cnt;
+
+    if(bqueue_put(blk_free, blk))
+    {
+      return;
+    }
+
+    if(filled == (chns * seg_pnts))
+    {
+      if(bqueue_put(seg_full, seg))
+      {
+        return;
+      }
+
+      seg = NULL;
+
+      s++;
+    }
+  }
+}
+
+
+void mem_pipeline::write_loop(void)
+{
+  int s;
+
+  struct mem_pipe_seg *seg;
+
+  for(s=0; s<seg_cnt; s++)
+  {
+    seg = (struct mem_pipe_seg *)bqueue_get(seg_full);
+    if(seg == NULL)
+    {
+      return;
+    }
+
+    if(sink(sink_ctx, seg->buf, seg_pnts))
+    {
+      fail(MEM_PIPE_ERR_STAGE, "A file write error occurred.");
+      return;
+    }
+
+    if(bqueue_put(seg_free, seg))
+    {
+      return;
+    }
+  }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
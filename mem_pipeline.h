@@ -0,0 +1,187 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef DEF_MEM_PIPELINE_H
+#define DEF_MEM_PIPELINE_H
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QThread>
+
+#include "global.h"
+#include "utils.h"
+#include "bqueue.h"
+#include "wav_convert.h"
+
+
+/* raw blocks in flight between the download and the conversion */
+#define MEM_PIPE_BLKS   (4)
+
+/* converted segments in flight between the conversion and the writer */
+#define MEM_PIPE_SEGS   (3)
+
+
+/*
+ * Writes one segment, buf[] has a buffer of cnt samples for every downloaded channel
+ * and NULL for the other channels. Called from the writer thread.
+ * Returns 0 on success.
+ */
+typedef int (*mem_pipe_sink)(void *ctx, short **buf, int cnt);
+
+
+struct mem_pipe_blk
+{
+  unsigned char *data;  /* ADC codes, interleaved when grp_cnt > 1 */
+  int start;            /* first sample */
+  int cnt;              /* samples per channel */
+  int grp_cnt;
+  int grp_chn[MAX_CHNS];
+};
+
+
+struct mem_pipe_seg
+{
+  short *buf[MAX_CHNS];
+};
+
+
+class mem_pipeline;
+
+
+class mem_pipe_stage : public QThread
+{
+public:
+
+  mem_pipe_stage(mem_pipeline *, int);
+
+private:
+
+  mem_pipeline *pipe;
+
+  int stage;
+
+  void run();
+};
+
+
+/*
+ * Download -> conversion -> writer pipeline for the deep memory.
+ * The memory is split in seg_cnt segments of seg_pnts samples per channel.
+ * mem_download_thread downloads the segments in order, all channels of a segment
+ * before the next segment, and passes the raw blocks with put_block().
+ * The conversion thread widens them into segment buffers and the writer thread
+ * hands every complete segment to the sink.
+ * The stages are connected by bounded queues, so the memory in use is
+ * MEM_PIPE_BLKS blocks plus MEM_PIPE_SEGS segments, independent of the memory depth.
+ */
+class mem_pipeline
+{
+public:
+
+  mem_pipeline();
+  ~mem_pipeline();
+
+  int start(const int *, int, int, int, mem_pipe_sink, void *, char *, int);
+  int finish(int, char *, int);
+
+  void set_offsets(const int *);
+  int get_seg_pnts(void);
+  int get_total_pnts(void);
+  int get_blk_sz(void);
+  long long get_buf_bytes(void);
+
+  struct mem_pipe_blk * get_block(void);
+  int put_block(struct mem_pipe_blk *);
+  void release_block(struct mem_pipe_blk *);
+
+private:
+
+  friend class mem_pipe_stage;
+
+  int chandisplay[MAX_CHNS],
+      chns,
+      yofs[MAX_CHNS],
+      seg_pnts,
+      seg_cnt,
+      seg_bufs,
+      blk_sz,
+      err_num,
+      running;
+
+  char err_str[4096];
+
+  mem_pipe_sink sink;
+
+  void *sink_ctx;
+
+  struct mem_pipe_blk blks[MEM_PIPE_BLKS];
+
+  struct mem_pipe_seg segs[MEM_PIPE_SEGS];
+
+  struct bqueue *blk_free,
+                *blk_full,
+                *seg_free,
+                *seg_full;
+
+  mem_pipe_stage *cnv_thrd,
+                 *wr_thrd;
+
+  void convert_loop(void);
+  void write_loop(void);
+  void fail(int, const char *);
+  void release(void);
+};
+
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
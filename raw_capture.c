@@ -0,0 +1,407 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "raw_capture.h"
+#include "utils.h"
+
+
+
+static int rawcap_check_arch(char *err, int err_sz)
+{
+  union
+  {
+    char four[4];
+    int one;
+  } byte_order_test_var;
+
+  if((sizeof(struct rawcap_chan) != 64) || (sizeof(struct rawcap_hdr) != 488) ||
+     (sizeof(long long) != 8) || (sizeof(double) != 8))
+  {
+    strlcpy(err, "Raw capture files are not supported on this platform.", err_sz);
+    return -1;
+  }
+
+  byte_order_test_var.one = 0x03020100;
+
+  if(byte_order_test_var.four[0] != 0)
+  {
+    strlcpy(err, "Raw capture files are not supported on big endian platforms.", err_sz);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int rawcap_smp_sz(const struct rawcap_hdr *hdr)
+{
+  return (hdr->smp_fmt == RAWCAP_FMT_U8) ? 1 : 2;
+}
+
+
+int rawcap_create(struct rawcap_file *f, const char *path, const struct rawcap_hdr *hdr_s, char *err, int err_sz)
+{
+  int chn, chns=0;
+
+  long long ofs, arr_sz;
+
+  struct rawcap_hdr hdr;
+
+  memset(f, 0, sizeof(struct rawcap_file));
+
+  f->fd = -1;
+
+  if(rawcap_check_arch(err, err_sz))
+  {
+    return -1;
+  }
+
+  hdr = *hdr_s;
+
+  if(((hdr.smp_fmt != RAWCAP_FMT_S16) && (hdr.smp_fmt != RAWCAP_FMT_U8)) || (hdr.smps < 1))
+  {
+    strlcpy(err, "rawcap_create(): invalid parameters.", err_sz);
+    return -1;
+  }
+
+  memcpy(hdr.magic, RAWCAP_MAGIC, 8);
+
+  hdr.version = RAWCAP_VERSION;
+
+  hdr.hdr_sz = RAWCAP_HDR_SZ;
+
+  arr_sz = hdr.smps * rawcap_smp_sz(&hdr);
+
+  arr_sz = ((arr_sz + RAWCAP_ALIGN - 1) / RAWCAP_ALIGN) * RAWCAP_ALIGN;
+
+  ofs = RAWCAP_HDR_SZ;
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(!hdr.chan[chn].captured)
+    {
+      hdr.chan[chn].data_ofs = 0;
+
+      continue;
+    }
+
+    hdr.chan[chn].data_ofs = ofs;
+
+    ofs += arr_sz;
+
+    chns++;
+  }
+
+  if(!chns)
+  {
+    strlcpy(err, "No active channels.", err_sz);
+    return -1;
+  }
+
+  hdr.chns = chns;
+
+  f->sz = ofs;
+
+  /* unlink first, truncating would raise SIGBUS in a mapping of the old file that is still in use */
+  unlink(path);
+
+  f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(f->fd < 0)
+  {
+    snprintf(err, err_sz, "Can not create file %s: %s", path, strerror(errno));
+    return -1;
+  }
+
+  /* a write to a mapping beyond the free space raises SIGBUS, reserve the space now */
+  errno = posix_fallocate(f->fd, 0, f->sz);
+  if(errno)
+  {
+    snprintf(err, err_sz, "Can not allocate %lli bytes for %s: %s", f->sz, path, strerror(errno));
+    goto OUT_ERROR;
+  }
+
+  f->map = (char *)mmap(NULL, f->sz, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+  if(f->map == MAP_FAILED)
+  {
+    f->map = NULL;
+    snprintf(err, err_sz, "Can not map file %s: %s", path, strerror(errno));
+    goto OUT_ERROR;
+  }
+
+  madvise(f->map, f->sz, MADV_SEQUENTIAL);
+
+  memcpy(f->map, &hdr, sizeof(struct rawcap_hdr));
+
+  f->hdr = (struct rawcap_hdr *)f->map;
+
+  f->writemode = 1;
+
+  return 0;
+
+OUT_ERROR:
+
+  rawcap_close(f);
+
+  unlink(path);
+
+  return -1;
+}
+
+
+int rawcap_open(struct rawcap_file *f, const char *path, char *err, int err_sz)
+{
+  int chn;
+
+  long long arr_sz;
+
+  struct stat st;
+
+  struct rawcap_hdr *hdr;
+
+  memset(f, 0, sizeof(struct rawcap_file));
+
+  f->fd = -1;
+
+  if(rawcap_check_arch(err, err_sz))
+  {
+    return -1;
+  }
+
+  f->fd = open(path, O_RDONLY);
+  if(f->fd < 0)
+  {
+    snprintf(err, err_sz, "Can not open file %s: %s", path, strerror(errno));
+    return -1;
+  }
+
+  if(fstat(f->fd, &st) || (st.st_size < RAWCAP_HDR_SZ))
+  {
+    snprintf(err, err_sz, "File %s is not a capture file.", path);
+    goto OUT_ERROR;
+  }
+
+  f->sz = st.st_size;
+
+  f->map = (char *)mmap(NULL, f->sz, PROT_READ, MAP_SHARED, f->fd, 0);
+  if(f->map == MAP_FAILED)
+  {
+    f->map = NULL;
+    snprintf(err, err_sz, "Can not map file %s: %s", path, strerror(errno));
+    goto OUT_ERROR;
+  }
+
+  hdr = (struct rawcap_hdr *)f->map;
+
+  if(memcmp(hdr->magic, RAWCAP_MAGIC, 8))
+  {
+    snprintf(err, err_sz, "File %s is not a capture file.", path);
+    goto OUT_ERROR;
+  }
+
+  if((hdr->version != RAWCAP_VERSION) || (hdr->hdr_sz != RAWCAP_HDR_SZ))
+  {
+    snprintf(err, err_sz, "Capture file %s has an unsupported version.", path);
+    goto OUT_ERROR;
+  }
+
+  if(((hdr->smp_fmt != RAWCAP_FMT_S16) && (hdr->smp_fmt != RAWCAP_FMT_U8)) ||
+     (!(hdr->samplerate > 0)) || hdr->model[63] || hdr->serial[63] ||
+     (hdr->channel_cnt < 1) || (hdr->channel_cnt > RAWCAP_MAX_CHNS))
+  {
+    snprintf(err, err_sz, "Capture file %s contains format errors.", path);
+    goto OUT_ERROR;
+  }
+
+  /* the values come from the file, compare before multiplying or adding so nothing can overflow */
+  if((hdr->smps < 1) || (hdr->smps > f->sz))
+  {
+    snprintf(err, err_sz, "Capture file %s is truncated or contains format errors.", path);
+    goto OUT_ERROR;
+  }
+
+  arr_sz = hdr->smps * rawcap_smp_sz(hdr);
+
+  if(arr_sz > (f->sz - RAWCAP_HDR_SZ))
+  {
+    snprintf(err, err_sz, "Capture file %s is truncated or contains format errors.", path);
+    goto OUT_ERROR;
+  }
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(!hdr->chan[chn].captured)
+    {
+      continue;
+    }
+
+    if((hdr->chan[chn].data_ofs < RAWCAP_HDR_SZ) || (hdr->chan[chn].data_ofs % RAWCAP_ALIGN) ||
+       (hdr->chan[chn].data_ofs > (f->sz - arr_sz)))
+    {
+      snprintf(err, err_sz, "Capture file %s is truncated or contains format errors.", path);
+      goto OUT_ERROR;
+    }
+  }
+
+  f->hdr = hdr;
+
+  f->wr_pos = hdr->smps;
+
+  return 0;
+
+OUT_ERROR:
+
+  rawcap_close(f);
+
+  return -1;
+}
+
+
+int rawcap_write_segment(struct rawcap_file *f, short **buf, int n)
+{
+  int i, chn, ofs;
+
+  unsigned char *dest8;
+
+  if((!f->writemode) || ((f->wr_pos + n) > f->hdr->smps))
+  {
+    return -1;
+  }
+
+  for(chn=0; chn<RAWCAP_MAX_CHNS; chn++)
+  {
+    if(!f->hdr->chan[chn].captured)
+    {
+      continue;
+    }
+
+    if(buf[chn] == NULL)
+    {
+      return -1;
+    }
+
+    if(f->hdr->smp_fmt == RAWCAP_FMT_S16)
+    {
+      memcpy((short *)(f->map + f->hdr->chan[chn].data_ofs) + f->wr_pos, buf[chn], n * sizeof(short));
+    }
+    else
+    {
+      dest8 = (unsigned char *)(f->map + f->hdr->chan[chn].data_ofs) + f->wr_pos;
+
+      ofs = f->hdr->chan[chn].yref + f->hdr->chan[chn].yor;
+
+      for(i=0; i<n; i++)
+      {
+        dest8[i] = buf[chn][i] + ofs;
+      }
+    }
+  }
+
+  f->wr_pos += n;
+
+  return 0;
+}
+
+
+void * rawcap_samples(const struct rawcap_file *f, int chn)
+{
+  if((f->hdr == NULL) || (chn < 0) || (chn >= RAWCAP_MAX_CHNS) || (!f->hdr->chan[chn].captured))
+  {
+    return NULL;
+  }
+
+  return f->map + f->hdr->chan[chn].data_ofs;
+}
+
+
+int rawcap_close(struct rawcap_file *f)
+{
+  int err=0;
+
+  if(f->map != NULL)
+  {
+    if(f->writemode)
+    {
+      if(msync(f->map, f->sz, MS_SYNC))
+      {
+        err = -1;
+      }
+    }
+
+    munmap(f->map, f->sz);
+  }
+
+  if(f->fd >= 0)
+  {
+    if(close(f->fd))
+    {
+      err = -1;
+    }
+  }
+
+  f->fd = -1;
+
+  f->map = NULL;
+
+  f->hdr = NULL;
+
+  f->writemode = 0;
+
+  return err;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
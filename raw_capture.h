@@ -0,0 +1,171 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#ifndef RAW_CAPTURE_H
+#define RAW_CAPTURE_H
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * Native capture file of the deep memory:
+ *
+ * a header of RAWCAP_HDR_SZ bytes (struct rawcap_hdr followed by zeros)
+ * followed by one contiguous sample array per captured channel,
+ * every array starts at a multiple of RAWCAP_ALIGN bytes.
+ * All numbers are little endian.
+ *
+ * RAWCAP_FMT_S16: 16-bit samples, ADC code minus YREF and YOR,
+ *                 the format of the Wave Inspector buffers, voltage = sample * yinc
+ * RAWCAP_FMT_U8:  8-bit samples, the ADC code as received,
+ *                 voltage = (sample - yref - yor) * yinc
+ *
+ * The file is written and read through one mapping of the whole file,
+ * so reading the samples needs no parsing or copying.
+ */
+
+
+#define RAWCAP_MAGIC      "DSRCAP\r\n"
+#define RAWCAP_VERSION    (1)
+#define RAWCAP_HDR_SZ     (4096)
+#define RAWCAP_ALIGN      (4096)
+#define RAWCAP_MAX_CHNS   (4)
+
+#define RAWCAP_FMT_S16    (0)
+#define RAWCAP_FMT_U8     (1)
+
+
+struct rawcap_chan
+{
+  double yinc;          /* Volt per ADC step */
+  double scale;         /* Volt per division */
+  double offset;        /* Volt */
+  long long data_ofs;   /* file offset of the samples, set by rawcap_create() */
+  int captured;         /* 1 when the file contains the samples of this channel */
+  int yref;
+  int yor;
+  int coupling;         /* 0=GND, 1=DC, 2=AC */
+  int bwlimit;          /* MHz, 0=off */
+  int invert;
+  int unit;             /* 0=V, 1=W, 2=A, 3=U */
+  int reserved;
+};
+
+
+struct rawcap_hdr
+{
+  char magic[8];
+  int version;
+  int hdr_sz;
+  int smp_fmt;
+  int chns;             /* number of captured channels */
+  long long smps;       /* samples per channel */
+  long long capture_time;  /* seconds since the epoch */
+  double samplerate;
+  double xorigin;       /* time of the first sample relative to the trigger, seconds */
+  double timebasescale;
+  double timebaseoffset;
+  double trig_level;
+  int trig_source;
+  int trig_slope;
+  int hordivisions;
+  int vertdivisions;
+  int channel_cnt;      /* channels of the device */
+  int modelserie;
+  char model[64];
+  char serial[64];
+  struct rawcap_chan chan[RAWCAP_MAX_CHNS];
+};
+
+
+struct rawcap_file
+{
+  int fd;
+  int writemode;
+  long long sz;
+  long long wr_pos;     /* samples per channel written by rawcap_write_segment() */
+  char *map;
+  struct rawcap_hdr *hdr;
+};
+
+
+/*
+ * Creates the file with the header hdr, smp_fmt, smps and chan[].captured must be set.
+ * The space for all samples is allocated, so a full disk is reported here.
+ * Returns 0 on success or -1 with the reason in err.
+ */
+int rawcap_create(struct rawcap_file *, const char *path, const struct rawcap_hdr *, char *err, int err_sz);
+
+/* maps an existing file read-only, returns 0 on success or -1 with the reason in err */
+int rawcap_open(struct rawcap_file *, const char *path, char *err, int err_sz);
+
+/* writes n samples of every captured channel after the samples written before, buf[] is as the Wave Inspector buffers */
+int rawcap_write_segment(struct rawcap_file *, short **buf, int n);
+
+/* the samples of a captured channel in the mapping, NULL when the channel is not in the file */
+void * rawcap_samples(const struct rawcap_file *, int chn);
+
+/* bytes per sample */
+int rawcap_smp_sz(const struct rawcap_hdr *);
+
+/* unmaps and closes the file, in writemode the file is synced first, returns 0 on success */
+int rawcap_close(struct rawcap_file *);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
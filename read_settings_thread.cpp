@@ -40,6 +40,10 @@ read_settings_thread::read_settings_thread()
   devparms = NULL;
 
   delay = 0;
+
+  groups = SETTINGS_GRP_ALL;
+
+  snap_cnt = 0;
 }
 
 
@@ -49,6 +53,77 @@ void read_settings_thread::set_delay(int val)
 }
 
 
+void read_settings_thread::set_groups(int mask)
+{
+  groups = mask;
+}
+
+
+/* copies the settings of the groups in mask from src to dest */
+void read_settings_thread::copy_groups(struct device_settings *dest, const struct device_settings *src, int mask)
+{
+  int i;
+
+  if(mask & SETTINGS_GRP_MATH)
+  {
+    dest->math_fft = src->math_fft;
+    dest->math_fft_split = src->math_fft_split;
+    dest->math_fft_src = src->math_fft_src;
+    dest->math_fft_unit = src->math_fft_unit;
+    dest->math_fft_hscale = src->math_fft_hscale;
+    dest->math_fft_hcenter = src->math_fft_hcenter;
+    dest->fft_vscale = src->fft_vscale;
+    dest->fft_voffset = src->fft_voffset;
+  }
+
+  if(mask & SETTINGS_GRP_DECODE)
+  {
+    dest->math_decode_display = src->math_decode_display;
+    dest->math_decode_mode = src->math_decode_mode;
+    dest->math_decode_format = src->math_decode_format;
+    dest->math_decode_pos = src->math_decode_pos;
+    for(i=0; i<MAX_CHNS; i++)
+    {
+      dest->math_decode_threshold[i] = src->math_decode_threshold[i];
+    }
+    dest->math_decode_threshold_auto = src->math_decode_threshold_auto;
+    dest->math_decode_threshold_uart_rx = src->math_decode_threshold_uart_rx;
+    dest->math_decode_threshold_uart_tx = src->math_decode_threshold_uart_tx;
+    dest->math_decode_uart_rx = src->math_decode_uart_rx;
+    dest->math_decode_uart_tx = src->math_decode_uart_tx;
+    dest->math_decode_uart_pol = src->math_decode_uart_pol;
+    dest->math_decode_uart_baud = src->math_decode_uart_baud;
+    dest->math_decode_uart_width = src->math_decode_uart_width;
+    dest->math_decode_uart_stop = src->math_decode_uart_stop;
+    dest->math_decode_uart_par = src->math_decode_uart_par;
+    dest->math_decode_spi_clk = src->math_decode_spi_clk;
+    dest->math_decode_spi_miso = src->math_decode_spi_miso;
+    dest->math_decode_spi_mosi = src->math_decode_spi_mosi;
+    dest->math_decode_spi_cs = src->math_decode_spi_cs;
+    dest->math_decode_spi_select = src->math_decode_spi_select;
+    dest->math_decode_spi_mode = src->math_decode_spi_mode;
+    dest->math_decode_spi_timeout = src->math_decode_spi_timeout;
+    dest->math_decode_spi_pol = src->math_decode_spi_pol;
+    dest->math_decode_spi_edge = src->math_decode_spi_edge;
+    dest->math_decode_spi_width = src->math_decode_spi_width;
+    dest->math_decode_spi_end = src->math_decode_spi_end;
+  }
+
+  if(mask & SETTINGS_GRP_RECORD)
+  {
+    dest->func_wrec_enable = src->func_wrec_enable;
+    dest->func_wrec_fend = src->func_wrec_fend;
+    dest->func_wrec_fmax = src->func_wrec_fmax;
+    dest->func_wrec_fintval = src->func_wrec_fintval;
+    dest->func_wplay_fstart = src->func_wplay_fstart;
+    dest->func_wplay_fend = src->func_wplay_fend;
+    dest->func_wplay_fmax = src->func_wplay_fmax;
+    dest->func_wplay_fintval = src->func_wplay_fintval;
+    dest->func_wplay_fcur = src->func_wplay_fcur;
+  }
+}
+
+
 int read_settings_thread::get_error_num(void)
 {
   return err_num;
@@ -73,12 +148,110 @@ void read_settings_thread::set_devparm_ptr(struct device_settings *devp)
 }
 
 
-void read_settings_thread::run()
+/*
+ * Reads the settings of one subsystem with compound queries ":Q1?;:Q2?;:Q3?"
+ * and keeps the responses until the next snapshot. A transmission whose response
+ * does not have the expected number of fields is dropped, those settings are
+ * then read with single queries by query().
+ * Returns the number of cached responses.
+ */
+int read_settings_thread::snapshot(const char * const *cmds, int n)
 {
-  int chn, line=0;
+  int i, done, cnt, flds;
+
+  char str[TMC_CMD_MAX_LEN + 16],
+       *fld[RDS_SNAP_MAX + 1];
+
+  snap_cnt = 0;
+
+  if(n > RDS_SNAP_MAX)
+  {
+    n = RDS_SNAP_MAX;
+  }
+
+  for(done=0; done<n; done+=cnt)
+  {
+    cnt = tmc_cmd_join_query(str, TMC_CMD_MAX_LEN + 16, cmds + done, n - done);
+    if(cnt < 1)
+    {
+      break;
+    }
+
+    usleep(TMC_GDS_DELAY);
+
+    if(tmc_write(str) != (int)strlen(str))
+    {
+      break;
+    }
+
+    if(tmc_read() < 1)
+    {
+      break;
+    }
+
+    flds = tmc_cmd_split(device->buf, fld, cnt);
+    if(flds != cnt)
+    {
+      printf("settings snapshot: expected %i responses, received %i\n", cnt, flds);
+
+      continue;
+    }
+
+    for(i=0; i<cnt; i++)
+    {
+      if((strlen(cmds[done + i]) >= RDS_SNAP_CMD_LEN) ||
+         (strlen(fld[i]) < 1) ||
+         (strlen(fld[i]) >= RDS_SNAP_RESP_LEN))
+      {
+        continue;
+      }
+
+      strlcpy(snap_cmd[snap_cnt], cmds[done + i], RDS_SNAP_CMD_LEN);
+
+      strlcpy(snap_resp[snap_cnt], fld[i], RDS_SNAP_RESP_LEN);
+
+      snap_cnt++;
+    }
+  }
+
+  return snap_cnt;
+}
 
-  char str[512]="";
 
+/*
+ * Same as tmc_write() followed by tmc_read() but answered from the snapshot
+ * when possible. The inter-command delay is only needed when the device is
+ * actually addressed.
+ */
+int read_settings_thread::query(const char *cmd)
+{
+  int i;
+
+  for(i=0; i<snap_cnt; i++)
+  {
+    if(!strcmp(snap_cmd[i], cmd))
+    {
+      strlcpy(device->buf, snap_resp[i], RDS_SNAP_RESP_LEN);
+
+      device->sz = strlen(device->buf);
+
+      return device->sz;
+    }
+  }
+
+  usleep(TMC_GDS_DELAY);
+
+  if(tmc_write(cmd) != (int)strlen(cmd))
+  {
+    return -1;
+  }
+
+  return tmc_read();
+}
+
+
+void read_settings_thread::run()
+{
   struct timespec rqtp;
 
   err_num = -1;
@@ -87,8 +260,6 @@ void read_settings_thread::run()
 
   if(devparms == NULL) return;
 
-  devparms->activechannel = -1;
-
   if(delay > 0)
   {
     rqtp.tv_nsec = 0;
@@ -97,20 +268,114 @@ void read_settings_thread::run()
     while(nanosleep(&rqtp, &rqtp)) {};
   }
 
-  for(chn=0; chn<devparms->channel_cnt; chn++)
+  err_num = read_groups(groups);
+}
+
+
+/*
+ * Reads the settings groups in mask (SETTINGS_GRP_xxx) in the calling thread.
+ * The caller must own the connection, i.e. the screen thread must not run
+ * unless it is the caller.
+ * Returns 0 on success or -1 on error, see get_error_str().
+ */
+int read_settings_thread::read_groups(int mask)
+{
+  if((device == NULL) || (devparms == NULL))
   {
-    snprintf(str, 512, ":CHAN%i:BWL?", chn + 1);
+    return -1;
+  }
 
-    usleep(TMC_GDS_DELAY);
+  if(mask & SETTINGS_GRP_CORE)
+  {
+    snap_cnt = 0;
+
+    if(read_core())  return -1;
+  }
+
+  if(mask & SETTINGS_GRP_MATH)
+  {
+    snap_cnt = 0;
+
+    if(read_math())  return -1;
+  }
+
+  if(mask & SETTINGS_GRP_DECODE)
+  {
+    snap_cnt = 0;
+
+    if(read_decode())  return -1;
+  }
+
+  if(mask & SETTINGS_GRP_RECORD)
+  {
+    snap_cnt = 0;
+
+    if(read_record())  return -1;
+  }
+
+  snap_cnt = 0;
+
+  return 0;
+}
+
+
+int read_settings_thread::error_out(const char *str, int line)
+{
+  snprintf(err_str, 4096,
+           "An error occurred while reading settings from device.\n"
+           "Command sent: %s\n"
+           "Received: %s\n"
+           "File %s line %i",
+           str, device->buf, __FILE__, line);
+
+  err_num = -1;
+
+  return -1;
+}
+
+
+/* channels, timebase, trigger, acquisition and display */
+int read_settings_thread::read_core(void)
+{
+  int chn, line=0, n;
+
+  char str[512]="",
+       chn_qry[RDS_SNAP_MAX][RDS_SNAP_CMD_LEN];
+
+  const char *qry[RDS_SNAP_MAX];
+
+  devparms->activechannel = -1;
 
-    if(tmc_write(str) != 11)
+  /* :CHANn:BWL? is not in the snapshot, not all firmware versions answer it */
+  for(chn=0, n=0; chn<devparms->channel_cnt; chn++)
+  {
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:COUP?", chn + 1);
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:DISP?", chn + 1);
+    if(devparms->modelserie != 1 && devparms->modelserie != 7)
     {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
+      snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:IMP?", chn + 1);
     }
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:INVert?", chn + 1);
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:OFFS?", chn + 1);
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:PROB?", chn + 1);
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:UNIT?", chn + 1);
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:SCAL?", chn + 1);
+    snprintf(chn_qry[n++], RDS_SNAP_CMD_LEN, ":CHAN%i:VERN?", chn + 1);
+  }
+
+  for(chn=0; chn<n; chn++)
+  {
+    qry[chn] = chn_qry[chn];
+  }
+
+  snapshot(qry, n);
+
+  for(chn=0; chn<devparms->channel_cnt; chn++)
+  {
+    snprintf(str, 512, ":CHAN%i:BWL?", chn + 1);
 
     // NK: DHO800/DHO900 app (scpi) hasn't implemented other BW limiters. "OFF" and "20M" responses are hardcoded (compiled C++).
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       //line = __LINE__;
       //goto GDS_OUT_ERROR;
@@ -139,15 +404,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:COUP?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -173,15 +430,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:DISP?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -210,15 +459,7 @@ void read_settings_thread::run()
     {
       snprintf(str, 512, ":CHAN%i:IMP?", chn + 1);
 
-      usleep(TMC_GDS_DELAY);
-
-      if(tmc_write(str) != 11)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
-
-      if(tmc_read() < 1)
+      if(query(str) < 1)
       {
         line = __LINE__;
         goto GDS_OUT_ERROR;
@@ -241,15 +482,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:INVert?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -271,15 +504,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:OFFS?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -289,15 +514,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:PROB?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -307,15 +524,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:UNIT?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -344,15 +553,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:SCAL?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -362,15 +563,7 @@ void read_settings_thread::run()
 
     snprintf(str, 512, ":CHAN%i:VERN?", chn + 1);
 
-    usleep(TMC_GDS_DELAY);
-
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -391,17 +584,27 @@ void read_settings_thread::run()
       }
   }
 
-  usleep(TMC_GDS_DELAY);
-
-  strlcpy(str, ":TIM:OFFS?", 512);
-
-  if(tmc_write(str) != 10)
+  n = 0;
+  qry[n++] = ":TIM:OFFS?";
+  qry[n++] = ":TIM:SCAL?";
+  qry[n++] = ":TIM:DEL:ENAB?";
+  qry[n++] = ":TIM:DEL:OFFS?";
+  qry[n++] = ":TIM:DEL:SCAL?";
+  if(devparms->modelserie != 1)
   {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
+    qry[n++] = ":TIM:HREF:MODE?";
+    qry[n++] = ":TIM:HREF:POS?";
   }
+  qry[n++] = ":TIM:MODE?";
+  if(devparms->modelserie != 1)
+  {
+    qry[n++] = ":TIM:VERN?";
+  }
+  snapshot(qry, n);
+
+  strlcpy(str, ":TIM:OFFS?", 512);
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -409,17 +612,9 @@ void read_settings_thread::run()
 
   devparms->timebaseoffset = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TIM:SCAL?", 512);
 
-  if(tmc_write(str) != 10)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -427,17 +622,9 @@ void read_settings_thread::run()
 
   devparms->timebasescale = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TIM:DEL:ENAB?", 512);
 
-  if(tmc_write(str) != 14)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -457,17 +644,9 @@ void read_settings_thread::run()
       goto GDS_OUT_ERROR;
     }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TIM:DEL:OFFS?", 512);
 
-  if(tmc_write(str) != 14)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -475,17 +654,9 @@ void read_settings_thread::run()
 
   devparms->timebasedelayoffset = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TIM:DEL:SCAL?", 512);
 
-  if(tmc_write(str) != 14)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -495,17 +666,9 @@ void read_settings_thread::run()
 
   if(devparms->modelserie != 1)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":TIM:HREF:MODE?", 512);
 
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -529,17 +692,9 @@ void read_settings_thread::run()
           goto GDS_OUT_ERROR;
         }
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":TIM:HREF:POS?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -548,17 +703,9 @@ void read_settings_thread::run()
     devparms->timebasehrefpos = atoi(device->buf);
   }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TIM:MODE?", 512);
 
-  if(tmc_write(str) != 10)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -584,17 +731,9 @@ void read_settings_thread::run()
 
   if(devparms->modelserie != 1)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":TIM:VERN?", 512);
 
-    if(tmc_write(str) != 10)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -617,17 +756,9 @@ void read_settings_thread::run()
 
   if((devparms->modelserie != 1) && (devparms->modelserie != 2) && (devparms->modelserie != 7))
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":TIM:XY1:DISP?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -647,17 +778,9 @@ void read_settings_thread::run()
         goto GDS_OUT_ERROR;
       }
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":TIM:XY2:DISP?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -674,21 +797,30 @@ void read_settings_thread::run()
       else
       {
         line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
-  }
-
-  usleep(TMC_GDS_DELAY);
-
-  strlcpy(str, ":TRIG:COUP?", 512);
+        goto GDS_OUT_ERROR;
+      }
+  }
 
-  if(tmc_write(str) != 11)
+  n = 0;
+  qry[n++] = ":TRIG:COUP?";
+  qry[n++] = ":TRIG:SWE?";
+  qry[n++] = ":TRIG:MODE?";
+  qry[n++] = ":TRIG:STAT?";
+  if(devparms->modelserie == 7)
   {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
+    qry[n++] = ":TRIGger:EDGe:SLOPe?";
+    qry[n++] = ":TRIGger:EDGe:SOURce?";
+  }
+  else
+  {
+    qry[n++] = ":TRIG:EDG:SLOP?";
+    qry[n++] = ":TRIG:EDG:SOUR?";
   }
+  snapshot(qry, n);
+
+  strlcpy(str, ":TRIG:COUP?", 512);
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -716,17 +848,9 @@ void read_settings_thread::run()
           goto GDS_OUT_ERROR;
         }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TRIG:SWE?", 512);
 
-  if(tmc_write(str) != 10)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -750,17 +874,9 @@ void read_settings_thread::run()
         goto GDS_OUT_ERROR;
       }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TRIG:MODE?", 512);
 
-  if(tmc_write(str) != 11)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -840,17 +956,9 @@ void read_settings_thread::run()
                                     goto GDS_OUT_ERROR;
                                   }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":TRIG:STAT?", 512);
 
-  if(tmc_write(str) != 11)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -886,32 +994,18 @@ void read_settings_thread::run()
               goto GDS_OUT_ERROR;
             }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":TRIGger:EDGe:SLOPe?", 512);
-
-    if(tmc_write(str) != 20)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":TRIG:EDG:SLOP?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   
   
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -935,30 +1029,16 @@ void read_settings_thread::run()
         goto GDS_OUT_ERROR;
       }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":TRIGger:EDGe:SOURce?", 512);
-
-    if(tmc_write(str) != 21)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":TRIG:EDG:SOUR?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1021,6 +1101,8 @@ void read_settings_thread::run()
                   goto GDS_OUT_ERROR;
                 }
 
+  snap_cnt = 0;
+
   /* temporary change the trigger source so that we can retrieve the respective trigger levels */
   for(chn=0; chn<devparms->channel_cnt; chn++)
   {
@@ -1034,17 +1116,9 @@ void read_settings_thread::run()
       goto GDS_OUT_ERROR;
     }
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":TRIG:EDGe:LEV?", 512);
 
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1115,17 +1189,20 @@ void read_settings_thread::run()
             }
           }
 
-  usleep(TMC_GDS_DELAY);
+  n = 0;
+  qry[n++] = ":TRIG:HOLD?";
+  qry[n++] = ":ACQ:SRAT?";
+  qry[n++] = ":DISP:GRID?";
+  qry[n++] = ":MEAS:COUN:SOUR?";
+  qry[n++] = ":DISP:TYPE?";
+  qry[n++] = ":ACQ:TYPE?";
+  qry[n++] = ":ACQ:AVER?";
+  qry[n++] = ":DISP:GRAD:TIME?";
+  snapshot(qry, n);
 
   strlcpy(str, ":TRIG:HOLD?", 512);
 
-  if(tmc_write(str) != 11)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1133,17 +1210,9 @@ void read_settings_thread::run()
 
   devparms->triggerholdoff = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":ACQ:SRAT?", 512);
 
-  if(tmc_write(str) != 10)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1151,17 +1220,9 @@ void read_settings_thread::run()
 
   devparms->samplerate = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":DISP:GRID?", 512);
 
-  if(tmc_write(str) != 11)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1185,17 +1246,9 @@ void read_settings_thread::run()
         goto GDS_OUT_ERROR;
       }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":MEAS:COUN:SOUR?", 512);
 
-  if(tmc_write(str) != 16)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1227,17 +1280,9 @@ void read_settings_thread::run()
             goto GDS_OUT_ERROR;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":DISP:TYPE?", 512);
 
-  if(tmc_write(str) != 11)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1257,17 +1302,9 @@ void read_settings_thread::run()
       goto GDS_OUT_ERROR;
     }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":ACQ:TYPE?", 512);
 
-  if(tmc_write(str) != 10)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1295,17 +1332,9 @@ void read_settings_thread::run()
           goto GDS_OUT_ERROR;
         }
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":ACQ:AVER?", 512);
 
-  if(tmc_write(str) != 10)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1313,17 +1342,9 @@ void read_settings_thread::run()
 
   devparms->acquireaverages = atoi(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   strlcpy(str, ":DISP:GRAD:TIME?", 512);
 
-  if(tmc_write(str) != 16)
-  {
-    line = __LINE__;
-    goto GDS_OUT_ERROR;
-  }
-
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1371,7 +1392,57 @@ void read_settings_thread::run()
                     goto GDS_OUT_ERROR;
                   }
 
-  usleep(TMC_GDS_DELAY);
+  return 0;
+
+GDS_OUT_ERROR:
+
+  return error_out(str, line);
+}
+
+
+/* math / FFT */
+int read_settings_thread::read_math(void)
+{
+  int line=0, n;
+
+  char str[512]="";
+
+  const char *qry[RDS_SNAP_MAX];
+
+  n = 0;
+  if(devparms->modelserie == 7)
+  {
+    qry[n++] = ":MATH1:DISP?";
+    qry[n++] = ":MATH1:FFT:UNIT?";
+    qry[n++] = ":MATH1:FFT:SOUR?";
+    qry[n++] = ":MATH1:FFT:HSC?";
+    qry[n++] = ":MATH1:FFT:HCEN?";
+    qry[n++] = ":MATH1:OFFS?";
+    qry[n++] = ":MATH1:SCAL?";
+  }
+  else if(devparms->modelserie != 1)
+  {
+    qry[n++] = ":CALC:FFT:SPL?";
+    qry[n++] = ":CALC:MODE?";
+    qry[n++] = ":CALC:FFT:VSM?";
+    qry[n++] = ":CALC:FFT:SOUR?";
+    qry[n++] = ":CALC:FFT:HSP?";
+    qry[n++] = ":CALC:FFT:HCEN?";
+    qry[n++] = ":CALC:FFT:VOFF?";
+    qry[n++] = ":CALC:FFT:VSC?";
+  }
+  else
+  {
+    qry[n++] = ":MATH:FFT:SPL?";
+    qry[n++] = ":MATH:DISP?";
+    qry[n++] = ":MATH:FFT:UNIT?";
+    qry[n++] = ":MATH:FFT:SOUR?";
+    qry[n++] = ":MATH:FFT:HSC?";
+    qry[n++] = ":MATH:FFT:HCEN?";
+    qry[n++] = ":MATH:OFFS?";
+    qry[n++] = ":MATH:SCAL?";
+  }
+  snapshot(qry, n);
 
   if(devparms->modelserie == 7)
   {
@@ -1382,25 +1453,13 @@ void read_settings_thread::run()
     if(devparms->modelserie != 1)
     {
       strlcpy(str, ":CALC:FFT:SPL?", 512);
-
-      if(tmc_write(str) != 14)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
     else
     {
       strlcpy(str, ":MATH:FFT:SPL?", 512);
-
-      if(tmc_write(str) != 14)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
 
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1408,20 +1467,13 @@ void read_settings_thread::run()
 
     devparms->math_fft_split = atoi(device->buf);
 
-    usleep(TMC_GDS_DELAY);
   }
 
   if(devparms->modelserie != 1 && devparms->modelserie != 7)
   {
     strlcpy(str, ":CALC:MODE?", 512);
 
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1441,25 +1493,13 @@ void read_settings_thread::run()
     if(devparms->modelserie == 7)
     {
       strlcpy(str, ":MATH1:DISP?", 512);
-
-      if(tmc_write(str) != 12)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
     else
     {
       strlcpy(str, ":MATH:DISP?", 512);
-
-      if(tmc_write(str) != 11)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
 
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1469,30 +1509,16 @@ void read_settings_thread::run()
 
     if(devparms->math_fft == 1)
     {
-      usleep(TMC_GDS_DELAY);
-
       if(devparms->modelserie == 7)
       {
         strlcpy(str, ":MATH1:OPER?", 512);
-
-        if(tmc_write(str) != 12)
-        {
-          line = __LINE__;
-          goto GDS_OUT_ERROR;
-        }
       }
       else
       {
         strlcpy(str, ":MATH:OPER?", 512);
-
-        if(tmc_write(str) != 11)
-        {
-          line = __LINE__;
-          goto GDS_OUT_ERROR;
-        }
       }
 
-      if(tmc_read() < 1)
+      if(query(str) < 1)
       {
         line = __LINE__;
         goto GDS_OUT_ERROR;
@@ -1509,40 +1535,20 @@ void read_settings_thread::run()
     }
   }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":MATH1:FFT:UNIT?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else if(devparms->modelserie != 1)
   {
     strlcpy(str, ":CALC:FFT:VSM?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":MATH:FFT:UNIT?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1565,40 +1571,20 @@ void read_settings_thread::run()
     devparms->math_fft_unit = 1;
   }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":MATH1:FFT:SOUR?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else if(devparms->modelserie != 1)
   {
     strlcpy(str, ":CALC:FFT:SOUR?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":MATH:FFT:SOUR?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1625,21 +1611,13 @@ void read_settings_thread::run()
           devparms->math_fft_src = 0;
         }
 
-  usleep(TMC_GDS_DELAY);
-
   devparms->current_screen_sf = 100.0 / devparms->timebasescale;
 
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":MATH1:FFT:HSC?", 512);
 
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1651,13 +1629,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":CALC:FFT:HSP?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1697,13 +1669,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":MATH:FFT:HSC?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1712,40 +1678,20 @@ void read_settings_thread::run()
     devparms->math_fft_hscale = atof(device->buf);
   }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":MATH1:FFT:HCEN?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else if(devparms->modelserie != 1)
   {
     strlcpy(str, ":CALC:FFT:HCEN?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
-  {
-    strlcpy(str, ":MATH:FFT:HCEN?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
+  {
+    strlcpy(str, ":MATH:FFT:HCEN?", 512);
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1753,19 +1699,11 @@ void read_settings_thread::run()
 
   devparms->math_fft_hcenter = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":MATH1:OFFS?", 512);
 
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1777,13 +1715,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":CALC:FFT:VOFF?", 512);
 
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1795,13 +1727,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":MATH:OFFS?", 512);
 
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1810,19 +1736,11 @@ void read_settings_thread::run()
     devparms->fft_voffset = atof(device->buf);
   }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":MATH1:SCAL?", 512);
 
-    if(tmc_write(str) != 12)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1834,13 +1752,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":CALC:FFT:VSC?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1859,13 +1771,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":MATH:SCAL?", 512);
 
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -1874,30 +1780,110 @@ void read_settings_thread::run()
     devparms->fft_vscale = atof(device->buf);
   }
 
-  usleep(TMC_GDS_DELAY);
+  return 0;
+
+GDS_OUT_ERROR:
+
+  return error_out(str, line);
+}
+
 
+/* serial bus decoder */
+int read_settings_thread::read_decode(void)
+{
+  int line=0, n;
+
+  char str[512]="";
+
+  const char *qry[RDS_SNAP_MAX];
+
+  n = 0;
   if(devparms->modelserie != 1)
   {
-    strlcpy(str, ":BUS1:MODE?", 512);
-
-    if(tmc_write(str) != 11)
+    qry[n++] = ":BUS1:MODE?";
+    qry[n++] = ":BUS1:DISP?";
+    qry[n++] = ":BUS1:FORM?";
+    if(devparms->modelserie == 7)
     {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
+      qry[n++] = ":BUS1:POSition?";
     }
+    else
+    {
+      qry[n++] = ":BUS1:SPI:OFFS?";
+    }
+    qry[n++] = ":BUS1:SPI:MISO:THR?";
+    qry[n++] = ":BUS1:SPI:MOSI:THR?";
+    if(devparms->channel_cnt == 4)
+    {
+      qry[n++] = ":BUS1:SPI:SCLK:THR?";
+      qry[n++] = ":BUS1:SPI:SS:THR?";
+    }
+    qry[n++] = ":BUS1:RS232:TTHR?";
+    qry[n++] = ":BUS1:RS232:RTHR?";
+    qry[n++] = ":BUS1:RS232:RX?";
+    qry[n++] = ":BUS1:RS232:TX?";
+    qry[n++] = ":BUS1:RS232:POL?";
+    qry[n++] = ":BUS1:RS232:END?";
+    qry[n++] = ":BUS1:RS232:BAUD?";
+    qry[n++] = ":BUS1:RS232:DBIT?";
+    qry[n++] = ":BUS1:RS232:SBIT?";
+    qry[n++] = ":BUS1:RS232:PAR?";
+    qry[n++] = ":BUS1:SPI:SCLK:SOUR?";
+    qry[n++] = ":BUS1:SPI:MISO:SOUR?";
+    qry[n++] = ":BUS1:SPI:MOSI:SOUR?";
+    qry[n++] = ":BUS1:SPI:SS:SOUR?";
+    qry[n++] = ":BUS1:SPI:SS:POL?";
+    qry[n++] = ":BUS1:SPI:MOSI:POL?";
+    qry[n++] = ":BUS1:SPI:SCLK:SLOP?";
+    qry[n++] = ":BUS1:SPI:DBIT?";
+    qry[n++] = ":BUS1:SPI:END?";
   }
   else
   {
-    strlcpy(str, ":DEC1:MODE?", 512);
+    qry[n++] = ":DEC1:MODE?";
+    qry[n++] = ":DEC1:DISP?";
+    qry[n++] = ":DEC1:FORM?";
+    qry[n++] = ":DEC1:POS?";
+    qry[n++] = ":DEC1:THRE:CHAN1?";
+    qry[n++] = ":DEC1:THRE:CHAN2?";
+    if(devparms->channel_cnt == 4)
+    {
+      qry[n++] = ":DEC1:THRE:CHAN3?";
+      qry[n++] = ":DEC1:THRE:CHAN4?";
+    }
+    qry[n++] = ":DEC1:THRE:AUTO?";
+    qry[n++] = ":DEC1:UART:RX?";
+    qry[n++] = ":DEC1:UART:TX?";
+    qry[n++] = ":DEC1:UART:POL?";
+    qry[n++] = ":DEC1:UART:END?";
+    qry[n++] = ":DEC1:UART:BAUD?";
+    qry[n++] = ":DEC1:UART:WIDT?";
+    qry[n++] = ":DEC1:UART:STOP?";
+    qry[n++] = ":DEC1:UART:PAR?";
+    qry[n++] = ":DEC1:SPI:CLK?";
+    qry[n++] = ":DEC1:SPI:MISO?";
+    qry[n++] = ":DEC1:SPI:MOSI?";
+    qry[n++] = ":DEC1:SPI:CS?";
+    qry[n++] = ":DEC1:SPI:SEL?";
+    qry[n++] = ":DEC1:SPI:MODE?";
+    qry[n++] = ":DEC1:SPI:TIM?";
+    qry[n++] = ":DEC1:SPI:POL?";
+    qry[n++] = ":DEC1:SPI:EDGE?";
+    qry[n++] = ":DEC1:SPI:WIDT?";
+    qry[n++] = ":DEC1:SPI:END?";
+  }
+  snapshot(qry, n);
 
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
+  if(devparms->modelserie != 1)
+  {
+    strlcpy(str, ":BUS1:MODE?", 512);
+  }
+  else
+  {
+    strlcpy(str, ":DEC1:MODE?", 512);
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1924,30 +1910,16 @@ void read_settings_thread::run()
             devparms->math_decode_mode = 3;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:DISP?", 512);
-
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:DISP?", 512);
-
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -1955,30 +1927,16 @@ void read_settings_thread::run()
 
   devparms->math_decode_display = atoi(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:FORM?", 512);
-
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:FORM?", 512);
-
-    if(tmc_write(str) != 11)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2005,40 +1963,20 @@ void read_settings_thread::run()
             devparms->math_decode_format = 4;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":BUS1:POSition?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:OFFS?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:POS?", 512);
-
-    if(tmc_write(str) != 10)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2046,30 +1984,16 @@ void read_settings_thread::run()
 
   devparms->math_decode_pos = atoi(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:MISO:THR?", 512);
-
-    if(tmc_write(str) != 19)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:THRE:CHAN1?", 512);
-
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2077,30 +2001,16 @@ void read_settings_thread::run()
 
   devparms->math_decode_threshold[0] = atof(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:MOSI:THR?", 512);
-
-    if(tmc_write(str) != 19)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:THRE:CHAN2?", 512);
-
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2110,30 +2020,16 @@ void read_settings_thread::run()
 
   if(devparms->channel_cnt == 4)
   {
-    usleep(TMC_GDS_DELAY);
-
     if(devparms->modelserie != 1)
     {
       strlcpy(str, ":BUS1:SPI:SCLK:THR?", 512);
-
-      if(tmc_write(str) != 19)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
     else
     {
       strlcpy(str, ":DEC1:THRE:CHAN3?", 512);
-
-      if(tmc_write(str) != 17)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
 
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2141,30 +2037,16 @@ void read_settings_thread::run()
 
     devparms->math_decode_threshold[2] = atof(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     if(devparms->modelserie != 1)
     {
       strlcpy(str, ":BUS1:SPI:SS:THR?", 512);
-
-      if(tmc_write(str) != 17)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
     else
     {
       strlcpy(str, ":DEC1:THRE:CHAN4?", 512);
-
-      if(tmc_write(str) != 17)
-      {
-        line = __LINE__;
-        goto GDS_OUT_ERROR;
-      }
     }
 
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2175,17 +2057,9 @@ void read_settings_thread::run()
 
   if(devparms->modelserie != 1)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":BUS1:RS232:TTHR?", 512);
 
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2194,17 +2068,9 @@ void read_settings_thread::run()
 //    devparms->math_decode_threshold_uart_tx = atof(device->buf);
     devparms->math_decode_threshold_uart_tx = atof(device->buf) * 10.0;  // hack for firmware bug!
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":BUS1:RS232:RTHR?", 512);
 
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2216,17 +2082,9 @@ void read_settings_thread::run()
 
   if(devparms->modelserie == 1)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":DEC1:THRE:AUTO?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2235,30 +2093,16 @@ void read_settings_thread::run()
     devparms->math_decode_threshold_auto = atoi(device->buf);
   }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:RX?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:RX?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2289,30 +2133,16 @@ void read_settings_thread::run()
             devparms->math_decode_uart_rx = 0;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:TX?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:TX?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2343,30 +2173,16 @@ void read_settings_thread::run()
             devparms->math_decode_uart_tx = 0;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:POL?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:POL?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2381,30 +2197,16 @@ void read_settings_thread::run()
       devparms->math_decode_uart_pol = 0;
     }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:END?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:END?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2419,30 +2221,16 @@ void read_settings_thread::run()
       devparms->math_decode_uart_pol = 0;
     }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:BAUD?", 512);
-
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:BAUD?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2451,30 +2239,16 @@ void read_settings_thread::run()
 //FIXME  DEC1:UART:BAUD? can return also "USER" instead of a number!
   devparms->math_decode_uart_baud = atoi(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
-    strlcpy(str, ":BUS1:RS232:DBIT?", 512);
-
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
+    strlcpy(str, ":BUS1:RS232:DBIT?", 512);
   }
   else
   {
     strlcpy(str, ":DEC1:UART:WIDT?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2482,30 +2256,16 @@ void read_settings_thread::run()
 
   devparms->math_decode_uart_width = atoi(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:SBIT?", 512);
-
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:STOP?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2524,30 +2284,16 @@ void read_settings_thread::run()
         devparms->math_decode_uart_stop = 2;
       }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:RS232:PAR?", 512);
-
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:UART:PAR?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2570,30 +2316,16 @@ void read_settings_thread::run()
         devparms->math_decode_uart_par = 0;
       }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:SCLK:SOUR?", 512);
-
-    if(tmc_write(str) != 20)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:CLK?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2616,30 +2348,16 @@ void read_settings_thread::run()
           devparms->math_decode_spi_clk = 3;
         }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:MISO:SOUR?", 512);
-
-    if(tmc_write(str) != 20)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:MISO?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2670,30 +2388,16 @@ void read_settings_thread::run()
             devparms->math_decode_spi_miso = 0;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:MOSI:SOUR?", 512);
-
-    if(tmc_write(str) != 20)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:MOSI?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2724,30 +2428,16 @@ void read_settings_thread::run()
             devparms->math_decode_spi_mosi = 0;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:SS:SOUR?", 512);
-
-    if(tmc_write(str) != 18)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:CS?", 512);
-
-    if(tmc_write(str) != 13)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2778,30 +2468,16 @@ void read_settings_thread::run()
             devparms->math_decode_spi_cs = 0;
           }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:SS:POL?", 512);
-
-    if(tmc_write(str) != 17)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:SEL?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2826,17 +2502,9 @@ void read_settings_thread::run()
 
   if(devparms->modelserie == 1)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":DEC1:SPI:MODE?", 512);
 
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2854,17 +2522,9 @@ void read_settings_thread::run()
 
   if(devparms->modelserie == 1)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":DEC1:SPI:TIM?", 512);
 
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -2873,30 +2533,16 @@ void read_settings_thread::run()
     devparms->math_decode_spi_timeout = atof(device->buf);
   }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:MOSI:POL?", 512);
-
-    if(tmc_write(str) != 19)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:POL?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2911,30 +2557,16 @@ void read_settings_thread::run()
       devparms->math_decode_spi_pol = 1;
     }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:SCLK:SLOP?", 512);
-
-    if(tmc_write(str) != 20)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:EDGE?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2957,30 +2589,16 @@ void read_settings_thread::run()
           devparms->math_decode_spi_edge = 1;
         }
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:DBIT?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:WIDT?", 512);
-
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -2988,30 +2606,16 @@ void read_settings_thread::run()
 
   devparms->math_decode_spi_width = atoi(device->buf);
 
-  usleep(TMC_GDS_DELAY);
-
   if(devparms->modelserie != 1)
   {
     strlcpy(str, ":BUS1:SPI:END?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
   else
   {
     strlcpy(str, ":DEC1:SPI:END?", 512);
-
-    if(tmc_write(str) != 14)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
   }
 
-  if(tmc_read() < 1)
+  if(query(str) < 1)
   {
     line = __LINE__;
     goto GDS_OUT_ERROR;
@@ -3026,19 +2630,26 @@ void read_settings_thread::run()
       devparms->math_decode_spi_end = 1;
     }
 
-  usleep(TMC_GDS_DELAY);
+  return 0;
+
+GDS_OUT_ERROR:
+
+  return error_out(str, line);
+}
+
+
+/* waveform record and playback */
+int read_settings_thread::read_record(void)
+{
+  int line=0;
+
+  char str[512]="";
 
   if(devparms->modelserie == 7)
   {
     strlcpy(str, ":RECord:WRECord:ENABle?", 512);
 
-    if(tmc_write(str) != 23)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3062,13 +2673,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":FUNC:WREC:ENAB?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3092,13 +2697,7 @@ void read_settings_thread::run()
   {
     strlcpy(str, ":FUNC:WRM?", 512);
 
-    if(tmc_write(str) != 10)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3125,17 +2724,9 @@ void read_settings_thread::run()
 
   if(devparms->func_wrec_enable)
   {
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREC:FEND?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3143,17 +2734,9 @@ void read_settings_thread::run()
 
     devparms->func_wrec_fend = atoi(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREC:FMAX?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3161,17 +2744,9 @@ void read_settings_thread::run()
 
     devparms->func_wrec_fmax = atoi(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREC:FINT?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3179,17 +2754,9 @@ void read_settings_thread::run()
 
     devparms->func_wrec_fintval = atof(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREP:FST?", 512);
 
-    if(tmc_write(str) != 15)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3197,17 +2764,9 @@ void read_settings_thread::run()
 
     devparms->func_wplay_fstart = atoi(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREP:FEND?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3215,17 +2774,9 @@ void read_settings_thread::run()
 
     devparms->func_wplay_fend = atoi(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREP:FMAX?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3233,17 +2784,9 @@ void read_settings_thread::run()
 
     devparms->func_wplay_fmax = atoi(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREP:FINT?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3251,17 +2794,9 @@ void read_settings_thread::run()
 
     devparms->func_wplay_fintval = atof(device->buf);
 
-    usleep(TMC_GDS_DELAY);
-
     strlcpy(str, ":FUNC:WREP:FCUR?", 512);
 
-    if(tmc_write(str) != 16)
-    {
-      line = __LINE__;
-      goto GDS_OUT_ERROR;
-    }
-
-    if(tmc_read() < 1)
+    if(query(str) < 1)
     {
       line = __LINE__;
       goto GDS_OUT_ERROR;
@@ -3270,22 +2805,11 @@ void read_settings_thread::run()
     devparms->func_wplay_fcur = atoi(device->buf);
   }
 
-  err_num = 0;
-
-  return;
+  return 0;
 
 GDS_OUT_ERROR:
 
-  snprintf(err_str, 4096,
-           "An error occurred while reading settings from device.\n"
-           "Command sent: %s\n"
-           "Received: %s\n"
-           "File %s line %i",
-           str, device->buf, __FILE__, line);
-
-  err_num = -1;
-
-  return;
+  return error_out(str, line);
 }
 
 
@@ -42,6 +42,12 @@
 #include "utils.h"
 #include "connection.h"
 #include "tmc_dev.h"
+#include "tmc_cmd.h"
+
+
+#define RDS_SNAP_MAX        (48)
+#define RDS_SNAP_CMD_LEN    (32)
+#define RDS_SNAP_RESP_LEN  (128)
 
 
 
@@ -58,15 +64,30 @@ public:
   int get_error_num(void);
   void get_error_str(char *, int);
   void set_delay(int);
+  void set_groups(int);
+  int read_groups(int);
+
+  static void copy_groups(struct device_settings *, const struct device_settings *, int);
 
 private:
 
   struct tmcdev *device;
   struct device_settings *devparms;
 
-  char err_str[4096];
+  char err_str[4096],
+       snap_cmd[RDS_SNAP_MAX][RDS_SNAP_CMD_LEN],
+       snap_resp[RDS_SNAP_MAX][RDS_SNAP_RESP_LEN];
+
+  int err_num, delay, groups, snap_cnt;
+
+  int snapshot(const char * const *, int);
+  int query(const char *);
+  int error_out(const char *, int);
 
-  int err_num, delay;
+  int read_core(void);
+  int read_math(void);
+  int read_decode(void);
+  int read_record(void);
 
   void run();
 };
@@ -26,7 +26,6 @@
 */
 
 
-#define SAV_MEM_BSZ    (250000)
 
 
 
@@ -41,7 +40,7 @@ void UI_Mainwindow::save_app_screenshot()
 
   scrn_timer->stop();
 
-  scrn_thread->wait();
+  scrn_thread->stop_streaming();
 
   if(recent_savedir[0]!=0)
   {
@@ -85,7 +84,7 @@ void UI_Mainwindow::save_screenshot()
 
   scrn_timer->stop();
 
-  scrn_thread->wait();
+  scrn_thread->stop_streaming();
 
   tmc_write(":DISPlay:DATA?");
 
@@ -221,14 +220,11 @@ OUT_ERROR:
 
 void UI_Mainwindow::get_deep_memory_waveform(void)
 {
-  int i, k,
-      n=0,
+  int i,
       chn,
       chns=0,
-      bytes_rcvd=0,
       mempnts,
-      yref[MAX_CHNS],
-      empty_buf;
+      yref[MAX_CHNS];
 
   char str[512];
 
@@ -236,9 +232,7 @@ void UI_Mainwindow::get_deep_memory_waveform(void)
 
   QEventLoop ev_loop;
 
-  QMessageBox wi_msg_box;
-
-  save_data_thread get_data_thrd(0);
+  mem_download_thread dl_thrd;
 
   if(device == NULL)
   {
@@ -247,7 +241,7 @@ void UI_Mainwindow::get_deep_memory_waveform(void)
 
   scrn_timer->stop();
 
-  scrn_thread->wait();
+  scrn_thread->stop_streaming();
 
   for(i=0; i<MAX_CHNS; i++)
   {
@@ -260,8 +254,6 @@ void UI_Mainwindow::get_deep_memory_waveform(void)
   progress.setWindowModality(Qt::WindowModal);
   progress.setMinimumDuration(0);
 
-  connect(&get_data_thrd, SIGNAL(finished()), &ev_loop, SLOT(quit()));
-
   statusLabel->setText("Downloading data...");
 
   for(i=0; i<MAX_CHNS; i++)
@@ -305,498 +297,505 @@ void UI_Mainwindow::get_deep_memory_waveform(void)
 
   usleep(20000);
 
-  for(chn=0; chn<MAX_CHNS; chn++)
+  if(mem_download_thread::prepare_device(device, &devparms, yref, str, 512))
   {
-    if(!devparms.chandisplay[chn])  // Download data only when channel is switched on
-    {
-      continue;
-    }
-
-    snprintf(str, 512, "Downloading channel %i waveform data...", chn + 1);
-    progress.setLabelText(str);
+    goto OUT_ERROR;
+  }
 
-    snprintf(str, 512, ":WAV:SOUR CHAN%i", chn + 1);
+  dl_thrd.set_params(&devparms, wavbuf, yref, mempnts);
 
-    tmc_write(str);
+  connect(&dl_thrd,  SIGNAL(dl_progress(int)),               &progress, SLOT(setValue(int)));
+  connect(&dl_thrd,  SIGNAL(dl_status(const QString &)),     &progress, SLOT(setLabelText(const QString &)));
+  connect(&dl_thrd,  SIGNAL(finished()),                     &ev_loop,  SLOT(quit()));
+  connect(&progress, SIGNAL(canceled()),                     &dl_thrd,  SLOT(abort()));
 
-    tmc_write(":WAV:FORM BYTE");
+  dl_thrd.start();
 
-    usleep(20000);
+  ev_loop.exec();
 
-    tmc_write(":WAV:MODE RAW");
+  devparms.wav_multichn = dl_thrd.get_wav_multichn();
 
-    usleep(20000);
+  dl_thrd.get_blk_sz(&devparms.mem_blk_sz, &devparms.mem_blk_max);
 
-    tmc_write(":WAV:YINC?");
+  if(dl_thrd.get_error_num())
+  {
+    dl_thrd.get_error_str(str, 512);
+    goto OUT_ERROR;
+  }
 
-    usleep(20000);
+  progress.reset();
 
-    tmc_read();
+  mem_download_thread::restore_device(&devparms);
 
-    devparms.yinc[chn] = atof(device->buf);
+  statusLabel->setText("Downloading finished");
 
-    if(devparms.yinc[chn] < 1e-6)
-    {
-      snprintf(str, 512, "Error, parameter \"YINC\" out of range for channel %i: %e  line %i file %s", chn, devparms.yinc[chn], __LINE__, __FILE__);
-      goto OUT_ERROR;
-    }
+  new UI_wave_window(&devparms, wavbuf, this);
 
-    usleep(20000);
+  disconnect(&dl_thrd, 0, 0, 0);
 
-    tmc_write(":WAV:YREF?");
+  scrn_timer->start(devparms.screentimerival);
 
-    usleep(20000);
+  return;
 
-    tmc_read();
+OUT_ERROR:
 
-    yref[chn] = atoi(device->buf);
+  disconnect(&dl_thrd, 0, 0, 0);
 
-    if((yref[chn] < 1) || (yref[chn] > 255))
-    {
-      snprintf(str, 512, "Error, parameter \"YREF\" out of range for channel %i: %i  line %i file %s", chn, yref[chn], __LINE__, __FILE__);
-      goto OUT_ERROR;
-    }
-
-    usleep(20000);
+  progress.reset();
 
-    tmc_write(":WAV:YOR?");
+  statusLabel->setText("Downloading aborted");
 
-    usleep(20000);
+  if(progress.wasCanceled() == false)
+  {
+    QMessageBox msgBox;
+    msgBox.setIcon(QMessageBox::Critical);
+    msgBox.setText(str);
+    msgBox.exec();
+  }
 
-    tmc_read();
+  mem_download_thread::restore_device(&devparms);
 
-    devparms.yor[chn] = atoi(device->buf);
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    free(wavbuf[chn]);
+    wavbuf[chn] = NULL;
+  }
 
-    if((devparms.yor[chn] < -32000) || (devparms.yor[chn] > 32000))
-    {
-      snprintf(str, 512, "Error, parameter \"YOR\" out of range for channel %i: %i  line %i file %s", chn, devparms.yor[chn], __LINE__, __FILE__);
-      goto OUT_ERROR;
-    }
+  scrn_timer->start(devparms.screentimerival);
+}
 
-//     printf("yinc[%i] : %f\n", chn, devparms.yinc[chn]);
-//     printf("yref[%i] : %i\n", chn, yref[chn]);
-//     printf("yor[%i]  : %i\n", chn, devparms.yor[chn]);
 
-    empty_buf = 0;
+void UI_Mainwindow::save_wave_inspector_buffer_to_edf(struct device_settings *d_parms)
+{
+  int i,
+      chns=0,
+      hdl=-1,
+      smps_per_record=0,
+      datrecs=1,
+      ret_stat;
 
-    for(bytes_rcvd=0; bytes_rcvd<mempnts ;)
-    {
-      progress.setValue(bytes_rcvd);
+  char str[512],
+       opath[MAX_PATHLEN];
 
-      if(progress.wasCanceled())
-      {
-        strlcpy(str, "Canceled", 512);
-        goto OUT_ERROR;
-      }
+  QMessageBox wi_msg_box;
 
-      snprintf(str, 512, ":WAV:STAR %i",  bytes_rcvd + 1);
+  save_data_thread sav_data_thrd(1);
 
-      usleep(20000);
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    if(!d_parms->chandisplay[i])
+    {
+      continue;
+    }
 
-      tmc_write(str);
+    chns++;
+  }
 
-      if((bytes_rcvd + SAV_MEM_BSZ) > mempnts)
-      {
-        snprintf(str, 512, ":WAV:STOP %i", mempnts);
-      }
-      else
-      {
-        snprintf(str, 512, ":WAV:STOP %i", bytes_rcvd + SAV_MEM_BSZ);
-      }
+  if(!chns)
+  {
+    strlcpy(str, "No active channels.", 512);
+    goto OUT_ERROR;
+  }
 
-      usleep(20000);
+  opath[0] = 0;
+  if(recent_savedir[0]!=0)
+  {
+    strlcpy(opath, recent_savedir, MAX_PATHLEN);
+    strlcat(opath, "/", MAX_PATHLEN);
+  }
+  strlcat(opath, "waveform.edf", MAX_PATHLEN);
 
-      tmc_write(str);
+  strlcpy(opath, QFileDialog::getSaveFileName(this, "Save file", opath, "EDF files (*.edf *.EDF)").toLocal8Bit().data(), MAX_PATHLEN);
 
-      usleep(20000);
+  if(!strcmp(opath, ""))
+  {
+    goto OUT_NORMAL;
+  }
 
-      tmc_write(":WAV:DATA?");
+  get_directory_from_path(recent_savedir, opath, MAX_PATHLEN);
 
-      get_data_thrd.start();
+  hdl = save_data_thread::create_memory_edf_file(d_parms, opath, &datrecs, &smps_per_record, str, 512);
+  if(hdl < 0)
+  {
+    goto OUT_ERROR;
+  }
 
-      ev_loop.exec();
+  statusLabel->setText("Saving EDF file...");
 
-      n = get_data_thrd.get_num_bytes_rcvd();
-      if(n < 0)
-      {
-        snprintf(str, 512, "Can not read from device.  line %i file %s", __LINE__, __FILE__);
-        goto OUT_ERROR;
-      }
+  sav_data_thrd.init_save_memory_edf_file(d_parms, hdl, datrecs, smps_per_record, d_parms->wavebuf);
 
-      if(n == 0)
-      {
-        snprintf(str, 512, "No waveform data available.");
-        goto OUT_ERROR;
-      }
+  wi_msg_box.setIcon(QMessageBox::NoIcon);
+  wi_msg_box.setText("Saving EDF file ...");
+  wi_msg_box.setStandardButtons(QMessageBox::Abort);
 
-      printf("received %i bytes, total %i bytes\n", n, n + bytes_rcvd);
+  connect(&sav_data_thrd, SIGNAL(finished()), &wi_msg_box, SLOT(accept()));
 
-      if(n > SAV_MEM_BSZ)
-      {
-        snprintf(str, 512, "Datablock too big for buffer: %i  line %i file %s", n, __LINE__, __FILE__);
-        goto OUT_ERROR;
-      }
+  sav_data_thrd.start();
 
-      if(n < 1)
-      {
-        if(empty_buf++ > 100)
-        {
-          break;
-        }
-      }
-      else
-      {
-        empty_buf = 0;
-      }
+  ret_stat = wi_msg_box.exec();
 
-      for(k=0; k<n; k++)
-      {
-        if((bytes_rcvd + k) >= mempnts)
-        {
-          break;
-        }
+  if(ret_stat != QDialog::Accepted)
+  {
+    strlcpy(str, "Saving EDF file aborted.", 512);
+    goto OUT_ERROR;
+  }
 
-        wavbuf[chn][bytes_rcvd + k] = ((int)(((unsigned char *)device->buf)[k])) - yref[chn] - devparms.yor[chn];
-      }
+  if(sav_data_thrd.get_error_num())
+  {
+    sav_data_thrd.get_error_str(str, 512);
+    goto OUT_ERROR;
+  }
 
-      bytes_rcvd += n;
+OUT_NORMAL:
 
-      if(bytes_rcvd >= mempnts)
-      {
-        break;
-      }
-    }
+  disconnect(&sav_data_thrd, 0, 0, 0);
 
-    if(bytes_rcvd < mempnts)
+  if(hdl >= 0)
+  {
+    if(edfclose_file(hdl))
     {
-      snprintf(str, 512, "Download error.  line %i file %s", __LINE__, __FILE__);
+      hdl = -1;
+
+      strlcpy(str, "A file write error occurred.", 512);
       goto OUT_ERROR;
     }
   }
 
-  progress.reset();
-
-  for(chn=0; chn<MAX_CHNS; chn++)
+  if(!strcmp(opath, ""))
   {
-    if(!devparms.chandisplay[chn])
-    {
-      continue;
-    }
+    statusLabel->setText("Save file canceled.");
+  }
+  else
+  {
+    statusLabel->setText("Saved memory buffer to EDF file.");
+  }
 
-    snprintf(str, 512, ":WAV:SOUR CHAN%i", chn + 1);
+  return;
 
-    usleep(20000);
+OUT_ERROR:
 
-    tmc_write(str);
+  disconnect(&sav_data_thrd, 0, 0, 0);
 
-    usleep(20000);
+  statusLabel->setText("Saving file aborted.");
 
-    tmc_write(":WAV:MODE NORM");
+  if(hdl >= 0)
+  {
+    edfclose_file(hdl);
+  }
 
-    usleep(20000);
+  wi_msg_box.setIcon(QMessageBox::Critical);
+  wi_msg_box.setText(str);
+  wi_msg_box.setStandardButtons(QMessageBox::Ok);
+  wi_msg_box.exec();
+}
 
-    tmc_write(":WAV:STAR 1");
 
-    if(devparms.modelserie == 1)
-    {
-      usleep(20000);
+void UI_Mainwindow::save_wave_inspector_buffer_to_raw(struct device_settings *d_parms)
+{
+  int ret_stat;
 
-      tmc_write(":WAV:STOP 1200");
-    }
-    else
-    {
-      usleep(20000);
+  char str[512],
+       opath[MAX_PATHLEN];
+
+  QMessageBox wi_msg_box;
 
-      tmc_write(":WAV:STOP 1400");
+  struct rawcap_file raw_file;
 
-      usleep(20000);
+  save_data_thread sav_data_thrd(2);
 
-      tmc_write(":WAV:POIN 1400");
-    }
+  opath[0] = 0;
+  if(recent_savedir[0]!=0)
+  {
+    strlcpy(opath, recent_savedir, MAX_PATHLEN);
+    strlcat(opath, "/", MAX_PATHLEN);
   }
+  strlcat(opath, "waveform.dscap", MAX_PATHLEN);
 
-  if(bytes_rcvd < mempnts)
+  strlcpy(opath, QFileDialog::getSaveFileName(this, "Save file", opath, "Capture files (*.dscap *.DSCAP)").toLocal8Bit().data(), MAX_PATHLEN);
+
+  if(!strcmp(opath, ""))
   {
-    snprintf(str, 512, "Download error.  line %i file %s", __LINE__, __FILE__);
-    goto OUT_ERROR;
+    statusLabel->setText("Save file canceled.");
+    return;
   }
-  else
+
+  get_directory_from_path(recent_savedir, opath, MAX_PATHLEN);
+
+  if(save_data_thread::create_memory_raw_file(d_parms, opath, RAWCAP_FMT_S16, &raw_file, str, 512))
   {
-    statusLabel->setText("Downloading finished");
+    goto OUT_ERROR;
   }
 
-  new UI_wave_window(&devparms, wavbuf, this);
+  statusLabel->setText("Saving capture file...");
 
-  disconnect(&get_data_thrd, 0, 0, 0);
+  sav_data_thrd.init_save_memory_raw_file(d_parms, &raw_file, d_parms->wavebuf);
 
-  scrn_timer->start(devparms.screentimerival);
+  wi_msg_box.setIcon(QMessageBox::NoIcon);
+  wi_msg_box.setText("Saving capture file ...");
+  wi_msg_box.setStandardButtons(QMessageBox::NoButton);
+
+  connect(&sav_data_thrd, SIGNAL(finished()), &wi_msg_box, SLOT(accept()));
+
+  sav_data_thrd.start();
+
+  ret_stat = wi_msg_box.exec();
+
+  sav_data_thrd.wait();  // the thread closes the file
+
+  disconnect(&sav_data_thrd, 0, 0, 0);
+
+  if((ret_stat != QDialog::Accepted) || sav_data_thrd.get_error_num())
+  {
+    sav_data_thrd.get_error_str(str, 512);
+    unlink(opath);
+    goto OUT_ERROR;
+  }
+
+  statusLabel->setText("Saved memory buffer to capture file.");
 
   return;
 
 OUT_ERROR:
 
-  disconnect(&get_data_thrd, 0, 0, 0);
+  statusLabel->setText("Saving file aborted.");
 
-  progress.reset();
+  wi_msg_box.setIcon(QMessageBox::Critical);
+  wi_msg_box.setText(str);
+  wi_msg_box.setStandardButtons(QMessageBox::Ok);
+  wi_msg_box.exec();
+}
 
-  statusLabel->setText("Downloading aborted");
 
-  if(get_data_thrd.isRunning() == true)
-  {
-    QMessageBox w_msg_box;
-    w_msg_box.setIcon(QMessageBox::NoIcon);
-    w_msg_box.setText("Waiting for thread to finish, please wait...");
-    w_msg_box.setStandardButtons(QMessageBox::Abort);
+/* writes a capture file saved earlier, by the Wave Inspector or by dsremote-cli, to an EDF file */
+void UI_Mainwindow::export_capture_to_edf()
+{
+  char str[512],
+       ipath[MAX_PATHLEN],
+       opath[MAX_PATHLEN];
 
-    connect(&get_data_thrd, SIGNAL(finished()), &w_msg_box, SLOT(accept()));
+  QMessageBox msg_box;
 
-    w_msg_box.exec();
-  }
+  save_data_thread sav_data_thrd(3);
 
-  if(progress.wasCanceled() == false)
+  strlcpy(ipath, QFileDialog::getOpenFileName(this, "Open capture file", recent_savedir, "Capture files (*.dscap *.DSCAP)").toLocal8Bit().data(), MAX_PATHLEN);
+
+  if(!strcmp(ipath, ""))
   {
-    QMessageBox msgBox;
-    msgBox.setIcon(QMessageBox::Critical);
-    msgBox.setText(str);
-    msgBox.exec();
+    return;
   }
 
-  for(chn=0; chn<MAX_CHNS; chn++)
+  get_directory_from_path(recent_savedir, ipath, MAX_PATHLEN);
+
+  strlcpy(opath, ipath, MAX_PATHLEN);
+
+  remove_extension_from_filename(opath);
+
+  strlcat(opath, ".edf", MAX_PATHLEN);
+
+  strlcpy(opath, QFileDialog::getSaveFileName(this, "Save file", opath, "EDF files (*.edf *.EDF)").toLocal8Bit().data(), MAX_PATHLEN);
+
+  if(!strcmp(opath, ""))
   {
-    if(!devparms.chandisplay[chn])
-    {
-      continue;
-    }
+    return;
+  }
 
-    snprintf(str, 512, ":WAV:SOUR CHAN%i", chn + 1);
+  statusLabel->setText("Exporting capture file...");
 
-    tmc_write(str);
+  sav_data_thrd.init_export_raw_file(ipath, opath);
 
-    tmc_write(":WAV:MODE NORM");
+  msg_box.setIcon(QMessageBox::NoIcon);
+  msg_box.setText("Exporting capture file ...");
+  msg_box.setStandardButtons(QMessageBox::NoButton);
 
-    tmc_write(":WAV:STAR 1");
+  connect(&sav_data_thrd, SIGNAL(finished()), &msg_box, SLOT(accept()));
 
-    if(devparms.modelserie == 1)
-    {
-      tmc_write(":WAV:STOP 1200");
-    }
-    else
-    {
-      tmc_write(":WAV:STOP 1400");
+  sav_data_thrd.start();
 
-      tmc_write(":WAV:POIN 1400");
-    }
-  }
+  msg_box.exec();
 
-  for(chn=0; chn<MAX_CHNS; chn++)
+  sav_data_thrd.wait();
+
+  disconnect(&sav_data_thrd, 0, 0, 0);
+
+  if(sav_data_thrd.get_error_num())
   {
-    free(wavbuf[chn]);
-    wavbuf[chn] = NULL;
+    sav_data_thrd.get_error_str(str, 512);
+
+    statusLabel->setText("Export aborted.");
+
+    msg_box.setIcon(QMessageBox::Critical);
+    msg_box.setText(str);
+    msg_box.setStandardButtons(QMessageBox::Ok);
+    msg_box.exec();
+
+    return;
   }
 
-  scrn_timer->start(devparms.screentimerival);
+  statusLabel->setText("Exported capture file to EDF file.");
 }
 
 
-void UI_Mainwindow::save_wave_inspector_buffer_to_edf(struct device_settings *d_parms)
+/*
+ * Opens a capture file (.dscap) or an EDF file saved by DSRemote in the Wave Inspector,
+ * no connection to the device is needed.
+ */
+void UI_Mainwindow::open_capture_file()
 {
-  int i, j,
-      chn,
-      chns=0,
-      hdl=-1,
-      mempnts,
-      smps_per_record,
-      datrecs=1,
-      ret_stat;
+  int chn, highest=0;
 
   char str[512],
-       opath[MAX_PATHLEN];
+       ipath[MAX_PATHLEN];
 
-  long long rec_len=0LL,
-            datrecduration;
+  double dtmp;
 
-  QMessageBox wi_msg_box;
+  short *wavbuf[MAX_CHNS];
 
-  save_data_thread sav_data_thrd(1);
+  struct capview *view=NULL;
 
-  mempnts = d_parms->acquirememdepth;
+  struct device_settings *d_parms=NULL;
 
-  smps_per_record = mempnts;
+  UI_wave_window *w_window;
 
-  for(i=0; i<MAX_CHNS; i++)
-  {
-    if(!d_parms->chandisplay[i])
-    {
-      continue;
-    }
+  strlcpy(ipath, QFileDialog::getOpenFileName(this, "Open capture file", recent_savedir,
+          "Capture files (*.dscap *.DSCAP *.edf *.EDF)").toLocal8Bit().data(), MAX_PATHLEN);
 
-    chns++;
-  }
-
-  if(!chns)
+  if(!strcmp(ipath, ""))
   {
-    strlcpy(str, "No active channels.", 512);
-    goto OUT_ERROR;
-  }
-
-  while(smps_per_record >= (5000000 / chns))
-  {
-    smps_per_record /= 2;
-
-    datrecs *= 2;
+    return;
   }
 
-  rec_len = (EDFLIB_TIME_DIMENSION * (long long)mempnts) / d_parms->samplerate;
+  get_directory_from_path(recent_savedir, ipath, MAX_PATHLEN);
 
-  if(rec_len < 100)
+  view = (struct capview *)calloc(1, sizeof(struct capview));
+  d_parms = (struct device_settings *)calloc(1, sizeof(struct device_settings));
+  if((view == NULL) || (d_parms == NULL))
   {
-    strlcpy(str, "Can not save waveforms shorter than 10 uSec.\n"
-                "Select a higher memory depth or a higher timebase.", 512);
+    snprintf(str, 512, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    free(view);
+    view = NULL;
     goto OUT_ERROR;
   }
 
-  opath[0] = 0;
-  if(recent_savedir[0]!=0)
+  if(capview_open(view, ipath, str, 512))
   {
-    strlcpy(opath, recent_savedir, MAX_PATHLEN);
-    strlcat(opath, "/", MAX_PATHLEN);
+    free(view);
+    view = NULL;
+    goto OUT_ERROR;
   }
-  strlcat(opath, "waveform.edf", MAX_PATHLEN);
 
-  strlcpy(opath, QFileDialog::getSaveFileName(this, "Save file", opath, "EDF files (*.edf *.EDF)").toLocal8Bit().data(), MAX_PATHLEN);
-
-  if(!strcmp(opath, ""))
+  if(view->smps < 2)
   {
-    goto OUT_NORMAL;
+    strlcpy(str, "The capture file contains no samples.", 512);
+    goto OUT_ERROR;
   }
 
-  get_directory_from_path(recent_savedir, opath, MAX_PATHLEN);
+  /* the display settings are the ones of the main window */
+  *d_parms = devparms;
 
-  hdl = edfopen_file_writeonly(opath, EDFLIB_FILETYPE_EDFPLUS, chns);
-  if(hdl < 0)
+  if(view->type == CAPVIEW_TYPE_RAW)
   {
-    strlcpy(str, "Can not create EDF file.", 512);
-    goto OUT_ERROR;
+    save_data_thread::raw_file_to_devparms(view->raw.hdr, d_parms);
   }
+  else
+  {
+    strlcpy(d_parms->modelname, view->model, 128);
 
-  statusLabel->setText("Saving EDF file...");
+    d_parms->samplerate = view->samplerate;
 
-  datrecduration = (rec_len / 10LL) / datrecs;
+    d_parms->acquirememdepth = view->smps;
 
-//  printf("rec_len: %lli   datrecs: %i   datrecduration: %lli\n", rec_len, datrecs, datrecduration);
+    d_parms->timebasedelayenable = 0;
 
-  if(datrecduration < 10000LL)
-  {
-    if(edf_set_micro_datarecord_duration(hdl, datrecduration))
-    {
-      snprintf(str, 512, "Can not set datarecord duration of EDF file: %lli", datrecduration);
-      printf("\ndebug line %i: rec_len: %lli   datrecs: %i   datrecduration: %lli\n", __LINE__, rec_len, datrecs, datrecduration);
-      goto OUT_ERROR;
-    }
-  }
-  else
-  {
-    if(edf_set_datarecord_duration(hdl, datrecduration / 10LL))
-    {
-      snprintf(str, 512, "Can not set datarecord duration of EDF file: %lli", datrecduration);
-      printf("\ndebug line %i: rec_len: %lli   datrecs: %i   datrecduration: %lli\n", __LINE__, rec_len, datrecs, datrecduration);
-      goto OUT_ERROR;
-    }
-  }
+    d_parms->timebaseoffset = 0;  // the trigger position is not in an EDF file
 
-  j = 0;
+    d_parms->timebasescale = round_down_step125(((double)view->smps / view->samplerate) / d_parms->hordivisions, NULL);
 
-  for(chn=0; chn<MAX_CHNS; chn++)
-  {
-    if(!d_parms->chandisplay[chn])
+    for(chn=0; chn<MAX_CHNS; chn++)
     {
-      continue;
-    }
+      d_parms->chandisplay[chn] = (view->buf[chn] != NULL) ? 1 : 0;
 
-    edf_set_samplefrequency(hdl, j, smps_per_record);
-    edf_set_digital_maximum(hdl, j, 32767);
-    edf_set_digital_minimum(hdl, j, -32768);
-    if(d_parms->chanscale[chn] > 2)
-    {
-      edf_set_physical_maximum(hdl, j, d_parms->yinc[chn] * 32767.0);
-      edf_set_physical_minimum(hdl, j, d_parms->yinc[chn] * -32768.0);
-      edf_set_physical_dimension(hdl, j, "V");
-    }
-    else
-    {
-      edf_set_physical_maximum(hdl, j, 1000.0 * d_parms->yinc[chn] * 32767.0);
-      edf_set_physical_minimum(hdl, j, 1000.0 * d_parms->yinc[chn] * -32768.0);
-      edf_set_physical_dimension(hdl, j, "mV");
-    }
-    snprintf(str, 512, "CHAN%i", chn + 1);
-    edf_set_label(hdl, j, str);
+      if(!d_parms->chandisplay[chn])
+      {
+        continue;
+      }
 
-    j++;
-  }
+      highest = chn + 1;
 
-  edf_set_equipment(hdl, d_parms->modelname);
+      d_parms->yinc[chn] = view->yinc[chn];
 
-//  printf("datrecs: %i    smps_per_record: %i\n", datrecs, smps_per_record);
+      d_parms->yor[chn] = 0;
 
-  sav_data_thrd.init_save_memory_edf_file(d_parms, hdl, datrecs, smps_per_record, d_parms->wavebuf);
+      d_parms->chanoffset[chn] = 0;
 
-  wi_msg_box.setIcon(QMessageBox::NoIcon);
-  wi_msg_box.setText("Saving EDF file ...");
-  wi_msg_box.setStandardButtons(QMessageBox::Abort);
+      d_parms->chaninvert[chn] = 0;
 
-  connect(&sav_data_thrd, SIGNAL(finished()), &wi_msg_box, SLOT(accept()));
+      if(view->scale[chn] > 0)
+      {
+        d_parms->chanscale[chn] = view->scale[chn];
 
-  sav_data_thrd.start();
+        continue;
+      }
 
-  ret_stat = wi_msg_box.exec();
+      /* not saved by this version, the smallest vertical scale that shows the physical range */
+      dtmp = view->range[chn] / d_parms->vertdivisions;
 
-  if(ret_stat != QDialog::Accepted)
-  {
-    strlcpy(str, "Saving EDF file aborted.", 512);
-    goto OUT_ERROR;
+      for(d_parms->chanscale[chn]=1e-3; (d_parms->chanscale[chn] < dtmp) && (d_parms->chanscale[chn] < 100); )
+      {
+        d_parms->chanscale[chn] = round_up_step125(d_parms->chanscale[chn], NULL);
+      }
+    }
+
+    if(d_parms->channel_cnt < highest)
+    {
+      d_parms->channel_cnt = (highest > 2) ? 4 : 2;
+    }
   }
 
-  if(sav_data_thrd.get_error_num())
+  /* the screen must fit in the memory */
+  while((d_parms->timebasescale * d_parms->hordivisions) > ((double)view->smps / view->samplerate))
   {
-    sav_data_thrd.get_error_str(str, 512);
-    goto OUT_ERROR;
+    d_parms->timebasescale = round_down_step125(d_parms->timebasescale, NULL);
   }
 
-OUT_NORMAL:
+  /* the decoder and the FFT settings belong to the connected device */
+  d_parms->math_decode_display = 0;
 
-  disconnect(&sav_data_thrd, 0, 0, 0);
+  d_parms->math_fft = 0;
 
-  if(hdl >= 0)
+  for(chn=0; chn<MAX_CHNS; chn++)
   {
-    edfclose_file(hdl);
+    wavbuf[chn] = view->buf[chn];
   }
 
-  if(!strcmp(opath, ""))
-  {
-    statusLabel->setText("Save file canceled.");
-  }
-  else
-  {
-    statusLabel->setText("Saved memory buffer to EDF file.");
-  }
+  w_window = new UI_wave_window(d_parms, wavbuf, this, view);
 
-  return;
+  snprintf(str, 512, "Wave Inspector - %s", ipath);
 
-OUT_ERROR:
+  w_window->setWindowTitle(str);
 
-  disconnect(&sav_data_thrd, 0, 0, 0);
+  free(d_parms);
 
-  statusLabel->setText("Saving file aborted.");
+  statusLabel->setText("Opened capture file");
 
-  if(hdl >= 0)
+  return;
+
+OUT_ERROR:
+
+  if(view != NULL)
   {
-    edfclose_file(hdl);
+    capview_close(view);
+
+    free(view);
   }
 
-  wi_msg_box.setIcon(QMessageBox::Critical);
-  wi_msg_box.setText(str);
-  wi_msg_box.setStandardButtons(QMessageBox::Ok);
-  wi_msg_box.exec();
+  free(d_parms);
+
+  statusLabel->setText("Can not open capture file");
+
+  QMessageBox msgBox;
+  msgBox.setIcon(QMessageBox::Critical);
+  msgBox.setText(str);
+  msgBox.exec();
 }
 
 
@@ -853,6 +852,8 @@ void UI_Mainwindow::save_screen_waveform()
 
   short *wavbuf[MAX_CHNS];
 
+  unsigned char *raw;
+
   long long rec_len=0LL;
 
   if(device == NULL)
@@ -874,7 +875,7 @@ void UI_Mainwindow::save_screen_waveform()
 
   scrn_timer->stop();
 
-  scrn_thread->wait();
+  scrn_thread->stop_streaming();
 
   if(devparms.timebasedelayenable)
   {
@@ -983,6 +984,10 @@ void UI_Mainwindow::save_screen_waveform()
       goto OUT_ERROR;
     }
 
+    raw = (unsigned char *)wavbuf[chn] + WAVFRM_MAX_BUFSZ;  // upper half of the buffer, widened in place below
+
+    get_data_thrd.set_block_dest((char *)raw, WAVFRM_MAX_BUFSZ);
+
     usleep(20000);
 
     tmc_write(":WAV:DATA?");
@@ -1019,10 +1024,7 @@ void UI_Mainwindow::save_screen_waveform()
       goto OUT_ERROR;
     }
 
-    for(i=0; i<n; i++)
-    {
-      wavbuf[chn][i] = ((int)(((unsigned char *)device->buf)[i]) - yref[chn] - devparms.yor[chn]) << 5;
-    }
+    wavcnv_u8_to_s16(wavbuf[chn], raw, n, yref[chn] + devparms.yor[chn], 5);
   }
 
   opath[0] = 0;
@@ -49,6 +49,16 @@ save_data_thread::save_data_thread(int job_s)
   datrecs = 0;
 
   smps_per_record = 0;
+
+  blk_dest = NULL;
+
+  blk_dest_sz = 0;
+
+  raw_file = NULL;
+
+  raw_path[0] = 0;
+
+  edf_path[0] = 0;
 }
 
 
@@ -70,6 +80,15 @@ int save_data_thread::get_num_bytes_rcvd(void)
 }
 
 
+/* When set, read_data() receives the block response directly into dest instead of device->buf. */
+void save_data_thread::set_block_dest(char *dest, int sz)
+{
+  blk_dest = dest;
+
+  blk_dest_sz = sz;
+}
+
+
 void save_data_thread::run()
 {
   err_str[0] = 0;
@@ -80,6 +99,10 @@ void save_data_thread::run()
             break;
     case 1: save_memory_edf_file();
             break;
+    case 2: save_memory_raw_file();
+            break;
+    case 3: err_num = export_raw_file_to_edf(raw_path, edf_path, err_str, 4096) ? 1 : 0;
+            break;
     default: err_num = -4;
             break;
   }
@@ -90,7 +113,14 @@ void save_data_thread::read_data(void)
 {
   msleep(100);
 
-  n_bytes_rcvd = tmc_read();
+  if(blk_dest != NULL)
+  {
+    n_bytes_rcvd = tmc_read_block(blk_dest, blk_dest_sz);
+  }
+  else
+  {
+    n_bytes_rcvd = tmc_read();
+  }
 
   err_num = 0;
 }
@@ -112,6 +142,198 @@ void save_data_thread::init_save_memory_edf_file(struct device_settings *devp, i
 }
 
 
+/* wav: the buffers of the displayed channels, the file is written and closed by the thread */
+void save_data_thread::init_save_memory_raw_file(struct device_settings *devp, struct rawcap_file *f, short **wav)
+{
+  devparms = devp;
+
+  raw_file = f;
+
+  wavbuf = wav;
+}
+
+
+void save_data_thread::init_export_raw_file(const char *src, const char *dest)
+{
+  strlcpy(raw_path, src, MAX_PATHLEN);
+
+  strlcpy(edf_path, dest, MAX_PATHLEN);
+}
+
+
+/*
+ * Creates an EDF+ file for the deep memory of the displayed channels and writes the header.
+ * Returns the handle of the file, the number of datarecords and the samples per datarecord,
+ * the samples are written by save_memory_edf_file().
+ * Returns -1 in case of an error, the reason is in err.
+ */
+int save_data_thread::create_memory_edf_file(struct device_settings *d_parms, const char *path,
+                                             int *records, int *smpls, char *err, int err_sz)
+{
+  int j,
+      chn,
+      chns=0,
+      hdl_n,
+      mempnts,
+      smps=0,
+      recs=1;
+
+  char str[128];
+
+  long long rec_len=0LL,
+            datrecduration;
+
+  mempnts = d_parms->acquirememdepth;
+
+  smps = mempnts;
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!d_parms->chandisplay[chn])
+    {
+      continue;
+    }
+
+    chns++;
+  }
+
+  if(!chns)
+  {
+    strlcpy(err, "No active channels.", err_sz);
+    return -1;
+  }
+
+  if((mempnts < 1) || (d_parms->samplerate < 1))
+  {
+    strlcpy(err, "Unknown memory depth or samplerate.", err_sz);
+    return -1;
+  }
+
+  while(smps >= (5000000 / chns))
+  {
+    smps /= 2;
+
+    recs *= 2;
+  }
+
+  rec_len = (EDFLIB_TIME_DIMENSION * (long long)mempnts) / d_parms->samplerate;
+
+  if(rec_len < 100)
+  {
+    strlcpy(err, "Can not save waveforms shorter than 10 uSec.\n"
+                 "Select a higher memory depth or a higher timebase.", err_sz);
+    return -1;
+  }
+
+  /* replace instead of truncate, the Wave Inspector can have a mapping of the file open (capture_view) */
+  unlink(path);
+
+  hdl_n = edfopen_file_writeonly(path, EDFLIB_FILETYPE_EDFPLUS, chns);
+  if(hdl_n < 0)
+  {
+    strlcpy(err, "Can not create EDF file.", err_sz);
+    return -1;
+  }
+
+  /* no flush per datarecord, the file is synced once when it is closed */
+  if(edf_set_stream_buffer(hdl_n, SAV_EDF_STREAM_BSZ, d_parms->edf_direct ? EDFLIB_STREAM_DIRECT : 0))
+  {
+    printf("EDF: can not allocate the stream buffer, writing unbuffered\n");
+  }
+
+  datrecduration = (rec_len / 10LL) / recs;
+
+  if(datrecduration < 10000LL)
+  {
+    if(edf_set_micro_datarecord_duration(hdl_n, datrecduration))
+    {
+      snprintf(err, err_sz, "Can not set datarecord duration of EDF file: %lli", datrecduration);
+      printf("\ndebug line %i: rec_len: %lli   datrecs: %i   datrecduration: %lli\n", __LINE__, rec_len, recs, datrecduration);
+      edfclose_file(hdl_n);
+      return -1;
+    }
+  }
+  else
+  {
+    if(edf_set_datarecord_duration(hdl_n, datrecduration / 10LL))
+    {
+      snprintf(err, err_sz, "Can not set datarecord duration of EDF file: %lli", datrecduration);
+      printf("\ndebug line %i: rec_len: %lli   datrecs: %i   datrecduration: %lli\n", __LINE__, rec_len, recs, datrecduration);
+      edfclose_file(hdl_n);
+      return -1;
+    }
+  }
+
+  j = 0;
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!d_parms->chandisplay[chn])
+    {
+      continue;
+    }
+
+    edf_set_samplefrequency(hdl_n, j, smps);
+    edf_set_digital_maximum(hdl_n, j, 32767);
+    edf_set_digital_minimum(hdl_n, j, -32768);
+    if(d_parms->chanscale[chn] > 2)
+    {
+      edf_set_physical_maximum(hdl_n, j, d_parms->yinc[chn] * 32767.0);
+      edf_set_physical_minimum(hdl_n, j, d_parms->yinc[chn] * -32768.0);
+      edf_set_physical_dimension(hdl_n, j, "V");
+    }
+    else
+    {
+      edf_set_physical_maximum(hdl_n, j, 1000.0 * d_parms->yinc[chn] * 32767.0);
+      edf_set_physical_minimum(hdl_n, j, 1000.0 * d_parms->yinc[chn] * -32768.0);
+      edf_set_physical_dimension(hdl_n, j, "mV");
+    }
+    snprintf(str, 128, "CHAN%i", chn + 1);
+    edf_set_label(hdl_n, j, str);
+    snprintf(str, 128, "DSRemote scale %e V/div", d_parms->chanscale[chn]);  // read back by capture_view
+    edf_set_transducer(hdl_n, j, str);
+
+    j++;
+  }
+
+  edf_set_equipment(hdl_n, d_parms->modelname);
+
+  *records = recs;
+
+  *smpls = smps;
+
+  return hdl_n;
+}
+
+
+/*
+ * Sink for mem_pipeline, writes one datarecord of the file created by create_memory_edf_file().
+ * ctx points to the handle of the file, buf[] has smps_per_record samples for every
+ * displayed channel and NULL for the other channels.
+ */
+int save_data_thread::write_memory_edf_record(void *ctx, short **buf, int)
+{
+  int chn, hdl_n;
+
+  hdl_n = *((int *)ctx);
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(buf[chn] == NULL)
+    {
+      continue;
+    }
+
+    if(edfwrite_digital_short_samples(hdl_n, buf[chn]))
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
 void save_data_thread::save_memory_edf_file(void)
 {
   int i, chn;
@@ -160,10 +382,329 @@ void save_data_thread::save_memory_edf_file(void)
     }
   }
 
+  if(edf_sync_file(hdl))  // here instead of in edfclose_file() in the GUI thread
+  {
+    strlcpy(err_str, "A file write error occurred.", 4096);
+
+    err_num = 3;
+
+    return;
+  }
+
   err_num = 0;
 }
 
 
+void save_data_thread::save_memory_raw_file(void)
+{
+  if((devparms == NULL) || (raw_file == NULL))
+  {
+    strlcpy(err_str, "save_memory_raw_file(): Invalid parameters.", 4096);
+
+    err_num = 1;
+
+    return;
+  }
+
+  if(rawcap_write_segment(raw_file, wavbuf, devparms->acquirememdepth))
+  {
+    rawcap_close(raw_file);
+
+    strlcpy(err_str, "A file write error occurred.", 4096);
+
+    err_num = 3;
+
+    return;
+  }
+
+  if(rawcap_close(raw_file))  // syncs the file
+  {
+    strlcpy(err_str, "A file write error occurred.", 4096);
+
+    err_num = 3;
+
+    return;
+  }
+
+  err_num = 0;
+}
+
+
+/*
+ * Creates a raw capture file for the deep memory of the displayed channels,
+ * fmt is RAWCAP_FMT_S16 or RAWCAP_FMT_U8. The samples are written with write_memory_raw_record()
+ * or rawcap_write_segment(), rawcap_close() finishes the file.
+ * Returns 0 on success or -1 with the reason in err.
+ */
+int save_data_thread::create_memory_raw_file(struct device_settings *d_parms, const char *path, int fmt,
+                                             struct rawcap_file *f, char *err, int err_sz)
+{
+  int chn;
+
+  struct rawcap_hdr hdr;
+
+  if((d_parms->acquirememdepth < 1) || (d_parms->samplerate < 1))
+  {
+    strlcpy(err, "Unknown memory depth or samplerate.", err_sz);
+    return -1;
+  }
+
+  memset(&hdr, 0, sizeof(struct rawcap_hdr));
+
+  hdr.smp_fmt = fmt;
+
+  hdr.smps = d_parms->acquirememdepth;
+
+  hdr.capture_time = time(NULL);
+
+  hdr.samplerate = d_parms->samplerate;
+
+  /* the memory is centered on the screen, the trigger is timebaseoffset left of the center */
+  hdr.xorigin = d_parms->timebaseoffset - ((d_parms->acquirememdepth / d_parms->samplerate) / 2);
+
+  hdr.timebasescale = d_parms->timebasescale;
+
+  hdr.timebaseoffset = d_parms->timebaseoffset;
+
+  hdr.trig_source = d_parms->triggeredgesource;
+
+  hdr.trig_level = d_parms->triggeredgelevel[d_parms->triggeredgesource];
+
+  hdr.trig_slope = d_parms->triggeredgeslope;
+
+  hdr.hordivisions = d_parms->hordivisions;
+
+  hdr.vertdivisions = d_parms->vertdivisions;
+
+  hdr.channel_cnt = d_parms->channel_cnt;
+
+  hdr.modelserie = d_parms->modelserie;
+
+  strlcpy(hdr.model, d_parms->modelname, 64);
+
+  strlcpy(hdr.serial, d_parms->serialnr, 64);
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    if(!d_parms->chandisplay[chn])
+    {
+      continue;
+    }
+
+    hdr.chan[chn].captured = 1;
+    hdr.chan[chn].yinc = d_parms->yinc[chn];
+    hdr.chan[chn].yor = d_parms->yor[chn];
+    hdr.chan[chn].yref = d_parms->yref[chn];
+    hdr.chan[chn].scale = d_parms->chanscale[chn];
+    hdr.chan[chn].offset = d_parms->chanoffset[chn];
+    hdr.chan[chn].coupling = d_parms->chancoupling[chn];
+    hdr.chan[chn].bwlimit = d_parms->chanbwlimit[chn];
+    hdr.chan[chn].invert = d_parms->chaninvert[chn];
+    hdr.chan[chn].unit = d_parms->chanunit[chn];
+  }
+
+  return rawcap_create(f, path, &hdr, err, err_sz);
+}
+
+
+/* sink for mem_pipeline, ctx points to the struct rawcap_file of create_memory_raw_file() */
+int save_data_thread::write_memory_raw_record(void *ctx, short **buf, int cnt)
+{
+  return rawcap_write_segment((struct rawcap_file *)ctx, buf, cnt);
+}
+
+
+/* copies the settings of a raw capture file into d_parms, the other members are left as they are */
+void save_data_thread::raw_file_to_devparms(const struct rawcap_hdr *hdr, struct device_settings *d_parms)
+{
+  int chn;
+
+  strlcpy(d_parms->modelname, hdr->model, 128);
+
+  strlcpy(d_parms->serialnr, hdr->serial, 128);
+
+  d_parms->modelserie = hdr->modelserie;
+
+  d_parms->channel_cnt = hdr->channel_cnt;
+
+  /* out of range in a corrupt or foreign header, keep the current divisions */
+  if((hdr->hordivisions > 0) && (hdr->hordivisions <= 100))
+  {
+    d_parms->hordivisions = hdr->hordivisions;
+  }
+
+  if((hdr->vertdivisions > 0) && (hdr->vertdivisions <= 100))
+  {
+    d_parms->vertdivisions = hdr->vertdivisions;
+  }
+
+  d_parms->samplerate = hdr->samplerate;
+
+  d_parms->acquirememdepth = hdr->smps;
+
+  d_parms->timebasescale = hdr->timebasescale;
+
+  d_parms->timebaseoffset = hdr->timebaseoffset;
+
+  d_parms->timebasedelayenable = 0;
+
+  if((hdr->trig_source >= 0) && (hdr->trig_source < MAX_TRIG_SRCS))
+  {
+    d_parms->triggeredgesource = hdr->trig_source;
+
+    d_parms->triggeredgelevel[hdr->trig_source] = hdr->trig_level;
+  }
+
+  d_parms->triggeredgeslope = hdr->trig_slope;
+
+  for(chn=0; chn<MAX_CHNS; chn++)
+  {
+    d_parms->chandisplay[chn] = hdr->chan[chn].captured;
+
+    if(!hdr->chan[chn].captured)
+    {
+      continue;
+    }
+
+    d_parms->yinc[chn] = hdr->chan[chn].yinc;
+    d_parms->yor[chn] = hdr->chan[chn].yor;
+    d_parms->yref[chn] = hdr->chan[chn].yref;
+    d_parms->chanscale[chn] = hdr->chan[chn].scale;
+    d_parms->chanoffset[chn] = hdr->chan[chn].offset;
+    d_parms->chancoupling[chn] = hdr->chan[chn].coupling;
+    d_parms->chanbwlimit[chn] = hdr->chan[chn].bwlimit;
+    d_parms->chaninvert[chn] = hdr->chan[chn].invert;
+    d_parms->chanunit[chn] = hdr->chan[chn].unit;
+  }
+}
+
+
+/*
+ * Writes the samples of a raw capture file to a new EDF+ file.
+ * Returns 0 on success or -1 with the reason in err.
+ */
+int save_data_thread::export_raw_file_to_edf(const char *src, const char *dest, char *err, int err_sz)
+{
+  int i, j, chn, hdl=-1, datrecs, smps_per_record, ofs;
+
+  short *cnv_buf=NULL;
+
+  const unsigned char *src8;
+
+  struct rawcap_file f;
+
+  struct device_settings *d_parms=NULL;
+
+  if(rawcap_open(&f, src, err, err_sz))
+  {
+    return -1;
+  }
+
+  if(f.hdr->smps > 0x7fffffffLL)
+  {
+    strlcpy(err, "The capture is too large for an EDF file.", err_sz);
+    goto OUT_ERROR;
+  }
+
+  d_parms = (struct device_settings *)calloc(1, sizeof(struct device_settings));
+  if(d_parms == NULL)
+  {
+    snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+    goto OUT_ERROR;
+  }
+
+  raw_file_to_devparms(f.hdr, d_parms);
+
+  hdl = create_memory_edf_file(d_parms, dest, &datrecs, &smps_per_record, err, err_sz);
+  if(hdl < 0)
+  {
+    goto OUT_ERROR;
+  }
+
+  if(f.hdr->smp_fmt == RAWCAP_FMT_U8)
+  {
+    cnv_buf = (short *)malloc(smps_per_record * sizeof(short));
+    if(cnv_buf == NULL)
+    {
+      snprintf(err, err_sz, "Malloc error.  line %i file %s", __LINE__, __FILE__);
+      goto OUT_ERROR;
+    }
+  }
+
+  madvise(f.map, f.sz, MADV_SEQUENTIAL);
+
+  for(i=0; i<datrecs; i++)
+  {
+    for(chn=0; chn<MAX_CHNS; chn++)
+    {
+      if(!d_parms->chandisplay[chn])
+      {
+        continue;
+      }
+
+      if(cnv_buf != NULL)
+      {
+        src8 = (const unsigned char *)rawcap_samples(&f, chn) + ((long long)i * smps_per_record);
+
+        ofs = d_parms->yref[chn] + d_parms->yor[chn];
+
+        for(j=0; j<smps_per_record; j++)
+        {
+          cnv_buf[j] = ((int)src8[j]) - ofs;
+        }
+
+        if(edfwrite_digital_short_samples(hdl, cnv_buf))
+        {
+          strlcpy(err, "A file write error occurred.", err_sz);
+          goto OUT_ERROR;
+        }
+      }
+      else  // the full digital range is used, edflib does not clip and does not write to the read-only mapping
+      {
+        if(edfwrite_digital_short_samples(hdl, (short *)rawcap_samples(&f, chn) + ((long long)i * smps_per_record)))
+        {
+          strlcpy(err, "A file write error occurred.", err_sz);
+          goto OUT_ERROR;
+        }
+      }
+    }
+  }
+
+  free(cnv_buf);
+
+  free(d_parms);
+
+  rawcap_close(&f);
+
+  if(edfclose_file(hdl))
+  {
+    strlcpy(err, "A file write error occurred.", err_sz);
+    unlink(dest);
+    return -1;
+  }
+
+  return 0;
+
+OUT_ERROR:
+
+  if(hdl >= 0)
+  {
+    edfclose_file(hdl);
+
+    unlink(dest);
+  }
+
+  free(cnv_buf);
+
+  free(d_parms);
+
+  rawcap_close(&f);
+
+  return -1;
+}
+
+
+
 
 
 
@@ -34,6 +34,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
 
 #include <QObject>
 #include <QThread>
@@ -43,8 +45,12 @@
 #include "connection.h"
 #include "tmc_dev.h"
 #include "edflib.h"
+#include "raw_capture.h"
 
 
+/* bytes of EDF datarecords collected before they are written to the file */
+#define SAV_EDF_STREAM_BSZ  (8388608)
+
 
 
 class save_data_thread : public QThread
@@ -58,8 +64,20 @@ public:
   int get_error_num(void);
   void get_error_str(char *, int);
   int get_num_bytes_rcvd(void);
+  void set_block_dest(char *, int);
   void init_save_memory_edf_file(struct device_settings *devp, int,
                                  int, int, short **wav);
+  void init_save_memory_raw_file(struct device_settings *devp, struct rawcap_file *, short **wav);
+  void init_export_raw_file(const char *, const char *);
+
+  static int create_memory_edf_file(struct device_settings *, const char *,
+                                    int *, int *, char *, int);
+  static int write_memory_edf_record(void *, short **, int);
+  static int create_memory_raw_file(struct device_settings *, const char *, int,
+                                    struct rawcap_file *, char *, int);
+  static int write_memory_raw_record(void *, short **, int);
+  static void raw_file_to_devparms(const struct rawcap_hdr *, struct device_settings *);
+  static int export_raw_file_to_edf(const char *, const char *, char *, int);
 
 private:
 
@@ -70,16 +88,25 @@ private:
       datrecs,
       smps_per_record;
 
-  char err_str[4096];
+  char err_str[4096],
+       raw_path[MAX_PATHLEN],
+       edf_path[MAX_PATHLEN];
+
+  char *blk_dest;
+
+  int blk_dest_sz;
 
   struct device_settings *devparms;
 
   short **wavbuf;
 
+  struct rawcap_file *raw_file;
+
   void run();
 
   void read_data(void);
   void save_memory_edf_file(void);
+  void save_memory_raw_file(void);
 };
 
 
@@ -0,0 +1,1301 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+/*
+ * dsremote-sim: a simulated DHO800/DHO900 on TCP port 5555.
+ *
+ * Implements the subset of SCPI that DSRemote uses, so the LAN transport,
+ * the settings readout and the deep-memory download can be benchmarked and
+ * debugged without an oscilloscope. The waveforms are synthetic and
+ * deterministic: the same settings always give the same samples.
+ *
+ * usage: dsremote-sim [options]
+ *
+ *  -p <port>        TCP port, default 5555
+ *  -m <model>       model in the *IDN? response, default DHO924S
+ *  -d <points>      memory depth, default 1000000
+ *  -B <bytes>       max. bytes per :WAV:DATA? block in RAW mode, default 1000000
+ *  -l <uSec>        latency added to every response, default 0
+ *  -b <bytes/Sec>   bandwidth of the responses, 0 = unlimited (default)
+ *  -t <mSec>        time between :SING and the trigger, default 20
+ *  -v               print every command
+ *
+ * Setters that are not simulated are stored and returned by the matching query.
+ * Headers are compared in their short form, ":CHANnel1:INVert?" equals ":CHAN1:INV?".
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "utils.h"
+
+
+
+#define SIM_CHNS               (4)
+
+#define SIM_HORDIVS           (10)
+#define SIM_SCRN_PNTS       (1000)  /* :WAV:MODE NORM */
+#define SIM_YREF             (127)
+#define SIM_MAX_SRATE     (1.25e9)
+
+#define SIM_SETTINGS_MAX     (512)
+#define SIM_HDR_LEN           (48)
+#define SIM_VAL_LEN           (64)
+
+#define SIM_CMD_LEN         (1024)
+#define SIM_PACE_CHUNK     (65536)
+
+#define SIM_BMP_W            (800)
+#define SIM_BMP_H            (480)
+#define SIM_BMP_SZ    (54 + (SIM_BMP_W * SIM_BMP_H * 3))
+
+#define SIM_STAT_RUN           (0)
+#define SIM_STAT_WAIT          (1)
+#define SIM_STAT_STOP          (2)
+
+
+
+struct sim_options
+{
+  int port;
+  char model[32];
+  int memdepth;
+  int blk_max;
+  int latency;
+  long long bandwidth;
+  int trig_delay;
+  int verbose;
+};
+
+struct sim_setting
+{
+  char hdr[SIM_HDR_LEN];
+  char val[SIM_VAL_LEN];
+};
+
+struct sim_state
+{
+  int run_stat;
+  long long arm_time;
+  int wav_src[SIM_CHNS];
+  int wav_src_cnt;
+  struct sim_setting settings[SIM_SETTINGS_MAX];
+  int setting_cnt;
+};
+
+
+/* the values DSRemote expects after *RST, as returned by the DHO800/DHO900 */
+static const char *sim_defaults[][2]=
+{
+  {":TIM:SCAL", "1.000000e-04"},
+  {":TIM:OFFS", "0.000000e+00"},
+  {":TIM:DEL:ENAB", "0"},
+  {":TIM:DEL:OFFS", "0.000000e+00"},
+  {":TIM:DEL:SCAL", "5.000000e-07"},
+  {":TIM:HREF:MODE", "CENT"},
+  {":TIM:HREF:POS", "0"},
+  {":TIM:MODE", "MAIN"},
+  {":TIM:VERN", "0"},
+  {":TIM:XY1:DISP", "0"},
+  {":TIM:XY2:DISP", "0"},
+  {":TRIG:COUP", "DC"},
+  {":TRIG:SWE", "AUTO"},
+  {":TRIG:MODE", "EDGE"},
+  {":TRIG:EDG:SLOP", "POS"},
+  {":TRIG:EDG:SOUR", "CHAN1"},
+  {":TRIG:EDG:LEV", "0.000000e+00"},
+  {":TRIG:HOLD", "8.000000e-09"},
+  {":ACQ:TYPE", "NORM"},
+  {":ACQ:AVER", "2"},
+  {":ACQ:MDEP", "AUTO"},
+  {":DISP:GRID", "FULL"},
+  {":DISP:TYPE", "VECT"},
+  {":DISP:GRAD:TIME", "MIN"},
+  {":MEAS:COUN:SOUR", "OFF"},
+  {":MEAS:COUN:VAL", "0.000000e+00"},
+  {":MATH:DISP", "0"},
+  {":MATH:OPER", "ADD"},
+  {":MATH:OFFS", "0.000000e+00"},
+  {":MATH:SCAL", "1.000000e+00"},
+  {":MATH:FFT:SOUR", "CHAN1"},
+  {":MATH:FFT:UNIT", "DB"},
+  {":MATH:FFT:SPL", "0"},
+  {":MATH:FFT:HSC", "5.000000e+06"},
+  {":MATH:FFT:HCEN", "2.500000e+07"},
+  {":MATH1:DISP", "0"},
+  {":MATH1:OPER", "ADD"},
+  {":MATH1:OFFS", "0.000000e+00"},
+  {":MATH1:SCAL", "1.000000e+00"},
+  {":MATH1:FFT:SOUR", "CHAN1"},
+  {":MATH1:FFT:UNIT", "DB"},
+  {":MATH1:FFT:HSC", "5.000000e+06"},
+  {":MATH1:FFT:HCEN", "2.500000e+07"},
+  {":CALC:MODE", "OFF"},
+  {":CALC:FFT:SOUR", "CHAN1"},
+  {":CALC:FFT:SPL", "FULL"},
+  {":CALC:FFT:VSM", "DB"},
+  {":CALC:FFT:HSP", "5.000000e+06"},
+  {":CALC:FFT:HSC", "1"},
+  {":CALC:FFT:HCEN", "2.500000e+07"},
+  {":CALC:FFT:VOFF", "0.000000e+00"},
+  {":CALC:FFT:VSC", "1.000000e+01"},
+  {":DEC1:MODE", "PAR"},
+  {":DEC1:DISP", "0"},
+  {":DEC1:FORM", "HEX"},
+  {":DEC1:POS", "350"},
+  {":DEC1:THRE:CHAN1", "0.000000e+00"},
+  {":DEC1:THRE:CHAN2", "0.000000e+00"},
+  {":DEC1:THRE:CHAN3", "0.000000e+00"},
+  {":DEC1:THRE:CHAN4", "0.000000e+00"},
+  {":DEC1:THRE:AUTO", "0"},
+  {":DEC1:UART:RX", "CHAN1"},
+  {":DEC1:UART:TX", "OFF"},
+  {":DEC1:UART:POL", "NEG"},
+  {":DEC1:UART:END", "LSB"},
+  {":DEC1:UART:BAUD", "9600"},
+  {":DEC1:UART:WIDT", "8"},
+  {":DEC1:UART:STOP", "1"},
+  {":DEC1:UART:PAR", "NONE"},
+  {":DEC1:SPI:CLK", "CHAN1"},
+  {":DEC1:SPI:MISO", "CHAN2"},
+  {":DEC1:SPI:MOSI", "OFF"},
+  {":DEC1:SPI:CS", "OFF"},
+  {":DEC1:SPI:SEL", "NCS"},
+  {":DEC1:SPI:MODE", "TIM"},
+  {":DEC1:SPI:TIM", "1.000000e-06"},
+  {":DEC1:SPI:POL", "POS"},
+  {":DEC1:SPI:EDGE", "RISE"},
+  {":DEC1:SPI:WIDT", "8"},
+  {":DEC1:SPI:END", "MSB"},
+  {":FUNC:WREC:ENAB", "0"},
+  {":FUNC:WREC:OPER", "STOP"},
+  {":FUNC:WREC:FEND", "1"},
+  {":FUNC:WREC:FMAX", "1"},
+  {":FUNC:WREC:FINT", "1.000000e-06"},
+  {":FUNC:WREP:OPER", "STOP"},
+  {":FUNC:WREP:FST", "1"},
+  {":FUNC:WREP:FEND", "1"},
+  {":FUNC:WREP:FMAX", "1"},
+  {":FUNC:WREP:FINT", "1.000000e-06"},
+  {":FUNC:WREP:FCUR", "1"},
+  {":FUNC:WRM", "OFF"},
+  {":WAV:MODE", "NORM"},
+  {":WAV:FORM", "BYTE"},
+  {":WAV:STAR", "1"},
+  {":WAV:STOP", "1000"},
+  {":WAV:POIN", "1000"},
+  {NULL, NULL}
+};
+
+/* per channel, ":CHANn" is prepended */
+static const char *sim_chan_defaults[][2]=
+{
+  {":BWL", "OFF"},
+  {":COUP", "DC"},
+  {":DISP", "0"},
+  {":IMP", "OMEG"},
+  {":INV", "0"},
+  {":OFFS", "0.000000e+00"},
+  {":PROB", "1.000000e+00"},
+  {":UNIT", "VOLT"},
+  {":SCAL", "1.000000e+00"},
+  {":VERN", "0"},
+  {NULL, NULL}
+};
+
+
+static struct sim_options opts;
+
+static struct sim_state state;
+
+static int clientfd=-1;
+
+static char *blk_buf=NULL;
+
+
+static long long sim_time_us(void);
+static void sim_short_hdr(const char *, char *, int);
+static const char *sim_get(const char *);
+static double sim_get_double(const char *);
+static void sim_set(const char *, const char *);
+static void sim_reset(void);
+static int sim_trig_stat(void);
+static int sim_memdepth(void);
+static double sim_samplerate(void);
+static int sim_sample(int, long long, double, double);
+static int sim_send(const char *, int);
+static int sim_send_block(const char *, int);
+static int sim_wav_data(void);
+static int sim_disp_data(void);
+static int sim_query(const char *, char *, int);
+static int sim_command(char *, char *, int);
+static int sim_line(char *);
+static int sim_serve(void);
+
+
+
+int main(int argc, char *argv[])
+{
+  int c, sockfd, on=1;
+
+  struct sockaddr_in addr;
+
+  opts.port = 5555;
+  strlcpy(opts.model, "DHO924S", 32);
+  opts.memdepth = 1000000;
+  opts.blk_max = 1000000;
+  opts.latency = 0;
+  opts.bandwidth = 0;
+  opts.trig_delay = 20;
+  opts.verbose = 0;
+
+  while((c = getopt(argc, argv, "p:m:d:B:l:b:t:v")) != -1)
+  {
+    switch(c)
+    {
+      case 'p': opts.port = atoi(optarg);
+                break;
+      case 'm': strlcpy(opts.model, optarg, 32);
+                break;
+      case 'd': opts.memdepth = atoi(optarg);
+                break;
+      case 'B': opts.blk_max = atoi(optarg);
+                break;
+      case 'l': opts.latency = atoi(optarg);
+                break;
+      case 'b': opts.bandwidth = atoll(optarg);
+                break;
+      case 't': opts.trig_delay = atoi(optarg);
+                break;
+      case 'v': opts.verbose = 1;
+                break;
+      default: fprintf(stderr, "usage: dsremote-sim [-p port] [-m model] [-d memdepth] [-B blocksize]"
+                               " [-l latency uSec] [-b bytes/Sec] [-t trigger delay mSec] [-v]\n");
+               return EXIT_FAILURE;
+    }
+  }
+
+  if((opts.port < 1) || (opts.port > 65535) || (opts.memdepth < SIM_SCRN_PNTS) ||
+     (opts.blk_max < 1000) || (opts.latency < 0) || (opts.bandwidth < 0) || (opts.trig_delay < 0))
+  {
+    fprintf(stderr, "dsremote-sim: invalid option value\n");
+    return EXIT_FAILURE;
+  }
+
+  blk_buf = (char *)malloc(opts.blk_max * SIM_CHNS + 16);
+  if(blk_buf == NULL)
+  {
+    fprintf(stderr, "dsremote-sim: malloc error\n");
+    return EXIT_FAILURE;
+  }
+
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  signal(SIGPIPE, SIG_IGN);
+
+  sim_reset();
+
+  sockfd = socket(PF_INET, SOCK_STREAM, 0);
+  if(sockfd == -1)
+  {
+    perror("dsremote-sim: socket()");
+    return EXIT_FAILURE;
+  }
+
+  setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (void *)&on, sizeof on);
+
+  memset(&addr, 0, sizeof(struct sockaddr_in));
+
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(opts.port);
+
+  if(bind(sockfd, (struct sockaddr *)&addr, sizeof(struct sockaddr_in)) ||
+     listen(sockfd, 1))
+  {
+    perror("dsremote-sim: bind()");
+    close(sockfd);
+    return EXIT_FAILURE;
+  }
+
+  printf("dsremote-sim: %s listening on port %i, memory depth %i\n", opts.model, opts.port, opts.memdepth);
+
+  while(1)  /* one client at a time, like the oscilloscope */
+  {
+    clientfd = accept(sockfd, NULL, NULL);
+    if(clientfd == -1)
+    {
+      if(errno == EINTR)  continue;
+
+      perror("dsremote-sim: accept()");
+      break;
+    }
+
+    setsockopt(clientfd, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof on);
+
+    printf("dsremote-sim: client connected\n");
+
+    sim_serve();
+
+    close(clientfd);
+
+    clientfd = -1;
+
+    printf("dsremote-sim: client disconnected\n");
+  }
+
+  close(sockfd);
+
+  free(blk_buf);
+
+  return EXIT_FAILURE;
+}
+
+
+static long long sim_time_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+
+/*
+ * Converts a header to its short form: ":CHANnel1:INVert" -> ":CHAN1:INV".
+ * Mixed case nodes are cut after the capitals, upper case nodes after
+ * four characters, or three when the fourth one is a vowel.
+ */
+static void sim_short_hdr(const char *src, char *dest, int sz)
+{
+  int i, j, len, upr, dig;
+
+  char node[SIM_HDR_LEN];
+
+  dest[0] = 0;
+
+  while(*src)
+  {
+    if((*src == ':') || (*src == '*'))
+    {
+      strlcat(dest, (*src == ':') ? ":" : "*", sz);
+
+      src++;
+
+      continue;
+    }
+
+    for(len=0; src[len] && (src[len] != ':') && (len < (SIM_HDR_LEN - 1)); len++)
+    {
+      node[len] = src[len];
+    }
+
+    node[len] = 0;
+
+    src += len;
+
+    while(*src && (*src != ':'))  src++;
+
+    for(dig=len; (dig > 0) && (node[dig - 1] >= '0') && (node[dig - 1] <= '9'); dig--);
+
+    for(upr=0; (upr < dig) && (node[upr] >= 'A') && (node[upr] <= 'Z'); upr++);
+
+    if((upr == dig) || (upr == 0))  /* no short form given by the case */
+    {
+      for(i=0; i<dig; i++)
+      {
+        if((node[i] >= 'a') && (node[i] <= 'z'))
+        {
+          node[i] -= 32;
+        }
+      }
+
+      upr = (dig > 4) ? 4 : dig;
+
+      if((upr == 4) && strchr("AEIOU", node[3]))  upr = 3;
+    }
+
+    for(i=upr, j=dig; j<=len; i++, j++)  /* keep the suffix and the terminating zero */
+    {
+      node[i] = node[j];
+    }
+
+    strlcat(dest, node, sz);
+  }
+}
+
+
+static const char *sim_get(const char *hdr)
+{
+  int i;
+
+  for(i=0; i<state.setting_cnt; i++)
+  {
+    if(!strcmp(state.settings[i].hdr, hdr))
+    {
+      return state.settings[i].val;
+    }
+  }
+
+  return NULL;
+}
+
+
+static double sim_get_double(const char *hdr)
+{
+  const char *val;
+
+  val = sim_get(hdr);
+
+  if(val == NULL)
+  {
+    return 0;
+  }
+
+  return atof(val);
+}
+
+
+static void sim_set(const char *hdr, const char *val)
+{
+  int i;
+
+  const char *old;
+
+  old = sim_get(hdr);
+
+  if(old != NULL)
+  {
+    if((!strcmp(old, "0")) || (!strcmp(old, "1")))  /* boolean, answered as 0 or 1 */
+    {
+      if(!strcmp(val, "ON"))  val = "1";
+
+      if(!strcmp(val, "OFF"))  val = "0";
+    }
+  }
+
+  for(i=0; i<state.setting_cnt; i++)
+  {
+    if(!strcmp(state.settings[i].hdr, hdr))
+    {
+      break;
+    }
+  }
+
+  if(i == state.setting_cnt)
+  {
+    if(state.setting_cnt >= SIM_SETTINGS_MAX)
+    {
+      return;
+    }
+
+    strlcpy(state.settings[i].hdr, hdr, SIM_HDR_LEN);
+
+    state.setting_cnt++;
+  }
+
+  strlcpy(state.settings[i].val, val, SIM_VAL_LEN);
+}
+
+
+static void sim_reset(void)
+{
+  int i, chn;
+
+  char hdr[SIM_HDR_LEN],
+       str[SIM_HDR_LEN];
+
+  state.setting_cnt = 0;
+
+  for(i=0; sim_defaults[i][0]!=NULL; i++)
+  {
+    sim_short_hdr(sim_defaults[i][0], hdr, SIM_HDR_LEN);
+
+    sim_set(hdr, sim_defaults[i][1]);
+  }
+
+  for(chn=0; chn<SIM_CHNS; chn++)
+  {
+    for(i=0; sim_chan_defaults[i][0]!=NULL; i++)
+    {
+      snprintf(str, SIM_HDR_LEN, ":CHAN%i%s", chn + 1, sim_chan_defaults[i][0]);
+
+      sim_short_hdr(str, hdr, SIM_HDR_LEN);
+
+      sim_set(hdr, sim_chan_defaults[i][1]);
+    }
+  }
+
+  sim_set(":CHAN1:DISP", "1");
+
+  state.run_stat = SIM_STAT_RUN;
+
+  state.arm_time = 0;
+
+  state.wav_src[0] = 0;
+
+  state.wav_src_cnt = 1;
+}
+
+
+/* returns SIM_STAT_xxx and fires the single shot when the trigger delay has passed */
+static int sim_trig_stat(void)
+{
+  if(state.run_stat == SIM_STAT_WAIT)
+  {
+    if((sim_time_us() - state.arm_time) >= (opts.trig_delay * 1000LL))
+    {
+      state.run_stat = SIM_STAT_STOP;
+    }
+  }
+
+  return state.run_stat;
+}
+
+
+static int sim_memdepth(void)
+{
+  const char *val;
+
+  val = sim_get(":ACQ:MDEP");
+
+  if((val == NULL) || (atoi(val) < SIM_SCRN_PNTS))
+  {
+    return opts.memdepth;
+  }
+
+  return atoi(val);
+}
+
+
+static double sim_samplerate(void)
+{
+  double srate;
+
+  srate = sim_memdepth() / (sim_get_double(":TIM:SCAL") * SIM_HORDIVS);
+
+  if(srate > SIM_MAX_SRATE)
+  {
+    srate = SIM_MAX_SRATE;
+  }
+
+  return srate;
+}
+
+
+/*
+ * Sample idx of channel chn as a BYTE value, samples are spaced tsmp seconds, scale is in V/div.
+ * CHAN1: 1 KHz sine, CHAN2: 5 KHz square, CHAN3: 2 KHz triangle, CHAN4: 10 KHz sine with noise.
+ * The amplitude is 3 divisions peak-peak when the vertical scale is 1 V/div.
+ */
+static int sim_sample(int chn, long long idx, double tsmp, double scale)
+{
+  int smp;
+
+  unsigned int rnd;
+
+  double t, ph, v;
+
+  t = idx * tsmp;
+
+  switch(chn)
+  {
+    case 0: v = 1.5 * sin(2 * M_PI * 1e3 * t);
+            break;
+    case 1: ph = fmod(t * 5e3, 1.0);
+            v = (ph < 0.5) ? 1.5 : -1.5;
+            break;
+    case 2: ph = fmod(t * 2e3, 1.0);
+            v = (ph < 0.5) ? ((ph * 12) - 1.5) : (4.5 - (ph * 12));
+            break;
+    default: rnd = (unsigned int)idx * 2654435761U;
+             rnd ^= rnd >> 15;
+             v = (1.0 * sin(2 * M_PI * 1e4 * t)) + ((rnd & 0xff) / 1280.0) - 0.1;
+             break;
+  }
+
+  smp = SIM_YREF + (int)(v / (scale / 25.0));
+
+  if(smp < 0)  smp = 0;
+
+  if(smp > 255)  smp = 255;
+
+  return smp;
+}
+
+
+/* sends len bytes to the client at the configured bandwidth */
+static int sim_send(const char *buf, int len)
+{
+  int n, chunk, sent=0;
+
+  long long t0, ahead;
+
+  t0 = sim_time_us();
+
+  while(sent < len)
+  {
+    chunk = len - sent;
+
+    if(opts.bandwidth && (chunk > SIM_PACE_CHUNK))
+    {
+      chunk = SIM_PACE_CHUNK;
+    }
+
+    n = send(clientfd, buf + sent, chunk, MSG_NOSIGNAL);
+    if(n < 1)
+    {
+      if((n < 0) && (errno == EINTR))  continue;
+
+      return -1;
+    }
+
+    sent += n;
+
+    if(opts.bandwidth)
+    {
+      ahead = ((sent * 1000000LL) / opts.bandwidth) - (sim_time_us() - t0);
+
+      if(ahead > 0)
+      {
+        usleep(ahead);
+      }
+    }
+  }
+
+  return sent;
+}
+
+
+/* sends buf as a definite length block: #9<len><data>\n */
+static int sim_send_block(const char *buf, int len)
+{
+  char hdr[16];
+
+  snprintf(hdr, 16, "#9%09i", len);
+
+  if(sim_send(hdr, 11) != 11)  return -1;
+
+  if(sim_send(buf, len) != len)  return -1;
+
+  if(sim_send("\n", 1) != 1)  return -1;
+
+  return 0;
+}
+
+
+/*
+ * :WAV:DATA? in NORM mode returns the screen (SIM_SCRN_PNTS samples),
+ * in RAW mode the memory from :WAV:STAR to :WAV:STOP, limited to opts.blk_max bytes.
+ * With more than one source, the samples of the sources are interleaved.
+ */
+static int sim_wav_data(void)
+{
+  int i, j, start, stop, pnts, mdep;
+
+  double tsmp, scale[SIM_CHNS];
+
+  char hdr[SIM_HDR_LEN];
+
+  const char *mode;
+
+  mode = sim_get(":WAV:MOD");
+
+  if((mode != NULL) && (!strcmp(mode, "RAW")))
+  {
+    mdep = sim_memdepth();
+
+    start = (int)sim_get_double(":WAV:STAR") - 1;
+
+    stop = (int)sim_get_double(":WAV:STOP");
+
+    if(start < 0)  start = 0;
+
+    if(stop > mdep)  stop = mdep;
+
+    pnts = stop - start;
+
+    if(pnts < 0)  pnts = 0;
+
+    if((pnts * state.wav_src_cnt) > opts.blk_max)
+    {
+      pnts = opts.blk_max / state.wav_src_cnt;
+    }
+
+    tsmp = 1.0 / sim_samplerate();
+  }
+  else
+  {
+    start = 0;
+
+    pnts = SIM_SCRN_PNTS;
+
+    tsmp = (sim_get_double(":TIM:SCAL") * SIM_HORDIVS) / SIM_SCRN_PNTS;
+  }
+
+  for(j=0; j<state.wav_src_cnt; j++)
+  {
+    snprintf(hdr, SIM_HDR_LEN, ":CHAN%i:SCAL", state.wav_src[j] + 1);
+
+    scale[j] = sim_get_double(hdr);
+
+    if(scale[j] <= 0)
+    {
+      scale[j] = 1;
+    }
+  }
+
+  for(i=0; i<pnts; i++)
+  {
+    for(j=0; j<state.wav_src_cnt; j++)
+    {
+      blk_buf[(i * state.wav_src_cnt) + j] = sim_sample(state.wav_src[j], start + i, tsmp, scale[j]);
+    }
+  }
+
+  usleep(opts.latency);
+
+  return sim_send_block(blk_buf, pnts * state.wav_src_cnt);
+}
+
+
+/* a 24-bit BMP with the graticule, like :DISP:DATA? of the oscilloscope */
+static int sim_disp_data(void)
+{
+  int x, y, ret;
+
+  unsigned char *bmp, *px;
+
+  bmp = (unsigned char *)calloc(1, SIM_BMP_SZ);
+  if(bmp == NULL)
+  {
+    return -1;
+  }
+
+  bmp[0] = 'B';
+  bmp[1] = 'M';
+  bmp[2] = SIM_BMP_SZ & 0xff;
+  bmp[3] = (SIM_BMP_SZ >> 8) & 0xff;
+  bmp[4] = (SIM_BMP_SZ >> 16) & 0xff;
+  bmp[10] = 54;
+  bmp[14] = 40;
+  bmp[18] = SIM_BMP_W & 0xff;
+  bmp[19] = (SIM_BMP_W >> 8) & 0xff;
+  bmp[22] = SIM_BMP_H & 0xff;
+  bmp[23] = (SIM_BMP_H >> 8) & 0xff;
+  bmp[26] = 1;
+  bmp[28] = 24;
+
+  for(y=0; y<SIM_BMP_H; y++)
+  {
+    for(x=0; x<SIM_BMP_W; x++)
+    {
+      if((!(x % (SIM_BMP_W / SIM_HORDIVS))) || (!(y % (SIM_BMP_H / 8))))
+      {
+        px = bmp + 54 + (((y * SIM_BMP_W) + x) * 3);
+
+        px[0] = 0x60;
+        px[1] = 0x60;
+        px[2] = 0x60;
+      }
+    }
+  }
+
+  usleep(opts.latency);
+
+  ret = sim_send_block((char *)bmp, SIM_BMP_SZ);
+
+  free(bmp);
+
+  return ret;
+}
+
+
+/* answers a query that is not a block, returns 0 on success */
+static int sim_query(const char *hdr, char *resp, int sz)
+{
+  int i, chn, stat;
+
+  const double freq[SIM_CHNS]={1e3, 5e3, 2e3, 1e4};  /* see sim_sample() */
+
+  const char *val;
+
+  char str[64];
+
+  if(!strcmp(hdr, "*IDN"))
+  {
+    snprintf(resp, sz, "RIGOL TECHNOLOGIES,%s,DHO9SIM000001,00.01.03", opts.model);
+    return 0;
+  }
+
+  if(!strcmp(hdr, "*OPC"))
+  {
+    strlcpy(resp, "1", sz);
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":SYST:ERR"))
+  {
+    strlcpy(resp, "0,\"No error\"", sz);
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":TRIG:STAT"))
+  {
+    stat = sim_trig_stat();
+
+    if(stat == SIM_STAT_STOP)
+    {
+      strlcpy(resp, "STOP", sz);
+    }
+    else if(stat == SIM_STAT_WAIT)
+      {
+        strlcpy(resp, "WAIT", sz);
+      }
+      else
+      {
+        val = sim_get(":TRIG:SWE");
+
+        strlcpy(resp, ((val != NULL) && (!strcmp(val, "AUTO"))) ? "AUTO" : "TD", sz);
+      }
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":ACQ:MDEP"))
+  {
+    snprintf(resp, sz, "%i", sim_memdepth());
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":ACQ:SRAT"))
+  {
+    snprintf(resp, sz, "%e", sim_samplerate());
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:SOUR"))
+  {
+    resp[0] = 0;
+
+    for(i=0; i<state.wav_src_cnt; i++)
+    {
+      snprintf(str, 64, "%sCHAN%i", i ? "," : "", state.wav_src[i] + 1);
+
+      strlcat(resp, str, sz);
+    }
+    return 0;
+  }
+
+  if(!strncmp(hdr, ":WAV:YINC", 9))
+  {
+    snprintf(str, 64, ":CHAN%i:SCAL", state.wav_src[0] + 1);
+
+    snprintf(resp, sz, "%e", sim_get_double(str) / 25.0);
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:YREF"))
+  {
+    snprintf(resp, sz, "%i", SIM_YREF);
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:YOR"))
+  {
+    strlcpy(resp, "0", sz);
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:XINC"))
+  {
+    snprintf(resp, sz, "%e", 1.0 / sim_samplerate());
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:XOR"))
+  {
+    snprintf(resp, sz, "%e", -(sim_get_double(":TIM:SCAL") * SIM_HORDIVS) / 2.0 + sim_get_double(":TIM:OFFS"));
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:PRE"))
+  {
+    snprintf(str, 64, ":CHAN%i:SCAL", state.wav_src[0] + 1);
+
+    snprintf(resp, sz, "0,2,%i,1,%e,%e,0,%e,0,%i", sim_memdepth(), 1.0 / sim_samplerate(),
+             -(sim_get_double(":TIM:SCAL") * SIM_HORDIVS) / 2.0, sim_get_double(str) / 25.0, SIM_YREF);
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":MEAS:COUN:VAL"))
+  {
+    val = sim_get(":MEAS:COUN:SOUR");
+
+    chn = ((val != NULL) && (!strncmp(val, "CHAN", 4))) ? (atoi(val + 4) - 1) : -1;
+
+    snprintf(resp, sz, "%e", ((chn >= 0) && (chn < SIM_CHNS)) ? freq[chn] : 0.0);
+    return 0;
+  }
+
+  val = sim_get(hdr);
+
+  if(val == NULL)
+  {
+    if(opts.verbose)
+    {
+      printf("dsremote-sim: unknown query %s?\n", hdr);
+    }
+
+    strlcpy(resp, "0", sz);
+    return 0;
+  }
+
+  strlcpy(resp, val, sz);
+
+  return 0;
+}
+
+
+/*
+ * Executes one command of a (compound) line. Query responses are appended to resp.
+ * Returns 1 when the response was a block that has already been sent, -1 on error, else 0.
+ */
+static int sim_command(char *cmd, char *resp, int sz)
+{
+  int i, chn, qry=0;
+
+  char hdr[SIM_HDR_LEN],
+       str[SIM_CMD_LEN],
+       *val,
+       *ptr;
+
+  while(*cmd == ' ')  cmd++;
+
+  if(!*cmd)
+  {
+    return 0;
+  }
+
+  val = strchr(cmd, ' ');
+  if(val != NULL)
+  {
+    *val++ = 0;
+
+    while(*val == ' ')  val++;
+  }
+
+  i = strlen(cmd);
+
+  if(i && (cmd[i - 1] == '?'))
+  {
+    cmd[i - 1] = 0;
+
+    qry = 1;
+  }
+
+  if((cmd[0] != ':') && (cmd[0] != '*'))
+  {
+    snprintf(str, SIM_CMD_LEN, ":%s", cmd);
+  }
+  else
+  {
+    strlcpy(str, cmd, SIM_CMD_LEN);
+  }
+
+  sim_short_hdr(str, hdr, SIM_HDR_LEN);
+
+  if(qry)
+  {
+    if((!strcmp(hdr, ":WAV:DAT")) || (!strcmp(hdr, ":DISP:DAT")))
+    {
+      if(resp[0])  /* a block ends the response */
+      {
+        strlcat(resp, "\n", sz);
+
+        usleep(opts.latency);
+
+        if(sim_send(resp, strlen(resp)) < 0)  return -1;
+
+        resp[0] = 0;
+      }
+
+      if(hdr[1] == 'W')
+      {
+        return (sim_wav_data() < 0) ? -1 : 1;
+      }
+
+      return (sim_disp_data() < 0) ? -1 : 1;
+    }
+
+    if(resp[0])
+    {
+      strlcat(resp, ";", sz);
+    }
+
+    sim_query(hdr, str, SIM_CMD_LEN);
+
+    strlcat(resp, str, sz);
+
+    return 0;
+  }
+
+  if(!strcmp(hdr, "*RST"))
+  {
+    sim_reset();
+    return 0;
+  }
+
+  if((!strcmp(hdr, "*CLS")) || (!strcmp(hdr, ":CLE")) || (!strcmp(hdr, ":DISP:CLE")))
+  {
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":RUN"))
+  {
+    state.run_stat = SIM_STAT_RUN;
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":STOP"))
+  {
+    state.run_stat = SIM_STAT_STOP;
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":SING"))
+  {
+    sim_set(":TRIG:SWE", "SING");
+
+    state.run_stat = SIM_STAT_WAIT;
+
+    state.arm_time = sim_time_us();
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":TFOR"))
+  {
+    if(state.run_stat == SIM_STAT_WAIT)
+    {
+      state.run_stat = SIM_STAT_STOP;
+    }
+    return 0;
+  }
+
+  if(val == NULL)
+  {
+    if(opts.verbose)
+    {
+      printf("dsremote-sim: ignored command %s\n", hdr);
+    }
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":WAV:SOUR"))  /* CHAN1 or a list: CHAN1,CHAN3 */
+  {
+    strlcpy(str, val, SIM_CMD_LEN);
+
+    state.wav_src_cnt = 0;
+
+    for(ptr=strtok(str, ","); ptr!=NULL; ptr=strtok(NULL, ","))
+    {
+      chn = -1;
+
+      if(!strncmp(ptr, "CHAN", 4))
+      {
+        chn = atoi(ptr + 4) - 1;
+      }
+
+      if((chn < 0) || (chn >= SIM_CHNS) || (state.wav_src_cnt >= SIM_CHNS))
+      {
+        state.wav_src[0] = 0;
+
+        state.wav_src_cnt = 1;
+
+        return 0;
+      }
+
+      state.wav_src[state.wav_src_cnt++] = chn;
+    }
+
+    if(!state.wav_src_cnt)
+    {
+      state.wav_src[0] = 0;
+
+      state.wav_src_cnt = 1;
+    }
+
+    return 0;
+  }
+
+  if(!strcmp(hdr, ":TRIG:SWE"))
+  {
+    if(state.run_stat == SIM_STAT_RUN)
+    {
+      if(!strncmp(val, "SING", 4))
+      {
+        state.run_stat = SIM_STAT_WAIT;
+
+        state.arm_time = sim_time_us();
+      }
+    }
+  }
+
+  sim_set(hdr, val);
+
+  return 0;
+}
+
+
+/* executes a line from the client, the commands are separated by ';' */
+static int sim_line(char *line)
+{
+  int ret=0;
+
+  char resp[SIM_CMD_LEN * 4],
+       *cmd,
+       *next;
+
+  if(opts.verbose)
+  {
+    printf("dsremote-sim: %s\n", line);
+  }
+
+  resp[0] = 0;
+
+  for(cmd=line; cmd!=NULL; cmd=next)
+  {
+    next = strchr(cmd, ';');
+    if(next != NULL)
+    {
+      *next++ = 0;
+    }
+
+    ret = sim_command(cmd, resp, SIM_CMD_LEN * 4);
+    if(ret < 0)
+    {
+      return -1;
+    }
+  }
+
+  if(resp[0])
+  {
+    strlcat(resp, "\n", SIM_CMD_LEN * 4);
+
+    usleep(opts.latency);
+
+    if(sim_send(resp, strlen(resp)) < 0)
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+static int sim_serve(void)
+{
+  int n, len=0;
+
+  char buf[SIM_CMD_LEN],
+       *eol;
+
+  while(1)
+  {
+    n = recv(clientfd, buf + len, SIM_CMD_LEN - 1 - len, 0);
+    if(n < 1)
+    {
+      if((n < 0) && (errno == EINTR))  continue;
+
+      return 0;
+    }
+
+    len += n;
+
+    buf[len] = 0;
+
+    while((eol = strchr(buf, '\n')) != NULL)
+    {
+      *eol = 0;
+
+      if((eol > buf) && (eol[-1] == '\r'))
+      {
+        eol[-1] = 0;
+      }
+
+      if(sim_line(buf))
+      {
+        return -1;
+      }
+
+      len -= (eol + 1 - buf);
+
+      memmove(buf, eol + 1, len + 1);
+    }
+
+    if(len >= (SIM_CMD_LEN - 1))  /* line too long, drop it */
+    {
+      len = 0;
+    }
+  }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
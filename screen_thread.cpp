@@ -39,71 +39,194 @@ void screen_thread::set_device(struct tmcdev *tmdev)
   params.cmd_cue_idx_out = 0;
   params.connected = 0;
 
+  slow_poll_due = 1;
+
+  stat_compound = 1;
+
   device = tmdev;
 }
 
 
 screen_thread::screen_thread()
 {
-  int i;
+  int i, j;
 
   device = NULL;
 
   h_busy = 0;
 
+  memset(frames, 0, sizeof(struct scrn_frame) * SCRN_FRAME_CNT);
+
+  for(j=0; j<SCRN_FRAME_CNT; j++)
+  {
+    for(i=0; i<MAX_CHNS; i++)
+    {
+      frames[j].wavebuf[i] = (short *)calloc(1, WAVFRM_MAX_BUFSZ * sizeof(short));
+    }
+
+    frames[j].fftbuf_out = (double *)calloc(1, FFT_MAX_BUFSZ * sizeof(double));
+  }
+
+  fftbuf_stream = (double *)calloc(1, FFT_MAX_BUFSZ * sizeof(double));
+
+  frm_back = 0;
+  frm_mid = 1;
+  frm_front = 2;
+  frm_seq = 0;
+  frm_seq_gui = 0;
+  stream_run = 0;
+
+  for(i=0; i<4; i++)
+  {
+    job_seq[i] = 0;
+  }
+
+  gui_attached = 0;
+
   for(i=0; i<MAX_CHNS; i++)
   {
-    params.wavebuf[i] = (short *)malloc(WAVFRM_MAX_BUFSZ);
+    params.wavebuf[i] = frames[frm_back].wavebuf[i];
   }
 
   params.cmd_cue_idx_in = 0;
   params.cmd_cue_idx_out = 0;
   params.connected = 0;
+  params.wav_multichn = 0;
+
+  slow_poll_due = 1;
+
+  stat_compound = 1;
+
+  settings_rd = new read_settings_thread;
+
+  settings_buf = (struct device_settings *)calloc(1, sizeof(struct device_settings));
+
+  settings_rd->set_devparm_ptr(settings_buf);
+
+  settings_req = 0;
+  settings_done = 0;
+
+  memset(&params_in, 0, sizeof(struct scrn_params_in));
+
+  params_in_new = 0;
+
+  pthread_mutex_init(&params_mtx, NULL);
 }
 
 
 screen_thread::~screen_thread()
 {
-  int i;
+  int i, j;
 
-  for(i=0; i<MAX_CHNS; i++)
+  for(j=0; j<SCRN_FRAME_CNT; j++)
   {
-    free(params.wavebuf[i]);
+    for(i=0; i<MAX_CHNS; i++)
+    {
+      free(frames[j].wavebuf[i]);
+    }
+
+    free(frames[j].fftbuf_out);
   }
+
+  free(fftbuf_stream);
+
+  delete settings_rd;
+
+  free(settings_buf);
+
+  pthread_mutex_destroy(&params_mtx);
 }
 
 
+/*
+ * Called by the GUI thread. The copy is picked up by run() before the next frame,
+ * the acquisition thread does not read the settings from devparms.
+ */
 void screen_thread::set_params(struct device_settings *dev_parms)
 {
+  struct scrn_params_in p_in;
+
   deviceparms = dev_parms;
-  params.connected = deviceparms->connected;
-  params.modelserie = deviceparms->modelserie;
-  params.chandisplay[0] = deviceparms->chandisplay[0];
-  params.chandisplay[1] = deviceparms->chandisplay[1];
-  params.chandisplay[2] = deviceparms->chandisplay[2];
-  params.chandisplay[3] = deviceparms->chandisplay[3];
-  params.chanscale[0] = deviceparms->chanscale[0];
-  params.chanscale[1] = deviceparms->chanscale[1];
-  params.chanscale[2] = deviceparms->chanscale[2];
-  params.chanscale[3] = deviceparms->chanscale[3];
-  params.countersrc = deviceparms->countersrc;
-  params.cmd_cue_idx_in = deviceparms->cmd_cue_idx_in;
-  params.math_fft_src = deviceparms->math_fft_src;
-  params.math_fft = deviceparms->math_fft;
-  params.math_fft_unit = deviceparms->math_fft_unit;
-  params.fftbuf_in = deviceparms->fftbuf_in;
-  params.fftbuf_out = deviceparms->fftbuf_out;
-  params.fftbufsz = deviceparms->fftbufsz;
-  params.k_cfg = deviceparms->k_cfg;
-  params.kiss_fftbuf = deviceparms->kiss_fftbuf;
-  params.current_screen_sf = deviceparms->current_screen_sf;
+
+  p_in.connected = dev_parms->connected;
+  p_in.modelserie = dev_parms->modelserie;
+  memcpy(p_in.chandisplay, dev_parms->chandisplay, sizeof(p_in.chandisplay));
+  memcpy(p_in.chanscale, dev_parms->chanscale, sizeof(p_in.chanscale));
+  p_in.countersrc = dev_parms->countersrc;
+  p_in.math_fft_src = dev_parms->math_fft_src;
+  p_in.math_fft = dev_parms->math_fft;
+  p_in.math_fft_unit = dev_parms->math_fft_unit;
+  p_in.fftbuf_in = dev_parms->fftbuf_in;
+  p_in.fftbuf_out = dev_parms->fftbuf_out;
+  p_in.fftbufsz = dev_parms->fftbufsz;
+  p_in.k_cfg = dev_parms->k_cfg;
+  p_in.kiss_fftbuf = dev_parms->kiss_fftbuf;
+  p_in.current_screen_sf = dev_parms->current_screen_sf;
+  p_in.func_wrec_enable = dev_parms->func_wrec_enable;
+  p_in.func_wrec_operate = dev_parms->func_wrec_operate;
+  p_in.func_wplay_operate = dev_parms->func_wplay_operate;
+  p_in.func_wplay_fcur = dev_parms->func_wplay_fcur;
+  p_in.func_wrec_fmax = dev_parms->func_wrec_fmax;
+  p_in.func_wrep_fmax = dev_parms->func_wplay_fmax;
+  p_in.wav_multichn = dev_parms->wav_multichn;
+
+  pthread_mutex_lock(&params_mtx);
+
+  params_in = p_in;
+
+  params_in_new = 1;
+
+  pthread_mutex_unlock(&params_mtx);
+}
+
+
+/* called by the acquisition thread before every frame */
+void screen_thread::take_params()
+{
+  int multichn;
+
+  multichn = params.wav_multichn;
+
+  pthread_mutex_lock(&params_mtx);
+
+  if(params_in_new)
+  {
+    params.connected = params_in.connected;
+    params.modelserie = params_in.modelserie;
+    memcpy(params.chandisplay, params_in.chandisplay, sizeof(params.chandisplay));
+    memcpy(params.chanscale, params_in.chanscale, sizeof(params.chanscale));
+    params.countersrc = params_in.countersrc;
+    params.math_fft_src = params_in.math_fft_src;
+    params.math_fft = params_in.math_fft;
+    params.math_fft_unit = params_in.math_fft_unit;
+    params.fftbuf_in = params_in.fftbuf_in;
+    params.fftbuf_out = params_in.fftbuf_out;
+    params.fftbufsz = params_in.fftbufsz;
+    params.k_cfg = params_in.k_cfg;
+    params.kiss_fftbuf = params_in.kiss_fftbuf;
+    params.current_screen_sf = params_in.current_screen_sf;
+    params.func_wrec_enable = params_in.func_wrec_enable;
+    params.func_wrec_operate = params_in.func_wrec_operate;
+    params.func_wplay_operate = params_in.func_wplay_operate;
+    params.func_wplay_fcur = params_in.func_wplay_fcur;
+    params.func_wrec_fmax = params_in.func_wrec_fmax;
+    params.func_wrep_fmax = params_in.func_wrep_fmax;
+    params.wav_multichn = params_in.wav_multichn;
+
+    params_in_new = 0;
+  }
+
+  pthread_mutex_unlock(&params_mtx);
+
+  if(__atomic_load_n(&stream_run, __ATOMIC_ACQUIRE))
+  {
+    params.wav_multichn = multichn;  // owned by this thread while streaming
+  }
+
   params.debug_str[0] = 0;
-  params.func_wrec_enable = deviceparms->func_wrec_enable;
-  params.func_wrec_operate = deviceparms->func_wrec_operate;
-  params.func_wplay_operate = deviceparms->func_wplay_operate;
-  params.func_wplay_fcur = deviceparms->func_wplay_fcur;
-  params.func_wrec_fmax = deviceparms->func_wrec_fmax;
-  params.func_wrep_fmax = deviceparms->func_wplay_fmax;
+
+  /* the command cue is a single producer, single consumer queue, published by its index */
+  params.cmd_cue_idx_in = __atomic_load_n(&deviceparms->cmd_cue_idx_in, __ATOMIC_ACQUIRE);
 }
 
 
@@ -129,6 +252,7 @@ void screen_thread::get_params(struct device_settings *dev_parms)
   dev_parms->thread_error_stat = params.error_stat;
   dev_parms->thread_error_line = params.error_line;
   dev_parms->cmd_cue_idx_out = params.cmd_cue_idx_out;
+  dev_parms->wav_multichn = params.wav_multichn;
   dev_parms->thread_result = params.result;
   dev_parms->thread_job = params.job;
   if(dev_parms->thread_job == TMC_THRD_JOB_TRIGEDGELEV)
@@ -162,287 +286,793 @@ void screen_thread::get_params(struct device_settings *dev_parms)
 }
 
 
+/* the order of the SCRN_STAT_xxx defines */
+static const char *scrn_stat_cmds[SCRN_STAT_CNT]=
+{
+  ":TRIG:STAT?",
+  ":TRIG:SWE?",
+  ":MEAS:COUN:VAL?",
+  ":FUNC:WREC:OPER?",
+  ":FUNC:WREP:OPER?",
+  ":FUNC:WREP:FCUR?",
+  ":ACQ:SRAT?",
+  ":ACQ:MDEP?",
+  ":FUNC:WREC:FMAX?",
+  ":FUNC:WREP:FMAX?"
+};
+
+
+/*
+ * Reads the trigger status and the other values that are shown with every frame
+ * with one compound query ":Q1?;:Q2?;...".
+ * The values that change only when the user changes a setting (samplerate, memory depth,
+ * record frame counts) are read every SCRN_SLOW_POLL_MS or after a command was sent.
+ * Falls back to single queries when the device does not answer the compound query.
+ */
 int screen_thread::get_devicestatus()
 {
-  int line;
+  int i, n=0, done, cnt, flds, slow,
+      ids[SCRN_STAT_CNT];
+
+  char str[TMC_CMD_MAX_LEN + 16],
+       *fld[SCRN_STAT_CNT + 1];
+
+  const char *cmds[SCRN_STAT_CNT];
+
+  slow = slow_poll_due || (!slow_poll_tmr.isValid()) || (slow_poll_tmr.elapsed() >= SCRN_SLOW_POLL_MS);
+
+  for(i=0; i<SCRN_STAT_CNT; i++)
+  {
+    if((i == SCRN_STAT_COUN_VAL) && (!params.countersrc))  continue;
+
+    if((!params.func_wrec_enable) &&
+       ((i == SCRN_STAT_WREC_OPER) || (i == SCRN_STAT_WREP_OPER) || (i == SCRN_STAT_WREP_FCUR) ||
+        (i == SCRN_STAT_WREC_FMAX) || (i == SCRN_STAT_WREP_FMAX)))  continue;
+
+    if((i >= SCRN_STAT_SLOW) && (!slow))  continue;
+
+    ids[n] = i;
+
+    cmds[n++] = scrn_stat_cmds[i];
+  }
+
+  for(done=0; done<n; done+=cnt)
+  {
+    if(!stat_compound)
+    {
+      cnt = 1;
+
+      if(query_status(ids[done]))
+      {
+        return -1;
+      }
 
+      continue;
+    }
+
+    cnt = tmc_cmd_join_query(str, TMC_CMD_MAX_LEN + 16, cmds + done, n - done);
+    if(cnt < 1)
+    {
+      params.error_line = __LINE__;
+      return -1;
+    }
+
+    usleep(TMC_GDS_DELAY);
+
+    if(tmc_write(str) != (int)strlen(str))
+    {
+      params.error_line = __LINE__;
+      return -1;
+    }
+
+    if(tmc_read() < 1)
+    {
+      strlcpy(params.debug_str, device->hdrbuf, 1024);
+      params.error_line = __LINE__;
+      return -1;
+    }
+
+    flds = tmc_cmd_split(device->buf, fld, cnt);
+    if(flds != cnt)
+    {
+      printf("device status: expected %i responses, received %i, using single queries\n", cnt, flds);
+
+      stat_compound = 0;
+
+      cnt = 0;  // read this part again
+
+      continue;
+    }
+
+    for(i=0; i<cnt; i++)
+    {
+      if(parse_status(ids[done + i], fld[i]))
+      {
+        return -1;
+      }
+    }
+  }
+
+  if(slow)
+  {
+    slow_poll_due = 0;
+
+    slow_poll_tmr.start();
+  }
+
+  params.debug_str[0] = 0;
+
+  return 0;
+}
+
+
+/* reads one value of the device status with a single query */
+int screen_thread::query_status(int id)
+{
   usleep(TMC_GDS_DELAY);
 
-  if(tmc_write(":TRIG:STAT?") != 11)
+  if(tmc_write(scrn_stat_cmds[id]) != (int)strlen(scrn_stat_cmds[id]))
   {
-    line = __LINE__;
-    goto OUT_ERROR;
+    params.error_line = __LINE__;
+    return -1;
   }
 
   if(tmc_read() < 1)
   {
-    line = __LINE__;
-    goto OUT_ERROR;
+    strlcpy(params.debug_str, device->hdrbuf, 1024);
+    params.error_line = __LINE__;
+    return -1;
   }
 
-  if(!strcmp(device->buf, "TD"))
+  return parse_status(id, device->buf);
+}
+
+
+int screen_thread::parse_status(int id, const char *resp)
+{
+  int line;
+
+  switch(id)
   {
-    params.triggerstatus = 0;
-  }
-  else if(!strcmp(device->buf, "WAIT"))
-    {
-      params.triggerstatus = 1;
-    }
-    else if(!strcmp(device->buf, "RUN"))
+    case SCRN_STAT_TRIG_STAT:
+      if(!strcmp(resp, "TD"))
       {
-        params.triggerstatus = 2;
+        params.triggerstatus = 0;
       }
-      else if(!strcmp(device->buf, "AUTO"))
+      else if(!strcmp(resp, "WAIT"))
         {
-          params.triggerstatus = 3;
+          params.triggerstatus = 1;
         }
-        else if(!strcmp(device->buf, "FIN"))
+        else if(!strcmp(resp, "RUN"))
           {
-            params.triggerstatus = 4;
+            params.triggerstatus = 2;
           }
-          else if(!strcmp(device->buf, "STOP"))
-            {
-              params.triggerstatus = 5;
-            }
-            else
+          else if(!strcmp(resp, "AUTO"))
             {
-              line = __LINE__;
-              goto OUT_ERROR;
+              params.triggerstatus = 3;
             }
+            else if(!strcmp(resp, "FIN"))
+              {
+                params.triggerstatus = 4;
+              }
+              else if(!strcmp(resp, "STOP"))
+                {
+                  params.triggerstatus = 5;
+                }
+                else
+                {
+                  line = __LINE__;
+                  goto OUT_ERROR;
+                }
+      break;
+
+    case SCRN_STAT_TRIG_SWE:
+      if(!strcmp(resp, "AUTO"))
+      {
+        params.triggersweep = 0;
+      }
+      else if(!strcmp(resp, "NORM"))
+        {
+          params.triggersweep = 1;
+        }
+        else if(!strcmp(resp, "SING"))
+          {
+            params.triggersweep = 2;
+          }
+          else
+          {
+            line = __LINE__;
+            goto OUT_ERROR;
+          }
+      break;
 
-  usleep(TMC_GDS_DELAY);
+    case SCRN_STAT_COUN_VAL:
+      params.counterfreq = atof(resp);
+      break;
+
+    case SCRN_STAT_WREC_OPER:
+      if(params.modelserie == 6)
+      {
+        if(!strcmp(resp, "REC"))
+        {
+          params.func_wrec_operate = 1;
+        }
+        else if(!strcmp(resp, "STOP"))
+          {
+            params.func_wrec_operate = 0;
+          }
+          else
+          {
+            line = __LINE__;
+            goto OUT_ERROR;
+          }
+      }
+      else
+      {
+        if(!strcmp(resp, "RUN"))
+        {
+          params.func_wrec_operate = 1;
+        }
+        else if(!strcmp(resp, "STOP"))
+          {
+            params.func_wrec_operate = 0;
+          }
+          else
+          {
+            line = __LINE__;
+            goto OUT_ERROR;
+          }
+      }
+      break;
+
+    case SCRN_STAT_WREP_OPER:
+      if(!strcmp(resp, "PLAY"))
+      {
+        params.func_wplay_operate = 1;
+      }
+      else if(!strcmp(resp, "STOP"))
+        {
+          params.func_wplay_operate = 0;
+        }
+        else if(!strcmp(resp, "PAUS"))
+          {
+            params.func_wplay_operate = 2;
+          }
+          else
+          {
+            line = __LINE__;
+            goto OUT_ERROR;
+          }
+      break;
+
+    case SCRN_STAT_WREP_FCUR:
+      params.func_wplay_fcur = atoi(resp);
+      break;
+
+    case SCRN_STAT_SRAT:
+      params.samplerate = atof(resp);
+      break;
+
+    case SCRN_STAT_MDEP:
+      params.memdepth = atoi(resp);
+      break;
+
+    case SCRN_STAT_WREC_FMAX:
+      params.func_wrec_fmax = atoi(resp);
+      break;
+
+    case SCRN_STAT_WREP_FMAX:
+      params.func_wrep_fmax = atoi(resp);
+      break;
+  }
+
+  return 0;
+
+OUT_ERROR:
+
+  strlcpy(params.debug_str, resp, 1024);
+
+  params.error_line = line;
+
+  return -1;
+}
+
+
+/*
+ * Downloads all displayed channels with one :WAV:DATA? in case the firmware
+ * supports a list of sources. On return, smps is the number of samples per channel
+ * or -1 if the data must be downloaded per channel (not supported or unexpected blocksize).
+ * Returns 0 on success or -1 in case of a communication error.
+ */
+int screen_thread::get_multichn_waveform(int chns, int *smps)
+{
+  int i, j, k, n;
+
+  char str[512];
+
+  const char *wav_cmds[3];
+
+  long long stg_t;
+
+  unsigned char *buf;
+
+  *smps = -1;
+
+  tmc_wav_source_list(str, 512, params.chandisplay);
+
+  if(params.wav_multichn < 0)
+  {
+    params.wav_multichn = tmc_wav_multi_source_probe(str);
+
+    if(params.wav_multichn < 0)
+    {
+      params.error_line = __LINE__;
+      return -1;
+    }
+
+    printf("multi-channel waveform readout is %ssupported\n", params.wav_multichn ? "" : "not ");
+
+    if(!params.wav_multichn)
+    {
+      return 0;
+    }
+  }
+
+  wav_cmds[0] = str;
+  wav_cmds[1] = ":WAV:FORM BYTE";
+  wav_cmds[2] = ":WAV:MODE NORM";
+
+  stg_t = stgtmr_begin();
+
+  if(tmc_write_batch_cached(wav_cmds, 3) != 3)
+  {
+    printf("Can not write to device.\n");
+    params.error_line = __LINE__;
+    return -1;
+  }
+
+  if(tmc_write(":WAV:XOR?") != 9)
+  {
+    printf("Can not write to device.\n");
+    params.error_line = __LINE__;
+    return -1;
+  }
+
+  if(tmc_read() < 1)
+  {
+    printf("Can not read from device.\n");
+    params.error_line = __LINE__;
+    return -1;
+  }
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    params.xorigin[i] = atof(device->buf);  // same timebase for all channels
+  }
+
+  if(tmc_write(":WAV:DATA?") != 10)
+  {
+    printf("Can not write to device.\n");
+    params.error_line = __LINE__;
+    return -1;
+  }
+
+  n = tmc_read();
+
+  if(n < 0)
+  {
+    printf("Can not read from device. (n is %i)\n", n);
+    params.error_line = __LINE__;
+    return -1;
+  }
+
+  if((n % chns) || ((n / chns) > WAVFRM_MAX_BUFSZ))
+  {
+    printf("Unexpected multi-channel blocksize %i, falling back to one channel per block.\n", n);
+
+    params.wav_multichn = 0;
+
+    tmc_shadow_invalidate(":WAV");
+
+    return 0;
+  }
+
+  stgtmr_end(STGTMR_TRANSPORT, stg_t);
+
+  n /= chns;
+
+  if(n < 32)
+  {
+    n = 0;
+  }
+
+  stg_t = stgtmr_begin();
+
+  buf = (unsigned char *)device->buf;
+
+  for(i=0, k=0; i<MAX_CHNS; i++)
+  {
+    if(!params.chandisplay[i])
+    {
+      continue;
+    }
+
+    for(j=0; j<n; j++)
+    {
+      params.wavebuf[i][j] = (int)(buf[(j * chns) + k]) - 127;
+    }
+
+    k++;
+  }
+
+  stgtmr_end(STGTMR_CONVERT, stg_t);
+
+  *smps = n;
+
+  return 0;
+}
+
+
+/*
+ * Starts the acquisition thread in continuous mode. Instead of one frame per start(),
+ * the thread keeps downloading frames and publishes each completed frame by swapping it
+ * with the middle one of the three frame buffers. The GUI picks up the newest frame
+ * with get_frame(), which swaps the pointers in devparms, no copy and no lock involved.
+ */
+void screen_thread::start_streaming(struct device_settings *dev_parms)
+{
+  if(isRunning())
+  {
+    return;
+  }
+
+  set_params(dev_parms);
+
+  __atomic_store_n(&stream_run, 1, __ATOMIC_RELEASE);
+
+  start();
+}
+
+
+/* Also waits for a single shot (non-streaming) run to finish, same as QThread::wait(). */
+bool screen_thread::stop_streaming(unsigned long ms)
+{
+  __atomic_store_n(&stream_run, 0, __ATOMIC_RELEASE);
+
+  return wait(ms);
+}
+
+
+int screen_thread::frame_pending()
+{
+  return (__atomic_load_n(&frm_mid, __ATOMIC_ACQUIRE) & SCRN_FRAME_FRESH) ? 1 : 0;
+}
+
+
+/* Called by the acquisition thread, hands the back buffer over to the GUI. */
+void screen_thread::publish_frame()
+{
+  int i;
+
+  struct scrn_frame *frm;
+
+  frm = &frames[frm_back];
+
+  frm->result = params.result;
+  frm->error_stat = params.error_stat;
+  frm->error_line = params.error_line;
+  frm->connected = params.connected;
+  frm->triggerstatus = params.triggerstatus;
+  frm->triggersweep = params.triggersweep;
+  frm->samplerate = params.samplerate;
+  frm->memdepth = params.memdepth;
+  frm->counterfreq = params.counterfreq;
+  frm->wavebufsz = params.wavebufsz;
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    frm->chandisplay[i] = params.chandisplay[i];
+    frm->xorigin[i] = params.xorigin[i];
+  }
+  if((params.fftbufsz > 0) && (params.fftbufsz <= FFT_MAX_BUFSZ))
+  {
+    memcpy(frm->fftbuf_out, fftbuf_stream, params.fftbufsz * sizeof(double));
+  }
+  frm->cmd_cue_idx_out = params.cmd_cue_idx_out;
+  frm->wav_multichn = params.wav_multichn;
+  for(i=0; i<4; i++)
+  {
+    frm->job_seq[i] = job_seq[i];
+  }
+  frm->triggeredgelevel = params.triggeredgelevel;
+  frm->timebasedelayoffset = params.timebasedelayoffset;
+  frm->timebasedelayscale = params.timebasedelayscale;
+  frm->math_fft_hscale = params.math_fft_hscale;
+  frm->math_fft_hcenter = params.math_fft_hcenter;
+  frm->func_wrec_operate = params.func_wrec_operate;
+  frm->func_wplay_operate = params.func_wplay_operate;
+  frm->func_wplay_fcur = params.func_wplay_fcur;
+  frm->func_wrec_fmax = params.func_wrec_fmax;
+  frm->func_wrep_fmax = params.func_wrep_fmax;
+  frm->seq = ++frm_seq;
+
+  frm_back = __atomic_exchange_n(&frm_mid, frm_back | SCRN_FRAME_FRESH, __ATOMIC_ACQ_REL) & SCRN_FRAME_IDX_MASK;
+}
+
+
+/*
+ * Called by the GUI thread. Returns 1 when a new frame was picked up or 0 when
+ * no frame was published since the last call.
+ * The buffers of the frame are owned by the GUI until the next call.
+ */
+int screen_thread::get_frame(struct device_settings *dev_parms)
+{
+  int i;
+
+  struct scrn_frame *frm;
 
-  if(tmc_write(":TRIG:SWE?") != 10)
+  if(!frame_pending())
   {
-    line = __LINE__;
-    goto OUT_ERROR;
+    return 0;
   }
 
-  if(tmc_read() < 1)
-  {
-    line = __LINE__;
-    goto OUT_ERROR;
-  }
+  frm_front = __atomic_exchange_n(&frm_mid, frm_front, __ATOMIC_ACQ_REL) & SCRN_FRAME_IDX_MASK;
+
+  frm = &frames[frm_front];
 
-  if(!strcmp(device->buf, "AUTO"))
+  if(!gui_attached)
   {
-    params.triggersweep = 0;
-  }
-  else if(!strcmp(device->buf, "NORM"))
+    for(i=0; i<MAX_CHNS; i++)
     {
-      params.triggersweep = 1;
+      gui_wavebuf[i] = dev_parms->wavebuf[i];
     }
-    else if(!strcmp(device->buf, "SING"))
-      {
-        params.triggersweep = 2;
-      }
-      else
-      {
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
 
-  usleep(TMC_GDS_DELAY);
+    gui_fftbuf_out = dev_parms->fftbuf_out;
 
-  if(tmc_write(":ACQ:SRAT?") != 10)
-  {
-    line = __LINE__;
-    goto OUT_ERROR;
+    gui_attached = 1;
   }
 
-  if(tmc_read() < 1)
+  dev_parms->connected = frm->connected;
+  dev_parms->triggerstatus = frm->triggerstatus;
+  dev_parms->triggersweep = frm->triggersweep;
+  dev_parms->samplerate = frm->samplerate;
+  dev_parms->acquirememdepth = frm->memdepth;
+  dev_parms->counterfreq = frm->counterfreq;
+  dev_parms->wavebufsz = frm->wavebufsz;
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    dev_parms->wavebuf[i] = frm->wavebuf[i];
+
+    if(frm->chandisplay[i])
+    {
+      dev_parms->xorigin[i] = frm->xorigin[i];
+    }
+  }
+  dev_parms->fftbuf_out = frm->fftbuf_out;
+  dev_parms->thread_error_stat = frm->error_stat;
+  dev_parms->thread_error_line = frm->error_line;
+  dev_parms->cmd_cue_idx_out = frm->cmd_cue_idx_out;
+  dev_parms->wav_multichn = frm->wav_multichn;
+  dev_parms->thread_result = frm->result;
+  dev_parms->thread_job = TMC_THRD_JOB_NONE;
+  if(frm->job_seq[TMC_THRD_JOB_TRIGEDGELEV] > frm_seq_gui)
+  {
+    dev_parms->triggeredgelevel[dev_parms->triggeredgesource] = frm->triggeredgelevel;
+  }
+  if(frm->job_seq[TMC_THRD_JOB_TIMDELAY] > frm_seq_gui)
   {
-    line = __LINE__;
-    goto OUT_ERROR;
+    dev_parms->timebasedelayoffset = frm->timebasedelayoffset;
+    dev_parms->timebasedelayscale = frm->timebasedelayscale;
+  }
+  if(frm->job_seq[TMC_THRD_JOB_FFTHZDIV] > frm_seq_gui)
+  {
+    dev_parms->math_fft_hscale = frm->math_fft_hscale;
+    dev_parms->math_fft_hcenter = frm->math_fft_hcenter;
+  }
+  if(dev_parms->func_wrec_enable)
+  {
+    dev_parms->func_wrec_operate = frm->func_wrec_operate;
+    dev_parms->func_wplay_operate = frm->func_wplay_operate;
+    dev_parms->func_wplay_fcur = frm->func_wplay_fcur;
+    dev_parms->func_wrec_fmax = frm->func_wrec_fmax;
+    dev_parms->func_wplay_fmax = frm->func_wrep_fmax;
   }
 
-  params.samplerate = atof(device->buf);
+  frm_seq_gui = frm->seq;
+
+  return 1;
+}
 
-  usleep(TMC_GDS_DELAY);
 
-  if(tmc_write(":ACQ:MDEP?") != 10)
+/*
+ * Gives devparms its own buffers back (with a copy of the last frame) and discards
+ * a pending frame.
+ * Must be called with the thread stopped, before devparms or this object are freed.
+ */
+void screen_thread::detach_frames(struct device_settings *dev_parms)
+{
+  int i;
+
+  __atomic_and_fetch(&frm_mid, SCRN_FRAME_IDX_MASK, __ATOMIC_ACQ_REL);  // drop a frame that was not picked up
+
+  if(!gui_attached)
   {
-    line = __LINE__;
-    goto OUT_ERROR;
+    return;
   }
 
-  if(tmc_read() < 1)
+  for(i=0; i<MAX_CHNS; i++)
   {
-    line = __LINE__;
-    goto OUT_ERROR;
+    if((dev_parms->wavebufsz > 0) && (dev_parms->wavebufsz <= WAVFRM_MAX_BUFSZ))
+    {
+      memcpy(gui_wavebuf[i], dev_parms->wavebuf[i], dev_parms->wavebufsz * sizeof(short));
+    }
+
+    dev_parms->wavebuf[i] = gui_wavebuf[i];
   }
 
-  params.memdepth = atoi(device->buf);
+  memcpy(gui_fftbuf_out, dev_parms->fftbuf_out, FFT_MAX_BUFSZ * sizeof(double));
+
+  dev_parms->fftbuf_out = gui_fftbuf_out;
+
+  gui_attached = 0;
+}
+
+
+void screen_thread::run()
+{
+  int i;
+
+  long long stg_t;
 
-  if(params.countersrc)
+  if(!__atomic_load_n(&stream_run, __ATOMIC_ACQUIRE))
   {
-    usleep(TMC_GDS_DELAY);
+    take_params();
 
-    if(tmc_write(":MEAS:COUN:VAL?") != 15)
+    for(i=0; i<MAX_CHNS; i++)
     {
-      line = __LINE__;
-      goto OUT_ERROR;
+      params.wavebuf[i] = frames[frm_back].wavebuf[i];
     }
 
-    if(tmc_read() < 1)
+    stg_t = stgtmr_begin();
+
+    acquire();
+
+    stgtmr_end(STGTMR_FRAME, stg_t);
+
+    if((!params.error_stat) && params.connected)
     {
-      line = __LINE__;
-      goto OUT_ERROR;
+      read_settings();
     }
 
-    params.counterfreq = atof(device->buf);
+    return;
   }
 
-  if(params.func_wrec_enable)
+  while(__atomic_load_n(&stream_run, __ATOMIC_ACQUIRE))
   {
-    usleep(TMC_GDS_DELAY);
+    take_params();
 
-    if(tmc_write(":FUNC:WREC:OPER?") != 16)
-    {
-      line = __LINE__;
-      goto OUT_ERROR;
-    }
+    params.fftbuf_out = fftbuf_stream;
 
-    if(tmc_read() < 1)
+    for(i=0; i<MAX_CHNS; i++)
     {
-      line = __LINE__;
-      goto OUT_ERROR;
+      params.wavebuf[i] = frames[frm_back].wavebuf[i];
     }
 
-    if(params.modelserie == 6)
-    {
-      if(!strcmp(device->buf, "REC"))
-      {
-        params.func_wrec_operate = 1;
-      }
-      else if(!strcmp(device->buf, "STOP"))
-        {
-          params.func_wrec_operate = 0;
-        }
-        else
-        {
-          line = __LINE__;
-          goto OUT_ERROR;
-        }
-    }
-    else
-    {
-      if(!strcmp(device->buf, "RUN"))
-      {
-        params.func_wrec_operate = 1;
-      }
-      else if(!strcmp(device->buf, "STOP"))
-        {
-          params.func_wrec_operate = 0;
-        }
-        else
-        {
-          line = __LINE__;
-          goto OUT_ERROR;
-        }
-    }
+    stg_t = stgtmr_begin();
 
-    usleep(TMC_GDS_DELAY);
+    acquire();
 
-    if(tmc_write(":FUNC:WREP:OPER?") != 16)
-    {
-      line = __LINE__;
-      goto OUT_ERROR;
-    }
+    stgtmr_end(STGTMR_FRAME, stg_t);
 
-    if(tmc_read() < 1)
+    if(params.job != TMC_THRD_JOB_NONE)
     {
-      line = __LINE__;
-      goto OUT_ERROR;
+      job_seq[params.job] = frm_seq + 1;  // delivered with the next published frame
     }
 
-    if(!strcmp(device->buf, "PLAY"))
+    if((params.result == TMC_THRD_RESULT_CMD) && (!params.error_stat))
     {
-      params.func_wplay_operate = 1;
+      continue;  // commands were sent, download the screen right away
     }
-    else if(!strcmp(device->buf, "STOP"))
-      {
-        params.func_wplay_operate = 0;
-      }
-      else if(!strcmp(device->buf, "PAUS"))
-        {
-          params.func_wplay_operate = 2;
-        }
-        else
-        {
-          line = __LINE__;
-          goto OUT_ERROR;
-        }
 
-    usleep(TMC_GDS_DELAY);
+    publish_frame();
 
-    if(tmc_write(":FUNC:WREP:FCUR?") != 16)
+    if(params.error_stat || (!params.connected) || (device == NULL))
     {
-      line = __LINE__;
-      goto OUT_ERROR;
+      break;
     }
 
-    if(tmc_read() < 1)
+    read_settings();
+
+    if(params.result != TMC_THRD_RESULT_SCRN)
     {
-      line = __LINE__;
-      goto OUT_ERROR;
+      msleep(SCRN_STREAM_IDLE_MS);
     }
+  }
+}
 
-    params.func_wplay_fcur = atoi(device->buf);
-
-    usleep(TMC_GDS_DELAY);
 
-    if(tmc_write(":FUNC:WREC:FMAX?") != 16)
-    {
-      line = __LINE__;
-      goto OUT_ERROR;
-    }
+/*
+ * Reads one of the settings groups the GUI did not wait for at connect time.
+ * Called between two frames so that the live trace is delayed by one group at most.
+ */
+void screen_thread::read_settings()
+{
+  int req, grp;
 
-    if(tmc_read() < 1)
-    {
-      line = __LINE__;
-      goto OUT_ERROR;
-    }
+  char str[4096];
 
-    params.func_wrec_fmax = atoi(device->buf);
+  req = __atomic_load_n(&settings_req, __ATOMIC_ACQUIRE);
+  if(!req)
+  {
+    return;
+  }
 
-    usleep(TMC_GDS_DELAY);
+  grp = req & -req;
 
-    if(tmc_write(":FUNC:WREP:FMAX?") != 16)
-    {
-      line = __LINE__;
-      goto OUT_ERROR;
-    }
+  settings_rd->set_device(device);
 
-    if(tmc_read() < 1)
-    {
-      line = __LINE__;
-      goto OUT_ERROR;
-    }
+  if(settings_rd->read_groups(grp))
+  {
+    settings_rd->get_error_str(str, 4096);
 
-    params.func_wrep_fmax = atoi(device->buf);
+    printf("screen_thread: background settings read failed:\n%s\n", str);  // the GUI reads it again when needed
+  }
+  else
+  {
+    __atomic_or_fetch(&settings_done, grp, __ATOMIC_RELEASE);
   }
 
-  params.debug_str[0] = 0;
+  __atomic_and_fetch(&settings_req, ~grp, __ATOMIC_RELEASE);
+}
 
-  return 0;
 
-OUT_ERROR:
+/* GUI: the thread must not run, the groups in mask are read between the next frames */
+void screen_thread::request_settings(struct device_settings *dev_parms, int mask)
+{
+  *settings_buf = *dev_parms;
 
-  strlcpy(params.debug_str, device->hdrbuf, 1024);
+  __atomic_store_n(&settings_done, 0, __ATOMIC_RELAXED);
 
-  params.error_line = line;
+  __atomic_store_n(&settings_req, mask, __ATOMIC_RELEASE);
+}
 
-  return -1;
+
+/* GUI: copies the groups that have been read in the meantime, returns their SETTINGS_GRP_xxx mask */
+int screen_thread::take_settings(struct device_settings *dev_parms)
+{
+  int done;
+
+  done = __atomic_exchange_n(&settings_done, 0, __ATOMIC_ACQUIRE);
+
+  if(done)
+  {
+    read_settings_thread::copy_groups(dev_parms, settings_buf, done);
+  }
+
+  return done;
 }
 
 
-void screen_thread::run()
+/* GUI: the thread must not run */
+void screen_thread::cancel_settings(int mask)
+{
+  __atomic_and_fetch(&settings_req, ~mask, __ATOMIC_RELEASE);
+
+  __atomic_and_fetch(&settings_done, ~mask, __ATOMIC_RELEASE);
+}
+
+
+void screen_thread::acquire()
 {
-  int i, j, k, n=0, chns=0, line, cmd_sent=0;
+  int i, k, n=0, chns=0, line, cmd_sent=0, multi_smps;
 
   char str[512];
 
+  const char *wav_cmds[3];
+
+  unsigned char *raw;
+
+  long long stg_t;
+
   double y_incr, binsz;
 
   params.error_stat = 0;
@@ -476,6 +1106,8 @@ void screen_thread::run()
   {
     usleep(TMC_GDS_DELAY);
 
+    tmc_shadow_invalidate(deviceparms->cmd_cue[params.cmd_cue_idx_out]);
+
     tmc_write(deviceparms->cmd_cue[params.cmd_cue_idx_out]);
 
     if(deviceparms->cmd_cue_resp[params.cmd_cue_idx_out] != NULL)
@@ -649,6 +1281,8 @@ void screen_thread::run()
     params.cmd_cue_idx_out %= TMC_CMD_CUE_SZ;
 
     cmd_sent = 1;
+
+    slow_poll_due = 1;  // the command may have changed the samplerate, memory depth, etc.
   }
 
   if(cmd_sent)
@@ -660,8 +1294,12 @@ void screen_thread::run()
     return;
   }
 
+  stg_t = stgtmr_begin();
+
   params.error_stat = get_devicestatus();
 
+  stgtmr_end(STGTMR_DEVSTATUS, stg_t);
+
   if(params.error_stat)
   {
     h_busy = 0;
@@ -695,6 +1333,17 @@ void screen_thread::run()
 
   params.result = TMC_THRD_RESULT_SCRN;
 
+  multi_smps = -1;
+
+  if((chns > 1) && (params.modelserie == 7) && params.wav_multichn)
+  {
+    if(get_multichn_waveform(chns, &multi_smps))
+    {
+      line = params.error_line;
+      goto OUT_ERROR;
+    }
+  }
+
 //struct waveform_preamble wfp;
 
 //  if(params.triggerstatus != 1)  // Don't download waveform data when triggerstatus is "wait"
@@ -748,80 +1397,87 @@ void screen_thread::run()
 
 ///////////////////////////////////////////////////////////
 
-      snprintf(str, 512, ":WAV:SOUR CHAN%i", i + 1);
-
-      if(tmc_write(str) != 15)
+      if(multi_smps >= 0)  // all channels were already downloaded in one block
       {
-        printf("Can not write to device.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
+        n = multi_smps;
       }
-
-      if(tmc_write(":WAV:FORM BYTE") != 14)
+      else
       {
-        printf("Can not write to device.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        snprintf(str, 512, ":WAV:SOUR CHAN%i", i + 1);
 
-      if(tmc_write(":WAV:MODE NORM") != 14)
-      {
-        printf("Can not write to device.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        wav_cmds[0] = str;
+        wav_cmds[1] = ":WAV:FORM BYTE";
+        wav_cmds[2] = ":WAV:MODE NORM";
 
-      if(tmc_write(":WAV:XOR?") != 9)
-      {
-        printf("Can not write to device.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        stg_t = stgtmr_begin();
 
-      if(tmc_read() < 1)
-      {
-        printf("Can not read from device.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        if(tmc_write_batch_cached(wav_cmds, 3) != 3)  // only the settings that changed since the last frame are sent
+        {
+          printf("Can not write to device.\n");
+          line = __LINE__;
+          goto OUT_ERROR;
+        }
 
-      params.xorigin[i] = atof(device->buf);
+        if(tmc_write(":WAV:XOR?") != 9)
+        {
+          printf("Can not write to device.\n");
+          line = __LINE__;
+          goto OUT_ERROR;
+        }
 
-      if(tmc_write(":WAV:DATA?") != 10)
-      {
-        printf("Can not write to device.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        if(tmc_read() < 1)
+        {
+          printf("Can not read from device.\n");
+          line = __LINE__;
+          goto OUT_ERROR;
+        }
 
-      n = tmc_read();
+        params.xorigin[i] = atof(device->buf);
 
-      if(n < 0)
-      {
-        printf("Can not read from device. (n is %i)\n", n);
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        if(tmc_write(":WAV:DATA?") != 10)
+        {
+          printf("Can not write to device.\n");
+          line = __LINE__;
+          goto OUT_ERROR;
+        }
 
-      if(n > WAVFRM_MAX_BUFSZ)
-      {
-        printf("Datablock too big for buffer.\n");
-        line = __LINE__;
-        goto OUT_ERROR;
-      }
+        raw = (unsigned char *)params.wavebuf[i] + WAVFRM_MAX_BUFSZ;  // upper half of the buffer, widened in place below
 
-      if(n < 32)
-      {
-        n = 0;
-      }
+        n = tmc_read_block((char *)raw, WAVFRM_MAX_BUFSZ);
 
-      for(j=0; j<n; j++)
-      {
-        params.wavebuf[i][j] = (int)(((unsigned char *)device->buf)[j]) - 127;
+        if(n == -4)
+        {
+          printf("Datablock too big for buffer.\n");
+          line = __LINE__;
+          goto OUT_ERROR;
+        }
+
+        if(n < 0)
+        {
+          printf("Can not read from device. (n is %i)\n", n);
+          line = __LINE__;
+          goto OUT_ERROR;
+        }
+
+        stgtmr_end(STGTMR_TRANSPORT, stg_t);
+
+        if(n < 32)
+        {
+          n = 0;
+        }
+
+        stg_t = stgtmr_begin();
+
+        wavcnv_u8_to_s16(params.wavebuf[i], raw, n, 127, 0);
+
+        stgtmr_end(STGTMR_CONVERT, stg_t);
       }
 
+
       if((n == (params.fftbufsz * 2)) && (params.math_fft == 1) && (i == params.math_fft_src))
       {
+        stg_t = stgtmr_begin();
+
         if(params.modelserie == 6)
         {
           y_incr = params.chanscale[i] / 32.0;
@@ -833,10 +1489,7 @@ void screen_thread::run()
 
         binsz = (double)params.current_screen_sf / (params.fftbufsz * 2.0);
 
-        for(j=0; j<n; j++)
-        {
-          params.fftbuf_in[j] = params.wavebuf[i][j] * y_incr;
-        }
+        wavcnv_s16_to_double(params.fftbuf_in, params.wavebuf[i], n, y_incr);
 
         kiss_fftr(params.k_cfg, params.fftbuf_in, params.kiss_fftbuf);
 
@@ -873,6 +1526,8 @@ void screen_thread::run()
             params.fftbuf_out[k] = sqrt(params.fftbuf_out[k]);
           }
         }
+
+        stgtmr_end(STGTMR_FFT, stg_t);
       }
     }
 
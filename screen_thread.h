@@ -35,18 +35,113 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <limits.h>
 
 #include <QObject>
 #include <QThread>
+#include <QElapsedTimer>
 
 #include "global.h"
 #include "utils.h"
 #include "connection.h"
 #include "tmc_dev.h"
+#include "tmc_cmd.h"
+#include "wav_convert.h"
+#include "read_settings_thread.h"
+#include "stage_timer.h"
 
 #include "third_party/kiss_fft/kiss_fftr.h"
 
 
+/* number of frame buffers shared between the acquisition thread and the GUI */
+#define SCRN_FRAME_CNT        (3)
+
+#define SCRN_FRAME_IDX_MASK   (0xff)
+#define SCRN_FRAME_FRESH      (0x100)
+
+/* pause between frames when there is nothing to download (in milli-Sec.) */
+#define SCRN_STREAM_IDLE_MS   (20)
+
+/* queries of get_devicestatus(), the ones from SCRN_STAT_SLOW are read at a lower rate */
+#define SCRN_STAT_TRIG_STAT    (0)
+#define SCRN_STAT_TRIG_SWE     (1)
+#define SCRN_STAT_COUN_VAL     (2)
+#define SCRN_STAT_WREC_OPER    (3)
+#define SCRN_STAT_WREP_OPER    (4)
+#define SCRN_STAT_WREP_FCUR    (5)
+#define SCRN_STAT_SRAT         (6)
+#define SCRN_STAT_MDEP         (7)
+#define SCRN_STAT_WREC_FMAX    (8)
+#define SCRN_STAT_WREP_FMAX    (9)
+#define SCRN_STAT_CNT         (10)
+
+#define SCRN_STAT_SLOW         (SCRN_STAT_SRAT)
+
+/* interval of the slowly changing values of the device status (in milli-Sec.) */
+#define SCRN_SLOW_POLL_MS    (1000)
+
+
+struct scrn_frame
+{
+  int seq;
+  int result;
+  int error_stat;
+  int error_line;
+  int connected;
+  int triggerstatus;
+  int triggersweep;
+  double samplerate;
+  int memdepth;
+  double counterfreq;
+  int wavebufsz;
+  int chandisplay[MAX_CHNS];
+  short *wavebuf[MAX_CHNS];
+  double xorigin[MAX_CHNS];
+  double *fftbuf_out;
+  int cmd_cue_idx_out;
+  int wav_multichn;
+
+  int job_seq[4];  /* sequence number of the first frame that carries the result of a TMC_THRD_JOB_ */
+  double triggeredgelevel;
+  double timebasedelayoffset;
+  double timebasedelayscale;
+  double math_fft_hscale;
+  double math_fft_hcenter;
+
+  int func_wrec_operate;
+  int func_wplay_operate;
+  int func_wplay_fcur;
+  int func_wrec_fmax;
+  int func_wrep_fmax;
+};
+
+
+/* the settings of devparms the acquisition needs, copied by set_params() on the GUI thread */
+struct scrn_params_in
+{
+  int connected;
+  int modelserie;
+  int chandisplay[MAX_CHNS];
+  double chanscale[MAX_CHNS];
+  int countersrc;
+  int math_fft_src;
+  int math_fft;
+  int math_fft_unit;
+  double *fftbuf_in;
+  double *fftbuf_out;
+  int fftbufsz;
+  kiss_fftr_cfg k_cfg;
+  kiss_fft_cpx *kiss_fftbuf;
+  int current_screen_sf;
+  int func_wrec_enable;
+  int func_wrec_operate;
+  int func_wplay_operate;
+  int func_wplay_fcur;
+  int func_wrec_fmax;
+  int func_wrep_fmax;
+  int wav_multichn;
+};
+
 
 class screen_thread : public QThread
 {
@@ -64,6 +159,16 @@ public:
   void set_params(struct device_settings *);
   void get_params(struct device_settings *);
 
+  void start_streaming(struct device_settings *);
+  bool stop_streaming(unsigned long ms=ULONG_MAX);
+  int frame_pending();
+  int get_frame(struct device_settings *);
+  void detach_frames(struct device_settings *);
+
+  void request_settings(struct device_settings *, int);
+  int take_settings(struct device_settings *);
+  void cancel_settings(int);
+
 private:
 
   struct {
@@ -112,17 +217,68 @@ private:
 
     double xorigin[MAX_CHNS];
 
+    int wav_multichn;
+
     char debug_str[1024];
   } params;
 
   struct tmcdev *device;
 
-  struct device_settings *deviceparms;
+  struct device_settings *deviceparms;  /* the acquisition thread reads only the command cue from it */
+
+  struct scrn_params_in params_in;  /* latest copy of set_params(), protected by params_mtx */
+
+  pthread_mutex_t params_mtx;
+
+  int params_in_new;
+
+  struct scrn_frame frames[SCRN_FRAME_CNT];
+
+  int frm_back,    /* written by the acquisition thread */
+      frm_mid,     /* latest published frame, exchanged atomically, SCRN_FRAME_FRESH when not yet picked up */
+      frm_front,   /* in use by the GUI */
+      frm_seq,
+      frm_seq_gui,
+      stream_run;
+
+  int job_seq[4];
+
+  double *fftbuf_stream;
+
+  short *gui_wavebuf[MAX_CHNS];
+  double *gui_fftbuf_out;
+  int gui_attached;
+
+  read_settings_thread *settings_rd;
+
+  struct device_settings *settings_buf;
+
+  QElapsedTimer slow_poll_tmr;
+
+  int slow_poll_due,  /* read the slowly changing values of the device status with the next frame */
+      stat_compound;  /* 0 when the device status must be read with single queries */
+
+  int settings_req,   /* SETTINGS_GRP_xxx still to be read between frames */
+      settings_done;  /* SETTINGS_GRP_xxx read into settings_buf, not yet picked up by the GUI */
 
   void run();
 
+  void take_params();
+
+  void acquire();
+
+  void publish_frame();
+
+  void read_settings();
+
   int get_devicestatus();
 
+  int query_status(int);
+
+  int parse_status(int, const char *);
+
+  int get_multichn_waveform(int, int *);
+
 };
 
 
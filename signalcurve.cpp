@@ -139,8 +139,12 @@ void SignalCurve::setUpdatesEnabled(bool enabled)
 
 void SignalCurve::paintEvent(QPaintEvent *)
 {
+  long long stg_t;
+
   if(updates_enabled == false)  return;
 
+  stg_t = stgtmr_begin();
+
   QPainter paint(this);
 #if (QT_VERSION >= 0x050000) && (QT_VERSION < 0x060000)
   paint.setRenderHint(QPainter::Qt4CompatiblePainting, true);
@@ -153,6 +157,10 @@ void SignalCurve::paintEvent(QPaintEvent *)
   drawWidget(&paint, width(), height());
 
   old_w = width();
+
+  paint.end();
+
+  stgtmr_end(STGTMR_PAINT, stg_t);
 }
 
 
@@ -197,7 +205,11 @@ void SignalCurve::drawWidget(QPainter *painter, int curve_w, int curve_h)
 
   double h_step=0.0,
          step,
-         step2;
+         step2,
+         v_trace_offset,
+         ytmp;
+
+  QPointF *pnt;
 
 //  clk_start = clock();
 
@@ -466,39 +478,47 @@ void SignalCurve::drawWidget(QPainter *painter, int curve_w, int curve_h)
 
       painter->setPen(QPen(QBrush(SignalColor[chn], Qt::SolidPattern), tracewidth, Qt::SolidLine, Qt::SquareCap, Qt::BevelJoin));
 
-      for(i=0; i<bufsize; i++)
+      v_trace_offset = (curve_h / 2) - chan_tmp_y_pixel_offset[chn];
+
+      if(bufsize < (curve_w / 2))
       {
-        if(bufsize < (curve_w / 2))
+        /* every sample gets a horizontal step of h_step pixels */
+        trace_poly.resize(bufsize * 2);
+
+        pnt = trace_poly.data();
+
+        for(i=0; i<bufsize; i++)
         {
-          painter->drawLine(i * h_step + w_trace_offset,
-                            (devparms->wavebuf[chn][i] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn],
-                            (i + 1) * h_step + w_trace_offset,
-                            (devparms->wavebuf[chn][i] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn]);
-          if(i)
-          {
-            painter->drawLine(i * h_step + w_trace_offset,
-                              (devparms->wavebuf[chn][i - 1] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn],
-                              i * h_step + w_trace_offset,
-                              (devparms->wavebuf[chn][i] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn]);
-          }
+          ytmp = (devparms->wavebuf[chn][i] * v_sense) + v_trace_offset;
+
+          pnt[i * 2].rx() = i * h_step + w_trace_offset;
+          pnt[i * 2].ry() = ytmp;
+
+          pnt[(i * 2) + 1].rx() = (i + 1) * h_step + w_trace_offset;
+          pnt[(i * 2) + 1].ry() = ytmp;
+        }
+
+        painter->drawPolyline(trace_poly);
+      }
+      else
+      {
+        trace_poly.resize(bufsize);
+
+        pnt = trace_poly.data();
+
+        for(i=0; i<bufsize; i++)
+        {
+          pnt[i].rx() = i * h_step + w_trace_offset;
+          pnt[i].ry() = (devparms->wavebuf[chn][i] * v_sense) + v_trace_offset;
+        }
+
+        if(devparms->displaytype)
+        {
+          painter->drawPoints(trace_poly.constData(), bufsize - 1);
         }
         else
         {
-          if(i < (bufsize - 1))
-          {
-            if(devparms->displaytype)
-            {
-              painter->drawPoint(i * h_step + w_trace_offset,
-                                 (devparms->wavebuf[chn][i] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn]);
-            }
-            else
-            {
-              painter->drawLine(i * h_step + w_trace_offset,
-                                (devparms->wavebuf[chn][i] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn],
-                                (i + 1) * h_step + w_trace_offset,
-                                (devparms->wavebuf[chn][i + 1] * v_sense) + (curve_h / 2) - chan_tmp_y_pixel_offset[chn]);
-            }
-          }
+          painter->drawPolyline(trace_poly);
         }
       }
     }
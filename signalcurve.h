@@ -36,6 +36,7 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPainterPath>
+#include <QPolygonF>
 #include <QPushButton>
 #include <QPen>
 #include <QString>
@@ -54,6 +55,7 @@
 #include "connection.h"
 #include "tmc_dev.h"
 #include "utils.h"
+#include "stage_timer.h"
 
 
 
@@ -116,6 +118,8 @@ private:
 
   QFont smallfont;
 
+  QPolygonF trace_poly;
+
   double v_sense,
          fft_v_sense,
          fft_v_offset;
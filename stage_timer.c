@@ -0,0 +1,409 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "stage_timer.h"
+
+
+#define STGTMR_MAX_THREADS  (8)
+
+
+struct stgtmr_sample
+{
+  long long t_end;
+  long long dur;
+};
+
+
+/* ringbuffer, written by one thread only */
+struct stgtmr_hist
+{
+  struct stgtmr_sample smp[STGTMR_HIST_SZ];
+  int idx;  /* number of samples written since the last reset */
+};
+
+
+struct stgtmr_event
+{
+  int stage;
+  int tid;
+  long long t_begin;
+  long long dur;
+};
+
+
+static int stgtmr_on=0;
+
+static struct stgtmr_hist stgtmr_hists[STGTMR_CNT];
+
+static struct stgtmr_event *stgtmr_trace=NULL;
+
+static int stgtmr_trace_on=0,
+           stgtmr_trace_idx=0;
+
+static long long stgtmr_trace_t0=0;
+
+static __thread int stgtmr_tid=0;
+
+static const char *stgtmr_names[STGTMR_CNT]={"frame", "devicestatus", "transport", "convert", "fft", "decode", "paint"};
+
+
+static long long stgtmr_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
+void stgtmr_enable(int on)
+{
+  __atomic_store_n(&stgtmr_on, on ? 1 : 0, __ATOMIC_RELEASE);
+}
+
+
+int stgtmr_enabled(void)
+{
+  return __atomic_load_n(&stgtmr_on, __ATOMIC_ACQUIRE);
+}
+
+
+long long stgtmr_begin(void)
+{
+  if(!__atomic_load_n(&stgtmr_on, __ATOMIC_RELAXED))
+  {
+    return 0;
+  }
+
+  return stgtmr_now();
+}
+
+
+void stgtmr_end(int stage, long long t_begin)
+{
+  int idx, n;
+
+  long long t_end;
+
+  struct stgtmr_hist *hist;
+
+  struct stgtmr_event *ev;
+
+  if((!t_begin) || (stage < 0) || (stage >= STGTMR_CNT))
+  {
+    return;
+  }
+
+  t_end = stgtmr_now();
+
+  hist = &stgtmr_hists[stage];
+
+  idx = __atomic_load_n(&hist->idx, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&hist->smp[idx % STGTMR_HIST_SZ].t_end, t_end, __ATOMIC_RELAXED);
+  __atomic_store_n(&hist->smp[idx % STGTMR_HIST_SZ].dur, t_end - t_begin, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&hist->idx, idx + 1, __ATOMIC_RELEASE);
+
+  if(!__atomic_load_n(&stgtmr_trace_on, __ATOMIC_ACQUIRE))
+  {
+    return;
+  }
+
+  n = __atomic_fetch_add(&stgtmr_trace_idx, 1, __ATOMIC_RELAXED);
+  if(n >= STGTMR_TRACE_SZ)
+  {
+    return;
+  }
+
+  if(!stgtmr_tid)
+  {
+    stgtmr_tid = syscall(SYS_gettid);
+  }
+
+  ev = &stgtmr_trace[n];
+
+  ev->stage = stage;
+  ev->tid = stgtmr_tid;
+  ev->t_begin = t_begin;
+  ev->dur = t_end - t_begin;
+}
+
+
+const char * stgtmr_name(int stage)
+{
+  if((stage < 0) || (stage >= STGTMR_CNT))
+  {
+    return "";
+  }
+
+  return stgtmr_names[stage];
+}
+
+
+/*
+ * When the ringbuffer holds less than STGTMR_WINDOW_NS of samples,
+ * the statistics cover the time span of the ringbuffer.
+ */
+void stgtmr_get_stats(int stage, struct stgtmr_stats *st)
+{
+  int i, idx, oldest;
+
+  long long now, t_end, dur, span, sum=0, max=0;
+
+  memset(st, 0, sizeof(struct stgtmr_stats));
+
+  if((stage < 0) || (stage >= STGTMR_CNT))
+  {
+    return;
+  }
+
+  now = stgtmr_now();
+
+  span = STGTMR_WINDOW_NS;
+
+  idx = __atomic_load_n(&stgtmr_hists[stage].idx, __ATOMIC_ACQUIRE);
+
+  oldest = (idx > STGTMR_HIST_SZ) ? (idx - STGTMR_HIST_SZ) : 0;
+
+  for(i=idx-1; i>=oldest; i--)
+  {
+    t_end = __atomic_load_n(&stgtmr_hists[stage].smp[i % STGTMR_HIST_SZ].t_end, __ATOMIC_RELAXED);
+    dur = __atomic_load_n(&stgtmr_hists[stage].smp[i % STGTMR_HIST_SZ].dur, __ATOMIC_RELAXED);
+
+    if((now - t_end) > STGTMR_WINDOW_NS)
+    {
+      break;
+    }
+
+    if((i == oldest) && (idx > STGTMR_HIST_SZ))
+    {
+      span = now - t_end + dur;
+    }
+
+    sum += dur;
+
+    if(dur > max)
+    {
+      max = dur;
+    }
+
+    st->cnt++;
+  }
+
+  if((!st->cnt) || (span < 1))
+  {
+    return;
+  }
+
+  st->rate = st->cnt / (span / 1e9);
+  st->mean = (sum / st->cnt) / 1e6;
+  st->max = max / 1e6;
+  st->load = (double)sum / span;
+}
+
+
+void stgtmr_reset(void)
+{
+  int i;
+
+  for(i=0; i<STGTMR_CNT; i++)
+  {
+    __atomic_store_n(&stgtmr_hists[i].idx, 0, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&stgtmr_trace_idx, 0, __ATOMIC_RELEASE);
+
+  stgtmr_trace_t0 = stgtmr_now();
+}
+
+
+int stgtmr_trace_start(void)
+{
+  if(stgtmr_trace == NULL)
+  {
+    stgtmr_trace = (struct stgtmr_event *)calloc(STGTMR_TRACE_SZ, sizeof(struct stgtmr_event));
+    if(stgtmr_trace == NULL)
+    {
+      return -1;
+    }
+  }
+
+  stgtmr_trace_t0 = stgtmr_now();
+
+  __atomic_store_n(&stgtmr_trace_idx, 0, __ATOMIC_RELEASE);
+
+  __atomic_store_n(&stgtmr_trace_on, 1, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+
+void stgtmr_trace_stop(void)
+{
+  __atomic_store_n(&stgtmr_trace_on, 0, __ATOMIC_RELEASE);
+}
+
+
+int stgtmr_trace_recording(void)
+{
+  return __atomic_load_n(&stgtmr_trace_on, __ATOMIC_ACQUIRE);
+}
+
+
+int stgtmr_trace_cnt(void)
+{
+  int n;
+
+  if(stgtmr_trace == NULL)
+  {
+    return 0;
+  }
+
+  n = __atomic_load_n(&stgtmr_trace_idx, __ATOMIC_ACQUIRE);
+
+  return (n > STGTMR_TRACE_SZ) ? STGTMR_TRACE_SZ : n;
+}
+
+
+int stgtmr_trace_write_json(const char *path)
+{
+  int i, j, n, err, pid,
+      tids[STGTMR_MAX_THREADS],
+      tid_cnt=0;
+
+  FILE *f;
+
+  struct stgtmr_event *ev;
+
+  n = stgtmr_trace_cnt();
+
+  f = fopen(path, "wb");
+  if(f == NULL)
+  {
+    return -1;
+  }
+
+  pid = getpid();
+
+  fprintf(f, "{\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+
+  for(i=0; i<n; i++)
+  {
+    ev = &stgtmr_trace[i];
+
+    fprintf(f, "{\"name\": \"%s\", \"cat\": \"screen\", \"ph\": \"X\", \"pid\": %i, \"tid\": %i, \"ts\": %.3f, \"dur\": %.3f},\n",
+            stgtmr_names[ev->stage], pid, ev->tid, (ev->t_begin - stgtmr_trace_t0) / 1e3, ev->dur / 1e3);
+
+    for(j=0; j<tid_cnt; j++)
+    {
+      if(tids[j] == ev->tid)  break;
+    }
+
+    if((j == tid_cnt) && (tid_cnt < STGTMR_MAX_THREADS))
+    {
+      tids[tid_cnt++] = ev->tid;
+
+      /* the GUI thread times the decoder and the painting, the screen thread does the rest */
+      fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %i, \"tid\": %i, \"args\": {\"name\": \"%s\"}},\n",
+              pid, ev->tid, (ev->stage >= STGTMR_DECODE) ? "GUI" : "screen_thread");
+    }
+  }
+
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %i, \"tid\": 0, \"args\": {\"name\": \"DSRemote\"}}\n]}\n", pid);
+
+  err = ferror(f);
+
+  if(fclose(f))  err = 1;
+
+  return err ? -1 : 0;
+}
+
+
+int stgtmr_trace_write_csv(const char *path)
+{
+  int i, n, err;
+
+  FILE *f;
+
+  struct stgtmr_event *ev;
+
+  n = stgtmr_trace_cnt();
+
+  f = fopen(path, "wb");
+  if(f == NULL)
+  {
+    return -1;
+  }
+
+  fprintf(f, "stage,thread,start_us,duration_us\n");
+
+  for(i=0; i<n; i++)
+  {
+    ev = &stgtmr_trace[i];
+
+    fprintf(f, "%s,%i,%.3f,%.3f\n",
+            stgtmr_names[ev->stage], ev->tid, (ev->t_begin - stgtmr_trace_t0) / 1e3, ev->dur / 1e3);
+  }
+
+  err = ferror(f);
+
+  if(fclose(f))  err = 1;
+
+  return err ? -1 : 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
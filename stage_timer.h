@@ -0,0 +1,135 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* stages of the screen loop */
+#define STGTMR_FRAME        (0)  /* screen_thread: one pass of the acquisition loop */
+#define STGTMR_DEVSTATUS    (1)  /* screen_thread: get_devicestatus() */
+#define STGTMR_TRANSPORT    (2)  /* screen_thread: waveform readout, :WAV:xxx and :WAV:DATA? */
+#define STGTMR_CONVERT      (3)  /* screen_thread: ADC codes to samples */
+#define STGTMR_FFT          (4)  /* screen_thread: FFT of the math channel */
+#define STGTMR_DECODE       (5)  /* GUI: serial_decoder() */
+#define STGTMR_PAINT        (6)  /* GUI: painting the trace */
+
+#define STGTMR_CNT          (7)
+
+/* number of recent samples per stage the statistics are calculated from */
+#define STGTMR_HIST_SZ   (1024)
+
+/* the statistics cover the samples of the last 2 seconds */
+#define STGTMR_WINDOW_NS  (2000000000LL)
+
+/* max. number of events in a recorded trace */
+#define STGTMR_TRACE_SZ  (1 << 18)
+
+
+struct stgtmr_stats
+{
+  int cnt;         /* samples in the window */
+  double rate,     /* samples per second */
+         mean,     /* milli-Sec. */
+         max,      /* milli-Sec. */
+         load;     /* fraction of the window spent in this stage */
+};
+
+
+/*
+ * The timers are always compiled in but do nothing when disabled,
+ * stgtmr_begin() then returns 0 and stgtmr_end() returns immediately.
+ * Every stage must be timed by one thread only.
+ */
+void stgtmr_enable(int);
+
+int stgtmr_enabled(void);
+
+/* returns a timestamp in nano-Sec. or 0 when the timers are disabled */
+long long stgtmr_begin(void);
+
+void stgtmr_end(int stage, long long t_begin);
+
+const char * stgtmr_name(int stage);
+
+void stgtmr_get_stats(int stage, struct stgtmr_stats *);
+
+/* clears the statistics and the recorded trace */
+void stgtmr_reset(void);
+
+/* starts recording all timed events, returns -1 on malloc error */
+int stgtmr_trace_start(void);
+
+void stgtmr_trace_stop(void);
+
+int stgtmr_trace_recording(void);
+
+/* number of recorded events */
+int stgtmr_trace_cnt(void);
+
+/* writes the recorded events in Chrome trace format (chrome://tracing, Perfetto), returns 0 on success */
+int stgtmr_trace_write_json(const char *path);
+
+/* writes the recorded events as CSV: stage, thread, start and duration in micro-Sec., returns 0 on success */
+int stgtmr_trace_write_csv(const char *path);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
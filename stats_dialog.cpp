@@ -0,0 +1,312 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include "stats_dialog.h"
+
+
+
+UI_stats_window::UI_stats_window(QWidget *w_parent)
+{
+  int i, j;
+
+  const char *hdr[5]={"Stage", "Calls/s", "Mean", "Max", "Load"};
+
+  mainwindow = (UI_Mainwindow *)w_parent;
+
+  setWindowTitle("Performance statistics");
+
+  setMinimumSize(480, 350);
+  setMaximumSize(480, 350);
+
+  setAttribute(Qt::WA_DeleteOnClose, true);
+
+  enable_checkbox = new QCheckBox("Stage timers", this);
+  enable_checkbox->setGeometry(20, 15, 200, 25);
+  enable_checkbox->setTristate(false);
+  if(stgtmr_enabled())
+  {
+    enable_checkbox->setCheckState(Qt::Checked);
+  }
+  else
+  {
+    enable_checkbox->setCheckState(Qt::Unchecked);
+  }
+  enable_checkbox->setToolTip("Measures the time spent in every stage of the screen loop");
+
+  for(i=0; i<=STGTMR_CNT; i++)
+  {
+    for(j=0; j<5; j++)
+    {
+      stats_label[i][j] = new QLabel(this);
+      stats_label[i][j]->setGeometry(j ? (60 + (j * 80)) : 20, 50 + (i * 25), j ? 80 : 120, 25);
+      if(j)
+      {
+        stats_label[i][j]->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+      }
+
+      if(!i)
+      {
+        stats_label[i][j]->setText(hdr[j]);
+      }
+      else if(!j)
+        {
+          stats_label[i][j]->setText(stgtmr_name(i - 1));
+        }
+    }
+  }
+
+  trace_label = new QLabel(this);
+  trace_label->setGeometry(20, 255, 440, 25);
+
+  record_button = new QPushButton(this);
+  record_button->setGeometry(20, 305, 100, 25);
+  record_button->setText("Record trace");
+  record_button->setAutoDefault(false);
+  record_button->setDefault(false);
+
+  export_button = new QPushButton(this);
+  export_button->setGeometry(130, 305, 100, 25);
+  export_button->setText("Export trace");
+  export_button->setAutoDefault(false);
+  export_button->setDefault(false);
+
+  reset_button = new QPushButton(this);
+  reset_button->setGeometry(240, 305, 100, 25);
+  reset_button->setText("Reset");
+  reset_button->setAutoDefault(false);
+  reset_button->setDefault(false);
+
+  close_button = new QPushButton(this);
+  close_button->setGeometry(360, 305, 100, 25);
+  close_button->setText("Close");
+  close_button->setAutoDefault(false);
+  close_button->setDefault(false);
+
+  t1 = new QTimer(this);
+
+  connect(enable_checkbox, SIGNAL(stateChanged(int)), this, SLOT(enable_checkbox_changed(int)));
+  connect(record_button,   SIGNAL(clicked()),         this, SLOT(record_button_clicked()));
+  connect(export_button,   SIGNAL(clicked()),         this, SLOT(export_button_clicked()));
+  connect(reset_button,    SIGNAL(clicked()),         this, SLOT(reset_button_clicked()));
+  connect(close_button,    SIGNAL(clicked()),         this, SLOT(close()));
+  connect(t1,              SIGNAL(timeout()),         this, SLOT(t1_func()));
+
+  t1_func();
+
+  t1->start(500);
+
+  show();
+}
+
+
+void UI_stats_window::t1_func()
+{
+  int i;
+
+  char str[256];
+
+  struct stgtmr_stats st;
+
+  for(i=0; i<STGTMR_CNT; i++)
+  {
+    stgtmr_get_stats(i, &st);
+
+    if(!st.cnt)
+    {
+      stats_label[i + 1][1]->setText("-");
+      stats_label[i + 1][2]->setText("-");
+      stats_label[i + 1][3]->setText("-");
+      stats_label[i + 1][4]->setText("-");
+
+      continue;
+    }
+
+    snprintf(str, 256, "%.1f", st.rate);
+    stats_label[i + 1][1]->setText(str);
+
+    snprintf(str, 256, "%.2f mS", st.mean);
+    stats_label[i + 1][2]->setText(str);
+
+    snprintf(str, 256, "%.2f mS", st.max);
+    stats_label[i + 1][3]->setText(str);
+
+    snprintf(str, 256, "%.1f %%", st.load * 100.0);
+    stats_label[i + 1][4]->setText(str);
+  }
+
+  if(stgtmr_trace_recording())
+  {
+    snprintf(str, 256, "Recording trace: %i events", stgtmr_trace_cnt());
+
+    if(stgtmr_trace_cnt() >= STGTMR_TRACE_SZ)
+    {
+      stgtmr_trace_stop();
+
+      record_button->setText("Record trace");
+
+      strlcat(str, " (full)", 256);
+    }
+  }
+  else
+  {
+    snprintf(str, 256, "Trace: %i events", stgtmr_trace_cnt());
+  }
+
+  trace_label->setText(str);
+
+  export_button->setEnabled((stgtmr_trace_cnt() > 0) && (!stgtmr_trace_recording()));
+}
+
+
+void UI_stats_window::enable_checkbox_changed(int state)
+{
+  QSettings settings;
+
+  if(state == Qt::Checked)
+  {
+    stgtmr_enable(1);
+  }
+  else
+  {
+    stgtmr_enable(0);
+
+    stgtmr_trace_stop();
+
+    record_button->setText("Record trace");
+  }
+
+  settings.setValue("gui/stage_timers", stgtmr_enabled());
+
+  t1_func();
+}
+
+
+void UI_stats_window::record_button_clicked()
+{
+  if(stgtmr_trace_recording())
+  {
+    stgtmr_trace_stop();
+
+    record_button->setText("Record trace");
+
+    t1_func();
+
+    return;
+  }
+
+  if(stgtmr_trace_start())
+  {
+    QMessageBox msgBox;
+    msgBox.setIcon(QMessageBox::Critical);
+    msgBox.setText("Malloc error.");
+    msgBox.exec();
+
+    return;
+  }
+
+  enable_checkbox->setCheckState(Qt::Checked);  // the trace needs the timers
+
+  record_button->setText("Stop");
+
+  t1_func();
+}
+
+
+void UI_stats_window::export_button_clicked()
+{
+  int len, err;
+
+  char opath[MAX_PATHLEN];
+
+  opath[0] = 0;
+  if(mainwindow->recent_savedir[0]!=0)
+  {
+    strlcpy(opath, mainwindow->recent_savedir, MAX_PATHLEN);
+    strlcat(opath, "/", MAX_PATHLEN);
+  }
+  strlcat(opath, "dsremote_trace.json", MAX_PATHLEN);
+
+  strlcpy(opath, QFileDialog::getSaveFileName(this, "Export trace", opath,
+          "Chrome trace files (*.json *.JSON);;CSV files (*.csv *.CSV)").toLocal8Bit().data(), MAX_PATHLEN);
+
+  if(!strcmp(opath, ""))
+  {
+    return;
+  }
+
+  get_directory_from_path(mainwindow->recent_savedir, opath, MAX_PATHLEN);
+
+  len = strlen(opath);
+
+  if((len > 4) && (!strcasecmp(opath + len - 4, ".csv")))
+  {
+    err = stgtmr_trace_write_csv(opath);
+  }
+  else
+  {
+    err = stgtmr_trace_write_json(opath);
+  }
+
+  if(err)
+  {
+    QMessageBox msgBox;
+    msgBox.setIcon(QMessageBox::Critical);
+    msgBox.setText("Can not write the trace file.");
+    msgBox.exec();
+  }
+}
+
+
+void UI_stats_window::reset_button_clicked()
+{
+  stgtmr_reset();
+
+  t1_func();
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
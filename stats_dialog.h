@@ -0,0 +1,106 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#ifndef UI_STATS_DIALOG_H
+#define UI_STATS_DIALOG_H
+
+
+#include "qt_headers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "mainwindow.h"
+#include "utils.h"
+#include "stage_timer.h"
+
+
+
+class UI_Mainwindow;
+
+
+
+/* rolling statistics of the stage timers of the screen loop, see stage_timer.h */
+class UI_stats_window : public QDialog
+{
+  Q_OBJECT
+
+public:
+  UI_stats_window(QWidget *parent);
+
+  UI_Mainwindow *mainwindow;
+
+private:
+
+  QCheckBox *enable_checkbox;
+
+  QLabel *stats_label[STGTMR_CNT + 1][5],
+         *trace_label;
+
+  QPushButton *record_button,
+              *export_button,
+              *reset_button,
+              *close_button;
+
+  QTimer *t1;
+
+private slots:
+
+  void t1_func();
+  void enable_checkbox_changed(int);
+  void record_button_clicked();
+  void export_button_clicked();
+  void reset_button_clicked();
+};
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -128,6 +128,22 @@ void UI_Mainwindow::scrn_timer_handler()
     return;
   }
 
+  if(devparms.acq_streaming)
+  {
+    if((!scrn_thread->isRunning()) && (!scrn_thread->frame_pending()))
+    {
+      scrn_thread->start_streaming(&devparms);  // (re)start after connect or after exclusive device access
+    }
+    else
+    {
+      scrn_thread->set_params(&devparms);  // the settings for the next frame
+    }
+
+    screenUpdate();
+
+    return;
+  }
+
   scrn_thread->set_params(&devparms);
 
   scrn_thread->start();
@@ -0,0 +1,246 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tmc_cmd.h"
+#include "utils.h"
+
+
+
+int tmc_cmd_class(const char *cmd)
+{
+  int len;
+
+  len = strlen(cmd);
+
+  if(len < 1)
+  {
+    return TMC_CMD_CLASS_SETTING;
+  }
+
+  if(cmd[len - 1] == '?')
+  {
+    return TMC_CMD_CLASS_QUERY;
+  }
+
+  if((!strncmp(cmd, "*RST", 4)) || (!strncmp(cmd, ":AUT", 4)))
+  {
+    return TMC_CMD_CLASS_SLOW;
+  }
+
+  if(!strncmp(cmd, ":WAV:", 5))
+  {
+    return TMC_CMD_CLASS_WAV;
+  }
+
+  return TMC_CMD_CLASS_SETTING;
+}
+
+
+void tmc_cmd_default_policy(struct tmc_compl_policy *pol)
+{
+  pol[TMC_CMD_CLASS_QUERY].policy = TMC_COMPL_NONE;
+  pol[TMC_CMD_CLASS_QUERY].delay = 0;
+
+  /* the waveform readout setup is handled immediately, no need to wait before polling */
+  pol[TMC_CMD_CLASS_WAV].policy = TMC_COMPL_OPC;
+  pol[TMC_CMD_CLASS_WAV].delay = 0;
+
+  pol[TMC_CMD_CLASS_SETTING].policy = TMC_COMPL_OPC;
+  pol[TMC_CMD_CLASS_SETTING].delay = 25000;
+
+  pol[TMC_CMD_CLASS_SLOW].policy = TMC_COMPL_NONE;
+  pol[TMC_CMD_CLASS_SLOW].delay = 0;
+
+  pol[TMC_CMD_CLASS_QUERY].timeout = 5000;
+  pol[TMC_CMD_CLASS_WAV].timeout = 5000;
+  pol[TMC_CMD_CLASS_SETTING].timeout = 5000;
+  pol[TMC_CMD_CLASS_SLOW].timeout = 10000;
+}
+
+
+int tmc_cmd_quiet(const char *cmd)
+{
+  if(!strncmp(cmd, ":TRIG:STAT?", 11) ||  /* don't print these commands to the console */
+     !strncmp(cmd, ":TRIG:SWE?", 10) ||   /* because they are used repeatedly */
+     !strncmp(cmd, ":WAV:DATA?", 10) ||
+     !strncmp(cmd, ":WAV:MODE NORM", 14) ||
+     !strncmp(cmd, ":WAV:FORM BYTE", 14) ||
+     !strncmp(cmd, ":WAV:SOUR CHAN", 14) ||
+     !strncmp(cmd, ":ACQ:SRAT?", 10) ||
+     !strncmp(cmd, ":ACQ:MDEP?", 10) ||
+     !strncmp(cmd, ":MEAS:COUN:VAL?", 15) ||
+     !strncmp(cmd, ":FUNC:WREC:OPER?", 16) ||
+     !strncmp(cmd, ":FUNC:WREP:OPER?", 16) ||
+     !strncmp(cmd, ":FUNC:WREP:FMAX?", 16) ||
+     !strncmp(cmd, ":FUNC:WREC:FMAX?", 16) ||
+     !strncmp(cmd, ":FUNC:WREP:FCUR?", 16) ||
+     !strncmp(cmd, ":WAV:XOR?", 9))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int tmc_cmd_join(char *dest, int sz, const char * const *cmds, int n, int opc)
+{
+  int i, len, total=0;
+
+  if((sz < (TMC_CMD_MAX_LEN + 16)) || (n < 1))
+  {
+    return -1;
+  }
+
+  dest[0] = 0;
+
+  for(i=0; i<n; i++)
+  {
+    len = strlen(cmds[i]);
+
+    if((len < 2) || (len > TMC_CMD_MAX_LEN))
+    {
+      return -1;
+    }
+
+    if(tmc_cmd_class(cmds[i]) == TMC_CMD_CLASS_QUERY)
+    {
+      return -1;
+    }
+
+    if(i)
+    {
+      if((total + 1 + len) > TMC_CMD_MAX_LEN)
+      {
+        break;
+      }
+
+      strlcat(dest, ";", sz);
+
+      total++;
+    }
+
+    strlcat(dest, cmds[i], sz);
+
+    total += len;
+  }
+
+  if(opc)
+  {
+    strlcat(dest, ";*OPC?", sz);
+  }
+
+  strlcat(dest, "\n", sz);
+
+  return i;
+}
+
+
+int tmc_cmd_join_query(char *dest, int sz, const char * const *cmds, int n)
+{
+  int i, len, total=0;
+
+  if((sz < (TMC_CMD_MAX_LEN + 16)) || (n < 1))
+  {
+    return -1;
+  }
+
+  dest[0] = 0;
+
+  for(i=0; i<n; i++)
+  {
+    len = strlen(cmds[i]);
+
+    if((len < 2) || (len > TMC_CMD_MAX_LEN))
+    {
+      return -1;
+    }
+
+    if(tmc_cmd_class(cmds[i]) != TMC_CMD_CLASS_QUERY)
+    {
+      return -1;
+    }
+
+    if(i)
+    {
+      if((total + 1 + len) > TMC_CMD_MAX_LEN)
+      {
+        break;
+      }
+
+      strlcat(dest, ";", sz);
+
+      total++;
+    }
+
+    strlcat(dest, cmds[i], sz);
+
+    total += len;
+  }
+
+  return i;
+}
+
+
+int tmc_cmd_split(char *resp, char **fields, int max_fields)
+{
+  int n=0;
+
+  char *ptr;
+
+  if(max_fields < 1)
+  {
+    return 0;
+  }
+
+  fields[n++] = resp;
+
+  for(ptr=resp; *ptr; ptr++)
+  {
+    if(*ptr == ';')
+    {
+      *ptr = 0;
+
+      if(n == max_fields)
+      {
+        return n + 1;  /* more fields than expected */
+      }
+
+      fields[n++] = ptr + 1;
+    }
+  }
+
+  return n;
+}
+
@@ -0,0 +1,99 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#ifndef TMC_CMD_H
+#define TMC_CMD_H
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define TMC_CMD_MAX_LEN         (255)
+
+#define TMC_CMD_CLASS_QUERY       (0)  /* command ends with '?', the response is the synchronisation */
+#define TMC_CMD_CLASS_WAV         (1)  /* waveform readout setup, :WAV:SOUR, :WAV:FORM, :WAV:MODE, etc. */
+#define TMC_CMD_CLASS_SETTING     (2)  /* all other setters */
+#define TMC_CMD_CLASS_SLOW        (3)  /* *RST and :AUT, caller waits itself */
+
+#define TMC_CMD_CLASS_CNT         (4)
+
+#define TMC_COMPL_NONE            (0)  /* return immediately after sending */
+#define TMC_COMPL_OPC             (1)  /* wait <delay> uSec, then poll *OPC? */
+#define TMC_COMPL_DELAY           (2)  /* wait <delay> uSec */
+
+
+struct tmc_compl_policy
+{
+  int policy;  /* TMC_COMPL_NONE, TMC_COMPL_OPC or TMC_COMPL_DELAY */
+  int delay;   /* micro-Sec */
+  int timeout; /* milli-Sec, maximum time the response may stall */
+};
+
+
+/* returns one of TMC_CMD_CLASS_xxx */
+int tmc_cmd_class(const char *);
+
+/* fills an array of TMC_CMD_CLASS_CNT policies with the default values */
+void tmc_cmd_default_policy(struct tmc_compl_policy *);
+
+/* returns 1 for commands that are sent repeatedly and must not be printed to the console */
+int tmc_cmd_quiet(const char *);
+
+/* Joins as many setters from cmds[] as fit in one transmission, separated by ';'.
+ * If opc is non-zero, ";*OPC?" is appended. A newline is always appended.
+ * sz is the size of dest, it must be at least TMC_CMD_MAX_LEN + 16.
+ * Returns the number of commands consumed from cmds[] or -1 on error
+ * (query in the list or a single command that is too long).
+ */
+int tmc_cmd_join(char *dest, int sz, const char * const *cmds, int n, int opc);
+
+/* Joins as many queries from cmds[] as fit in one transmission, separated by ';'.
+ * No newline is appended, the result is meant for tmc_write().
+ * sz is the size of dest, it must be at least TMC_CMD_MAX_LEN + 16.
+ * Returns the number of queries consumed from cmds[] or -1 on error
+ * (setter in the list or a single query that is too long).
+ */
+int tmc_cmd_join_query(char *dest, int sz, const char * const *cmds, int n);
+
+/* Splits the response of a compound query in place at the ';' separators.
+ * Returns the number of fields stored in fields[] or max_fields + 1
+ * if the response has more fields than that.
+ */
+int tmc_cmd_split(char *resp, char **fields, int max_fields);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -30,9 +30,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 #include <linux/usb/tmc.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
 
 #include "tmc_dev.h"
 #include "utils.h"
@@ -42,6 +44,39 @@
 #define MAX_CMD_LEN     (255)
 #define MAX_RESP_LEN    (1024 * 1024 * 2)
 
+/* size of the first transfer of a block read, the rest goes directly into the destination */
+#define TMC_BLOCK_FIRST_READ  (4096)
+
+#define TMC_USB_MIN_TIMEOUT    (100)  /* milli-Sec, the usbtmc driver does not accept less */
+#define TMC_USB_DEF_TIMEOUT   (5000)  /* milli-Sec, default of the usbtmc driver */
+
+
+/*
+ * Optimized usbtmc path (the default, tmcdev_set_fastpath() selects the plain path for comparison):
+ * - the driver timeout follows the timeout of the command class (struct tmc_compl_policy)
+ * - the driver aborts the bulk-in transfer after an error so that the next response is in sync
+ * - a setter that needs *OPC? is sent as "<cmd>;*OPC?", one write and one read instead of two writes
+ * - a block is read in two transfers: the header with the first part of the payload,
+ *   then the rest of the payload together with the newline
+ * The device ends every response with EOM, so TermChar is not used, a block can contain the newline byte.
+ */
+struct tmc_usb
+{
+  int fast;
+  int api;  /* API version of the usbtmc driver, 0 when the driver does not report it */
+  int tmo;  /* milli-Sec, timeout the driver is set to */
+};
+
+
+
+static long long tmcdev_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
 
 
 struct tmcdev * tmcdev_open(const char *device)
@@ -65,10 +100,26 @@ struct tmcdev * tmcdev_open(const char *device)
 
   dev->buf = dev->hdrbuf;
 
+  dev->conn_type = TMC_CONN_USB;
+
+  tmc_cmd_default_policy(dev->cmd_compl);
+
+  dev->usb = (struct tmc_usb *)calloc(1, sizeof(struct tmc_usb));
+  if(dev->usb == NULL)
+  {
+    free(dev->hdrbuf);
+
+    free(dev);
+
+    return NULL;
+  }
+
   dev->fd = open(device, O_RDWR);
 
   if(dev->fd == -1)
   {
+    free(dev->usb);
+
     free(dev->hdrbuf);
 
     free(dev);
@@ -76,10 +127,104 @@ struct tmcdev * tmcdev_open(const char *device)
     return NULL;
   }
 
+  tmcdev_set_fastpath(dev, 1);
+
   return dev;
 }
 
 
+void tmcdev_set_fastpath(struct tmcdev *dev, int fast)
+{
+  __u32 val;
+
+  if((dev == NULL) || (dev->usb == NULL))
+  {
+    return;
+  }
+
+  dev->usb->fast = fast ? 1 : 0;
+
+#ifdef USBTMC_IOCTL_API_VERSION
+  if(dev->usb->fast && (!dev->usb->api))
+  {
+    if(ioctl(dev->fd, USBTMC_IOCTL_API_VERSION, &val) == 0)
+    {
+      dev->usb->api = val;
+
+      printf("tmc_dev: usbtmc driver API version %i\n", dev->usb->api);
+    }
+  }
+#endif
+
+#ifdef USBTMC_IOCTL_AUTO_ABORT
+  {
+    __u8 on;
+
+    on = dev->usb->fast;
+
+    if(ioctl(dev->fd, USBTMC_IOCTL_AUTO_ABORT, &on) && dev->usb->fast)
+    {
+      printf("tmc_dev: the usbtmc driver does not abort a failed transfer\n");
+    }
+  }
+#endif
+
+  if(!dev->usb->fast)  /* back to the driver default */
+  {
+    val = TMC_USB_DEF_TIMEOUT;
+
+    ioctl(dev->fd, USBTMC_IOCTL_SET_TIMEOUT, &val);
+  }
+
+  dev->usb->tmo = 0;
+
+  if(ioctl(dev->fd, USBTMC_IOCTL_GET_TIMEOUT, &val) == 0)
+  {
+    dev->usb->tmo = val;
+  }
+}
+
+
+int tmcdev_get_fastpath(struct tmcdev *dev)
+{
+  if((dev == NULL) || (dev->usb == NULL))
+  {
+    return 0;
+  }
+
+  return dev->usb->fast;
+}
+
+
+/* sets the driver timeout to the timeout of the command class, only when it changes */
+static void tmcdev_set_timeout(struct tmcdev *dev, int msec)
+{
+  __u32 tmo;
+
+  if(!dev->usb->fast)
+  {
+    return;
+  }
+
+  if(msec < TMC_USB_MIN_TIMEOUT)
+  {
+    msec = TMC_USB_MIN_TIMEOUT;
+  }
+
+  if(msec == dev->usb->tmo)
+  {
+    return;
+  }
+
+  tmo = msec;
+
+  if(ioctl(dev->fd, USBTMC_IOCTL_SET_TIMEOUT, &tmo) == 0)
+  {
+    dev->usb->tmo = msec;
+  }
+}
+
+
 void tmcdev_close(struct tmcdev *dev)
 {
   if(dev == NULL)
@@ -89,18 +234,86 @@ void tmcdev_close(struct tmcdev *dev)
 
   close(dev->fd);
 
+  free(dev->usb);
+
   free(dev->hdrbuf);
 
   free(dev);
 }
 
 
+static int tmcdev_wait_opc(struct tmcdev *dev, int delay)
+{
+  int i, n;
+
+  char str[256];
+
+  for(i=0; i<20; i++)
+  {
+    if(delay > 0)
+    {
+      usleep(delay);
+    }
+
+    n = write(dev->fd, "*OPC?\n", 6);
+
+    if(n < 0)
+    {
+      printf("tmcdev error: device write error");
+
+      return -1;
+    }
+
+    n = read(dev->fd, str, 128);
+
+    if(n < 0)
+    {
+      printf("tmcdev error: device read error");
+
+      return -1;
+    }
+
+    if(n == 2)
+    {
+      if(str[0] == '1')
+      {
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+static int tmcdev_complete(struct tmcdev *dev, int cmd_class)
+{
+  struct tmc_compl_policy *pol;
+
+  pol = &dev->cmd_compl[cmd_class];
+
+  if(pol->policy == TMC_COMPL_OPC)
+  {
+    return tmcdev_wait_opc(dev, pol->delay);
+  }
+
+  if(pol->policy == TMC_COMPL_DELAY)
+  {
+    if(pol->delay > 0)
+    {
+      usleep(pol->delay);
+    }
+  }
+
+  return 0;
+}
+
+
 int tmcdev_write(struct tmcdev *dev, const char *cmd)
 {
-  int i, n, len, qry=0;
+  int n, len, cmd_class;
 
-  char buf[MAX_CMD_LEN + 16],
-       str[256];
+  char buf[MAX_CMD_LEN + 16];
 
   if(dev == NULL)
   {
@@ -123,40 +336,32 @@ int tmcdev_write(struct tmcdev *dev, const char *cmd)
     return -1;
   }
 
-  if(cmd[len - 1] == '?')
+  cmd_class = tmc_cmd_class(cmd);
+
+  if(dev->usb->fast)
   {
-    qry = 1;
+    if((cmd_class != TMC_CMD_CLASS_QUERY) && (dev->cmd_compl[cmd_class].policy == TMC_COMPL_OPC))
+    {
+      if(tmcdev_write_batch(dev, &cmd, 1) != 1)  /* sends "<cmd>;*OPC?" */
+      {
+        return -1;
+      }
+
+      return len;
+    }
+
+    tmcdev_set_timeout(dev, dev->cmd_compl[cmd_class].timeout);
   }
 
   strlcpy(buf, cmd, MAX_CMD_LEN + 16);
 
   strlcat(buf, "\n", MAX_CMD_LEN + 16);
 
-  if(!(!strncmp(buf, ":TRIG:STAT?", 11) ||  /* don't print these commands to the console */
-       !strncmp(buf, ":TRIG:SWE?", 10) ||   /* because they are used repeatedly */
-       !strncmp(buf, ":WAV:DATA?", 10) ||
-       !strncmp(buf, ":WAV:MODE NORM", 14) ||
-       !strncmp(buf, ":WAV:FORM BYTE", 14) ||
-       !strncmp(buf, ":WAV:SOUR CHAN", 14) ||
-       !strncmp(buf, ":TRIG:SWE?", 10) ||
-       !strncmp(buf, ":ACQ:SRAT?", 10) ||
-       !strncmp(buf, ":ACQ:MDEP?", 10) ||
-       !strncmp(buf, ":MEAS:COUN:VAL?", 15) ||
-       !strncmp(buf, ":FUNC:WREC:OPER?", 16) ||
-       !strncmp(buf, ":FUNC:WREP:OPER?", 16) ||
-       !strncmp(buf, ":FUNC:WREP:FMAX?", 16) ||
-       !strncmp(buf, ":FUNC:WREC:FMAX?", 16) ||
-       !strncmp(buf, ":FUNC:WREP:FCUR?", 16) ||
-       !strncmp(buf, ":WAV:XOR?", 9)))
+  if(!tmc_cmd_quiet(buf))
   {
     printf("tmc_dev write: %s", buf);
   }
 
-  if((!strncmp(buf, "*RST", 4)) || (!strncmp(buf, ":AUT", 4)))
-  {
-    qry = 1;
-  }
-
   n = write(dev->fd, buf, strlen(buf));
 
   if(n != (len + 1))
@@ -166,41 +371,130 @@ int tmcdev_write(struct tmcdev *dev, const char *cmd)
     return -1;
   }
 
-  if(!qry)
+  if(tmcdev_complete(dev, cmd_class))
+  {
+    return -1;
+  }
+
+  return len;
+}
+
+
+/*
+ * Sends a list of setters as one compound command: ":CMD1;:CMD2;:CMD3;*OPC?\n"
+ * The strongest completion policy of the commands in the transmission is used,
+ * so the device is synchronised once per transmission instead of once per command.
+ * Returns the number of commands written or -1 on error.
+ */
+int tmcdev_write_batch(struct tmcdev *dev, const char * const *cmds, int cnt)
+{
+  int i, n, len, cmd_class, opc, delay, tmo, quiet, done=0;
+
+  char buf[MAX_CMD_LEN + 16],
+       str[256];
+
+  if(dev == NULL)
+  {
+    return -1;
+  }
+
+  while(done < cnt)
   {
-    for(i=0; i<20; i++)
+    n = tmc_cmd_join(buf, MAX_CMD_LEN + 16, cmds + done, cnt - done, 0);
+
+    if(n < 1)
     {
-      usleep(25000);
+      printf("tmcdev error: invalid command batch\n");
 
-      n = write(dev->fd, "*OPC?\n", 6);
+      return -1;
+    }
 
-      if(n < 0)
+    opc = 0;
+
+    delay = 0;
+
+    tmo = 0;
+
+    quiet = 1;
+
+    for(i=done; i<(done + n); i++)
+    {
+      cmd_class = tmc_cmd_class(cmds[i]);
+
+      if(dev->cmd_compl[cmd_class].timeout > tmo)
       {
-        printf("tmcdev error: device write error");
+        tmo = dev->cmd_compl[cmd_class].timeout;
+      }
 
-        return -1;
+      if(dev->cmd_compl[cmd_class].policy == TMC_COMPL_OPC)
+      {
+        opc = 1;
+      }
+
+      if(dev->cmd_compl[cmd_class].policy != TMC_COMPL_NONE)
+      {
+        if(dev->cmd_compl[cmd_class].delay > delay)
+        {
+          delay = dev->cmd_compl[cmd_class].delay;
+        }
+      }
+
+      if(!tmc_cmd_quiet(cmds[i]))
+      {
+        quiet = 0;
       }
+    }
+
+    if(opc)
+    {
+      tmc_cmd_join(buf, MAX_CMD_LEN + 16, cmds + done, n, 1);
+    }
+
+    if(!quiet)
+    {
+      printf("tmc_dev write: %s", buf);
+    }
+
+    tmcdev_set_timeout(dev, tmo);
+
+    len = strlen(buf);
 
-      n = read(dev->fd, str, 128);
+    if(write(dev->fd, buf, len) != len)
+    {
+      printf("tmcdev error: device write error");
+
+      return -1;
+    }
 
-      if(n < 0)
+    if(delay > 0)
+    {
+      usleep(delay);
+    }
+
+    if(opc)
+    {
+      len = read(dev->fd, str, 128);
+
+      if(len < 0)
       {
         printf("tmcdev error: device read error");
 
         return -1;
       }
 
-      if(n == 2)
+      if((len != 2) || (str[0] != '1'))
       {
-        if(str[0] == '1')
+        if(tmcdev_wait_opc(dev, delay))
         {
-          break;
+          return -1;
         }
       }
     }
+
+    done += n;
   }
 
-  return len;
+  return done;
 }
 
 
@@ -302,6 +596,132 @@ int tmcdev_read(struct tmcdev *dev)
 }
 
 
+/*
+ * Same as tmcdev_read() but for responses that are expected to be a
+ * definite length block (#NXXXXXX). Only the first transfer goes through
+ * hdrbuf, the rest of the payload is read directly into dest.
+ * Returns the number of bytes in dest or a negative number in case of an error.
+ * When the response is not a block, the response is in dev->buf and -3 is returned.
+ * When the block does not fit in dest, it is discarded and -4 is returned.
+ */
+int tmcdev_read_block(struct tmcdev *dev, char *dest, int dest_sz)
+{
+  int n, size, size2, len, rcvd, nl, extra;
+
+  long long t0;
+
+  char blockhdr[32];
+
+  if((dev == NULL) || (dest == NULL))
+  {
+    return -1;
+  }
+
+  dev->hdrbuf[0] = 0;
+
+  dev->buf = dev->hdrbuf;
+
+  dev->sz = 0;
+
+  size = read(dev->fd, dev->hdrbuf, TMC_BLOCK_FIRST_READ);
+
+  t0 = tmcdev_ns();
+
+  if((size < 2) || (size > TMC_BLOCK_FIRST_READ))
+  {
+    dev->hdrbuf[0] = 0;
+
+    return -2;
+  }
+
+  dev->hdrbuf[size] = 0;
+
+  if(dev->hdrbuf[0] != '#')
+  {
+    if(dev->hdrbuf[size - 1] == '\n')
+    {
+      dev->hdrbuf[--size] = 0;
+    }
+
+    dev->sz = size;
+
+    return -3;
+  }
+
+  len = dev->hdrbuf[1] - '0';
+
+  if((len < 1) || (len > 9) || (size < (len + 2)))
+  {
+    return -1;
+  }
+
+  strncpy(blockhdr, dev->hdrbuf, len + 2);
+
+  blockhdr[len + 2] = 0;
+
+  size2 = atoi(blockhdr + 2);
+
+  size -= (len + 2);  /* payload (and newline) bytes that came with the header */
+
+  if(size2 > dest_sz)
+  {
+    for(rcvd=size; rcvd<=size2; rcvd+=n)  /* keep the device in sync */
+    {
+      n = read(dev->fd, dev->hdrbuf, ((size2 + 1 - rcvd) > MAX_RESP_LEN) ? MAX_RESP_LEN : (size2 + 1 - rcvd));
+
+      if(n < 1)
+      {
+        return -4;
+      }
+    }
+
+    return -4;
+  }
+
+  rcvd = (size > size2) ? size2 : size;
+
+  memcpy(dest, dev->hdrbuf + len + 2, rcvd);
+
+  nl = (size > size2) ? 1 : 0;
+
+  /* the newline is received in the same transfer as the rest of the payload when dest has room for it */
+  extra = (dev->usb->fast && (dest_sz > size2)) ? 1 : 0;
+
+  while(rcvd < size2)
+  {
+    n = read(dev->fd, dest + rcvd, size2 + extra - rcvd);
+
+    if(n < 1)  /* timeout or error occurred */
+    {
+      return -5;
+    }
+
+    rcvd += n;
+  }
+
+  if(rcvd > size2)
+  {
+    nl = 1;
+  }
+
+  if(!nl)  /* newline not yet received */
+  {
+    if(read(dev->fd, blockhdr, 1) != 1)
+    {
+      return -5;
+    }
+  }
+
+  dev->xfer_bytes += size2;
+
+  dev->xfer_nsec += tmcdev_ns() - t0;
+
+  dev->sz = size2;
+
+  return size2;
+}
+
+
 
 
 
@@ -30,25 +30,48 @@
 #define TMC_DEV_H
 
 
+#include "tmc_cmd.h"
+
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+#define TMC_CONN_USB   (0)
+#define TMC_CONN_LAN   (1)
+
+#define TMC_ERR_CANCELED   (-6)  /* the transfer was interrupted by tmc_dev_cancel() */
+
+
+struct tmc_shadow;  /* device-state shadow, private to connection.cpp */
+struct tmc_lan;  /* socket transport state, private to tmc_lan.c */
+struct tmc_usb;  /* usbtmc transport state, private to tmc_dev.c */
+
 struct tmcdev
 {
   int fd;
   char *hdrbuf;
   char *buf;
   int sz;
+  struct tmc_compl_policy cmd_compl[TMC_CMD_CLASS_CNT];
+  int conn_type;  /* TMC_CONN_USB or TMC_CONN_LAN */
+  struct tmc_shadow *shadow;
+  struct tmc_lan *lan;
+  struct tmc_usb *usb;
+  long long xfer_bytes;  /* block payloads received so far */
+  long long xfer_nsec;   /* and the time it took, from block header to end of block */
 };
 
 
 struct tmcdev * tmcdev_open(const char *);
 void tmcdev_close(struct tmcdev *);
 int tmcdev_write(struct tmcdev *, const char *);
+int tmcdev_write_batch(struct tmcdev *, const char * const *, int);
 int tmcdev_read(struct tmcdev *);
+int tmcdev_read_block(struct tmcdev *, char *, int);
+void tmcdev_set_fastpath(struct tmcdev *, int);
+int tmcdev_get_fastpath(struct tmcdev *);
 
 
 #ifdef __cplusplus
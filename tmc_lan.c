@@ -30,13 +30,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <locale.h>
 #include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/time.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -50,93 +54,724 @@
 
 
 
-#define TMC_LAN_TIMEOUT   (5)
+#define TMC_LAN_TIMEOUT   (5000)  /* milli-Sec */
 
 #define TMC_TCP_PORT   (5555)
 
 #define MAX_CMD_LEN     (255)
 #define MAX_RESP_LEN    (1024 * 1024 * 2)
 
+#define TMCLAN_IBUF_SZ      (65536)
+#define TMCLAN_DIRECT_MIN    (4096)  /* payload parts of at least this size bypass the input buffer */
 
-int sockfd;
+#define TMCLAN_RCVBUF      (4 * 1024 * 1024)  /* receive buffer for bulk transfers */
+#define TMCLAN_BULK_MIN       (65536)  /* blocks of at least this size are received in large parts */
+#define TMCLAN_LOWAT_MAX     (262144)  /* wake up when this much of the payload is waiting */
 
-struct sockaddr_in inet_address;
+#define TMCLAN_RX_IDLE      (0)  /* no response in progress */
+#define TMCLAN_RX_FIRST     (1)  /* waiting for the first byte of a response */
+#define TMCLAN_RX_NDIG      (2)  /* '#' received, waiting for the number of size digits */
+#define TMCLAN_RX_SIZE      (3)  /* receiving the size digits of a block header */
+#define TMCLAN_RX_DATA      (4)  /* receiving the payload of a block */
+#define TMCLAN_RX_END       (5)  /* waiting for the newline that follows a block */
+#define TMCLAN_RX_LINE      (6)  /* receiving a newline terminated response */
 
-struct timeval timeout;
 
-fd_set tcp_fds;  /* filedescriptor pool */
+/*
+ * All transport state lives in struct tmcdev and in the struct tmc_lan it points to,
+ * so that several instruments can be used concurrently, each one from its own thread.
+ * The socket is non-blocking, the thread waits with epoll for the socket or for
+ * the eventfd that is signaled by tmclan_cancel().
+ * The receive state is kept between calls: a response that was interrupted by a timeout
+ * or a cancel request is drained before the next response is read.
+ */
+struct tmc_lan
+{
+  int epfd;
+  int cancel_fd;
+  int canceled;
+  int ev_mask;    /* events the socket is registered for */
+  int tmo;        /* milli-Sec, timeout of the class of the last command that was sent */
+  int rx_state;   /* TMCLAN_RX_xxx */
+  int rx_blk;     /* the response is a block */
+  int rx_ndig;    /* size digits left */
+  int rx_size;    /* payload size of the block */
+  int rx_left;    /* payload bytes left */
+  int rx_len;     /* length of the line */
+  int rx_err;     /* the rest of the response is discarded and this error is returned */
+  int tuning;     /* TMC_LAN_BULK, TMC_LAN_QUICKACK */
+  int lowat;      /* current SO_RCVLOWAT */
+  long long xfer_t0;  /* nano-Sec, the block header was received */
+  int ibuf_rd;
+  int ibuf_wr;
+  char ibuf[TMCLAN_IBUF_SZ];  /* bytes that were received but not yet consumed */
+};
+
+
+static long long tmclan_ns(void)
+{
+  struct timespec ts;
 
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
 
 
-static int tmclan_send(const char *str)
+static void tmclan_free(struct tmcdev *tmc_device)
 {
-  int len;
+  if(tmc_device == NULL)
+  {
+    return;
+  }
 
-  fd_set temp_tcp_fds;
+  if(tmc_device->fd != -1)
+  {
+    close(tmc_device->fd);
+    tmc_device->fd = -1;
+  }
 
-  struct timeval temp_timeout;
+  if(tmc_device->lan != NULL)
+  {
+    if(tmc_device->lan->epfd != -1)
+    {
+      close(tmc_device->lan->epfd);
+    }
+
+    if(tmc_device->lan->cancel_fd != -1)
+    {
+      close(tmc_device->lan->cancel_fd);
+    }
 
-  memcpy(&temp_tcp_fds, &tcp_fds, sizeof(fd_set));  /* because select overwrites the arguments */
+    free(tmc_device->lan);
+  }
+
+  free(tmc_device->hdrbuf);
 
-  memcpy(&temp_timeout, &timeout, sizeof(struct timeval));
+  free(tmc_device);
+}
+
+
+/*
+ * Waits until the socket is ready for events (EPOLLIN or EPOLLOUT).
+ * A cancel request is only honored when cancelable is non-zero.
+ * Returns 0 when ready, -2 in case of a timeout or an error or TMC_ERR_CANCELED.
+ */
+static int tmclan_wait(struct tmcdev *tmc_device, int events, int cancelable)
+{
+  int i, n, ready;
+
+  uint64_t cnt;
+
+  struct epoll_event ev[2];
+
+  struct tmc_lan *lan;
+
+  lan = tmc_device->lan;
+
+  if(lan->ev_mask != events)
+  {
+    ev[0].events = events;
+    ev[0].data.fd = tmc_device->fd;
+
+    if(epoll_ctl(lan->epfd, EPOLL_CTL_MOD, tmc_device->fd, ev))
+    {
+      perror("*** error *** epoll_ctl()");
+
+      return -2;
+    }
+
+    lan->ev_mask = events;
+  }
+
+  while(1)
+  {
+    if(cancelable && __atomic_load_n(&lan->canceled, __ATOMIC_ACQUIRE))
+    {
+      return TMC_ERR_CANCELED;
+    }
+
+    n = epoll_wait(lan->epfd, ev, 2, lan->tmo);
+
+    if(n < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+
+      perror("*** error *** epoll_wait()");
+
+      return -2;
+    }
+
+    if(n == 0)
+    {
+      printf("tmclan error: timeout\n");
+
+      return -2;
+    }
+
+    ready = 0;
+
+    for(i=0; i<n; i++)
+    {
+      if(ev[i].data.fd == tmc_device->fd)
+      {
+        ready = 1;
+      }
+      else if(!cancelable || !__atomic_load_n(&lan->canceled, __ATOMIC_ACQUIRE))
+        {
+          if(read(lan->cancel_fd, &cnt, sizeof(uint64_t)) != sizeof(uint64_t))  /* stale or not for us */
+          {
+            cnt = 0;
+          }
+        }
+    }
+
+    if(ready)
+    {
+      return 0;
+    }
+  }
+}
+
+
+/* sends all of str, a cancel request does not interrupt a command halfway */
+static int tmclan_send(struct tmcdev *tmc_device, const char *str)
+{
+  int n, len, sent=0;
 
   len = strlen(str);
 
-  if(select(sockfd + 1, 0, &temp_tcp_fds, 0, &temp_timeout) != -1)
+  while(sent < len)
+  {
+    n = send(tmc_device->fd, str + sent, len - sent, MSG_NOSIGNAL);
+
+    if(n > 0)
+    {
+      sent += n;
+
+      continue;
+    }
+
+    if((n < 0) && (errno == EINTR))
+    {
+      continue;
+    }
+
+    if((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+    {
+      if(tmclan_wait(tmc_device, EPOLLOUT, 0))
+      {
+        return -1;
+      }
+
+      continue;
+    }
+
+    perror("*** error *** send()");
+
+    return -1;
+  }
+
+  return sent;
+}
+
+
+/* receives at least one byte, returns the number of bytes, -2 in case of a timeout or an error or TMC_ERR_CANCELED */
+static int tmclan_recv(struct tmcdev *tmc_device, char *buf, int sz)
+{
+  int n, err, one=1;
+
+  while(1)
   {
-    if(FD_ISSET(sockfd, &temp_tcp_fds))  /* check if our file descriptor is set */
+    if(__atomic_load_n(&tmc_device->lan->canceled, __ATOMIC_ACQUIRE))
+    {
+      return TMC_ERR_CANCELED;
+    }
+
+    n = recv(tmc_device->fd, buf, sz, 0);
+
+    if(n > 0)
     {
-      len = send(sockfd, str, len, MSG_NOSIGNAL);
-      if(len == -1)
+      if(tmc_device->lan->tuning & TMC_LAN_QUICKACK)  /* the kernel clears it after some time, set it again */
       {
-        perror("*** error *** send()");
+        setsockopt(tmc_device->fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(int));
       }
 
-      return len;
+      return n;
+    }
+
+    if(n == 0)
+    {
+      printf("tmclan error: connection closed by device\n");
+
+      return -2;
+    }
+
+    if(errno == EINTR)
+    {
+      continue;
+    }
+
+    if((errno != EAGAIN) && (errno != EWOULDBLOCK))
+    {
+      perror("*** error *** recv()");
+
+      return -2;
+    }
+
+    err = tmclan_wait(tmc_device, EPOLLIN, 1);
+    if(err)
+    {
+      return err;
     }
   }
-  else
+}
+
+
+/*
+ * The socket becomes readable when at least n bytes are waiting, so that a bulk
+ * payload is received in a few large parts instead of one part per segment
+ * while tmclan_wait() still sees cancel requests.
+ */
+static void tmclan_lowat(struct tmcdev *tmc_device, int n)
+{
+  if(n < 1)
+  {
+    n = 1;
+  }
+
+  if(n == tmc_device->lan->lowat)
+  {
+    return;
+  }
+
+  if(setsockopt(tmc_device->fd, SOL_SOCKET, SO_RCVLOWAT, &n, sizeof(int)))
+  {
+    n = 1;
+  }
+
+  tmc_device->lan->lowat = n;
+}
+
+
+/* refills the empty input buffer */
+static int tmclan_fill(struct tmcdev *tmc_device)
+{
+  int n;
+
+  struct tmc_lan *lan;
+
+  lan = tmc_device->lan;
+
+  tmclan_lowat(tmc_device, 1);
+
+  n = tmclan_recv(tmc_device, lan->ibuf, TMCLAN_IBUF_SZ);
+
+  if(n < 0)
+  {
+    return n;
+  }
+
+  lan->ibuf_rd = 0;
+
+  lan->ibuf_wr = n;
+
+  return n;
+}
+
+
+/*
+ * Receive state machine for definite length blocks (#NXXXXXX<payload>\n)
+ * and newline terminated responses.
+ *
+ * TMC Blockheader ::= #NXXXXXX: is used to describe
+ * the length of the data stream, wherein, # is the start denoter of
+ * the data stream; N is less than or equal to 9; the N figures
+ * followed N represents the length of the data stream in bytes.
+ * For example, #9001152054. Wherein, N is 9 and 001152054
+ * represents that the data stream contains 1152054 bytes
+ * effective data.
+ *
+ * The payload of a block is stored in dest, a line is stored in line without the newline
+ * and null-terminated. When dest or line is NULL, the data is discarded.
+ * Large payloads are received directly into dest.
+ * Returns the number of bytes of the response and sets *blk to 1 for a block or to 0 for a line.
+ * Errors: -1 invalid block header, -2 timeout or receive error, -3 the line does not fit,
+ * -4 the block does not fit, TMC_ERR_CANCELED.
+ * After a timeout or a cancel request the response is still in progress, tmclan_drain() finishes it.
+ */
+static int tmclan_rx(struct tmcdev *tmc_device, char *dest, int dest_sz, char *line, int line_sz, int *blk)
+{
+  int n, err;
+
+  char c, *p;
+
+  struct tmc_lan *lan;
+
+  lan = tmc_device->lan;
+
+  if(lan->rx_state == TMCLAN_RX_IDLE)
+  {
+    lan->rx_state = TMCLAN_RX_FIRST;
+    lan->rx_blk = 0;
+    lan->rx_size = 0;
+    lan->rx_left = 0;
+    lan->rx_len = 0;
+    lan->rx_err = 0;
+  }
+
+  while(lan->rx_state != TMCLAN_RX_IDLE)
+  {
+    if(lan->rx_state == TMCLAN_RX_DATA)
+    {
+      if(lan->ibuf_rd < lan->ibuf_wr)  /* received together with the header or the previous part */
+      {
+        n = lan->ibuf_wr - lan->ibuf_rd;
+
+        if(n > lan->rx_left)
+        {
+          n = lan->rx_left;
+        }
+
+        if((dest != NULL) && (!lan->rx_err))
+        {
+          memcpy(dest + (lan->rx_size - lan->rx_left), lan->ibuf + lan->ibuf_rd, n);
+        }
+
+        lan->ibuf_rd += n;
+      }
+      else if((dest != NULL) && (!lan->rx_err) && (lan->rx_left >= TMCLAN_DIRECT_MIN))
+        {
+          if((lan->tuning & TMC_LAN_BULK) && (lan->rx_size >= TMCLAN_BULK_MIN))
+          {
+            tmclan_lowat(tmc_device, (lan->rx_left > TMCLAN_LOWAT_MAX) ? TMCLAN_LOWAT_MAX : lan->rx_left);
+          }
+          else
+          {
+            tmclan_lowat(tmc_device, 1);
+          }
+
+          n = tmclan_recv(tmc_device, dest + (lan->rx_size - lan->rx_left), lan->rx_left);
+          if(n < 0)
+          {
+            return n;
+          }
+        }
+        else
+        {
+          err = tmclan_fill(tmc_device);
+          if(err < 0)
+          {
+            return err;
+          }
+
+          continue;
+        }
+
+      lan->rx_left -= n;
+
+      if(!lan->rx_left)
+      {
+        lan->rx_state = TMCLAN_RX_END;
+      }
+
+      continue;
+    }
+
+    if(lan->ibuf_rd == lan->ibuf_wr)
+    {
+      err = tmclan_fill(tmc_device);
+      if(err < 0)
+      {
+        return err;
+      }
+    }
+
+    if(lan->rx_state == TMCLAN_RX_FIRST)
+    {
+      if(lan->ibuf[lan->ibuf_rd] == '#')
+      {
+        lan->ibuf_rd++;
+
+        lan->rx_blk = 1;
+
+        lan->rx_state = TMCLAN_RX_NDIG;
+      }
+      else
+      {
+        lan->rx_state = TMCLAN_RX_LINE;
+      }
+
+      continue;
+    }
+
+    if(lan->rx_state == TMCLAN_RX_LINE)
+    {
+      n = lan->ibuf_wr - lan->ibuf_rd;
+
+      p = (char *)memchr(lan->ibuf + lan->ibuf_rd, '\n', n);
+      if(p != NULL)
+      {
+        n = p - (lan->ibuf + lan->ibuf_rd);
+      }
+
+      if((line != NULL) && (!lan->rx_err))
+      {
+        if((lan->rx_len + n) < line_sz)
+        {
+          memcpy(line + lan->rx_len, lan->ibuf + lan->ibuf_rd, n);
+        }
+        else
+        {
+          lan->rx_err = -3;
+        }
+      }
+
+      lan->rx_len += n;
+
+      lan->ibuf_rd += n;
+
+      if(p != NULL)
+      {
+        lan->ibuf_rd++;  /* newline */
+
+        lan->rx_state = TMCLAN_RX_IDLE;
+      }
+
+      continue;
+    }
+
+    c = lan->ibuf[lan->ibuf_rd++];
+
+    if(lan->rx_state == TMCLAN_RX_NDIG)
+    {
+      lan->rx_ndig = c - '0';
+
+      if((lan->rx_ndig < 1) || (lan->rx_ndig > 9))
+      {
+        lan->rx_err = -1;
+
+        lan->rx_state = TMCLAN_RX_LINE;  /* skip to the newline to stay in sync as far as possible */
+      }
+      else
+      {
+        lan->rx_state = TMCLAN_RX_SIZE;
+      }
+    }
+    else if(lan->rx_state == TMCLAN_RX_SIZE)
+      {
+        if((c < '0') || (c > '9'))
+        {
+          lan->rx_err = -1;
+
+          lan->rx_state = TMCLAN_RX_LINE;
+
+          continue;
+        }
+
+        lan->rx_size = (lan->rx_size * 10) + (c - '0');
+
+        if(--lan->rx_ndig)
+        {
+          continue;
+        }
+
+        if((dest != NULL) && (lan->rx_size > dest_sz))
+        {
+          lan->rx_err = -4;
+        }
+
+        lan->rx_left = lan->rx_size;
+
+        lan->rx_state = lan->rx_left ? TMCLAN_RX_DATA : TMCLAN_RX_END;
+
+        lan->xfer_t0 = tmclan_ns();
+      }
+      else if(lan->rx_state == TMCLAN_RX_END)  /* newline */
+        {
+          lan->rx_state = TMCLAN_RX_IDLE;
+
+          if(!lan->rx_err)
+          {
+            tmc_device->xfer_bytes += lan->rx_size;
+
+            tmc_device->xfer_nsec += tmclan_ns() - lan->xfer_t0;
+          }
+        }
+  }
+
+  if(lan->rx_err)
+  {
+    return lan->rx_err;
+  }
+
+  if(blk != NULL)
   {
-    perror("*** error *** select()");
+    *blk = lan->rx_blk;
   }
 
-  return -1;
+  if(lan->rx_blk)
+  {
+    return lan->rx_size;
+  }
+
+  if(line != NULL)
+  {
+    line[lan->rx_len] = 0;
+  }
+
+  return lan->rx_len;
 }
 
 
-static int tmclan_recv(char *buf, int sz)
+/*
+ * Finishes and discards a response that was interrupted by a timeout or a cancel request.
+ * When the device does not finish it within the timeout, the rest is considered lost.
+ * Returns 0 or TMC_ERR_CANCELED.
+ */
+static int tmclan_drain(struct tmcdev *tmc_device)
 {
-  fd_set temp_tcp_fds;
+  int n;
+
+  struct tmc_lan *lan;
+
+  lan = tmc_device->lan;
+
+  if(lan->rx_state == TMCLAN_RX_IDLE)
+  {
+    return 0;
+  }
+
+  n = tmclan_rx(tmc_device, NULL, 0, NULL, 0, NULL);
 
-  struct timeval temp_timeout;
+  if(n == TMC_ERR_CANCELED)
+  {
+    return n;
+  }
+
+  if(n == -2)
+  {
+    printf("tmclan error: discarding an incomplete response\n");
+
+    lan->rx_state = TMCLAN_RX_IDLE;
+
+    lan->ibuf_rd = 0;
+
+    lan->ibuf_wr = 0;
+  }
+
+  return 0;
+}
 
-  memcpy(&temp_tcp_fds, &tcp_fds, sizeof(fd_set));  /* because select overwrites the arguments */
 
-  memcpy(&temp_timeout, &timeout, sizeof(struct timeval));
+/* reads the response of *OPC?, returns 1 when the device answered "1", 0 otherwise or a negative number in case of an error */
+static int tmclan_read_opc(struct tmcdev *tmc_device)
+{
+  int n;
+
+  char str[128];
+
+  n = tmclan_drain(tmc_device);  /* a response that is still pending comes first */
+  if(n < 0)
+  {
+    return n;
+  }
+
+  n = tmclan_rx(tmc_device, NULL, 0, str, 128, NULL);
+
+  if((n < 0) && (n != -3))
+  {
+    printf("tmclan error: device read error");
+
+    return n;
+  }
+
+  if((n == 1) && (str[0] == '1'))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Enlarges the receive buffer so that the device can keep sending at line rate
+ * during bulk transfers. Setting SO_RCVBUF disables the receive buffer autotuning
+ * of the kernel, so it is only done when that gives a larger buffer than the
+ * autotuning limit (tcp_rmem). The size is limited by rmem_max.
+ * Must be done before connect(), the window scale is negotiated in the handshake.
+ */
+static void tmclan_set_rcvbuf(int sockfd)
+{
+  int rmem_auto=0, rmem_max=0, sz;
+
+  FILE *f;
+
+  f = fopen("/proc/sys/net/ipv4/tcp_rmem", "rb");
+  if(f != NULL)
+  {
+    if(fscanf(f, "%*i %*i %i", &rmem_auto) != 1)
+    {
+      rmem_auto = 0;
+    }
+
+    fclose(f);
+  }
+
+  f = fopen("/proc/sys/net/core/rmem_max", "rb");
+  if(f != NULL)
+  {
+    if(fscanf(f, "%i", &rmem_max) != 1)
+    {
+      rmem_max = 0;
+    }
+
+    fclose(f);
+  }
+
+  sz = TMCLAN_RCVBUF / 2;  /* the kernel doubles the value for its bookkeeping */
+
+  if(sz > rmem_max)
+  {
+    sz = rmem_max;
+  }
+
+  if((sz * 2) <= rmem_auto)
+  {
+    return;
+  }
 
-  if(select(sockfd + 1, &temp_tcp_fds, 0, 0, &temp_timeout) != -1)
+  if(setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(int)))
   {
-    if(FD_ISSET(sockfd, &temp_tcp_fds))  /* check if our file descriptor is set */
-    {
-      return recv(sockfd, buf, sz, MSG_NOSIGNAL);
-    }
+    perror("*** error *** setsockopt(SO_RCVBUF)");
   }
-
-  return -1;
 }
 
 
 struct tmcdev * tmclan_open(const char *host_or_ip)
 {
+  int sockfd, err;
+
+  socklen_t err_len;
+
   char ip_address[256]={""};
 
   struct tmcdev *tmc_device;
 
+  struct sockaddr_in inet_address;
+
   struct addrinfo *addr_result, *res;
 
   struct sockaddr_in *ipv4_addr;
 
+  struct pollfd pfd;
+
+  struct epoll_event ev;
+
   if((host_or_ip[0] >= 'a') && (host_or_ip[0] <= 'z'))
   {
     printf("Resolving hostname: %s...\n", host_or_ip);
@@ -173,7 +808,7 @@ struct tmcdev * tmclan_open(const char *host_or_ip)
     strlcpy(ip_address, host_or_ip, 256);
   }
 
-  sockfd = socket(PF_INET, SOCK_STREAM, 0);
+  sockfd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if(sockfd == -1)
   {
     return NULL;
@@ -183,80 +818,272 @@ struct tmcdev * tmclan_open(const char *host_or_ip)
 
   if(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (void *)&tcp_nodelay, sizeof tcp_nodelay) == -1)
   {
+    close(sockfd);
     return NULL;
   }
 
-  FD_ZERO(&tcp_fds);         /* clear file descriptor pool     */
-  FD_SET(sockfd, &tcp_fds);  /* add our filedescriptor to pool */
-
-  timeout.tv_sec = TMC_LAN_TIMEOUT;
-  timeout.tv_usec = 0;
-
   memset(&inet_address, 0, sizeof(struct sockaddr_in));
 
   inet_address.sin_family = AF_INET;
   if(inet_aton(ip_address, &inet_address.sin_addr) == 0)
   {
+    close(sockfd);
     return NULL;
   }
   inet_address.sin_port = htons(TMC_TCP_PORT);
 
+  tmclan_set_rcvbuf(sockfd);
+
   if(connect(sockfd, (struct sockaddr *) &inet_address, sizeof(struct sockaddr)) < 0)
   {
-    return NULL;
+    if(errno != EINPROGRESS)
+    {
+      close(sockfd);
+      return NULL;
+    }
+
+    pfd.fd = sockfd;
+    pfd.events = POLLOUT;
+
+    if(poll(&pfd, 1, TMC_LAN_TIMEOUT) != 1)
+    {
+      printf("tmclan error: can not connect to %s\n", ip_address);
+      close(sockfd);
+      return NULL;
+    }
+
+    err = 0;
+
+    err_len = sizeof(int);
+
+    if(getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &err_len) || err)
+    {
+      close(sockfd);
+      return NULL;
+    }
   }
 
   tmc_device = (struct tmcdev *)calloc(1, sizeof(struct tmcdev));
   if(tmc_device == NULL)
   {
     close(sockfd);
-    sockfd = -1;
     return NULL;
   }
 
+  tmc_device->fd = sockfd;
+
+  tmc_device->conn_type = TMC_CONN_LAN;
+
+  tmc_device->lan = (struct tmc_lan *)calloc(1, sizeof(struct tmc_lan));
+  if(tmc_device->lan == NULL)
+  {
+    tmclan_free(tmc_device);
+    return NULL;
+  }
+
+  tmc_device->lan->cancel_fd = -1;
+
+  tmc_device->lan->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if(tmc_device->lan->epfd == -1)
+  {
+    tmclan_free(tmc_device);
+    return NULL;
+  }
+
+  tmc_device->lan->cancel_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(tmc_device->lan->cancel_fd == -1)
+  {
+    tmclan_free(tmc_device);
+    return NULL;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = sockfd;
+
+  if(epoll_ctl(tmc_device->lan->epfd, EPOLL_CTL_ADD, sockfd, &ev))
+  {
+    tmclan_free(tmc_device);
+    return NULL;
+  }
+
+  tmc_device->lan->ev_mask = EPOLLIN;
+
+  ev.events = EPOLLIN;
+  ev.data.fd = tmc_device->lan->cancel_fd;
+
+  if(epoll_ctl(tmc_device->lan->epfd, EPOLL_CTL_ADD, tmc_device->lan->cancel_fd, &ev))
+  {
+    tmclan_free(tmc_device);
+    return NULL;
+  }
+
+  tmc_device->lan->tmo = TMC_LAN_TIMEOUT;
+
+  tmc_device->lan->tuning = TMC_LAN_BULK;
+
+  tmc_device->lan->lowat = 1;
+
   tmc_device->hdrbuf = (char *)calloc(1, MAX_RESP_LEN + 1024);
   if(tmc_device->hdrbuf == NULL)
   {
-    close(sockfd);
-    sockfd = -1;
-    free(tmc_device);
-    tmc_device = NULL;
+    tmclan_free(tmc_device);
     return NULL;
   }
 
   tmc_device->buf = tmc_device->hdrbuf;
 
+  tmc_cmd_default_policy(tmc_device->cmd_compl);
+
   return tmc_device;
 }
 
 
 void tmclan_close(struct tmcdev *tmc_device)
 {
-  if(sockfd != -1)
+  tmclan_free(tmc_device);
+}
+
+
+/*
+ * Interrupts a receive that is in progress or waiting in another thread, it returns TMC_ERR_CANCELED.
+ * Every receive fails until tmclan_cancel_clear() is called.
+ * Commands are never interrupted halfway.
+ */
+void tmclan_cancel(struct tmcdev *tmc_device)
+{
+  uint64_t cnt=1;
+
+  if((tmc_device == NULL) || (tmc_device->lan == NULL))
   {
-    close(sockfd);
-    sockfd = -1;
+    return;
+  }
+
+  __atomic_store_n(&tmc_device->lan->canceled, 1, __ATOMIC_RELEASE);
+
+  if(write(tmc_device->lan->cancel_fd, &cnt, sizeof(uint64_t)) != sizeof(uint64_t))
+  {
+    perror("*** error *** write()");
   }
+}
 
-  if(tmc_device != NULL)
+
+void tmclan_cancel_clear(struct tmcdev *tmc_device)
+{
+  uint64_t cnt;
+
+  if((tmc_device == NULL) || (tmc_device->lan == NULL))
   {
-    free(tmc_device->hdrbuf);
+    return;
+  }
 
-    free(tmc_device);
+  __atomic_store_n(&tmc_device->lan->canceled, 0, __ATOMIC_RELEASE);
 
-    tmc_device = NULL;
+  if(read(tmc_device->lan->cancel_fd, &cnt, sizeof(uint64_t)) != sizeof(uint64_t))
+  {
+    cnt = 0;  /* was not signaled */
   }
 }
 
 
-int tmclan_write(struct tmcdev *tmc_device __attribute__ ((unused)), const char *cmd)
+/* TMC_LAN_BULK and/or TMC_LAN_QUICKACK, TMC_LAN_BULK is the default */
+void tmclan_set_tuning(struct tmcdev *tmc_device, int tuning)
 {
-  int i, n, len, qry=0;
+  int n=0;
 
-  char buf[MAX_CMD_LEN + 16],
-       str[256];
+  if((tmc_device == NULL) || (tmc_device->lan == NULL))
+  {
+    return;
+  }
 
-  if(sockfd == -1)
+  tmc_device->lan->tuning = tuning;
+
+  if(!(tuning & TMC_LAN_QUICKACK))
+  {
+    setsockopt(tmc_device->fd, IPPROTO_TCP, TCP_QUICKACK, &n, sizeof(int));
+  }
+}
+
+
+int tmclan_get_tuning(struct tmcdev *tmc_device)
+{
+  if((tmc_device == NULL) || (tmc_device->lan == NULL))
+  {
+    return 0;
+  }
+
+  return tmc_device->lan->tuning;
+}
+
+
+static int tmclan_wait_opc(struct tmcdev *tmc_device, int delay)
+{
+  int i, n;
+
+  for(i=0; i<20; i++)
+  {
+    if(delay > 0)
+    {
+      usleep(delay);
+    }
+
+    if(tmclan_send(tmc_device, "*OPC?\n") != 6)
+    {
+      printf("tmclan error: device write error");
+
+      return -1;
+    }
+
+    n = tmclan_read_opc(tmc_device);
+
+    if(n < 0)
+    {
+      return -1;
+    }
+
+    if(n == 1)
+    {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+
+static int tmclan_complete(struct tmcdev *tmc_device, int cmd_class)
+{
+  struct tmc_compl_policy *pol;
+
+  pol = &tmc_device->cmd_compl[cmd_class];
+
+  if(pol->policy == TMC_COMPL_OPC)
+  {
+    return tmclan_wait_opc(tmc_device, pol->delay);
+  }
+
+  if(pol->policy == TMC_COMPL_DELAY)
+  {
+    if(pol->delay > 0)
+    {
+      usleep(pol->delay);
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ * The command is sent without waiting for a response that is still being received,
+ * that response is drained before the next response is read.
+ */
+int tmclan_write(struct tmcdev *tmc_device, const char *cmd)
+{
+  int n, len, cmd_class;
+
+  char buf[MAX_CMD_LEN + 16];
+
+  if((tmc_device == NULL) || (tmc_device->fd == -1))
   {
     return -1;
   }
@@ -277,41 +1104,20 @@ int tmclan_write(struct tmcdev *tmc_device __attribute__ ((unused)), const char
     return -1;
   }
 
-  if(cmd[len - 1] == '?')
-  {
-    qry = 1;
-  }
-
   strlcpy(buf, cmd, MAX_CMD_LEN + 16);
 
   strlcat(buf, "\n", MAX_CMD_LEN + 16);
 
-  if(!(!strncmp(buf, ":TRIG:STAT?", 11) ||  /* don't print these commands to the console */
-      !strncmp(buf, ":TRIG:SWE?", 10) ||    /* because they are used repeatedly */
-      !strncmp(buf, ":WAV:DATA?", 10) ||
-      !strncmp(buf, ":WAV:MODE NORM", 14) ||
-      !strncmp(buf, ":WAV:FORM BYTE", 14) ||
-      !strncmp(buf, ":WAV:SOUR CHAN", 14) ||
-      !strncmp(buf, ":TRIG:SWE?", 10) ||
-      !strncmp(buf, ":ACQ:SRAT?", 10) ||
-      !strncmp(buf, ":ACQ:MDEP?", 10) ||
-      !strncmp(buf, ":MEAS:COUN:VAL?", 15) ||
-      !strncmp(buf, ":FUNC:WREC:OPER?", 16) ||
-      !strncmp(buf, ":FUNC:WREP:OPER?", 16) ||
-      !strncmp(buf, ":FUNC:WREP:FMAX?", 16) ||
-      !strncmp(buf, ":FUNC:WREC:FMAX?", 16) ||
-      !strncmp(buf, ":FUNC:WREP:FCUR?", 16) ||
-      !strncmp(buf, ":WAV:XOR?", 9)))
+  if(!tmc_cmd_quiet(buf))
   {
     printf("tmc_lan write: %s", buf);
   }
 
-  if((!strncmp(buf, "*RST", 4)) || (!strncmp(buf, ":AUT", 4)))
-  {
-    qry = 1;
-  }
+  cmd_class = tmc_cmd_class(cmd);
+
+  tmc_device->lan->tmo = tmc_device->cmd_compl[cmd_class].timeout;
 
-  n = tmclan_send(buf);
+  n = tmclan_send(tmc_device, buf);
 
   if(n != (len + 1))
   {
@@ -320,139 +1126,230 @@ int tmclan_write(struct tmcdev *tmc_device __attribute__ ((unused)), const char
     return -1;
   }
 
-  if(!qry)
+  if(tmclan_complete(tmc_device, cmd_class))
+  {
+    return -1;
+  }
+
+  return len;
+}
+
+
+/*
+ * Sends a list of setters as one compound command: ":CMD1;:CMD2;:CMD3;*OPC?\n"
+ * The strongest completion policy of the commands in the transmission is used,
+ * so the device is synchronised once per transmission instead of once per command.
+ * Returns the number of commands written or -1 on error.
+ */
+int tmclan_write_batch(struct tmcdev *tmc_device, const char * const *cmds, int cnt)
+{
+  int i, n, len, cmd_class, opc, delay, tmo, quiet, done=0;
+
+  char buf[MAX_CMD_LEN + 16];
+
+  if((tmc_device == NULL) || (tmc_device->fd == -1))
+  {
+    return -1;
+  }
+
+  while(done < cnt)
   {
-    for(i=0; i<20; i++)
+    n = tmc_cmd_join(buf, MAX_CMD_LEN + 16, cmds + done, cnt - done, 0);
+
+    if(n < 1)
+    {
+      printf("tmc_lan error: invalid command batch\n");
+
+      return -1;
+    }
+
+    opc = 0;
+
+    delay = 0;
+
+    tmo = 0;
+
+    quiet = 1;
+
+    for(i=done; i<(done + n); i++)
     {
-      usleep(25000);
+      cmd_class = tmc_cmd_class(cmds[i]);
 
-      if(tmclan_send("*OPC?\n") != 6)
+      if(tmc_device->cmd_compl[cmd_class].policy == TMC_COMPL_OPC)
       {
-        printf("tmclan error: device write error");
+        opc = 1;
+      }
 
-        return -1;
+      if(tmc_device->cmd_compl[cmd_class].policy != TMC_COMPL_NONE)
+      {
+        if(tmc_device->cmd_compl[cmd_class].delay > delay)
+        {
+          delay = tmc_device->cmd_compl[cmd_class].delay;
+        }
       }
 
-      n = tmclan_recv(str, 128);
+      if(tmc_device->cmd_compl[cmd_class].timeout > tmo)
+      {
+        tmo = tmc_device->cmd_compl[cmd_class].timeout;
+      }
 
-      if(n < 0)
+      if(!tmc_cmd_quiet(cmds[i]))
       {
-        printf("tmclan error: device read error");
+        quiet = 0;
+      }
+    }
+
+    if(opc)
+    {
+      tmc_cmd_join(buf, MAX_CMD_LEN + 16, cmds + done, n, 1);
+    }
+
+    if(!quiet)
+    {
+      printf("tmc_lan write: %s", buf);
+    }
+
+    tmc_device->lan->tmo = tmo;
+
+    len = strlen(buf);
+
+    if(tmclan_send(tmc_device, buf) != len)
+    {
+      printf("tmclan error: device write error");
+
+      return -1;
+    }
+
+    if(delay > 0)
+    {
+      usleep(delay);
+    }
+
+    if(opc)
+    {
+      len = tmclan_read_opc(tmc_device);
 
+      if(len < 0)
+      {
         return -1;
       }
 
-      if(n == 2)
+      if(len != 1)
       {
-        if(str[0] == '1')
+        if(tmclan_wait_opc(tmc_device, delay))
         {
-          break;
+          return -1;
         }
       }
     }
+
+    done += n;
   }
 
-  return len;
+  return done;
 }
 
 
 /*
- * TMC Blockheader ::= #NXXXXXX: is used to describe
- * the length of the data stream, wherein, # is the start denoter of
- * the data stream; N is less than or equal to 9; the N figures
- * followed N represents the length of the data stream in bytes.
- * For example, #9001152054. Wherein, N is 9 and 001152054
- * represents that the data stream contains 1152054 bytes
- * effective data.
+ * Reads a response, a line or the payload of a block, into tmc_device->buf.
+ * Returns the number of bytes in tmc_device->buf or a negative number in case of an error.
  */
 int tmclan_read(struct tmcdev *tmc_device)
 {
-  int n, size, size2, len;
+  int n, blk=0;
 
-  char blockhdr[32];
-
-  if(sockfd == -1)
+  if((tmc_device == NULL) || (tmc_device->fd == -1))
   {
     return -1;
   }
 
   tmc_device->hdrbuf[0] = 0;
 
-  tmc_device->sz = 0;
+  tmc_device->buf = tmc_device->hdrbuf;
 
-  size = 0;
+  tmc_device->sz = 0;
 
-  while(1)
+  n = tmclan_drain(tmc_device);
+  if(n < 0)
   {
-    n = tmclan_recv(tmc_device->hdrbuf + size, MAX_RESP_LEN - size);
+    return n;
+  }
 
-    if(n < 1)
-    {
-      return -2;
-    }
+  n = tmclan_rx(tmc_device, tmc_device->hdrbuf, MAX_RESP_LEN, tmc_device->hdrbuf, MAX_RESP_LEN, &blk);
 
-    size += n;
+  if(n < 0)
+  {
+    tmc_device->hdrbuf[0] = 0;
 
-    if(tmc_device->hdrbuf[size - 1] == '\n')
+    if(n == -4)
     {
-      break;
+      return -3;
     }
+
+    return n;
   }
 
-  if((size < 2) || (size > MAX_RESP_LEN))
+  if((!blk) && (n < 1))
   {
-    tmc_device->hdrbuf[0] = 0;
-
-    tmc_device->buf[0] = 0;
-
     return -3;
   }
 
-  tmc_device->hdrbuf[size] = 0;
-
-  if(tmc_device->hdrbuf[0] != '#')
-  {
-    if(tmc_device->hdrbuf[size - 1] == '\n')
-    {
-      tmc_device->hdrbuf[--size] = 0;
-    }
-
-    tmc_device->buf = tmc_device->hdrbuf;
+  tmc_device->hdrbuf[n] = 0;
 
-    tmc_device->sz = size;
+  tmc_device->sz = n;
 
-    return tmc_device->sz;
-  }
+  return tmc_device->sz;
+}
 
-  strncpy(blockhdr, tmc_device->hdrbuf, 16);
 
-  len = blockhdr[1] - '0';
+/*
+ * Same as tmclan_read() but for responses that are expected to be a
+ * definite length block (#NXXXXXX). The payload is received directly into dest,
+ * the header and the terminating newline are consumed but not stored.
+ * Returns the number of bytes in dest or a negative number in case of an error.
+ * When the response is not a block, the response is in tmc_device->buf and -3 is returned.
+ * When the block does not fit in dest, it is discarded and -4 is returned.
+ * TMC_ERR_CANCELED is returned when tmclan_cancel() interrupted the transfer,
+ * the rest of the block is discarded by the next read.
+ */
+int tmclan_read_block(struct tmcdev *tmc_device, char *dest, int dest_sz)
+{
+  int n, blk=0;
 
-  if((len < 1) || (len > 9))
+  if((tmc_device == NULL) || (tmc_device->fd == -1) || (dest == NULL))
   {
-    blockhdr[31] = 0;
-
     return -1;
   }
 
-  blockhdr[len + 2] = 0;
+  tmc_device->hdrbuf[0] = 0;
 
-  size2 = atoi(blockhdr + 2);
+  tmc_device->buf = tmc_device->hdrbuf;
 
-  size--;  // remove the last character
+  tmc_device->sz = 0;
 
-  if(size < size2)
+  n = tmclan_drain(tmc_device);
+  if(n < 0)
   {
-    blockhdr[31] = 0;
+    return n;
+  }
 
-    return -1;
+  n = tmclan_rx(tmc_device, dest, dest_sz, tmc_device->hdrbuf, MAX_RESP_LEN, &blk);
+
+  if(n < 0)
+  {
+    tmc_device->hdrbuf[0] = 0;
+
+    return n;
   }
 
-  tmc_device->buf = tmc_device->hdrbuf + len + 2;
+  tmc_device->sz = n;
 
-  tmc_device->sz = size2;
+  if(!blk)
+  {
+    return -3;
+  }
 
-  return tmc_device->sz;
+  return n;
 }
 
 
@@ -465,5 +1362,14 @@ int tmclan_read(struct tmcdev *tmc_device)
 
 
 
+
+
+
+
+
+
+
+
+
 
 
@@ -35,10 +35,20 @@ extern "C" {
 #endif
 
 
+#define TMC_LAN_BULK       (1)  /* large receive buffer, block payloads are received in large parts */
+#define TMC_LAN_QUICKACK   (2)  /* acknowledge received segments immediately */
+
+
 struct tmcdev * tmclan_open(const char *);
 void tmclan_close(struct tmcdev *);
 int tmclan_write(struct tmcdev *, const char *);
+int tmclan_write_batch(struct tmcdev *, const char * const *, int);
 int tmclan_read(struct tmcdev *);
+int tmclan_read_block(struct tmcdev *, char *, int);
+void tmclan_cancel(struct tmcdev *);
+void tmclan_cancel_clear(struct tmcdev *);
+void tmclan_set_tuning(struct tmcdev *, int);
+int tmclan_get_tuning(struct tmcdev *);
 
 
 #ifdef __cplusplus
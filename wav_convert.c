@@ -0,0 +1,293 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/*
+ * Conversion of the raw BYTE waveform data.
+ * The vectorized versions are selected at runtime, depending on the CPU.
+ * On other architectures or compilers only the scalar versions are used.
+ */
+
+
+#include "wav_convert.h"
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define WAVCNV_X86
+#include <immintrin.h>
+#endif
+
+
+
+static int wavcnv_lvl=-1;
+
+
+
+int wavcnv_level(void)
+{
+  if(wavcnv_lvl >= 0)
+  {
+    return wavcnv_lvl;
+  }
+
+#ifdef WAVCNV_X86
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2"))
+  {
+    wavcnv_lvl = WAVCNV_AVX2;
+  }
+  else if(__builtin_cpu_supports("sse2"))
+    {
+      wavcnv_lvl = WAVCNV_SSE2;
+    }
+    else
+    {
+      wavcnv_lvl = WAVCNV_SCALAR;
+    }
+#else
+  wavcnv_lvl = WAVCNV_SCALAR;
+#endif
+
+  return wavcnv_lvl;
+}
+
+
+int wavcnv_set_level(int lvl)
+{
+  static int detected=-1;
+
+  if(detected < 0)
+  {
+    detected = wavcnv_level();
+  }
+
+  if((lvl < WAVCNV_SCALAR) || (lvl > detected))
+  {
+    lvl = detected;
+  }
+
+  wavcnv_lvl = lvl;
+
+  return wavcnv_lvl;
+}
+
+
+static void wavcnv_u8_to_s16_scalar(short *dest, const unsigned char *src, int n, int offset, int shift)
+{
+  int i, mul;
+
+  mul = 1 << shift;
+
+  for(i=0; i<n; i++)
+  {
+    dest[i] = ((int)src[i] - offset) * mul;
+  }
+}
+
+
+static void wavcnv_s16_to_double_scalar(double *dest, const short *src, int n, double scale)
+{
+  int i;
+
+  for(i=0; i<n; i++)
+  {
+    dest[i] = src[i] * scale;
+  }
+}
+
+
+#ifdef WAVCNV_X86
+
+/*
+ * Every iteration loads the source bytes before it stores the result,
+ * the stores never reach source bytes that are not yet loaded when src
+ * starts at or after byte offset n of dest.
+ */
+__attribute__((target("sse2")))
+static void wavcnv_u8_to_s16_sse2(short *dest, const unsigned char *src, int n, int offset, int shift)
+{
+  int i;
+
+  __m128i zero, offs, cnt, v, lo, hi;
+
+  zero = _mm_setzero_si128();
+
+  offs = _mm_set1_epi16(offset);
+
+  cnt = _mm_cvtsi32_si128(shift);
+
+  for(i=0; i<=(n-16); i+=16)
+  {
+    v = _mm_loadu_si128((const __m128i *)(src + i));
+
+    lo = _mm_sll_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), offs), cnt);
+
+    hi = _mm_sll_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), offs), cnt);
+
+    _mm_storeu_si128((__m128i *)(dest + i), lo);
+
+    _mm_storeu_si128((__m128i *)(dest + i + 8), hi);
+  }
+
+  wavcnv_u8_to_s16_scalar(dest + i, src + i, n - i, offset, shift);
+}
+
+
+__attribute__((target("avx2")))
+static void wavcnv_u8_to_s16_avx2(short *dest, const unsigned char *src, int n, int offset, int shift)
+{
+  int i;
+
+  __m128i cnt;
+
+  __m256i offs, lo, hi;
+
+  offs = _mm256_set1_epi16(offset);
+
+  cnt = _mm_cvtsi32_si128(shift);
+
+  for(i=0; i<=(n-32); i+=32)
+  {
+    lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i)));
+
+    hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i + 16)));
+
+    lo = _mm256_sll_epi16(_mm256_sub_epi16(lo, offs), cnt);
+
+    hi = _mm256_sll_epi16(_mm256_sub_epi16(hi, offs), cnt);
+
+    _mm256_storeu_si256((__m256i *)(dest + i), lo);
+
+    _mm256_storeu_si256((__m256i *)(dest + i + 16), hi);
+  }
+
+  wavcnv_u8_to_s16_scalar(dest + i, src + i, n - i, offset, shift);
+}
+
+
+__attribute__((target("sse2")))
+static void wavcnv_s16_to_double_sse2(double *dest, const short *src, int n, double scale)
+{
+  int i;
+
+  __m128i v, lo, hi;
+
+  __m128d scl;
+
+  scl = _mm_set1_pd(scale);
+
+  for(i=0; i<=(n-8); i+=8)
+  {
+    v = _mm_loadu_si128((const __m128i *)(src + i));
+
+    lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);  /* sign extend to 32-bit */
+
+    hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+    _mm_storeu_pd(dest + i, _mm_mul_pd(_mm_cvtepi32_pd(lo), scl));
+
+    _mm_storeu_pd(dest + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), scl));
+
+    _mm_storeu_pd(dest + i + 4, _mm_mul_pd(_mm_cvtepi32_pd(hi), scl));
+
+    _mm_storeu_pd(dest + i + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), scl));
+  }
+
+  wavcnv_s16_to_double_scalar(dest + i, src + i, n - i, scale);
+}
+
+
+__attribute__((target("avx2")))
+static void wavcnv_s16_to_double_avx2(double *dest, const short *src, int n, double scale)
+{
+  int i;
+
+  __m256i v;
+
+  __m256d scl;
+
+  scl = _mm256_set1_pd(scale);
+
+  for(i=0; i<=(n-8); i+=8)
+  {
+    v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+
+    _mm256_storeu_pd(dest + i, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), scl));
+
+    _mm256_storeu_pd(dest + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), scl));
+  }
+
+  wavcnv_s16_to_double_scalar(dest + i, src + i, n - i, scale);
+}
+
+#endif
+
+
+void wavcnv_u8_to_s16(short *dest, const unsigned char *src, int n, int offset, int shift)
+{
+  if(n < 1)
+  {
+    return;
+  }
+
+#ifdef WAVCNV_X86
+  switch(wavcnv_level())
+  {
+    case WAVCNV_AVX2: wavcnv_u8_to_s16_avx2(dest, src, n, offset, shift);
+                      return;
+    case WAVCNV_SSE2: wavcnv_u8_to_s16_sse2(dest, src, n, offset, shift);
+                      return;
+  }
+#endif
+
+  wavcnv_u8_to_s16_scalar(dest, src, n, offset, shift);
+}
+
+
+void wavcnv_s16_to_double(double *dest, const short *src, int n, double scale)
+{
+  if(n < 1)
+  {
+    return;
+  }
+
+#ifdef WAVCNV_X86
+  switch(wavcnv_level())
+  {
+    case WAVCNV_AVX2: wavcnv_s16_to_double_avx2(dest, src, n, scale);
+                      return;
+    case WAVCNV_SSE2: wavcnv_s16_to_double_sse2(dest, src, n, scale);
+                      return;
+  }
+#endif
+
+  wavcnv_s16_to_double_scalar(dest, src, n, scale);
+}
+
+
@@ -0,0 +1,73 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef WAV_CONVERT_H
+#define WAV_CONVERT_H
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define WAVCNV_SCALAR    (0)
+#define WAVCNV_SSE2      (1)
+#define WAVCNV_AVX2      (2)
+
+
+/* returns the instruction set used by the conversion functions, WAVCNV_SCALAR, WAVCNV_SSE2 or WAVCNV_AVX2 */
+int wavcnv_level(void);
+
+/*
+ * Selects a lower instruction set than the detected one, for benchmarks.
+ * Returns the level in use, the detected level when lvl is not supported.
+ * Not thread safe, call it while no conversion is running.
+ */
+int wavcnv_set_level(int lvl);
+
+/*
+ * Converts n unsigned 8-bit ADC codes to dest[i] = (src[i] - offset) * 2^shift.
+ * src may be located inside dest, as long as it starts at or after byte offset n,
+ * e.g. in the upper half of dest (the samples are widened in place).
+ */
+void wavcnv_u8_to_s16(short *dest, const unsigned char *src, int n, int offset, int shift);
+
+/* dest[i] = src[i] * scale */
+void wavcnv_s16_to_double(double *dest, const short *src, int n, double scale);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif
+
+
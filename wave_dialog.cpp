@@ -32,12 +32,20 @@
 
 
 
-UI_wave_window::UI_wave_window(struct device_settings *p_devparms, short *wbuf[MAX_CHNS], QWidget *parnt)
+/*
+ * Takes ownership of the buffers in wbuf[], they are freed when the window is closed.
+ * When view is not NULL, wbuf[] are the buffers of a saved capture and view is closed instead.
+ */
+UI_wave_window::UI_wave_window(struct device_settings *p_devparms, short *wbuf[MAX_CHNS], QWidget *parnt, struct capview *view)
 {
-  int i;
+  int i, load_smps=0;
+
+  short *wbuf_pyr[MAX_CHNS];
 
   mainwindow = (UI_Mainwindow *)parnt;
 
+  cap_view = view;
+
   setMinimumSize(840, 655);
   setWindowTitle("Wave Inspector");
   setWindowIcon(QIcon(":/images/r_dsremote.png"));
@@ -85,6 +93,37 @@ UI_wave_window::UI_wave_window(struct device_settings *p_devparms, short *wbuf[M
   wavcurve->setBorderSize(40);
   wavcurve->setDeviceParameters(devparms);
 
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    memset(&pyramid[i], 0, sizeof(struct wav_pyramid));
+
+    if((i >= devparms->channel_cnt) || (!devparms->chandisplay[i]))
+    {
+      wbuf_pyr[i] = NULL;
+    }
+    else
+    {
+      wbuf_pyr[i] = devparms->wavebuf[i];
+    }
+  }
+
+  /* the pyramids are built in the background, until then the view draws one sample per pixel column */
+  wavcurve->setPyramidPending(1);
+
+  pyr_thrd = new wave_pyramid_thread;
+  pyr_thrd->set_buffers(pyramid, wbuf_pyr, devparms->wavebufsz);
+  if((cap_view != NULL) && (!cap_view->loaded))
+  {
+    /* the samples are converted in the thread too, the buffers must not be read before it finishes */
+    load_smps = 1;
+
+    pyr_thrd->set_capview(cap_view);
+
+    wavcurve->setSamplesPending(1);
+  }
+  connect(pyr_thrd, SIGNAL(finished()), this, SLOT(pyramid_thread_finished()));
+  pyr_thrd->start();
+
   wavslider = new QSlider;
   wavslider->setOrientation(Qt::Horizontal);
   set_wavslider();
@@ -96,7 +135,12 @@ UI_wave_window::UI_wave_window(struct device_settings *p_devparms, short *wbuf[M
   savemenu = new QMenu(this);
   savemenu->setTitle("Save");
   savemenu->addAction("Save to EDF file", this, SLOT(save_wi_buffer_to_edf()));
+  savemenu->addAction("Save to capture file", this, SLOT(save_wi_buffer_to_raw()));
   menubar->addMenu(savemenu);
+  if(load_smps)
+  {
+    savemenu->setEnabled(false);
+  }
 
   helpmenu = new QMenu(this);
   helpmenu->setTitle("Help");
@@ -159,21 +203,68 @@ UI_wave_window::~UI_wave_window()
 {
   int i;
 
+  /* the thread reads the sample buffers */
+  pyr_thrd->abort();
+  pyr_thrd->wait();
+  delete pyr_thrd;
+
   for(i=0; i<MAX_CHNS; i++)
   {
-    free(devparms->wavebuf[i]);
+    wavpyr_free(&pyramid[i]);
+
+    if(cap_view == NULL)
+    {
+      free(devparms->wavebuf[i]);
+    }
+  }
+
+  if(cap_view != NULL)
+  {
+    capview_close(cap_view);
+
+    free(cap_view);
   }
 
   free(devparms);
 }
 
 
+void UI_wave_window::pyramid_thread_finished()
+{
+  int i;
+
+  pyr_thrd->wait();
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    if(pyr_thrd->is_built(i))
+    {
+      wavcurve->setPyramid(i, &pyramid[i]);
+    }
+  }
+
+  wavcurve->setPyramidPending(0);
+
+  wavcurve->setSamplesPending(0);
+
+  savemenu->setEnabled(true);
+
+  wavcurve->update();
+}
+
+
 void UI_wave_window::save_wi_buffer_to_edf()
 {
   mainwindow->save_wave_inspector_buffer_to_edf(devparms);
 }
 
 
+void UI_wave_window::save_wi_buffer_to_raw()
+{
+  mainwindow->save_wave_inspector_buffer_to_raw(devparms);
+}
+
+
 void UI_wave_window::wavslider_value_changed(int val)
 {
   devparms->wave_mem_view_sample_start = val;
@@ -38,6 +38,9 @@
 #include "mainwindow.h"
 #include "global.h"
 #include "wave_view.h"
+#include "wave_pyramid.h"
+#include "wave_pyramid_thread.h"
+#include "capture_view.h"
 
 
 class UI_Mainwindow;
@@ -51,7 +54,7 @@ class UI_wave_window : public QDialog
 
 public:
 
-  UI_wave_window(struct device_settings *, short *wbuf[MAX_CHNS], QWidget *parent=0);
+  UI_wave_window(struct device_settings *, short *wbuf[MAX_CHNS], QWidget *parent=0, struct capview *view=NULL);
   ~UI_wave_window();
 
   void set_wavslider(void);
@@ -60,6 +63,12 @@ private:
 
 struct device_settings *devparms;
 
+struct wav_pyramid pyramid[MAX_CHNS];
+
+struct capview *cap_view;
+
+wave_pyramid_thread *pyr_thrd;
+
 UI_Mainwindow *mainwindow;
 
 QMenuBar     *menubar;
@@ -96,6 +105,9 @@ void center_position();
 void center_trigger();
 
 void save_wi_buffer_to_edf();
+void save_wi_buffer_to_raw();
+
+void pyramid_thread_finished();
 
 };
 
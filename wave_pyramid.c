@@ -0,0 +1,214 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wave_pyramid.h"
+
+
+
+int wavpyr_build(struct wav_pyramid *pyr, const short *buf, int n)
+{
+  int i, j, lvl, b, len;
+
+  short s_min, s_max;
+
+  const short *src_min, *src_max;
+
+  memset(pyr, 0, sizeof(struct wav_pyramid));
+
+  pyr->smps = n;
+
+  for(lvl=0, b=WAVPYR_FIRST_BUCKET; lvl<WAVPYR_MAX_LEVELS; lvl++, b*=WAVPYR_FACTOR)
+  {
+    len = n / b;
+
+    if(len < 2)
+    {
+      break;
+    }
+
+    pyr->min[lvl] = (short *)malloc(len * sizeof(short));
+    pyr->max[lvl] = (short *)malloc(len * sizeof(short));
+    if((pyr->min[lvl] == NULL) || (pyr->max[lvl] == NULL))
+    {
+      free(pyr->min[lvl]);
+      free(pyr->max[lvl]);
+
+      wavpyr_free(pyr);
+
+      return -1;
+    }
+
+    pyr->bucket[lvl] = b;
+
+    pyr->len[lvl] = len;
+
+    pyr->levels = lvl + 1;
+
+    if(lvl == 0)
+    {
+      for(i=0; i<len; i++)
+      {
+        s_min = s_max = buf[i * b];
+
+        for(j=1; j<b; j++)
+        {
+          if(buf[(i * b) + j] < s_min)  s_min = buf[(i * b) + j];
+          if(buf[(i * b) + j] > s_max)  s_max = buf[(i * b) + j];
+        }
+
+        pyr->min[lvl][i] = s_min;
+        pyr->max[lvl][i] = s_max;
+      }
+    }
+    else
+    {
+      src_min = pyr->min[lvl - 1];
+      src_max = pyr->max[lvl - 1];
+
+      for(i=0; i<len; i++)
+      {
+        s_min = src_min[i * WAVPYR_FACTOR];
+        s_max = src_max[i * WAVPYR_FACTOR];
+
+        for(j=1; j<WAVPYR_FACTOR; j++)
+        {
+          if(src_min[(i * WAVPYR_FACTOR) + j] < s_min)  s_min = src_min[(i * WAVPYR_FACTOR) + j];
+          if(src_max[(i * WAVPYR_FACTOR) + j] > s_max)  s_max = src_max[(i * WAVPYR_FACTOR) + j];
+        }
+
+        pyr->min[lvl][i] = s_min;
+        pyr->max[lvl][i] = s_max;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+void wavpyr_free(struct wav_pyramid *pyr)
+{
+  int i;
+
+  for(i=0; i<pyr->levels; i++)
+  {
+    free(pyr->min[i]);
+    free(pyr->max[i]);
+  }
+
+  memset(pyr, 0, sizeof(struct wav_pyramid));
+}
+
+
+/*
+ * The part of the range that is aligned to the buckets of level lvl
+ * is taken from that level, the edges from the levels below.
+ */
+static void wavpyr_range(const struct wav_pyramid *pyr, const short *buf, int lvl, int start, int end, short *s_min, short *s_max)
+{
+  int i, b, a_start, a_end;
+
+  if(start >= end)
+  {
+    return;
+  }
+
+  if(lvl < 0)
+  {
+    for(i=start; i<end; i++)
+    {
+      if(buf[i] < *s_min)  *s_min = buf[i];
+      if(buf[i] > *s_max)  *s_max = buf[i];
+    }
+
+    return;
+  }
+
+  b = pyr->bucket[lvl];
+
+  a_start = ((start + b - 1) / b) * b;
+
+  a_end = (end / b) * b;
+
+  if(a_end > (pyr->len[lvl] * b))
+  {
+    a_end = pyr->len[lvl] * b;
+  }
+
+  if(a_start >= a_end)
+  {
+    wavpyr_range(pyr, buf, lvl - 1, start, end, s_min, s_max);
+
+    return;
+  }
+
+  wavpyr_range(pyr, buf, lvl - 1, start, a_start, s_min, s_max);
+
+  for(i=a_start/b; i<a_end/b; i++)
+  {
+    if(pyr->min[lvl][i] < *s_min)  *s_min = pyr->min[lvl][i];
+    if(pyr->max[lvl][i] > *s_max)  *s_max = pyr->max[lvl][i];
+  }
+
+  wavpyr_range(pyr, buf, lvl - 1, a_end, end, s_min, s_max);
+}
+
+
+void wavpyr_minmax(const struct wav_pyramid *pyr, const short *buf, int start, int end, short *s_min, short *s_max)
+{
+  int lvl;
+
+  if(start < 0)
+  {
+    start = 0;
+  }
+
+  if(end > pyr->smps)
+  {
+    end = pyr->smps;
+  }
+
+  *s_min = 32767;
+  *s_max = -32768;
+
+  for(lvl=pyr->levels-1; lvl>=0; lvl--)  /* coarsest level that fits in the range */
+  {
+    if(pyr->bucket[lvl] <= (end - start))
+    {
+      break;
+    }
+  }
+
+  wavpyr_range(pyr, buf, lvl, start, end, s_min, s_max);
+}
+
+
@@ -0,0 +1,77 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef WAVE_PYRAMID_H
+#define WAVE_PYRAMID_H
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define WAVPYR_MAX_LEVELS     (12)
+#define WAVPYR_FIRST_BUCKET   (16)  /* samples per min/max pair of the first level */
+#define WAVPYR_FACTOR          (4)  /* every next level combines this number of pairs */
+
+
+/*
+ * Min/max (peak detect) decimation of a sample buffer.
+ * Level l holds the min and max of every bucket[l] samples,
+ * only complete buckets are stored.
+ */
+struct wav_pyramid
+{
+  int levels;
+  int smps;
+  int bucket[WAVPYR_MAX_LEVELS];
+  int len[WAVPYR_MAX_LEVELS];
+  short *min[WAVPYR_MAX_LEVELS];
+  short *max[WAVPYR_MAX_LEVELS];
+};
+
+
+/* returns 0 on success or -1 on malloc error, the pyramid keeps no reference to buf */
+int wavpyr_build(struct wav_pyramid *, const short *buf, int n);
+
+void wavpyr_free(struct wav_pyramid *);
+
+/* min and max of buf[start] to buf[end - 1], buf must be the buffer the pyramid was built from */
+void wavpyr_minmax(const struct wav_pyramid *, const short *buf, int start, int end, short *min, short *max);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif
+
+
@@ -0,0 +1,148 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#include "wave_pyramid_thread.h"
+
+
+wave_pyramid_thread::wave_pyramid_thread()
+{
+  int i;
+
+  smps = 0;
+
+  abort_req = 0;
+
+  pyramid = NULL;
+
+  cap_view = NULL;
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    wavbuf[i] = NULL;
+
+    built[i] = 0;
+  }
+}
+
+
+/* pyr[] must have MAX_CHNS elements, channels with a NULL buffer are skipped */
+void wave_pyramid_thread::set_buffers(struct wav_pyramid *pyr, short **wav, int n)
+{
+  int i;
+
+  pyramid = pyr;
+
+  smps = n;
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    wavbuf[i] = wav[i];
+
+    built[i] = 0;
+  }
+
+  __atomic_store_n(&abort_req, 0, __ATOMIC_RELAXED);
+}
+
+
+/* view->loaded is valid after the thread has finished, the buffers must not be used before */
+void wave_pyramid_thread::set_capview(struct capview *view)
+{
+  cap_view = view;
+}
+
+
+/* valid after the thread has finished */
+int wave_pyramid_thread::is_built(int chn)
+{
+  return built[chn];
+}
+
+
+/* skips the channels that are not started yet, wait() must still be called */
+void wave_pyramid_thread::abort(void)
+{
+  __atomic_store_n(&abort_req, 1, __ATOMIC_RELAXED);
+}
+
+
+void wave_pyramid_thread::run()
+{
+  int i;
+
+  if(cap_view != NULL)
+  {
+    if(capview_load(cap_view, &abort_req))
+    {
+      return;
+    }
+  }
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    if(__atomic_load_n(&abort_req, __ATOMIC_RELAXED))
+    {
+      return;
+    }
+
+    if(wavbuf[i] == NULL)
+    {
+      continue;
+    }
+
+    if(wavpyr_build(&pyramid[i], wavbuf[i], smps))
+    {
+      printf("Malloc error! file: %s  line: %i", __FILE__, __LINE__);  /* falls back to drawing every sample */
+
+      continue;
+    }
+
+    built[i] = 1;
+  }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
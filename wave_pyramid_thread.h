@@ -0,0 +1,102 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2015 - 2023 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef DEF_WAVE_PYRAMID_THREAD_H
+#define DEF_WAVE_PYRAMID_THREAD_H
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QObject>
+#include <QThread>
+
+#include "global.h"
+#include "wave_pyramid.h"
+#include "capture_view.h"
+
+
+
+/*
+ * Builds the min/max pyramids of the Wave Inspector in the background,
+ * so that the window opens without reading the whole sample buffer first.
+ * The samples of a saved capture that need a conversion are loaded first.
+ */
+class wave_pyramid_thread : public QThread
+{
+  Q_OBJECT
+
+public:
+
+  wave_pyramid_thread();
+
+  void set_buffers(struct wav_pyramid *, short **, int);
+  void set_capview(struct capview *);
+  int is_built(int);
+  void abort(void);
+
+private:
+
+  int smps,
+      built[MAX_CHNS],
+      abort_req;
+
+  short *wavbuf[MAX_CHNS];
+
+  struct wav_pyramid *pyramid;
+
+  struct capview *cap_view;
+
+  void run();
+};
+
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
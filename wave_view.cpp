@@ -33,6 +33,8 @@
 
 WaveCurve::WaveCurve(QWidget *w_parent) : QWidget(w_parent)
 {
+  int i;
+
   wavedialog = (UI_wave_window *)w_parent;
 
   setAttribute(Qt::WA_OpaquePaintEvent);
@@ -64,12 +66,23 @@ WaveCurve::WaveCurve(QWidget *w_parent) : QWidget(w_parent)
   old_w = 10000;
 
   devparms = NULL;
+
+  pyramid_pending = 0;
+
+  samples_pending = 0;
+
+  for(i=0; i<MAX_CHNS; i++)
+  {
+    pyramid[i] = NULL;
+  }
 }
 
 
 void WaveCurve::paintEvent(QPaintEvent *)
 {
   int i, chn,
+      smp1,
+      smp2,
       small_rulers,
       h_trace_offset,
       w_trace_offset,
@@ -80,6 +93,9 @@ void WaveCurve::paintEvent(QPaintEvent *)
       sample_end,
       t_pos;
 
+  short s_min,
+        s_max;
+
   double h_step=0.0,
          samples_per_div,
          step,
@@ -271,7 +287,14 @@ void WaveCurve::paintEvent(QPaintEvent *)
 
 /////////////////////////////////// draw the curve ///////////////////////////////////////////
 
-  if(bufsize > 32)
+  if(samples_pending)
+  {
+    painter->setPen(RasterColor);
+
+    painter->drawText(0, 0, curve_w, curve_h, Qt::AlignCenter, "Loading samples...");
+  }
+
+  if((bufsize > 32) && (!samples_pending))
   {
     painter->setClipping(true);
     painter->setClipRegion(QRegion(0, 0, curve_w, curve_h), Qt::ReplaceClip);
@@ -314,6 +337,61 @@ void WaveCurve::paintEvent(QPaintEvent *)
 
       painter->setPen(QPen(QBrush(SignalColor[chn], Qt::SolidPattern), tracewidth, Qt::SolidLine, Qt::SquareCap, Qt::BevelJoin));
 
+      if(((pyramid[chn] != NULL) || pyramid_pending) && (sample_range > (curve_w * 2)))
+      {
+        /* more than two samples per pixel, draw the min/max envelope of every pixel column */
+        for(i=0; i<curve_w; i++)
+        {
+          smp1 = sample_start + (int)(i / h_step);
+
+          smp2 = sample_start + (int)((i + 1) / h_step) + 1;  /* overlap one sample so that the columns connect */
+
+          if(smp2 > sample_end)
+          {
+            smp2 = sample_end;
+          }
+
+          if(smp1 >= smp2)
+          {
+            break;
+          }
+
+          if(pyramid[chn] != NULL)
+          {
+            wavpyr_minmax(pyramid[chn], devparms->wavebuf[chn], smp1, smp2, &s_min, &s_max);
+          }
+          else  /* the pyramid is not built yet, only the first sample of this and the next column */
+          {
+            s_min = devparms->wavebuf[chn][smp1];
+
+            s_max = devparms->wavebuf[chn][smp2 - 1];
+
+            if(s_min > s_max)
+            {
+              s_min = s_max;
+
+              s_max = devparms->wavebuf[chn][smp1];
+            }
+          }
+
+          if(devparms->displaytype)
+          {
+            painter->drawPoint(i + w_trace_offset, (s_min * v_sense) + h_trace_offset);
+
+            painter->drawPoint(i + w_trace_offset, (s_max * v_sense) + h_trace_offset);
+          }
+          else
+          {
+            painter->drawLine(i + w_trace_offset,
+                              (s_min * v_sense) + h_trace_offset,
+                              i + w_trace_offset,
+                              (s_max * v_sense) + h_trace_offset);
+          }
+        }
+
+        continue;
+      }
+
       for(i=0; i<sample_range; i++)
       {
         if(sample_range < (curve_w / 2))
@@ -417,6 +495,28 @@ void WaveCurve::setDeviceParameters(struct device_settings *devp)
 }
 
 
+void WaveCurve::setPyramid(int chn, struct wav_pyramid *pyr)
+{
+  if((chn < 0) || (chn >= MAX_CHNS))  return;
+
+  pyramid[chn] = pyr;
+}
+
+
+/* while set, channels without a pyramid are drawn sparsely instead of reading every sample */
+void WaveCurve::setPyramidPending(int pending)
+{
+  pyramid_pending = pending;
+}
+
+
+/* while set, the sample buffers are being filled and the traces are not drawn */
+void WaveCurve::setSamplesPending(int pending)
+{
+  samples_pending = pending;
+}
+
+
 void WaveCurve::drawTopLabels(QPainter *painter)
 {
   int i;
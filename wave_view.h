@@ -39,6 +39,7 @@
 
 #include "global.h"
 #include "utils.h"
+#include "wave_pyramid.h"
 #include "wave_dialog.h"
 
 
@@ -65,6 +66,9 @@ public:
   void setTextColor(QColor);
   void setBorderSize(int);
   void setDeviceParameters(struct device_settings *);
+  void setPyramid(int, struct wav_pyramid *);
+  void setPyramidPending(int);
+  void setSamplesPending(int);
 
 
 private slots:
@@ -93,7 +97,9 @@ private:
       mouse_x,
       mouse_y,
       mouse_old_x,
-      mouse_old_y;
+      mouse_old_y,
+      pyramid_pending,
+      samples_pending;
 
   void drawArrow(QPainter *, int, int, int, QColor, char);
   void drawSmallTriggerArrow(QPainter *, int, int, int, QColor);
@@ -106,6 +112,8 @@ private:
 
   struct device_settings *devparms;
 
+  struct wav_pyramid *pyramid[MAX_CHNS];
+
   UI_wave_window *wavedialog;
 
 protected: